@@ -57,6 +57,7 @@ private:
 
 public:
 	bool bMightKillPixels() { return false; }
+	bool bNeedsDestinationColor() { return false; }
 	bool bExecute( const shaderreg *i_pInput, vector4 &io_vColor, float32 &io_fDepth )
 	{
 		#ifdef ANTIALIAS_BOARD
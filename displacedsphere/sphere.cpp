@@ -35,6 +35,7 @@ class CSpherePS : public IMuli3DPixelShader
 {
 public:
 	bool bMightKillPixels() { return false; }
+	bool bNeedsDestinationColor() { return false; }
 	bool bExecute( const shaderreg *i_pInput, vector4 &io_vColor, float32 &io_fDepth )
 	{
 		SampleTexture( io_vColor, 0, i_pInput[0].x, i_pInput[0].y, 0.0f );
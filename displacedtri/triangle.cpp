@@ -61,6 +61,7 @@ class CTrianglePS : public IMuli3DPixelShader
 {
 public:
 	bool bMightKillPixels() { return false; }
+	bool bNeedsDestinationColor() { return false; }
 	bool bExecute( const shaderreg *i_pInput, vector4 &io_vColor, float32 &io_fDepth )
 	{
 		// read normal from normalmap
@@ -4,6 +4,7 @@
 
 #include "base.h"
 #include "../../libmuli3d/include/m3d.h"
+#include "camera.h"
 
 struct tCreationFlags
 {
@@ -32,7 +33,9 @@ public:
 	virtual void FrameMove() = 0;		// update animated objects, etc.
 	virtual void RenderWorld() = 0;		// draw objects
 
-	virtual result Present( CMuli3DRenderTarget *i_pRenderTarget ) = 0;
+	// Copies the rendertarget's colorbuffer to the backbuffer. If a source rectangle is passed, it is upscaled to the backbuffer's dimensions.
+	virtual result Present( CMuli3DRenderTarget *i_pRenderTarget, const m3drect *i_pSourceRect = 0, eUpscaleFilter i_UpscaleFilter = eUpscaleFilter_Bilinear ) = 0;
+	result Present( class CCamera *i_pCamera ); // Presents the camera's render rectangle, see CCamera::SetDynamicResolution()
 
 protected:
 	bool bCreateSubSystems( const tCreationFlags &i_creationFlags );
@@ -144,7 +147,8 @@ public:
 	virtual void FrameMove() = 0;		// update animated objects, etc.
 	virtual void RenderWorld() = 0;		// draw objects
 
-	result 	Present( CMuli3DRenderTarget *i_pRenderTarget );
+	using IApplication::Present;
+	result 	Present( CMuli3DRenderTarget *i_pRenderTarget, const m3drect *i_pSourceRect = 0, eUpscaleFilter i_UpscaleFilter = eUpscaleFilter_Bilinear );
 
 private:
 	void BeginFrame();
@@ -0,0 +1,59 @@
+
+#ifndef __ATLASBUILDER_H__
+#define __ATLASBUILDER_H__
+
+#include "../include/base.h"
+#include "../../libmuli3d/include/m3d.h"
+#include <vector>
+
+// Location of an image inside a texture array built by CAtlasBuilder. Sample the
+// array with u' = u * vTexCoordTransform.x + vTexCoordTransform.z,
+// v' = v * vTexCoordTransform.y + vTexCoordTransform.w and w = iLayer.
+struct tAtlasEntry
+{
+	string	sName;
+	uint32	iLayer;
+	vector4	vTexCoordTransform;
+};
+
+// Packs images into the layers of a single texture array, so that objects using
+// different images can share one texture and be drawn without texture switches.
+// If all images have the same dimensions each image gets a layer of its own,
+// otherwise the images are packed into shelves on layers of i_iLayerSize pixels.
+class CAtlasBuilder
+{
+public:
+	CAtlasBuilder( uint32 i_iLayerSize = 512, uint32 i_iPadding = 2 );
+	~CAtlasBuilder();
+
+	// Adds an image; its base mip-level is copied when the atlas is built.
+	// All images have to use the same format.
+	bool bAddImage( string i_sName, CMuli3DTexture *i_pImage );
+
+	// Builds the texture array with mip-sublevels generated on demand.
+	// o_Entries receives the location of each image, in the order they have been added.
+	CMuli3DTextureArray *pBuild( CMuli3DDevice *i_pDevice, vector<tAtlasEntry> &o_Entries );
+
+	// Returns true if all images have the same dimensions, i.e. each image will get a layer of its own.
+	bool bSameDimensions();
+
+	inline uint32 iGetNumImages() { return (uint32)m_Images.size(); }
+
+private:
+	struct tAtlasImage
+	{
+		string			sName;
+		CMuli3DTexture	*pImage;
+		uint32			iWidth, iHeight;
+		uint32			iLayer, iX, iY;	// placement, excluding padding
+	};
+
+	uint32 iPackShelves( uint32 i_iLayerSize );
+	void CopyImage( const tAtlasImage &i_Image, float32 *o_pLayer, uint32 i_iLayerWidth, uint32 i_iFloats, uint32 i_iPadding );
+
+private:
+	uint32				m_iLayerSize, m_iPadding;
+	vector<tAtlasImage>	m_Images;
+};
+
+#endif // __ATLASBUILDER_H__
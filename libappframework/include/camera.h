@@ -12,6 +12,12 @@ enum eVisibility
 	eVisibility_CompletelyIn
 };
 
+enum eUpscaleFilter
+{
+	eUpscaleFilter_Bilinear = 0,
+	eUpscaleFilter_EdgeAware	// bilinear, but taps differing in luminance from the nearest one are weighted down
+};
+
 class CCamera
 {
 public:
@@ -21,6 +27,18 @@ public:
 	// Create rendersurface/depthsurface and replaces set ones+viewport with them -> after calling this you can't change surfaces anymore!
 	bool bCreateRenderCamera( uint32 i_iWidth, uint32 i_iHeight, m3dformat i_fmtFrameBuffer = m3dfmt_r32g32b32f, bool i_bDepthBuffer = true );
 
+	// Dynamic resolution: the camera renders to the top-left sub-rectangle GetRenderRect() of its surfaces, which is scaled by a frame time governor
+	// in BeginRender() so that the measured frame time approaches i_fFrameTimeBudget. Within +/- i_fHysteresis (relative to the budget) the
+	// resolution is kept. Present the camera with IApplication::Present( CCamera * ) to upscale the rectangle to the backbuffer.
+	void SetDynamicResolution( bool i_bEnable, float32 i_fFrameTimeBudget = 1.0f / 30.0f, float32 i_fMinScale = 0.5f, float32 i_fHysteresis = 0.1f, eUpscaleFilter i_UpscaleFilter = eUpscaleFilter_Bilinear );
+	void UpdateDynamicResolution( float32 i_fFrameTime ); // Called by BeginRender() with the last frame's duration
+
+	// Interleaved rendering: every frame only the pixels of one phase of the pattern are rendered (see m3drs_interleave), the others keep their
+	// color of previous frames, so a still image converges after CMuli3DSurface::iGetInterleavePhases() frames - don't clear the colorbuffer!
+	// In frames, in which the view has changed, EndRender() reconstructs the other pixels from their neighbours instead.
+	void SetInterleavedRendering( m3dinterleave i_Interleave );
+	inline void InvalidateHistory() { m_bHistoryValid = false; } // Call this if the scene has changed, but the view hasn't
+
 	void CalculateProjection( float32 i_fFOVAngle, float32 i_fViewDistance, float32 i_fNearClippingPlane = 1.0f, float32 i_fAspect = 4.0f / 3.0f ); // Call this before calling CalculateView(), because the projection matrix is needed for frustum calcs!
 	void CalculateView(); // Has to be called after making changes to camera position / rotation ...
 
@@ -37,12 +55,21 @@ public:
 
 private:
 	void BuildFrustum();
+	void SetRenderRect( uint32 i_iWidth, uint32 i_iHeight );
 
 public:
 	inline class CGraphics *pGetParent() { return m_pParent; }
 
 	inline CMuli3DRenderTarget *pGetRenderTarget() { return m_pRenderTarget; }
 
+	inline bool bGetDynamicResolution() { return m_bDynamicResolution; }
+	inline float32 fGetResolutionScale() { return m_fResolutionScale; }
+	inline const m3drect &GetRenderRect() { return m_RenderRect; }
+	inline eUpscaleFilter GetUpscaleFilter() { return m_UpscaleFilter; }
+
+	inline m3dinterleave GetInterleave() { return m_Interleave; }
+	inline bool bGetConverged() { return m_iStaticFrames + 1 >= CMuli3DSurface::iGetInterleavePhases( m_Interleave ); } // True if every pixel has been rendered with the current view after EndRender()
+
 	inline void SetWorldMatrix( const matrix44 &i_matWorld ) { m_matWorld = i_matWorld; }
 	inline void SetViewMatrix( const matrix44 &i_matView ) { m_matView = i_matView; }
 	inline void SetProjectionMatrix( const matrix44 &i_matProjection ) { m_matProjection = i_matProjection; }
@@ -76,6 +103,19 @@ public:
 	CMuli3DRenderTarget *m_pRenderTarget;
 	bool m_bLockedSurfacesViewport;
 
+	uint32		m_iWidth, m_iHeight;
+	m3drect		m_RenderRect;
+	bool		m_bDynamicResolution;
+	float32		m_fFrameTimeBudget, m_fMinScale, m_fHysteresis;
+	float32		m_fResolutionScale, m_fSmoothedFrameTime;
+	eUpscaleFilter	m_UpscaleFilter;
+
+	m3dinterleave	m_Interleave;
+	uint32		m_iInterleavePhase, m_iStaticFrames;
+	bool		m_bHistoryValid;
+	matrix44	m_matHistoryView, m_matHistoryProjection;
+	m3drect		m_HistoryRect;
+
 	matrix44	m_matWorld, m_matView, m_matProjection;
 	plane		m_plFrustum[6];
 
@@ -6,12 +6,14 @@
 #include "graphics.h"
 #include "resmanager.h"
 #include "application.h"
+#include "atlasbuilder.h"
 
 enum eTextureType
 {
-	eTextureType_Default,	// either animated or non-animated 2d texture
+	eTextureType_Default,	// non-animated 2d texture
 //	eTextureType_Volume,
-	eTextureType_Cube
+	eTextureType_Cube,
+	eTextureType_Array		// animated texture or atlas; the layer is selected by the w texture coordinate
 };
 
 class CTexture
@@ -21,6 +23,7 @@ protected:
 	friend void *pLoadTexture( CResManager *i_pParent, string i_sFilename );
 	friend void *pLoadCubeTexture( CResManager *i_pParent, string i_sFilename );
 	friend void *pLoadAnimatedTexture( CResManager *i_pParent, string i_sFilename );
+	friend void *pLoadTextureAtlas( CResManager *i_pParent, string i_sFilename );
 	friend void UnloadTexture( CResManager *i_pParent, void *i_pResource );
 
 	CTexture( CResManager *i_pParent, CMuli3DTexture *i_pTexture )
@@ -31,6 +34,8 @@ protected:
 		m_ppTextures = new CMuli3DTexture *[m_iNumTextures];
 		m_ppTextures[0] = i_pTexture;
 		m_pCubeTexture = 0;
+		m_pTextureArray = 0;
+		m_fFPS = 0.0f;
 		m_eTextureType = eTextureType_Default;
 	}
 
@@ -41,24 +46,29 @@ protected:
 		m_iNumTextures = 0;
 		m_ppTextures = 0;
 		m_pCubeTexture = i_pCubeTexture;
+		m_pTextureArray = 0;
+		m_fFPS = 0.0f;
 		m_eTextureType = eTextureType_Cube;
 	}
 
-	CTexture( CResManager *i_pParent, uint32 i_iNumTextures, float32 i_fFPS, CMuli3DTexture **i_ppTexture )
+	CTexture( CResManager *i_pParent, CMuli3DTextureArray *i_pTextureArray, float32 i_fFPS, const vector<tAtlasEntry> &i_AtlasEntries )
 	{	
-		// animated texture
+		// animated texture (one frame per layer) or atlas
 		m_pParent = i_pParent;
-		m_iNumTextures = i_iNumTextures;
-		m_fFPS = i_fFPS;
-		m_ppTextures = (CMuli3DTexture **)i_ppTexture;
-		m_fCurTexture = 0.0f;
+		m_iNumTextures = 0;
+		m_ppTextures = 0;
 		m_pCubeTexture = 0;
-		m_eTextureType = eTextureType_Default;
+		m_pTextureArray = i_pTextureArray;
+		m_fFPS = i_fFPS;
+		m_fCurLayer = 0.0f;
+		m_AtlasEntries = i_AtlasEntries;
+		m_eTextureType = eTextureType_Array;
 	}
 
 	~CTexture()
 	{
 		SAFE_RELEASE( m_pCubeTexture );
+		SAFE_RELEASE( m_pTextureArray );
 
 		for( uint32 i = 0; i < m_iNumTextures; ++i )
 			SAFE_RELEASE( m_ppTextures[i] );
@@ -78,16 +88,41 @@ public:
 		if( m_pCubeTexture )
 			return m_pCubeTexture;
 
-		m_fCurTexture += m_fFPS * m_pParent->pGetParent()->fGetInvFPS();
+		return m_pTextureArray;
+	}
+
+	// Returns the layer to be passed as w texture coordinate. Animated textures
+	// advance to the next frame, so this should be called once per frame; the
+	// texture itself stays bound.
+	inline float32 fGetLayer()
+	{
+		if( !m_pTextureArray || m_fFPS <= 0.0f )
+			return 0.0f;
 
-		uint32 iTexIndex = (uint32)m_fCurTexture;
-		if( iTexIndex >= m_iNumTextures )
+		m_fCurLayer += m_fFPS * m_pParent->pGetParent()->fGetInvFPS();
+
+		uint32 iLayer = (uint32)m_fCurLayer;
+		if( iLayer >= m_pTextureArray->iGetNumLayers() )
 		{
-			m_fCurTexture = 0;
-			iTexIndex = 0;
+			m_fCurLayer = 0;
+			iLayer = 0;
 		}
 
-		return m_ppTextures[iTexIndex];
+		return (float32)iLayer;
+	}
+
+	// Atlas entries, in the order the images are listed in the atlas file.
+	inline uint32 iGetNumAtlasEntries() { return (uint32)m_AtlasEntries.size(); }
+	inline const tAtlasEntry &GetAtlasEntry( uint32 i_iEntry ) { return m_AtlasEntries[i_iEntry]; }
+
+	const tAtlasEntry *pFindAtlasEntry( string i_sName )
+	{
+		for( uint32 i = 0; i < m_AtlasEntries.size(); ++i )
+		{
+			if( m_AtlasEntries[i].sName == i_sName )
+				return &m_AtlasEntries[i];
+		}
+		return 0;
 	}
 
 	inline eTextureType eGetTextureType() { return m_eTextureType; }
@@ -97,7 +132,9 @@ private:
 	uint32				m_iNumTextures;
 	CMuli3DTexture		**m_ppTextures;
 	CMuli3DCubeTexture	*m_pCubeTexture;
-	float32				m_fFPS, m_fCurTexture;
+	CMuli3DTextureArray	*m_pTextureArray;
+	float32				m_fFPS, m_fCurLayer;
+	vector<tAtlasEntry>	m_AtlasEntries;
 	eTextureType		m_eTextureType;
 };
 
@@ -86,6 +86,20 @@ bool IApplication::bCreateSubSystems( const tCreationFlags &i_creationFlags )
 	return true;
 }
 
+result IApplication::Present( CCamera *i_pCamera )
+{
+	if( !i_pCamera )
+	{
+		FUNC_FAILING( "IApplication::Present: parameter i_pCamera points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	if( !i_pCamera->bGetDynamicResolution() )
+		return Present( i_pCamera->pGetRenderTarget() );
+
+	return Present( i_pCamera->pGetRenderTarget(), &i_pCamera->GetRenderRect(), i_pCamera->GetUpscaleFilter() );
+}
+
 // ----------------------------------------------------------------------------
 
 #ifdef WIN32
@@ -411,7 +425,7 @@ void CApplication::EndFrame()
 	memcpy( &m_LastTime, &theCurrentTime, sizeof( m_LastTime ) );
 }
 
-result CApplication::Present( CMuli3DRenderTarget *i_pRenderTarget )
+result CApplication::Present( CMuli3DRenderTarget *i_pRenderTarget, const m3drect *i_pSourceRect, eUpscaleFilter i_UpscaleFilter )
 {
 	if( !i_pRenderTarget )
 	{
@@ -427,12 +441,38 @@ result CApplication::Present( CMuli3DRenderTarget *i_pRenderTarget )
 		return e_invalidstate;
 	}
 
-	if( pColorBuffer->iGetWidth() != m_pBackbuffer->w ||
-		pColorBuffer->iGetHeight() != m_pBackbuffer->h )
+	if( pColorBuffer->iGetSamples() > 1 )
 	{
 		SAFE_RELEASE( pColorBuffer );
-		FUNC_FAILING( "CMuli3DDevice::Present: colorbuffer's dimensions don't match backbuffer\n" );
-		return e_invalidstate;
+		FUNC_FAILING( "CMuli3DDevice::Present: colorbuffer is multisampled - call ResolveToSurface() first!\n" );
+		return e_invalidformat;
+	}
+
+	m3drect SourceRect;
+	if( i_pSourceRect )
+	{
+		if( i_pSourceRect->iRight > pColorBuffer->iGetWidth() || i_pSourceRect->iBottom > pColorBuffer->iGetHeight() ||
+			i_pSourceRect->iLeft >= i_pSourceRect->iRight || i_pSourceRect->iTop >= i_pSourceRect->iBottom )
+		{
+			SAFE_RELEASE( pColorBuffer );
+			FUNC_FAILING( "CMuli3DDevice::Present: invalid source rectangle\n" );
+			return e_invalidparameters;
+		}
+
+		SourceRect = *i_pSourceRect;
+	}
+	else
+	{
+		if( pColorBuffer->iGetWidth() != m_pBackbuffer->w ||
+			pColorBuffer->iGetHeight() != m_pBackbuffer->h )
+		{
+			SAFE_RELEASE( pColorBuffer );
+			FUNC_FAILING( "CMuli3DDevice::Present: colorbuffer's dimensions don't match backbuffer\n" );
+			return e_invalidstate;
+		}
+
+		SourceRect.iLeft = 0; SourceRect.iRight = pColorBuffer->iGetWidth();
+		SourceRect.iTop = 0; SourceRect.iBottom = pColorBuffer->iGetHeight();
 	}
 
 	const uint32 iFloats = pColorBuffer->iGetFormatFloats();
@@ -453,19 +493,110 @@ result CApplication::Present( CMuli3DRenderTarget *i_pRenderTarget )
 
 	SDL_LockSurface( m_pBackbuffer );
 
-	// Copy pixels to the backbuffer surface ----------------------------------------
+	const uint32 iSourceWidth = SourceRect.iRight - SourceRect.iLeft;
+	const uint32 iSourceHeight = SourceRect.iBottom - SourceRect.iTop;
+	const uint32 iSourcePitch = pColorBuffer->iGetWidth() * iFloats;
+	if( iSourceWidth == (uint32)m_pBackbuffer->w && iSourceHeight == (uint32)m_pBackbuffer->h )
+	{
+		// Copy pixels to the backbuffer surface ----------------------------------
+
+		// 24-bit
+		for( int32 iY = 0; iY < m_pBackbuffer->h; ++iY )
+		{
+			const float32 *pSourceRow = &pSource[(SourceRect.iTop + iY) * iSourcePitch + SourceRect.iLeft * iFloats];
+			uint8 *pDestination = (uint8 *)m_pBackbuffer->pixels + iY * m_pBackbuffer->pitch;
+			for( int32 iX = 0; iX < m_pBackbuffer->w; ++iX )
+			{
+				pDestination[0] = iClamp( ftol( pSourceRow[2] * 255.0f ), 0, 255 ); // b
+				pDestination[1] = iClamp( ftol( pSourceRow[1] * 255.0f ), 0, 255 ); // g
+				pDestination[2] = iClamp( ftol( pSourceRow[0] * 255.0f ), 0, 255 ); // r
 
-	// 24-bit
-	uint8 *pDestination = (uint8 *)m_pBackbuffer->pixels;
-	uint32 iPixels = m_pBackbuffer->w * m_pBackbuffer->h;
-	while( iPixels-- )
+				pSourceRow += iFloats;
+				pDestination += 3;
+			}
+		}
+	}
+	else
 	{
-		pDestination[0] = iClamp( ftol( pSource[2] * 255.0f ), 0, 255 ); // b
-		pDestination[1] = iClamp( ftol( pSource[1] * 255.0f ), 0, 255 ); // g
-		pDestination[2] = iClamp( ftol( pSource[0] * 255.0f ), 0, 255 ); // r
+		// Upscale the source rectangle to the backbuffer -------------------------
+
+		// Precompute horizontal taps and weights, which are the same for every row.
+		int32 *pTapX = new int32[m_pBackbuffer->w * 2];
+		float32 *pWeightX = new float32[m_pBackbuffer->w];
+		if( !pTapX || !pWeightX )
+		{
+			SAFE_DELETE_ARRAY( pTapX );
+			SAFE_DELETE_ARRAY( pWeightX );
+			SDL_UnlockSurface( m_pBackbuffer );
+			pColorBuffer->UnlockRect();
+			SAFE_RELEASE( pColorBuffer );
+			FUNC_FAILING( "CMuli3DDevice::Present: out of memory, cannot upscale.\n" );
+			return e_outofmemory;
+		}
+
+		const float32 fScaleX = (float32)iSourceWidth / (float32)m_pBackbuffer->w;
+		for( int32 iX = 0; iX < m_pBackbuffer->w; ++iX )
+		{
+			const float32 fX = fClamp( ( (float32)iX + 0.5f ) * fScaleX - 0.5f, 0.0f, (float32)( iSourceWidth - 1 ) );
+			const int32 iX0 = ftol( floorf( fX ) );
+			pTapX[iX * 2 + 0] = ( SourceRect.iLeft + iX0 ) * iFloats;
+			pTapX[iX * 2 + 1] = ( SourceRect.iLeft + ( iX0 + 1 < (int32)iSourceWidth ? iX0 + 1 : iX0 ) ) * iFloats;
+			pWeightX[iX] = fX - (float32)iX0;
+		}
+
+		const float32 fScaleY = (float32)iSourceHeight / (float32)m_pBackbuffer->h;
+		for( int32 iY = 0; iY < m_pBackbuffer->h; ++iY )
+		{
+			const float32 fY = fClamp( ( (float32)iY + 0.5f ) * fScaleY - 0.5f, 0.0f, (float32)( iSourceHeight - 1 ) );
+			const int32 iY0 = ftol( floorf( fY ) );
+			const float32 fWeightY = fY - (float32)iY0;
+			const float32 *pSourceRow0 = &pSource[(SourceRect.iTop + iY0) * iSourcePitch];
+			const float32 *pSourceRow1 = &pSource[(SourceRect.iTop + ( iY0 + 1 < (int32)iSourceHeight ? iY0 + 1 : iY0 )) * iSourcePitch];
+
+			uint8 *pDestination = (uint8 *)m_pBackbuffer->pixels + iY * m_pBackbuffer->pitch;
+			for( int32 iX = 0; iX < m_pBackbuffer->w; ++iX, pDestination += 3 )
+			{
+				const float32 *pTaps[4] = { &pSourceRow0[pTapX[iX * 2 + 0]], &pSourceRow0[pTapX[iX * 2 + 1]],
+					&pSourceRow1[pTapX[iX * 2 + 0]], &pSourceRow1[pTapX[iX * 2 + 1]] };
+				const float32 fWeightX = pWeightX[iX];
+				float32 fWeights[4] = { ( 1.0f - fWeightX ) * ( 1.0f - fWeightY ), fWeightX * ( 1.0f - fWeightY ),
+					( 1.0f - fWeightX ) * fWeightY, fWeightX * fWeightY };
+
+				if( i_UpscaleFilter == eUpscaleFilter_EdgeAware )
+				{
+					// Weight down taps, whose luminance differs from the nearest tap's, so that edges aren't smeared.
+					float32 fLuminance[4];
+					uint32 iNearest = 0;
+					for( uint32 iTap = 0; iTap < 4; ++iTap )
+					{
+						fLuminance[iTap] = pTaps[iTap][0] * 0.299f + pTaps[iTap][1] * 0.587f + pTaps[iTap][2] * 0.114f;
+						if( fWeights[iTap] > fWeights[iNearest] )
+							iNearest = iTap;
+					}
+
+					float32 fWeightSum = 0.0f;
+					for( uint32 iTap = 0; iTap < 4; ++iTap )
+					{
+						fWeights[iTap] /= 1.0f + 16.0f * fabsf( fLuminance[iTap] - fLuminance[iNearest] );
+						fWeightSum += fWeights[iTap];
+					}
+
+					const float32 fInvWeightSum = 1.0f / fWeightSum;
+					for( uint32 iTap = 0; iTap < 4; ++iTap )
+						fWeights[iTap] *= fInvWeightSum;
+				}
+
+				for( uint32 iChannel = 0; iChannel < 3; ++iChannel )
+				{
+					const float32 fValue = pTaps[0][iChannel] * fWeights[0] + pTaps[1][iChannel] * fWeights[1] +
+						pTaps[2][iChannel] * fWeights[2] + pTaps[3][iChannel] * fWeights[3];
+					pDestination[2 - iChannel] = iClamp( ftol( fValue * 255.0f ), 0, 255 ); // bgr
+				}
+			}
+		}
 
-		pSource += iFloats;
-		pDestination += 3;
+		SAFE_DELETE_ARRAY( pWeightX );
+		SAFE_DELETE_ARRAY( pTapX );
 	}
 
 	SDL_UnlockSurface( m_pBackbuffer );
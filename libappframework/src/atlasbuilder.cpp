@@ -0,0 +1,198 @@
+
+#include "../include/atlasbuilder.h"
+#include <algorithm>
+
+CAtlasBuilder::CAtlasBuilder( uint32 i_iLayerSize, uint32 i_iPadding )
+{
+	m_iLayerSize = i_iLayerSize;
+	m_iPadding = i_iPadding;
+}
+
+CAtlasBuilder::~CAtlasBuilder()
+{
+	for( uint32 i = 0; i < m_Images.size(); ++i )
+		SAFE_RELEASE( m_Images[i].pImage );
+}
+
+bool CAtlasBuilder::bAddImage( string i_sName, CMuli3DTexture *i_pImage )
+{
+	if( !i_pImage )
+		return false;
+
+	tAtlasImage Image;
+	Image.sName = i_sName;
+	Image.pImage = i_pImage;
+	Image.iWidth = i_pImage->iGetWidth();
+	Image.iHeight = i_pImage->iGetHeight();
+	Image.iLayer = Image.iX = Image.iY = 0;
+
+	i_pImage->AddRef();
+	m_Images.push_back( Image );
+	return true;
+}
+
+bool CAtlasBuilder::bSameDimensions()
+{
+	for( uint32 i = 1; i < m_Images.size(); ++i )
+	{
+		if( m_Images[i].iWidth != m_Images[0].iWidth || m_Images[i].iHeight != m_Images[0].iHeight )
+			return false;
+	}
+	return true;
+}
+
+static bool bTallerImage( const pair<uint32, uint32> &i_A, const pair<uint32, uint32> &i_B )
+{
+	return i_A.first > i_B.first;
+}
+
+uint32 CAtlasBuilder::iPackShelves( uint32 i_iLayerSize )
+{
+	// place images in order of decreasing height, so that the shelves waste little space
+	vector<pair<uint32, uint32> > Order; // (padded height, image index)
+	for( uint32 i = 0; i < m_Images.size(); ++i )
+		Order.push_back( pair<uint32, uint32>( m_Images[i].iHeight + 2 * m_iPadding, i ) );
+	stable_sort( Order.begin(), Order.end(), bTallerImage );
+
+	uint32 iLayer = 0, iShelfY = 0, iShelfHeight = 0, iX = 0;
+	for( uint32 i = 0; i < Order.size(); ++i )
+	{
+		tAtlasImage &Image = m_Images[Order[i].second];
+		const uint32 iPaddedWidth = Image.iWidth + 2 * m_iPadding;
+		const uint32 iPaddedHeight = Order[i].first;
+
+		if( iX + iPaddedWidth > i_iLayerSize )
+		{
+			// start a new shelf
+			iShelfY += iShelfHeight;
+			iShelfHeight = 0;
+			iX = 0;
+		}
+
+		if( iShelfY + iPaddedHeight > i_iLayerSize )
+		{
+			// start a new layer
+			++iLayer;
+			iShelfY = 0;
+			iShelfHeight = 0;
+			iX = 0;
+		}
+
+		Image.iLayer = iLayer;
+		Image.iX = iX + m_iPadding;
+		Image.iY = iShelfY + m_iPadding;
+
+		iX += iPaddedWidth;
+		if( iPaddedHeight > iShelfHeight )
+			iShelfHeight = iPaddedHeight;
+	}
+
+	return iLayer + 1;
+}
+
+void CAtlasBuilder::CopyImage( const tAtlasImage &i_Image, float32 *o_pLayer, uint32 i_iLayerWidth, uint32 i_iFloats, uint32 i_iPadding )
+{
+	float32 *pSrc = 0;
+	if( FUNC_FAILED( i_Image.pImage->LockRect( 0, (void **)&pSrc, 0 ) ) )
+		return;
+
+	const uint32 iSrcFloats = i_Image.pImage->iGetFormatFloats();
+
+	// copy the image and replicate its borders into the padding, which limits
+	// bleeding of neighboring images when filtering
+	const int32 iPadding = (int32)i_iPadding;
+	for( int32 iY = -iPadding; iY < (int32)i_Image.iHeight + iPadding; ++iY )
+	{
+		const int32 iSrcY = iY < 0 ? 0 : ( iY >= (int32)i_Image.iHeight ? i_Image.iHeight - 1 : iY );
+		float32 *pDest = &o_pLayer[( ( i_Image.iY + iY ) * i_iLayerWidth + i_Image.iX - iPadding ) * i_iFloats];
+		for( int32 iX = -iPadding; iX < (int32)i_Image.iWidth + iPadding; ++iX, pDest += i_iFloats )
+		{
+			const int32 iSrcX = iX < 0 ? 0 : ( iX >= (int32)i_Image.iWidth ? i_Image.iWidth - 1 : iX );
+			const float32 *pPixel = &pSrc[( iSrcY * i_Image.iWidth + iSrcX ) * iSrcFloats];
+
+			// expand to the atlas' format; missing alpha is 1
+			for( uint32 i = 0; i < i_iFloats; ++i )
+				pDest[i] = i < iSrcFloats ? pPixel[i] : ( i == 3 ? 1.0f : 0.0f );
+		}
+	}
+
+	i_Image.pImage->UnlockRect( 0 );
+}
+
+CMuli3DTextureArray *CAtlasBuilder::pBuild( CMuli3DDevice *i_pDevice, vector<tAtlasEntry> &o_Entries )
+{
+	o_Entries.clear();
+	if( !i_pDevice || !m_Images.size() )
+		return 0;
+
+	// the atlas uses the format with the most channels
+	m3dformat fmtFormat = m_Images[0].pImage->fmtGetFormat();
+	uint32 iMaxDimension = 0;
+	for( uint32 i = 0; i < m_Images.size(); ++i )
+	{
+		if( m_Images[i].pImage->fmtGetFormat() > fmtFormat )
+			fmtFormat = m_Images[i].pImage->fmtGetFormat();
+		iMaxDimension = max( iMaxDimension, max( m_Images[i].iWidth, m_Images[i].iHeight ) );
+	}
+
+	uint32 iLayerWidth, iLayerHeight, iNumLayers, iPadding;
+	if( bSameDimensions() )
+	{
+		// one image per layer
+		iLayerWidth = m_Images[0].iWidth;
+		iLayerHeight = m_Images[0].iHeight;
+		iNumLayers = (uint32)m_Images.size();
+		for( uint32 i = 0; i < iNumLayers; ++i )
+		{
+			m_Images[i].iLayer = i;
+			m_Images[i].iX = m_Images[i].iY = 0;
+		}
+		iPadding = 0;
+	}
+	else
+	{
+		iLayerWidth = iLayerHeight = max( m_iLayerSize, iMaxDimension + 2 * m_iPadding );
+		iNumLayers = iPackShelves( iLayerWidth );
+		iPadding = m_iPadding;
+	}
+
+	CMuli3DTextureArray *pTextureArray = 0;
+	if( FUNC_FAILED( i_pDevice->CreateTextureArray( &pTextureArray, iLayerWidth, iLayerHeight, iNumLayers, 0, fmtFormat ) ) )
+		return 0;
+
+	const uint32 iFloats = pTextureArray->iGetFormatFloats();
+	for( uint32 iLayer = 0; iLayer < iNumLayers; ++iLayer )
+	{
+		float32 *pLayer = 0;
+		if( FUNC_FAILED( pTextureArray->LockRect( iLayer, 0, (void **)&pLayer, 0 ) ) )
+			continue;
+
+		memset( pLayer, 0, sizeof( float32 ) * iLayerWidth * iLayerHeight * iFloats );
+		for( uint32 i = 0; i < m_Images.size(); ++i )
+		{
+			if( m_Images[i].iLayer == iLayer )
+				CopyImage( m_Images[i], pLayer, iLayerWidth, iFloats, iPadding );
+		}
+
+		pTextureArray->UnlockRect( iLayer, 0 );
+	}
+
+	// texture coordinates map [0,1] to the centers of the border pixels
+	const float32 fInvLayerWidth = iLayerWidth > 1 ? 1.0f / (float32)( iLayerWidth - 1 ) : 0.0f;
+	const float32 fInvLayerHeight = iLayerHeight > 1 ? 1.0f / (float32)( iLayerHeight - 1 ) : 0.0f;
+	for( uint32 i = 0; i < m_Images.size(); ++i )
+	{
+		const tAtlasImage &Image = m_Images[i];
+
+		tAtlasEntry Entry;
+		Entry.sName = Image.sName;
+		Entry.iLayer = Image.iLayer;
+		Entry.vTexCoordTransform = vector4( (float32)( Image.iWidth - 1 ) * fInvLayerWidth,
+			(float32)( Image.iHeight - 1 ) * fInvLayerHeight,
+			(float32)Image.iX * fInvLayerWidth, (float32)Image.iY * fInvLayerHeight );
+		o_Entries.push_back( Entry );
+	}
+
+	pTextureArray->SetAutoGenMipSubLevels( true ); // mip-sublevels are generated on first use
+	return pTextureArray;
+}
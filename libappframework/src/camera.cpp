@@ -13,6 +13,21 @@ CCamera::CCamera( CGraphics *i_pParent )
 
 	m_bLockedSurfacesViewport = false;
 
+	m_iWidth = 0; m_iHeight = 0;
+	memset( &m_RenderRect, 0, sizeof( m_RenderRect ) );
+	m_bDynamicResolution = false;
+	m_fFrameTimeBudget = 1.0f / 30.0f;
+	m_fMinScale = 0.5f;
+	m_fHysteresis = 0.1f;
+	m_fResolutionScale = 1.0f;
+	m_fSmoothedFrameTime = 0.0f;
+	m_UpscaleFilter = eUpscaleFilter_Bilinear;
+
+	m_Interleave = m3dil_none;
+	m_iInterleavePhase = 0;
+	m_iStaticFrames = 0;
+	m_bHistoryValid = false;
+
 	matMatrix44Identity( m_matWorld );
 	matMatrix44Identity( m_matView );
 	matMatrix44Identity( m_matProjection );
@@ -48,9 +63,9 @@ bool CCamera::bCreateRenderCamera( uint32 i_iWidth, uint32 i_iHeight, m3dformat
 	}
 
 	// Set the viewport -------------------------------------------------------
-	matrix44 matViewport;
-	matMatrix44Viewport( matViewport, 0, 0, i_iWidth, i_iHeight, 0.0f, 1.0f );
-	m_pRenderTarget->SetViewportMatrix( matViewport );
+	m_iWidth = i_iWidth; m_iHeight = i_iHeight;
+	m_fResolutionScale = 1.0f;
+	SetRenderRect( i_iWidth, i_iHeight );
 	
 	m_pRenderTarget->SetColorBuffer( pColorBuffer );
 	m_pRenderTarget->SetDepthBuffer( pDepthBuffer );
@@ -63,17 +78,101 @@ bool CCamera::bCreateRenderCamera( uint32 i_iWidth, uint32 i_iHeight, m3dformat
 	return true;
 }
 
+void CCamera::SetDynamicResolution( bool i_bEnable, float32 i_fFrameTimeBudget, float32 i_fMinScale, float32 i_fHysteresis, eUpscaleFilter i_UpscaleFilter )
+{
+	m_bDynamicResolution = i_bEnable;
+	m_fFrameTimeBudget = i_fFrameTimeBudget;
+	m_fMinScale = fClamp( i_fMinScale, 0.1f, 1.0f );
+	m_fHysteresis = fClamp( i_fHysteresis, 0.0f, 0.9f );
+	m_UpscaleFilter = i_UpscaleFilter;
+
+	// Restart at full resolution ---------------------------------------------
+	m_fResolutionScale = 1.0f;
+	m_fSmoothedFrameTime = 0.0f;
+	if( m_bLockedSurfacesViewport )
+		SetRenderRect( m_iWidth, m_iHeight );
+}
+
+void CCamera::UpdateDynamicResolution( float32 i_fFrameTime )
+{
+	if( !m_bDynamicResolution || !m_bLockedSurfacesViewport || i_fFrameTime <= 0.0f || m_fFrameTimeBudget <= 0.0f )
+		return;
+
+	// Smooth the measured frame time, so that single spikes are ignored ------
+	if( m_fSmoothedFrameTime <= 0.0f )
+		m_fSmoothedFrameTime = i_fFrameTime;
+	else
+		m_fSmoothedFrameTime += ( i_fFrameTime - m_fSmoothedFrameTime ) * 0.25f;
+
+	// Adjust the scale only when leaving the hysteresis band -----------------
+	if( m_fSmoothedFrameTime <= m_fFrameTimeBudget * ( 1.0f + m_fHysteresis ) &&
+		m_fSmoothedFrameTime >= m_fFrameTimeBudget * ( 1.0f - m_fHysteresis ) )
+		return;
+
+	// Rendering cost is proportional to the number of pixels, which is the square of the scale.
+	// Steps are limited - decreasing quickly, but increasing slowly to avoid oscillation.
+	const float32 fStep = fClamp( sqrtf( m_fFrameTimeBudget / m_fSmoothedFrameTime ), 0.8f, 1.1f );
+	m_fResolutionScale = fClamp( m_fResolutionScale * fStep, m_fMinScale, 1.0f );
+
+	const uint32 iWidth = ftol( (float32)m_iWidth * m_fResolutionScale + 0.5f );
+	const uint32 iHeight = ftol( (float32)m_iHeight * m_fResolutionScale + 0.5f );
+	SetRenderRect( iWidth > 0 ? iWidth : 1, iHeight > 0 ? iHeight : 1 );
+}
+
+void CCamera::SetRenderRect( uint32 i_iWidth, uint32 i_iHeight )
+{
+	if( m_RenderRect.iRight == i_iWidth && m_RenderRect.iBottom == i_iHeight )
+		return;
+
+	m_RenderRect.iLeft = 0; m_RenderRect.iTop = 0;
+	m_RenderRect.iRight = i_iWidth; m_RenderRect.iBottom = i_iHeight;
+
+	matrix44 matViewport;
+	matMatrix44Viewport( matViewport, 0, 0, i_iWidth, i_iHeight, 0.0f, 1.0f );
+	m_pRenderTarget->SetViewportMatrix( matViewport );
+}
+
+void CCamera::SetInterleavedRendering( m3dinterleave i_Interleave )
+{
+	m_Interleave = i_Interleave;
+	m_iInterleavePhase = 0;
+	m_bHistoryValid = false;
+}
+
 void CCamera::BeginRender()
 {
+	UpdateDynamicResolution( m_pParent->pGetParent()->fGetInvFPS() );
+
 	m_pParent->PushStateBlock();
 
 	m_pParent->SetRenderTarget( m_pRenderTarget );
 	m_pParent->SetCurCamera( this );
+
+	if( m_Interleave != m3dil_none )
+	{
+		// Pixels of previous frames may only be kept, if the view hasn't changed
+		if( m_bHistoryValid && !memcmp( &m_matHistoryView, &m_matView, sizeof( matrix44 ) ) &&
+			!memcmp( &m_matHistoryProjection, &m_matProjection, sizeof( matrix44 ) ) &&
+			!memcmp( &m_HistoryRect, &m_RenderRect, sizeof( m3drect ) ) )
+			++m_iStaticFrames;
+		else
+			m_iStaticFrames = 0;
+
+		m_matHistoryView = m_matView;
+		m_matHistoryProjection = m_matProjection;
+		m_HistoryRect = m_RenderRect;
+		m_bHistoryValid = true;
+
+		m_pParent->SetRenderState( m3drs_interleave, m_Interleave );
+		m_pParent->SetRenderState( m3drs_interleavephase, m_iInterleavePhase );
+	}
 }
 
 void CCamera::ClearToSceneColor( const m3drect *i_pRect )
 {
 	CScene *pScene = m_pParent->pGetParent()->pGetScene();
+	if( !i_pRect && m_bDynamicResolution )
+		i_pRect = &m_RenderRect; // pixels outside the render rectangle aren't presented
 	m_pRenderTarget->ClearColorBuffer( pScene->vGetClearColor(), i_pRect );
 	m_pRenderTarget->ClearDepthBuffer( 1.0f, i_pRect );
 }
@@ -81,6 +180,22 @@ void CCamera::ClearToSceneColor( const m3drect *i_pRect )
 void CCamera::EndRender()
 {
 	m_pParent->PopStateBlock();
+
+	if( m_Interleave != m3dil_none )
+	{
+		// Replace outdated pixels of the other phases ----------------------------
+		if( !m_iStaticFrames )
+		{
+			CMuli3DSurface *pColorBuffer = m_pRenderTarget->pGetColorBuffer();
+			if( pColorBuffer )
+			{
+				pColorBuffer->ReconstructInterleaved( m_Interleave, m_iInterleavePhase, m_RenderRect.iRight ? &m_RenderRect : 0 );
+				SAFE_RELEASE( pColorBuffer );
+			}
+		}
+
+		m_iInterleavePhase = ( m_iInterleavePhase + 1 ) % CMuli3DSurface::iGetInterleavePhases( m_Interleave );
+	}
 }
 
 void CCamera::CalculateProjection( float32 i_fFOVAngle, float32 i_fViewDistance, float32 i_fNearClippingPlane, float32 i_fAspect )
@@ -184,7 +184,7 @@ void *pLoadTexture( CResManager *i_pParent, string i_sFilename )
 	if( !bResult )
 		return 0;
 
-	pTexture->GenerateMipSubLevels( 0 );
+	pTexture->SetAutoGenMipSubLevels( true ); // mip-sublevels are generated on first use
 
 	return new CTexture( g_pResManager, pTexture );
 }
@@ -312,11 +312,40 @@ void *pLoadCubeTexture( CResManager *i_pParent, string i_sFilename )
 
 	SAFE_DELETE_ARRAY( ppTextures );
 
-	pCubeTexture->GenerateMipSubLevels( 0 );
+	pCubeTexture->SetAutoGenMipSubLevels( true );
 
 	return new CTexture( g_pResManager, pCubeTexture );
 }
 
+// Loads a list of PNGs and packs them into the layers of a texture array.
+static CMuli3DTextureArray *pBuildTextureArray( CGraphics *i_pGraphics, const vector<string> &i_sFilenames, bool i_bOneImagePerLayer, vector<tAtlasEntry> &o_AtlasEntries )
+{
+	CFileIO *pFileIO = i_pGraphics->pGetParent()->pGetFileIO();
+
+	CAtlasBuilder AtlasBuilder;
+	for( uint32 i = 0; i < i_sFilenames.size(); ++i )
+	{
+		byte *pTexData = 0;
+		uint32 iTexLength = pFileIO->iReadFile( i_sFilenames[i], &pTexData );
+		if( !iTexLength )
+			return 0;
+
+		CMuli3DTexture *pTexture = 0;
+		bool bResult = bLoadPNGTexture( &pTexture, pTexData, i_pGraphics->pGetM3DDevice() );
+		SAFE_DELETE_ARRAY( pTexData );
+		if( !bResult )
+			return 0;
+
+		AtlasBuilder.bAddImage( i_sFilenames[i], pTexture );
+		SAFE_RELEASE( pTexture );
+	}
+
+	if( i_bOneImagePerLayer && !AtlasBuilder.bSameDimensions() )
+		return 0;
+
+	return AtlasBuilder.pBuild( i_pGraphics->pGetM3DDevice(), o_AtlasEntries );
+}
+
 void *pLoadAnimatedTexture( CResManager *i_pParent, string i_sFilename )
 {
 	CGraphics *pGraphics = i_pParent->pGetParent()->pGetGraphics();
@@ -361,39 +390,52 @@ void *pLoadAnimatedTexture( CResManager *i_pParent, string i_sFilename )
 
 	SAFE_DELETE_ARRAY( pData );
 
-	uint32 iNumTextures = (uint32)sFilenames.size();
-	if( !iNumTextures )
+	// all frames have to be of the same size, so that each frame is a layer of its own
+	vector<tAtlasEntry> AtlasEntries;
+	CMuli3DTextureArray *pTextureArray = pBuildTextureArray( pGraphics, sFilenames, true, AtlasEntries );
+	if( !pTextureArray )
 		return 0;
 
-	CMuli3DTexture **ppTextures = new CMuli3DTexture *[iNumTextures];
-	for( uint32 i = 0; i < iNumTextures; ++i )
+	return new CTexture( g_pResManager, pTextureArray, fFPS, AtlasEntries );
+}
+
+void *pLoadTextureAtlas( CResManager *i_pParent, string i_sFilename )
+{
+	CGraphics *pGraphics = i_pParent->pGetParent()->pGetGraphics();
+	CFileIO *pFileIO = pGraphics->pGetParent()->pGetFileIO();
+	
+	byte *pData = 0;
+	uint32 iLength = pFileIO->iReadFile( i_sFilename, &pData, true );
+	if( !iLength )
+		return 0;
+
+	vector<string> sFilenames;
+
+	char *pCurPosition = (char *)pData;
+
+	// read in textures
+	while( true )
 	{
-		byte *pTexData = 0;
-		uint32 iTexLength = pFileIO->iReadFile( sFilenames[i], &pTexData );
-		if( !iTexLength )
-		{
-			// release created textures up to now
-			for( uint32 j = 0; j < i; ++j )
-				SAFE_RELEASE( ppTextures[j] );
-			SAFE_DELETE_ARRAY( ppTextures );
-			return 0;
-		}
+		char *pEndOfLine = strchr( pCurPosition, '\n' );
+		if( pEndOfLine ) *pEndOfLine = 0;
 
-		bool bResult = bLoadPNGTexture( &ppTextures[i], pTexData, pGraphics->pGetM3DDevice() );
-		SAFE_DELETE_ARRAY( pTexData );
-		if( !bResult )
-		{
-			// release created textures up to now
-			for( uint32 j = 0; j < i; ++j )
-				SAFE_RELEASE( ppTextures[j] );
-			SAFE_DELETE_ARRAY( ppTextures );
-			return 0;
-		}
+		if( !strlen( pCurPosition ) ) break;
+		sFilenames.push_back( pCurPosition );
 
-		ppTextures[i]->GenerateMipSubLevels( 0 );
+		if( pEndOfLine )
+			pCurPosition = pEndOfLine + 1;
+		else
+			break;
 	}
 
-	return new CTexture( g_pResManager, iNumTextures, fFPS, ppTextures );
+	SAFE_DELETE_ARRAY( pData );
+
+	vector<tAtlasEntry> AtlasEntries;
+	CMuli3DTextureArray *pTextureArray = pBuildTextureArray( pGraphics, sFilenames, false, AtlasEntries );
+	if( !pTextureArray )
+		return 0;
+
+	return new CTexture( g_pResManager, pTextureArray, 0.0f, AtlasEntries );
 }
 
 void UnloadTexture( CResManager *i_pParent, void *i_pResource )
@@ -411,6 +453,7 @@ bool CResManager::bInitialize()
 	RegisterResourceExtension( "png", pLoadTexture, UnloadTexture );
 	RegisterResourceExtension( "cube", pLoadCubeTexture, UnloadTexture );
 	RegisterResourceExtension( "anim", pLoadAnimatedTexture, UnloadTexture );
+	RegisterResourceExtension( "atlas", pLoadTextureAtlas, UnloadTexture );
 
 	return true;
 }
@@ -57,6 +57,10 @@ result CreateMuli3D( class CMuli3D **o_ppMuli3D );
 #include "m3dcore_indexbuffer.h"
 #include "m3dcore_rendertarget.h"
 #include "m3dcore_shaders.h"
+#include "m3dcore_sparsetexture.h"
+#include "m3dcore_stencilbuffer.h"
+#include "m3dcore_summedareatexture.h"
+#include "m3dcore_texturearray.h"
 #include "m3dcore_surface.h"
 #include "m3dcore_texture.h"
 #include "m3dcore_primitiveassembler.h"
@@ -70,7 +70,7 @@ protected:
 	/// @param[in] i_iSamplerNumber number of the sampler.
 	/// @param[in] i_fU u-component of the lookup-vector.
 	/// @param[in] i_fV v-component of the lookup-vector.
-	/// @param[in] i_fW w-component of the lookup-vector.
+	/// @param[in] i_fW w-component of the lookup-vector; selects the layer of texture arrays.
 	/// @param[in] i_pXGradient partial derivatives of the texture coordinates with respect to the screen-space x coordinate (optional, base for mip-level calculations).
 	/// @param[in] i_pYGradient partial derivatives of the texture coordinates with respect to the screen-space y coordinate (optional, base for mip-level calculations).
 	/// @return s_ok if the function succeeds.
@@ -79,6 +79,56 @@ protected:
 		float32 i_fU, float32 i_fV, float32 i_fW = 0.0f,
 		const vector4 *i_pXGradient = 0, const vector4 *i_pYGradient = 0 );
 
+	/// Samples the texture at 4 locations at once. This function simply forwards the sampling-call to the device.
+	/// Cube textures select the faces of all 4 lookup-vectors together, which is faster than 4 calls to SampleTexture().
+	/// @param[out] o_pColors receives the 4 looked-up colors.
+	/// @param[in] i_iSamplerNumber number of the sampler.
+	/// @param[in] i_pCoords 4 lookup-vectors; the x-, y- and z-components are the u-, v- and w-components.
+	/// @param[in] i_pXGradients 4 partial derivatives of the texture coordinates with respect to the screen-space x coordinate (optional, base for mip-level calculations).
+	/// @param[in] i_pYGradients 4 partial derivatives of the texture coordinates with respect to the screen-space y coordinate (optional, base for mip-level calculations).
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	result SampleTexture4( vector4 *o_pColors, uint32 i_iSamplerNumber, const vector4 *i_pCoords,
+		const vector4 *i_pXGradients = 0, const vector4 *i_pYGradients = 0 );
+
+	/// Returns the average color of an axis-aligned rectangle of a 2d texture. This function simply forwards the sampling-call to the device.
+	/// Summed-area textures compute the exact average in constant time; other textures sample the center of the rectangle at a mip-level matching its size.
+	/// @param[out] o_vColor receives the average color.
+	/// @param[in] i_iSamplerNumber number of the sampler.
+	/// @param[in] i_fU0 left border of the rectangle.
+	/// @param[in] i_fV0 top border of the rectangle.
+	/// @param[in] i_fU1 right border of the rectangle.
+	/// @param[in] i_fV1 bottom border of the rectangle.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	result SampleTextureRect( vector4 &o_vColor, uint32 i_iSamplerNumber,
+		float32 i_fU0, float32 i_fV0, float32 i_fU1, float32 i_fV1 );
+
+	/// Performs a depth-comparison lookup with percentage closer filtering on a 2d texture. This function simply forwards the call to the device.
+	/// Replaces several SampleTexture()-calls and manual comparisons for shadow mapping: the texels are compared before they are filtered.
+	/// @param[out] o_fResult receives the fraction of texels that pass the comparison, e [0,1], e.g. the amount of light reaching a pixel.
+	/// @param[in] i_iSamplerNumber number of the sampler.
+	/// @param[in] i_fU u-component of the lookup-vector.
+	/// @param[in] i_fV v-component of the lookup-vector.
+	/// @param[in] i_fReference reference value, which is compared to the texels' red channel.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	result SampleTextureCmp( float32 &o_fResult, uint32 i_iSamplerNumber,
+		float32 i_fU, float32 i_fV, float32 i_fReference );
+
+	/// Integrates color and opacity along a ray through a volume texture. This function simply forwards the call to the device.
+	/// Replaces a ray-marching loop of SampleTexture()-calls: empty bricks of the volume are skipped and the ray is terminated once it is opaque.
+	/// @param[out] o_vColor receives the accumulated color, premultiplied by the accumulated opacity, which is returned in alpha.
+	/// @param[in] i_iSamplerNumber number of the sampler.
+	/// @param[in] i_vOrigin origin of the ray in texture space.
+	/// @param[in] i_vDirection direction of the ray in texture space.
+	/// @param[in] i_Integration parameters of the integration.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	result IntegrateVolume( vector4 &o_vColor, uint32 i_iSamplerNumber,
+		const vector3 &i_vOrigin, const vector3 &i_vDirection,
+		const m3dvolumeintegration &i_Integration );
+
 private:
 	float32				m_fConstants[c_iNumShaderConstants];	///< Single float-constants.
 	vector4				m_vConstants[c_iNumShaderConstants];	///< vector4-constants.
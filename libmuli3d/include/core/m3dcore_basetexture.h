@@ -53,12 +53,119 @@ protected:
 		float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient,
 		const uint32 *i_pSamplerStates ) = 0;
 
+	/// Samples the texture at 4 locations at once. The default implementation calls SampleTexture() for each of them; textures with a vectorized lookup override it.
+	/// @param[out] o_pColors receives the 4 colors.
+	/// @param[in] i_pCoords 4 lookup-vectors; the x-, y- and z-components are the u-, v- and w-components.
+	/// @param[in] i_pXGradients 4 partial derivatives of the texture coordinates with respect to the screen-space x coordinate or 0.
+	/// @param[in] i_pYGradients 4 partial derivatives of the texture coordinates with respect to the screen-space y coordinate or 0.
+	/// @param[in] i_pSamplerStates texture sampler states.
+	/// @return s_ok if the function succeeds.
+	virtual result SampleTexture4( vector4 *o_pColors, const vector4 *i_pCoords,
+		const vector4 *i_pXGradients, const vector4 *i_pYGradients,
+		const uint32 *i_pSamplerStates );
+
+	/// Returns the average color of an axis-aligned rectangle in texture space.
+	/// The default implementation samples the center of the rectangle and passes its extents as texture coordinate gradients, so that a matching mip-level is selected.
+	/// @param[out] o_vColor receives the average color.
+	/// @param[in] i_fU0 left border of the rectangle.
+	/// @param[in] i_fV0 top border of the rectangle.
+	/// @param[in] i_fU1 right border of the rectangle.
+	/// @param[in] i_fV1 bottom border of the rectangle.
+	/// @param[in] i_pSamplerStates texture sampler states.
+	/// @return s_ok if the function succeeds.
+	virtual result SampleTextureRect( vector4 &o_vColor, float32 i_fU0, float32 i_fV0,
+		float32 i_fU1, float32 i_fV1, const uint32 *i_pSamplerStates );
+
+	/// Performs a depth-comparison lookup with percentage closer filtering; see CMuli3DSurface::fSampleCompare(). The default implementation fails, because only 2-dimensional textures support depth-comparison lookups.
+	/// @param[out] o_fResult receives the fraction of texels that pass the comparison, e [0,1].
+	/// @param[in] i_fU u-component of the lookup-vector.
+	/// @param[in] i_fV v-component of the lookup-vector.
+	/// @param[in] i_fReference reference value, which is compared to the texels' red channel.
+	/// @param[in] i_pSamplerStates texture sampler states; m3dtss_comparefunc, m3dtss_pcfkernelsize and m3dtss_minfilter control the lookup.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidstate if the texture doesn't support depth-comparison lookups.
+	virtual result SampleTextureCmp( float32 &o_fResult, float32 i_fU, float32 i_fV,
+		float32 i_fReference, const uint32 *i_pSamplerStates );
+
+	/// Integrates color and opacity along a ray through a volume. The default implementation fails, because only volume textures support ray integration.
+	/// @param[out] o_vColor receives the accumulated color, premultiplied by the accumulated opacity, which is returned in alpha.
+	/// @param[in] i_vOrigin origin of the ray in texture space.
+	/// @param[in] i_vDirection direction of the ray in texture space.
+	/// @param[in] i_Integration parameters of the integration.
+	/// @param[in] i_pSamplerStates texture sampler states.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidstate if the texture doesn't support ray integration.
+	virtual result IntegrateRay( vector4 &o_vColor, const vector3 &i_vOrigin,
+		const vector3 &i_vDirection, const m3dvolumeintegration &i_Integration,
+		const uint32 *i_pSamplerStates );
+
+	/// Records a texture lookup in the sampler feedback map. Call only if m_pSamplerFeedback is not 0.
+	/// @param[in] i_fU u-component of the lookup-vector, e [0,1].
+	/// @param[in] i_fV v-component of the lookup-vector, e [0,1].
+	/// @param[in] i_fMipLevel mip-level selected for the lookup.
+	void RecordSamplerFeedback( float32 i_fU, float32 i_fV, float32 i_fMipLevel );
+
+	/// @internal Describes the downsampling of a mip-level to the next smaller mip-level.
+	struct mipdownsample
+	{
+		const float32	*pSrcData;		///< Pixels of the source mip-level.
+		float32			*pDestData;		///< Pixels of the destination mip-level.
+		uint32			iFloats;		///< Number of floats per pixel, e [1,4].
+		uint32			iSrcWidth, iSrcHeight, iSrcDepth; ///< Dimensions of the source mip-level; iSrcDepth is 1 for 2d textures.
+		m3dmipfilter	Filter;			///< Downsampling filter.
+	};
+
+	/// Downsamples mip-levels to half their dimensions (minimum 1). The rows of all destination mip-levels are distributed across worker threads.
+	/// @param[in] i_pDownsamples downsampling descriptions; all of them have to be independent of each other.
+	/// @param[in] i_iNumDownsamples number of downsampling descriptions.
+	static void DownsampleMipLevels( const mipdownsample *i_pDownsamples, uint32 i_iNumDownsamples );
+
+private:
+	/// @internal Describes a set of independent downsampling operations, whose destination rows are numbered consecutively.
+	struct mipdownsampleinfo
+	{
+		const mipdownsample	*pDownsamples;		///< Downsampling operations.
+		uint32				iNumDownsamples;	///< Number of downsampling operations.
+		const uint32		*pFirstRows;		///< Index of the first destination row of each operation; pFirstRows[iNumDownsamples] is the total number of rows.
+		uint32				iMaxSrcRowFloats;	///< Number of floats of the longest source row.
+	};
+
+	/// @internal Work-function for ParallelFor(): downsamples the destination rows [i_iBegin,i_iEnd[ of a mipdownsampleinfo.
+	static void DownsampleMipRows( uint32 i_iBegin, uint32 i_iEnd, void *i_pUserData );
+
+public:
+	/// Enables or disables sampler feedback. While enabled the texture records the minimum mip-level that is sampled in each cell of a c_iSamplerFeedbackSize x c_iSamplerFeedbackSize grid over uv-space.
+	/// Recording is thread-safe and costs little more than a comparison for cells that have already been sampled at the same or a finer mip-level.
+	/// Volume textures record over their uv-plane, i.e. each cell holds the minimum of all slices. Summed-area textures record the mip-level a mip-mapped texture would have chosen for the averaged rectangle.
+	/// @param[in] i_bEnable true to enable sampler feedback. Enabling clears the feedback.
+	/// @return s_ok if the function succeeds.
+	/// @return e_outofmemory if memory allocation failed.
+	/// @return e_invalidstate if the texture doesn't support sampler feedback. Cube textures and texture arrays record feedback per face or layer; use CMuli3DCubeTexture::pGetCubeFace() or CMuli3DTextureArray::pGetLayer().
+	/// @note Don't enable or disable sampler feedback while the texture is being sampled.
+	virtual result SetSamplerFeedback( bool i_bEnable );
+
+	/// Resets the sampler feedback to "not sampled", e.g. at the beginning of a frame.
+	void ClearSamplerFeedback();
+
+	/// Copies the sampler feedback map.
+	/// @param[out] o_pMinMipLevels receives c_iSamplerFeedbackSize * c_iSamplerFeedbackSize values in row-major order, each being the minimum mip-level sampled within a cell or c_iSamplerFeedbackNotSampled.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidstate if sampler feedback is disabled.
+	result GetSamplerFeedback( uint32 *o_pMinMipLevels );
+
+	/// Returns the minimum mip-level that has been sampled since the sampler feedback has been cleared, i.e. the texture has never been sampled below (at a finer level than) this mip-level and the larger mip-levels could be trimmed.
+	/// Returns c_iSamplerFeedbackNotSampled if the texture hasn't been sampled or sampler feedback is disabled.
+	uint32 iGetMinSampledMipLevel();
+
 public:
 	/// Returns a pointer to the associated device. Calling this function will increase the internal reference count of the device. Failure to call Release() when finished using the pointer will result in a memory leak.
 	class CMuli3DDevice *pGetDevice();
 
 protected:
 	class CMuli3DDevice	*m_pParent;	///< Pointer to parent.
+	volatile uint32		*m_pSamplerFeedback;		///< Sampler feedback map or 0 if sampler feedback is disabled.
+	volatile uint32		m_iMinSampledMipLevel;	///< Minimum mip-level sampled in any cell of the sampler feedback map.
 };
 
 #endif // __M3DCORE_BASETEXTURE_H__
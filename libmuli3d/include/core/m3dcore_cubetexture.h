@@ -53,7 +53,7 @@ protected:
 	m3dtexsampleinput eGetTexSampleInput(); ///< Sampling this texture requires a 3-dimensional floating point vector.
 
 	/// Accessible by CMuli3DDevice.
-	/// Samples the texture and returns the looked-up color.
+	/// Samples the texture and returns the looked-up color. Partial derivatives of the lookup-vector are projected onto the selected face to determine the mip-level.
 	/// @param[out] o_vColor receives the color of the pixel to be looked up.
 	/// @param[in] i_fU u-component of the lookup-vector.
 	/// @param[in] i_fV v-component of the lookup-vector.
@@ -66,12 +66,34 @@ protected:
 		float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient,
 		const uint32 *i_pSamplerStates );
 
+	/// Accessible by CMuli3DDevice.
+	/// Samples the texture with 4 lookup-vectors, whose faces and face coordinates are determined at once.
+	/// @param[out] o_pColors receives the 4 colors.
+	/// @param[in] i_pCoords 4 lookup-vectors.
+	/// @param[in] i_pXGradients 4 partial derivatives of the lookup-vectors with respect to the screen-space x coordinate or 0.
+	/// @param[in] i_pYGradients 4 partial derivatives of the lookup-vectors with respect to the screen-space y coordinate or 0.
+	/// @param[in] i_pSamplerStates texture sampler states.
+	/// @return s_ok if the function succeeds.
+	result SampleTexture4( vector4 *o_pColors, const vector4 *i_pCoords,
+		const vector4 *i_pXGradients, const vector4 *i_pYGradients,
+		const uint32 *i_pSamplerStates );
+
 public:
-	/// Generates mip-sublevels through downsampling (using a box-filter) a given source mip-level.
+	/// Generates mip-sublevels through downsampling a given source mip-level. The rows of each mip-level are distributed across worker threads.
+	/// If automatic mip-sublevel generation is enabled the mip-sublevels are only marked invalid and will be generated the first time they are accessed.
 	/// @param[in] i_iSrcLevel the mip-level which will be taken as the starting point.
+	/// @param[in] i_Filter downsampling filter. Member of the enumeration m3dmipfilter; m3dmf_tent gives smoother results at higher cost.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	result GenerateMipSubLevels( uint32 i_iSrcLevel, m3dmipfilter i_Filter = m3dmf_box );
+
+	/// Enables or disables automatic (on-demand) generation of mip-sublevels for all cube faces. See CMuli3DTexture::SetAutoGenMipSubLevels().
+	/// @param[in] i_bAutoGen true to enable automatic generation.
+	/// @param[in] i_Filter downsampling filter used for generation. Member of the enumeration m3dmipfilter.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
-	result GenerateMipSubLevels( uint32 i_iSrcLevel );
+	/// @return e_outofmemory if memory allocation failed.
+	result SetAutoGenMipSubLevels( bool i_bAutoGen, m3dmipfilter i_Filter = m3dmf_box );
 
 	/// Returns a pointer to the contents of a given mip-level.
 	/// @param[in] i_Face cube face that is requested. Member of the enumeration m3dcubefaces.
@@ -100,11 +122,37 @@ public:
 	/// @param[in] i_iMipLevel the mip-level whose edge length is requested.
 	uint32 iGetEdgeLength( uint32 i_iMipLevel = 0 );
 	
+	/// Fails, because cube textures record sampler feedback per face: enable it on the textures returned by pGetCubeFace().
+	/// @param[in] i_bEnable true to enable sampler feedback.
+	/// @return s_ok if sampler feedback is to be disabled.
+	/// @return e_invalidstate if sampler feedback is to be enabled.
+	result SetSamplerFeedback( bool i_bEnable );
+
 	/// Returns a pointer to a cube face which can then be accessed like a normal 2d texture.
 	/// Calling this function will increase the internal reference count of the texture. Failure to call Release() when finished using the pointer will result in a memory leak.
 	/// @param[in] i_Face member of the enumeration m3dcubefaces.
 	class CMuli3DTexture *pGetCubeFace( m3dcubefaces i_Face );
 
+private:
+	/// @internal Up to 4 cube map lookups in structure-of-arrays layout, so that ProjectToFaces() processes them in lock-step.
+	struct cubelookups
+	{
+		float32	fX[4], fY[4], fZ[4];				///< Lookup-vectors.
+		float32	fXGradX[4], fXGradY[4], fXGradZ[4];	///< Partial derivatives of the lookup-vectors with respect to the screen-space x coordinate.
+		float32	fYGradX[4], fYGradY[4], fYGradZ[4];	///< Partial derivatives of the lookup-vectors with respect to the screen-space y coordinate.
+		uint32	iFace[4];							///< Selected faces; members of the enumeration m3dcubefaces.
+		float32	fS[4], fT[4];						///< Texture coordinates on the selected faces.
+		float32	fXGradS[4], fXGradT[4];				///< Partial derivatives of the face texture coordinates with respect to the screen-space x coordinate.
+		float32	fYGradS[4], fYGradT[4];				///< Partial derivatives of the face texture coordinates with respect to the screen-space y coordinate.
+	};
+
+	/// @internal Selects the face of each lookup-vector by its major axis and projects the lookup-vector and, optionally, its partial derivatives onto that face.
+	/// The lookups are processed without data-dependent branches, so that the compiler can vectorize the loop.
+	/// @param[in,out] io_Lookups lookups.
+	/// @param[in] i_iNumLookups number of lookups, e [1,4].
+	/// @param[in] i_bGradients true to project the partial derivatives.
+	static void ProjectToFaces( cubelookups &io_Lookups, uint32 i_iNumLookups, bool i_bGradients );
+
 private:
 	class CMuli3DTexture	*m_ppCubeFaces[6]; ///< Pointer to the 6 cube faces.
 };
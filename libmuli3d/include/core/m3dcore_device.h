@@ -26,6 +26,8 @@
 #include "../m3dbase.h"
 #include "../m3dtypes.h"
 
+#include "m3dcore_threads.h"
+
 /// The Muli3D device.
 class CMuli3DDevice : public IBase
 {
@@ -121,6 +123,29 @@ public:
 	result CreateSurface( class CMuli3DSurface **o_ppSurface, uint32 i_iWidth,
 		uint32 i_iHeight, m3dformat i_fmtFormat );
 
+	/// Creates a multisampled surface, which may be used as color- or depthbuffer of a rendertarget. Coverage and depth are determined per sample, but pixel shaders are executed only once per pixel.
+	/// Multisampled colorbuffers have to be resolved to a regular surface with CMuli3DSurface::ResolveToSurface() before they can be presented or sampled.
+	/// @param[out] o_ppSurface receives a pointer to the created surface.
+	/// @param[in] i_iWidth width of the surface in pixels.
+	/// @param[in] i_iHeight height of the surface in pixels.
+	/// @param[in] i_fmtFormat format of the new surface. Member of the enumeration m3dformat.
+	/// @param[in] i_iSamples number of samples per pixel; 1, 2, 4 or 8.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	result CreateMultiSampleSurface( class CMuli3DSurface **o_ppSurface, uint32 i_iWidth,
+		uint32 i_iHeight, m3dformat i_fmtFormat, uint32 i_iSamples );
+
+	/// Creates a stencil buffer, which may be attached to a rendertarget. All stencil values are initialized to 0.
+	/// @param[out] o_ppStencilBuffer receives a pointer to the created stencil buffer.
+	/// @param[in] i_iWidth width of the stencil buffer in pixels.
+	/// @param[in] i_iHeight height of the stencil buffer in pixels.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	result CreateStencilBuffer( class CMuli3DStencilBuffer **o_ppStencilBuffer,
+		uint32 i_iWidth, uint32 i_iHeight );
+
 	/// Creates a standard 2d texture, which may either be used for texture data storage or as a target for rendering-operations (as frame- or depthbuffer).
 	/// @param[out] o_ppTexture receives a pointer to the created texture.
 	/// @param[in] i_iWidth width of the texture in pixels.
@@ -170,6 +195,41 @@ public:
 		uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth,
 		uint32 i_iMipLevels, m3dformat i_fmtFormat );
 
+	/// Creates a texture array. A pointer to each of the layers can be obtained and used as a target for rendering-operations like a standard 2d texture.
+	/// @param[out] o_ppTextureArray receives a pointer to the created texture.
+	/// @param[in] i_iWidth width of the layers in pixels.
+	/// @param[in] i_iHeight height of the layers in pixels.
+	/// @param[in] i_iNumLayers number of layers.
+	/// @param[in] i_iMipLevels number of miplevels of the new texture; specify 0 to create a full mip-chain.
+	/// @param[in] i_fmtFormat format of the new texture. Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	result CreateTextureArray( class CMuli3DTextureArray **o_ppTextureArray,
+		uint32 i_iWidth, uint32 i_iHeight, uint32 i_iNumLayers,
+		uint32 i_iMipLevels, m3dformat i_fmtFormat );
+
+	/// Creates a sparse texture, whose pages are streamed in from a tiled texture file on demand. Sparse textures cannot be used as a target for rendering-operations.
+	/// @param[out] o_ppSparseTexture receives a pointer to the created texture.
+	/// @param[in] i_szFilename tiled texture file; see CMuli3DSparseTexture::WriteTiledTextureFile().
+	/// @param[in] i_iMaxResidentPages maximum number of pages that are resident in memory, apart from the mip-levels that fit into a single page.
+	/// @param[in] i_bLoaderThread true to load requested pages on a background thread. Otherwise (or if the platform doesn't support threads) CMuli3DSparseTexture::iUpdateResidency() has to be called.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid or the file couldn't be read.
+	/// @return e_outofmemory if memory allocation failed.
+	/// @return e_invalidformat if the file's format is invalid.
+	result CreateSparseTexture( class CMuli3DSparseTexture **o_ppSparseTexture,
+		const char *i_szFilename, uint32 i_iMaxResidentPages, bool i_bLoaderThread );
+
+	/// Creates a summed-area texture, which returns the average of arbitrarily large rectangles in constant time. Summed-area textures cannot be used as a target for rendering-operations.
+	/// @param[out] o_ppSummedAreaTexture receives a pointer to the created texture.
+	/// @param[in] i_pSourceTexture texture whose base mip-level the summed-area table is built from; see CMuli3DSummedAreaTexture::Update().
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	result CreateSummedAreaTexture( class CMuli3DSummedAreaTexture **o_ppSummedAreaTexture,
+		class CMuli3DTexture *i_pSourceTexture );
+
 	/// Creates a render target.
 	/// @param[out] o_ppVertexFormat receives a pointer to the created render target.
 	/// @return s_ok if the function succeeds.
@@ -216,6 +276,7 @@ public:
 	class IMuli3DTriangleShader *pGetTriangleShader(); ///< Returns a pointer to the active triangle shader. Calling this function will increase the internal reference count of the triangle shader. Failure to call Release() when finished using the pointer will result in a memory leak.
 
 	/// Sets the pixel shader.
+	/// A pixel shader may be omitted (0) for depth-only rendering, i.e. if the rendertarget has no colorbuffer or m3drs_colorwriteenable is false.
 	/// @param[in] i_pPixelShader pointer to the pixel shader.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidstate if the type of pixelshader is invalid.
@@ -289,7 +350,7 @@ public:
 	/// @param[in] i_iSamplerNumber number of the sampler.
 	/// @param[in] i_fU u-component of the lookup-vector.
 	/// @param[in] i_fV v-component of the lookup-vector.
-	/// @param[in] i_fW w-component of the lookup-vector.
+	/// @param[in] i_fW w-component of the lookup-vector; selects the layer of texture arrays.
 	/// @param[in] i_pXGradient partial derivatives of the texture coordinates with respect to the screen-space x coordinate. If 0 the base mip-level will be chosen and the minification filter will be used for texture sampling.
 	/// @param[in] i_pYGradient partial derivatives of the texture coordinates with respect to the screen-space y coordinate. If 0 the base mip-level will be chosen and the minification filter will be used for texture sampling.
 	/// @return s_ok if the function succeeds.
@@ -298,6 +359,55 @@ public:
 		float32 i_fU, float32 i_fV, float32 i_fW,
 		const vector4 *i_pXGradient, const vector4 *i_pYGradient );
 
+	/// Samples the texture at 4 locations at once. Cube textures select the faces of all 4 lookup-vectors together.
+	/// @param[out] o_pColors receives the 4 looked-up colors.
+	/// @param[in] i_iSamplerNumber number of the sampler.
+	/// @param[in] i_pCoords 4 lookup-vectors; the x-, y- and z-components are the u-, v- and w-components.
+	/// @param[in] i_pXGradients 4 partial derivatives of the texture coordinates with respect to the screen-space x coordinate or 0.
+	/// @param[in] i_pYGradients 4 partial derivatives of the texture coordinates with respect to the screen-space y coordinate or 0.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	result SampleTexture4( vector4 *o_pColors, uint32 i_iSamplerNumber,
+		const vector4 *i_pCoords, const vector4 *i_pXGradients, const vector4 *i_pYGradients );
+
+	/// Returns the average color of an axis-aligned rectangle of a 2d texture. The texture addressing modes are applied to the center of the rectangle.
+	/// @param[out] o_vColor receives the average color.
+	/// @param[in] i_iSamplerNumber number of the sampler.
+	/// @param[in] i_fU0 left border of the rectangle.
+	/// @param[in] i_fV0 top border of the rectangle.
+	/// @param[in] i_fU1 right border of the rectangle.
+	/// @param[in] i_fV1 bottom border of the rectangle.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidstate if the texture isn't sampled with 2 coordinates.
+	result SampleTextureRect( vector4 &o_vColor, uint32 i_iSamplerNumber,
+		float32 i_fU0, float32 i_fV0, float32 i_fU1, float32 i_fV1 );
+
+	/// Performs a depth-comparison lookup with percentage closer filtering on a 2d texture, e.g. a shadow map. The compare-function and the kernel size are taken from the sampler states m3dtss_comparefunc and m3dtss_pcfkernelsize; the minification filter selects between bi-linear weighting and equally weighted texels.
+	/// @param[out] o_fResult receives the fraction of texels that pass the comparison, e [0,1].
+	/// @param[in] i_iSamplerNumber number of the sampler.
+	/// @param[in] i_fU u-component of the lookup-vector.
+	/// @param[in] i_fV v-component of the lookup-vector.
+	/// @param[in] i_fReference reference value, which is compared to the texels' red channel.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidstate if the texture doesn't support depth-comparison lookups or a sampler state is invalid.
+	result SampleTextureCmp( float32 &o_fResult, uint32 i_iSamplerNumber,
+		float32 i_fU, float32 i_fV, float32 i_fReference );
+
+	/// Integrates color and opacity along a ray through a volume texture; see CMuli3DVolumeTexture::IntegrateRay(). Texture addressing modes don't apply: the ray is clipped to the volume.
+	/// @param[out] o_vColor receives the accumulated color, premultiplied by the accumulated opacity, which is returned in alpha.
+	/// @param[in] i_iSamplerNumber number of the sampler.
+	/// @param[in] i_vOrigin origin of the ray in texture space.
+	/// @param[in] i_vDirection direction of the ray in texture space.
+	/// @param[in] i_Integration parameters of the integration.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidstate if the texture doesn't support ray integration.
+	result IntegrateVolume( vector4 &o_vColor, uint32 i_iSamplerNumber,
+		const vector3 &i_vOrigin, const vector3 &i_vDirection,
+		const m3dvolumeintegration &i_Integration );
+
 	/// Sets the render target.
 	/// @param[in] i_pRenderTarget pointer to the render target.
 	void SetRenderTarget( class CMuli3DRenderTarget *i_pRenderTarget );
@@ -310,7 +420,9 @@ public:
 	result SetScissorRect( const m3drect &i_ScissorRect );
 	m3drect GetScissorRect(); ///< Returns the currently set scissor rect.
 
-	/// Sets the bounding values for depth.
+	/// Sets the bounding values for depth. Pixels whose depth stored in the depthbuffer lies outside these bounds are rejected before they are shaded.
+	/// Whole triangles, which can't pass the depth-test at any pixel within the bounds, and tiles of the depthbuffer without any depth value within the bounds are skipped altogether.
+	/// The test is disabled, if no depthbuffer is available or if the bounds cover the entire range [0;1].
 	/// @param[in] i_fMinZ minimum allowed depth value, e [0;1], default: 0.
 	/// @param[in] i_fMaxZ maximum allowed depth value, e [0;1], default: 1.
 	/// @return s_ok if the function succeeds.
@@ -318,6 +430,13 @@ public:
 	result SetDepthBounds( float32 i_fMinZ, float32 i_fMaxZ );
 	void GetDepthBounds( float32 &o_fMinZ, float32 &o_fMaxZ ); ///< Returns the currently set depth bounding values.
 
+	/// Sets the shading rate image, which assigns a shading rate to each tile of c_iShadingRateTileSize x c_iShadingRateTileSize pixels of the rendertarget. Every texel holds a member of the enumeration m3dshadingrate; it is combined with renderstate m3drs_shadingrate, see there.
+	/// @param[in] i_pShadingRateImage surface of format m3dfmt_r32f, which covers all tiles of the viewport. Pass in 0 to disable per-tile shading rates.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidformat if the surface isn't a single-sampled m3dfmt_r32f surface.
+	result SetShadingRateImage( class CMuli3DSurface *i_pShadingRateImage );
+	class CMuli3DSurface *pGetShadingRateImage(); ///< Returns a pointer to the active shading rate image. Calling this function will increase the internal reference count of the surface. Failure to call Release() when finished using the pointer will result in a memory leak.
+
 	/// Sets an user-specified clipping plane.
 	/// @param[in] i_eIndex clipping plane index (member of the enumeration m3dclippingplanes) starting from m3dcp_user0.
 	/// @param[in] i_pPlane pointer to clipping plane. Pass 0 to disable a clipping plane.
@@ -334,10 +453,64 @@ public:
 	uint32 iGetRenderedPixels(); ///< Returns the number of pixels that passed the depth-test during the last Draw*Primitive() call.
 
 private:
+	/// @internal Describes a vertex of a triangle generated during subdivision.
+	/// @note This structure is used internally by devices.
+	struct subdivvertex
+	{
+		const m3dvsoutput	*pVSOutput;		///< Vertex shader input and output.
+		uint32		iBarycentrics[3];	///< Position in the input triangle: weights of the triangle's vertices in units of 2^-m3drs_subdivisionlevels. Unused for center vertices of adaptive-subdivision.
+	};
+
+	/// @internal Describes an entry of a subdivvertexcache.
+	/// @note This structure is used internally by devices.
+	struct subdivcacheentry
+	{
+		uint32				iKey[3];	///< Identifies the vertex.
+		const m3dvsoutput	*pVSOutput;	///< The vertex or 0 if the entry is empty.
+	};
+
+	/// @internal Holds vertices generated during subdivision and maps keys to them. Memory is kept when the cache is emptied.
+	/// @note This structure is used internally by devices.
+	struct subdivvertexcache
+	{
+		std::vector<subdivcacheentry> Entries;	///< Hash table with linear probing; its size is a power of two.
+		uint32		iNumEntries;	///< Number of occupied entries.
+		std::vector<m3dvsoutput *> Chunks;	///< Storage of the vertices in chunks of fixed size, so vertices don't move.
+		uint32		iNumVertices;	///< Number of stored vertices.
+	};
+
+	/// @internal Describes a triangle queued for subdivision.
+	/// @note This structure is used internally by devices.
+	struct subdivpatch
+	{
+		m3dvsoutput		VSOutputs[3];		///< Copies of the triangle's vertices.
+		uint32			iVertexIndices[3];	///< Indices of the triangle's vertices; they identify the triangle's edges in the shared edge vertex cache.
+		subdivvertexcache InnerVertices;	///< Vertices generated inside the triangle, keyed by their barycentric coordinates.
+		std::vector<const m3dvsoutput *> Triangles;	///< Vertices of the generated triangles, three per triangle.
+	};
+
+	/// @internal Part of the cache holding the vertices generated on the edges of triangles during subdivision.
+	/// @note This structure is used internally by devices.
+	struct subdivcacheshard
+	{
+		CMuli3DMutex		Mutex;		///< Serializes accesses from the threads tessellating triangles.
+		subdivvertexcache	Vertices;	///< Vertices keyed by the ordered vertex indices of the edge they lie on and the weight of the edge's second vertex.
+	};
+
 	void SetDefaultRenderStates();	///< Initializes renderstates to default values.
 	void SetDefaultTextureSamplerStates();	///< Initializes samplerstates to default values.
 	void SetDefaultClippingPlanes(); ///< Initializes the frustum clipping planes.
 
+	/// Applies the addressing modes of a texture sampler to a lookup-vector.
+	/// @param[in] i_iSamplerNumber number of the sampler; its texture has to be set.
+	/// @param[in,out] io_fU u-component of the lookup-vector.
+	/// @param[in,out] io_fV v-component of the lookup-vector.
+	/// @param[in,out] io_fW w-component of the lookup-vector.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if a cube texture is sampled with a null vector.
+	/// @return e_invalidstate if an invalid sampler state was encountered.
+	result AddressTextureCoords( uint32 i_iSamplerNumber, float32 &io_fU, float32 &io_fV, float32 &io_fW );
+
 	/// Prepares internal structure with information used for rendering.
 	/// Checks if all necessary objects (vertexbuffer, vertex format, etc.) have been set + if renderstates are valid.
 	/// @return s_ok if the function succeeds.
@@ -347,6 +520,9 @@ private:
 	/// Performs cleanup: Unlocking frame- and depthbuffer, etc.
 	void PostRender();
 
+	/// Unlocks the colorbuffers locked by PreRender().
+	void UnlockColorBuffers();
+
 	/// Loads data of a particular vertex from the vertex streams using the active vertex format as a description.
 	/// @param[out] o_VertexShaderInput filled with vertex data from the streams.
 	/// @param[in] i_iVertex index of the vertex.
@@ -362,12 +538,12 @@ private:
 	/// @param[in] i_iVertex index of the vertex.
 	result FetchVertex( m3dvertexcacheentry **io_ppVertex, uint32 i_iVertex );
 
-	/// Begins the processing-pipeline that works on a per-triangle base. Either continues to the clipping-stage or takes care of subdivision.
-	/// @param[in] i_pVSOutput0 vertex A.
-	/// @param[in] i_pVSOutput1 vertex B.
-	/// @param[in] i_pVSOutput2 vertex C.
-	void ProcessTriangle( const m3dvsoutput *i_pVSOutput0,
-		const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 );
+	/// Begins the processing-pipeline that works on a per-triangle base. Either continues to the clipping-stage or queues the triangle for subdivision.
+	/// @param[in] i_pVertex0 vertex A.
+	/// @param[in] i_pVertex1 vertex B.
+	/// @param[in] i_pVertex2 vertex C.
+	void ProcessTriangle( const m3dvertexcacheentry *i_pVertex0,
+		const m3dvertexcacheentry *i_pVertex1, const m3dvertexcacheentry *i_pVertex2 );
 
 	/// Interpolates between two vertex shader inputs (used for subdivision).
 	/// @param[out] o_pVSInput output.
@@ -393,48 +569,91 @@ private:
 	/// @param[in] i_fVal floating point value to multiply registers with.
 	void MultiplyVertexShaderOutputRegisters( m3dvsoutput *o_pDest, const m3dvsoutput *i_pSrc, float32 i_fVal );
 
-	/// Performs simple-subdivision.
+	/// Tessellates the queued triangles in parallel and draws the generated triangles in submission order.
+	void SubdivideTriangleBatch();
+
+	/// Empties the cache holding the vertices generated on shared triangle edges during subdivision.
+	void ClearSubdivisionCache();
+
+	/// Empties a subdivision vertex cache.
+	/// @param[in,out] io_Cache the cache.
+	void ClearSubdivisionVertexCache( subdivvertexcache &io_Cache );
+
+	/// Looks up a vertex in a subdivision vertex cache.
+	/// @param[in] i_Cache the cache.
+	/// @param[in] i_pKey key of the vertex.
+	/// @return the vertex or 0 if the cache doesn't hold it.
+	const m3dvsoutput *pFindSubdivisionVertex( const subdivvertexcache &i_Cache, const uint32 *i_pKey );
+
+	/// Adds a vertex to a subdivision vertex cache, which doesn't hold the key yet.
+	/// @param[in,out] io_Cache the cache.
+	/// @param[in] i_pKey key of the vertex.
+	/// @param[in] i_pVSOutput the vertex.
+	void InsertSubdivisionVertex( subdivvertexcache &io_Cache, const uint32 *i_pKey, const m3dvsoutput *i_pVSOutput );
+
+	/// Allocates storage for a vertex in a subdivision vertex cache.
+	/// @param[in,out] io_Cache the cache.
+	/// @return the vertex; it stays valid until the cache is emptied.
+	m3dvsoutput *pAllocateSubdivisionVertex( subdivvertexcache &io_Cache );
+
+	/// @internal Work-function for ParallelFor(): tessellates the queued triangles [i_iBegin,i_iEnd[.
+	static void SubdivideTriangleRange( uint32 i_iBegin, uint32 i_iEnd, void *i_pUserData );
+
+	/// Returns the vertex in the middle of an edge of a triangle generated during subdivision. The vertex is looked up in the patch's or the shared edge vertex cache and only generated if it doesn't exist yet.
+	/// @param[out] o_Vertex the vertex in the middle of the edge.
+	/// @param[in,out] io_Patch patch the edge belongs to.
+	/// @param[in] i_VertexA first vertex of the edge.
+	/// @param[in] i_VertexB second vertex of the edge.
+	/// @param[in] i_bSmooth if true the vertex is offset using the vertices' normals (smooth-subdivision).
+	void GetEdgeVertex( subdivvertex &o_Vertex, subdivpatch &io_Patch,
+		const subdivvertex &i_VertexA, const subdivvertex &i_VertexB, bool i_bSmooth );
+
+	/// Generates the vertex in the middle of an edge and executes the vertex shader for it.
+	/// @param[out] o_pVSOutput the generated vertex.
+	/// @param[in] i_pVSOutputA first vertex of the edge.
+	/// @param[in] i_pVSOutputB second vertex of the edge.
+	/// @param[in] i_bSmooth if true the vertex is offset using the vertices' normals (smooth-subdivision).
+	void GenerateEdgeVertex( m3dvsoutput *o_pVSOutput, const m3dvsoutput *i_pVSOutputA,
+		const m3dvsoutput *i_pVSOutputB, bool i_bSmooth );
+
+	/// Performs simple- or smooth-subdivision.
+	/// @param[in,out] io_Patch patch receiving the generated triangles.
 	/// @param[in] i_iSubdivisionLevel number of times to subdivide.
-	/// @param[in] i_pVSOutput0 vertex A.
-	/// @param[in] i_pVSOutput1 vertex B.
-	/// @param[in] i_pVSOutput2 vertex C.
-	void SubdivideTriangle_Simple( uint32 i_iSubdivisionLevel,
-		const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1,
-		const m3dvsoutput *i_pVSOutput2 );
-
-	/// Performs smooth-subdivision.
-	/// @param[in] i_iSubdivisionLevel number of times to subdivide.
-	/// @param[in] i_pVSOutput0 vertex A.
-	/// @param[in] i_pVSOutput1 vertex B.
-	/// @param[in] i_pVSOutput2 vertex C.
-	void SubdivideTriangle_Smooth( uint32 i_iSubdivisionLevel,
-		const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1,
-		const m3dvsoutput *i_pVSOutput2 );
+	/// @param[in] i_Vertex0 vertex A.
+	/// @param[in] i_Vertex1 vertex B.
+	/// @param[in] i_Vertex2 vertex C.
+	/// @param[in] i_bSmooth if true smooth-subdivision is performed.
+	void SubdivideTriangle_Simple( subdivpatch &io_Patch, uint32 i_iSubdivisionLevel,
+		const subdivvertex &i_Vertex0, const subdivvertex &i_Vertex1,
+		const subdivvertex &i_Vertex2, bool i_bSmooth );
 
 	/// Performs adaptive-subdivision: Finds the triangle's center vertex and initiates splitting of triangle edges.
-	/// @param[in] i_pVSOutput0 vertex A.
-	/// @param[in] i_pVSOutput1 vertex B.
-	/// @param[in] i_pVSOutput2 vertex C.
-	void SubdivideTriangle_Adaptive( const m3dvsoutput *i_pVSOutput0,
-		const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 );
+	/// @param[in,out] io_Patch patch receiving the generated triangles.
+	/// @param[in] i_Vertex0 vertex A.
+	/// @param[in] i_Vertex1 vertex B.
+	/// @param[in] i_Vertex2 vertex C.
+	void SubdivideTriangle_Adaptive( subdivpatch &io_Patch, const subdivvertex &i_Vertex0,
+		const subdivvertex &i_Vertex1, const subdivvertex &i_Vertex2 );
 
 	/// Helper function for adaptive-subdivision: Recursively splits triangle edges.
+	/// @param[in,out] io_Patch patch receiving the generated triangles.
 	/// @param[in] i_iSubdivisionLevel number of times to subdivide.
-	/// @param[in] i_pVSOutput0 vertex A.
-	/// @param[in] i_pVSOutput1 vertex B.
-	/// @param[in] i_pVSOutput2 vertex C.
-	void SubdivideTriangle_Adaptive_SubdivideEdges( uint32 i_iSubdivisionLevel,
-		const m3dvsoutput *i_pVSOutputEdge0, const m3dvsoutput *i_pVSOutputEdge1,
-		const m3dvsoutput *i_pVSOutputCenter );
+	/// @param[in] i_VertexEdge0 first vertex of the edge.
+	/// @param[in] i_VertexEdge1 second vertex of the edge.
+	/// @param[in] i_VertexCenter center vertex of the triangle.
+	void SubdivideTriangle_Adaptive_SubdivideEdges( subdivpatch &io_Patch,
+		uint32 i_iSubdivisionLevel, const subdivvertex &i_VertexEdge0,
+		const subdivvertex &i_VertexEdge1, const subdivvertex &i_VertexCenter );
 	
 	/// Helper function for adaptive-subdivision: Recursively subdivides triangles until their screen-area falls below a user-defined threshold.
+	/// @param[in,out] io_Patch patch receiving the generated triangles.
 	/// @param[in] i_iSubdivisionLevel number of times to subdivide.
-	/// @param[in] i_pVSOutput0 vertex A.
-	/// @param[in] i_pVSOutput1 vertex B.
-	/// @param[in] i_pVSOutput2 vertex C.
-	void SubdivideTriangle_Adaptive_SubdivideInnerPart(
-		uint32 i_iSubdivisionLevel, const m3dvsoutput *i_pVSOutput0,
-		const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 );
+	/// @param[in] i_Vertex0 vertex A.
+	/// @param[in] i_Vertex1 vertex B.
+	/// @param[in] i_Vertex2 vertex C.
+	void SubdivideTriangle_Adaptive_SubdivideInnerPart( subdivpatch &io_Patch,
+		uint32 i_iSubdivisionLevel, const subdivvertex &i_Vertex0,
+		const subdivvertex &i_Vertex1, const subdivvertex &i_Vertex2 );
 	
 	/// iClipToPlane() clippes a polygon to the specified clipping plane.
 	/// @param[in] i_iNumVertices number of vertices of the polygon to clip.
@@ -452,6 +671,17 @@ private:
 	void DrawTriangle( const m3dvsoutput *i_pVSOutput0,
 		const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 );
 	
+	/// Performs early culling of a triangle in clip space, before it is clipped and projected: outcode-based trivial rejection, back face culling and zero-area rejection using the homogeneous determinant, and small-primitive culling of triangles that cover no pixel centers.
+	/// @param[in] i_pVSOutput0 vertex A.
+	/// @param[in] i_pVSOutput1 vertex B.
+	/// @param[in] i_pVSOutput2 vertex C.
+	/// @param[out] o_iClipMask receives the clipping planes the triangle has to be clipped against, bit i corresponds to plane i of m3dclippingplanes; 0 if the triangle can be trivially accepted.
+	/// @param[out] o_bFacingTested receives true if back face culling has already been performed.
+	/// @return true if the triangle is invisible and has been culled.
+	bool bEarlyCullTriangle( const m3dvsoutput *i_pVSOutput0,
+		const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2,
+		uint32 &o_iClipMask, bool &o_bFacingTested );
+
 	/// Performs back face culling in screen space.
 	/// @param[in] i_pVSOutput0 vertex A.
 	/// @param[in] i_pVSOutput1 vertex B.
@@ -463,13 +693,17 @@ private:
 	/// @param[in,out] io_pVSOutput the vertex.
 	void ProjectVertex( m3dvsoutput *io_pVSOutput );
 
-	/// Calculates gradients for shader registers.
+	/// Queues a projected triangle for triangle setup. Triangles are set up in batches of c_iTriangleSetupBatchSize and rasterized in the order they have been queued.
 	/// @param[in] i_pVSOutput0 vertex A.
 	/// @param[in] i_pVSOutput1 vertex B.
 	/// @param[in] i_pVSOutput2 vertex C.
-	void CalculateTriangleGradients( const m3dvsoutput *i_pVSOutput0,
+	void SetupTriangle( const m3dvsoutput *i_pVSOutput0,
 		const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 );
 
+	/// Calculates the gradients of z, w and the shader registers for all queued triangles at once and rasterizes the triangles.
+	/// The gradients are computed in structure-of-arrays form across the batch.
+	void SetupTriangleBatch();
+
 	/// Sets shader registers from triangle gradients.
 	/// @param[in,out] io_pVSOutput vertex shader output.
 	/// @param[in] i_fX screen space x-coordinate.
@@ -480,13 +714,142 @@ private:
 	/// @param[in,out] io_pVSOutput vertex shader output.
 	void StepXVSOutputFromGradient( m3dvsoutput *io_pVSOutput );
 
-	/// Rasterizes a single triangle: Performs triangle setup and does scanline-conversion.
+	/// Rasterizes a single triangle: Does scanline-conversion using the gradients, which have been set up by SetupTriangleBatch().
 	/// @param[in] i_pVSOutput0 vertex A.
 	/// @param[in] i_pVSOutput1 vertex B.
 	/// @param[in] i_pVSOutput2 vertex C.
 	void RasterizeTriangle( const m3dvsoutput *i_pVSOutput0,
 		const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 );
 
+	/// Rasterizes a single triangle to multisampled buffers: Determines per scanline the coverage of each sample position and shades every pixel with at least one covered sample by calling ShadeMultiSamplePixel().
+	/// @note Called by RasterizeTriangle() after the triangle gradients have been computed.
+	/// @param[in] i_pVSOutput0 vertex A.
+	/// @param[in] i_pVSOutput1 vertex B.
+	/// @param[in] i_pVSOutput2 vertex C.
+	void RasterizeTriangle_MultiSample( const m3dvsoutput *i_pVSOutput0,
+		const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 );
+
+	/// Shades a pixel of multisampled buffers. Depth is interpolated and tested per covered sample, but the pixel shader is executed only once at the pixel's center; its colors are written to all samples that passed.
+	/// @param[in] i_iX position in rendertarget along x-axis.
+	/// @param[in] i_iY position in rendertarget along y-axis.
+	/// @param[in] i_iCoverage bitmask of the samples covered by the primitive.
+	/// @param[in] i_pVSOutput interpolated vertex data at the pixel's center.
+	/// @param[in] i_bTriangle true if the pixel belongs to a triangle: depth is interpolated to the samples using the triangle gradients and the shader registers still have to be divided by position w component. False for lines, whose vertex data has already been divided.
+	void ShadeMultiSamplePixel( uint32 i_iX, uint32 i_iY, uint32 i_iCoverage,
+		const m3dvsoutput *i_pVSOutput, bool i_bTriangle );
+
+	/// Checks if a triangle can pass the depth-test at pixels whose stored depth lies within the depth bounds.
+	/// Triangles are never rejected if failing the depth-test modifies the stencil-buffer (m3drs_stencilzfail other than m3dsop_keep).
+	/// @param[in] i_pVSOutput0 vertex A.
+	/// @param[in] i_pVSOutput1 vertex B.
+	/// @param[in] i_pVSOutput2 vertex C.
+	/// @return true if the triangle can be rejected.
+	bool bDepthBoundsCullTriangle( const m3dvsoutput *i_pVSOutput0,
+		const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 );
+
+	/// Rasterizes a scanline span of a triangle with the function matching the current render states.
+	/// @param[in] i_iY position in rendertarget along y-axis.
+	/// @param[in] i_iX left position in rendertarget along x-axis.
+	/// @param[in] i_iX2 right position in rendertarget along x-axis.
+	void RasterizeSpan( uint32 i_iY, int32 i_iX, int32 i_iX2 );
+
+	/// Rasterizes the pixels of a scanline span of a triangle, which belong to the current phase of the interleave pattern, see renderstate m3drs_interleave.
+	/// @param[in] i_iY position in rendertarget along y-axis.
+	/// @param[in] i_iX left position in rendertarget along x-axis.
+	/// @param[in] i_iX2 right position in rendertarget along x-axis.
+	void RasterizeSpan_Interleaved( uint32 i_iY, int32 i_iX, int32 i_iX2 );
+
+	/// Rasterizes those parts of a scanline span of a triangle, which cover depthbuffer tiles with depth values within the depth bounds.
+	/// @param[in] i_iY position in rendertarget along y-axis.
+	/// @param[in] i_iX left position in rendertarget along x-axis.
+	/// @param[in] i_iX2 right position in rendertarget along x-axis.
+	void RasterizeSpan_DepthBounds( uint32 i_iY, int32 i_iX, int32 i_iX2 );
+
+	/// Checks if a tile of the depthbuffer contains depth values within the depth bounds. Tiles are classified on first access during a draw-call.
+	/// @param[in] i_iTileX tile-column.
+	/// @param[in] i_iTileY tile-row.
+	/// @return false if the stored depth of every pixel of the tile lies outside the depth bounds.
+	bool bDepthBoundsTile( uint32 i_iTileX, uint32 i_iTileY );
+
+	/// Adds a scanline span to the pending row of 2x2 pixel quads; a completed row is rasterized by RasterizeQuadRow().
+	/// @param[in] i_iY position in rendertarget along y-axis.
+	/// @param[in] i_iX left position in rendertarget along x-axis.
+	/// @param[in] i_iX2 right position in rendertarget along x-axis.
+	void AddQuadSpan( uint32 i_iY, int32 i_iX, int32 i_iX2 );
+
+	/// Rasterizes the pending row of 2x2 pixel quads. All four pixels of a quad are set up before the covered ones are shaded, so that the pixel shader can compute partial derivatives as finite differences.
+	void RasterizeQuadRow();
+
+	/// Adds a scanline span to the pending row of coarse pixel blocks, which is four scanlines high; a completed row is rasterized by RasterizeCoarseRow().
+	/// @param[in] i_iY position in rendertarget along y-axis.
+	/// @param[in] i_iX left position in rendertarget along x-axis.
+	/// @param[in] i_iX2 right position in rendertarget along x-axis.
+	void AddCoarseSpan( uint32 i_iY, int32 i_iX, int32 i_iX2 );
+
+	/// Rasterizes the pending row of coarse pixel blocks: Looks up the shading rate of every 4x4 pixel cell, tests the covered pixels of each block, executes the pixel shader once at the block's center and writes its color to the pixels that passed.
+	void RasterizeCoarseRow();
+
+	/// Performs the depth-test.
+	/// @param[in] i_fDepth depth of the pixel.
+	/// @param[in] i_pDepthData pointer to the pixel's depth in the depthbuffer; not dereferenced if no depthbuffer is available.
+	/// @return true if the pixel passed the depth-test.
+	bool bDepthTest( float32 i_fDepth, const float32 *i_pDepthData );
+
+	/// Performs the depth bounds-test, which compares the depth stored in the depthbuffer against the depth bounds.
+	/// @param[in] i_pDepthData pointer to the pixel's depth in the depthbuffer; not dereferenced if the depth bounds-test is disabled.
+	/// @return true if the pixel passed the depth bounds-test.
+	bool bDepthBoundsTest( const float32 *i_pDepthData );
+
+	/// Performs the stencil-test for a pixel and applies the stencil-operation for failing pixels.
+	/// @param[in,out] io_pStencilData pointer to the pixel's stencil-value.
+	/// @return true if the pixel passed the stencil-test.
+	bool bStencilTest( uint8 *io_pStencilData );
+
+	/// Applies a stencil-operation to a pixel's stencil-value, respecting the stencil write-mask.
+	/// @param[in,out] io_pStencilData pointer to the pixel's stencil-value.
+	/// @param[in] i_Operation stencil-operation.
+	void UpdateStencil( uint8 *io_pStencilData, m3dstencilop i_Operation );
+
+	/// Performs the depth bounds-test, the stencil-test (if enabled) and the depth-test for a pixel before it is shaded, applying the stencil-operations for failing pixels.
+	/// @param[in] i_fDepth depth of the pixel.
+	/// @param[in] i_pDepthData pointer to the pixel's depth in the depthbuffer; not dereferenced if no depthbuffer is available.
+	/// @param[in,out] io_pStencilData pointer to the pixel's stencil-value; not dereferenced if stencil-testing is disabled.
+	/// @return true if the pixel passed all tests.
+	bool bStencilDepthTest( float32 i_fDepth, const float32 *i_pDepthData, uint8 *io_pStencilData );
+
+	/// Reads the color of a pixel from a colorbuffer, if the pixel shader needs it; otherwise returns (0,0,0,1).
+	/// @param[out] o_vColor receives the color.
+	/// @param[in] i_pFrameData pointer to the pixel's color in the colorbuffer; not dereferenced if no colorbuffer is available.
+	/// @param[in] i_iFloats number of floats of the colorbuffer.
+	void ReadPixelColor( vector4 &o_vColor, const float32 *i_pFrameData, uint32 i_iFloats );
+
+	/// Writes a color outputted by the pixel shader to a colorbuffer, blending it with the color in the colorbuffer according to renderstate m3drs_blendmode.
+	/// @param[in,out] io_pFrameData pointer to the pixel's color in the colorbuffer; not dereferenced if no colorbuffer is available.
+	/// @param[in] i_vColor color outputted by the pixel shader.
+	/// @param[in] i_iFloats number of floats of the colorbuffer.
+	void WritePixelColor( float32 *io_pFrameData, const vector4 &i_vColor, uint32 i_iFloats );
+
+	/// Reads the colors of a pixel from all colorbuffers, see ReadPixelColor().
+	/// @param[out] o_pColors receives one color per colorbuffer.
+	/// @param[in] i_pFrameData pointer to the pixel's color in the first colorbuffer.
+	/// @param[in] i_iX position in rendertarget along x-axis.
+	/// @param[in] i_iY position in rendertarget along y-axis.
+	void ReadPixelColors( vector4 *o_pColors, const float32 *i_pFrameData, uint32 i_iX, uint32 i_iY );
+
+	/// Writes the colors outputted by the pixel shader to all colorbuffers, see WritePixelColor().
+	/// @param[in,out] io_pFrameData pointer to the pixel's color in the first colorbuffer.
+	/// @param[in] i_iX position in rendertarget along x-axis.
+	/// @param[in] i_iY position in rendertarget along y-axis.
+	/// @param[in] i_pColors one color per colorbuffer.
+	void WritePixelColors( float32 *io_pFrameData, uint32 i_iX, uint32 i_iY, const vector4 *i_pColors );
+
+	/// Executes the pixel shader, calling IMuli3DPixelShader::bExecuteMRT() if the rendertarget holds more than one colorbuffer.
+	/// @param[in] i_pInput pixel shader input registers.
+	/// @param[in,out] io_pColors one color per colorbuffer.
+	/// @param[in,out] io_fDepth depth of the pixel.
+	/// @return false if the pixel got killed.
+	bool bExecutePixelShader( const shaderreg *i_pInput, vector4 *io_pColors, float32 &io_fDepth );
+
 	/// Rasterizes a line.
 	/// @param[in] i_pVSOutput0 vertex A.
 	/// @param[in] i_pVSOutput1 vertex B.
@@ -532,6 +895,28 @@ private:
 	void DrawPixel_ColorDepth( uint32 i_iX,
 		uint32 i_iY, const m3dvsoutput *i_pVSOutput );
 
+	/// Rasterizes a scanline span for depth-only rendering. Steps the interpolated depth across the span and depth-tests and writes it in blocks of pixels without calling the pixel shader.
+	/// @param[in] i_iY position in rendertarget along y-axis.
+	/// @param[in] i_iX left position in rendertarget along x-axis.
+	/// @param[in] i_iX2 right position in rendertarget along x-axis.
+	/// @param[in] i_fDepth interpolated depth at the left border of the span.
+	void RasterizeScanline_DepthOnly( uint32 i_iY,
+		uint32 i_iX, uint32 i_iX2, float32 i_fDepth );
+
+	/// Draws a single pixel to multisampled buffers, covering all of its samples. See ShadeMultiSamplePixel().
+	/// @param[in] i_iX position in rendertarget along x-axis.
+	/// @param[in] i_iY position in rendertarget along y-axis.
+	/// @param[in] i_pVSOutput interpolated vertex data, already divided by position w component.
+	void DrawPixel_MultiSample( uint32 i_iX,
+		uint32 i_iY, const m3dvsoutput *i_pVSOutput );
+
+	/// Draws a single pixel for depth-only rendering. Depth-tests and writes the pixel depth, which has been interpolated from the vertices, without calling the pixel shader.
+	/// @param[in] i_iX position in rendertarget along x-axis.
+	/// @param[in] i_iY position in rendertarget along y-axis.
+	/// @param[in] i_pVSOutput interpolated vertex data, already divided by position w component.
+	void DrawPixel_DepthOnly( uint32 i_iX,
+		uint32 i_iY, const m3dvsoutput *i_pVSOutput );
+
 private:
 	class CMuli3D	*m_pParent;			///< Pointer to parent.
 	
@@ -563,6 +948,7 @@ private:
 	} m_TextureSamplers[c_iMaxTextureSamplers];	///< The texture samplers.
 	
 	class CMuli3DRenderTarget	*m_pRenderTarget;	///< The render target.
+	class CMuli3DSurface		*m_pShadingRateImage;	///< The shading rate image (optional).
 
 	m3drect	m_ScissorRect;	///< The active scissor rect.
 
@@ -576,23 +962,75 @@ private:
 		uint32 iColorBufferPitch;	///< Colorbuffer width * number of floats; pitch in multiples of sizeof( float32 ).
 		bool bColorWrite;			///< True if writing to the colorbuffer has been enabled + if a colorbuffer is available.
 
+		uint32 iNumColorBuffers;	///< Number of colorbuffers written by the pixel shader; greater than 1 when rendering to multiple render targets.
+		float32 *pMRTData[c_iMaxColorBuffers];	///< Holds pointers to the data of the colorbuffers; entry 0 equals pFrameData.
+		uint32 iMRTFloats[c_iMaxColorBuffers];	///< Number of floats of the colorbuffers.
+		uint32 iMRTPitch[c_iMaxColorBuffers];	///< Pitches of the colorbuffers in multiples of sizeof( float32 ).
+
 		float32 *pDepthData;		///< Holds a pointer to the depthbuffer data.
 		uint32 iDepthBufferPitch;	///< Depthbuffer width * 1 (depthbuffers may only contain a single float); pitch in multiples of sizeof( float32 ).
 		m3dcmpfunc DepthCompare;	///< Depth compare-function. If no depthbuffer is available this is m3dcmp_always.
 		bool bDepthWrite;			///< True if writing to the depthbuffer has been enabled + if a depthbuffer is available.
 
+		float32 fMinDepthBound;		///< Minimum depth value stored in the depthbuffer that passes the depth bounds-test.
+		float32 fMaxDepthBound;		///< Maximum depth value stored in the depthbuffer that passes the depth bounds-test.
+		bool bDepthBoundsTest;		///< True if the depth bounds don't cover the entire range [0;1] + if a depthbuffer is available.
+		uint32 iDepthBoundsTilesX;	///< Number of depthbuffer tiles along the x-axis.
+
+		uint8 *pStencilData;		///< Holds a pointer to the stencil buffer data.
+		uint32 iStencilBufferPitch;	///< Stencil buffer width; pitch in bytes.
+		bool bStencilTest;			///< True if stencil-testing has been enabled + if a stencil buffer is available.
+		m3dcmpfunc StencilCompare;	///< Stencil compare-function.
+		uint32 iStencilRef;			///< Stencil reference value.
+		uint32 iStencilMask;		///< Mask applied before comparing stencil-values.
+		uint32 iStencilWriteMask;	///< Mask of the stencil bits that may be written.
+		m3dstencilop StencilFail;	///< Stencil-operation for pixels failing the stencil-test.
+		m3dstencilop StencilZFail;	///< Stencil-operation for pixels passing the stencil-test but failing the depth-test.
+		m3dstencilop StencilPass;	///< Stencil-operation for pixels passing both tests.
+
+		m3dblend BlendMode;			///< Blend-function applied when writing to the colorbuffer.
+		bool bReadDestColor;		///< True if the pixel shader needs the color in the colorbuffer.
+
 		void (CMuli3DDevice::*fpRasterizeScanline)( uint32, uint32, uint32,
 			m3dvsoutput * );	///< Rasterization-function for scanlines (triangle-drawing).
 
 		void (CMuli3DDevice::*fpDrawPixel)( uint32, uint32, const m3dvsoutput * );	///< Drawing-function for individual pixels.
 
+		bool bEarlyDepthTest;		///< True if the depth-test is performed before the pixel shader is executed (m3dpso_coloronly-shaders).
+		bool bMightKillPixels;		///< True if the pixel shader might kill pixels.
+		bool bDepthOnly;			///< True if only depth is rendered: no color is written and the pixel shader, if any, can neither kill pixels nor output depth. Neither the pixel shader is executed nor are vertex shader outputs interpolated.
+
+		uint32 iQuadRowY;			///< Upper scanline of the pending row of 2x2 pixel quads.
+		int32 iQuadSpans[2][2];		///< Left and right border of the two scanline spans of the pending quad row; empty spans have left >= right.
+		bool bQuadRowPending;		///< True if the pending quad row contains spans which have not been rasterized yet.
+
+		m3dinterleave Interleave;	///< Interleave pattern of triangle rasterization; m3dil_none if every pixel is processed.
+		uint32 iInterleavePhase;	///< Phase of the interleave pattern, whose pixels are processed.
+
+		bool bCoarseShading;		///< True if triangles are shaded in blocks of pixels, see renderstate m3drs_shadingrate.
+		uint32 iShadingRate;		///< Shading rate set by renderstate m3drs_shadingrate.
+		const float32 *pShadingRateData;	///< Holds a pointer to the data of the shading rate image; 0 if no shading rate image is used.
+		uint32 iShadingRateImageWidth;	///< Width of the shading rate image in tiles.
+		uint32 iCoarseRowY;			///< Upper scanline of the pending row of coarse pixel blocks.
+		int32 iCoarseSpans[4][2];	///< Left and right border of the four scanline spans of the pending row of coarse pixel blocks; empty spans have left >= right.
+		bool bCoarseRowPending;		///< True if the pending row of coarse pixel blocks contains spans which have not been rasterized yet.
+
 		uint32 iRenderedPixels;		///< Counts the number of pixels that pass the depth-test.
 
+		uint32 iSamples;			///< Number of samples per pixel of the rendertarget's buffers; 1 if they aren't multisampled.
+		float32 fSampleOffsets[c_iMaxMultiSamples][2];	///< Positions of the samples relative to the pixel's center, see CMuli3DSurface::GetSamplePosition().
+
 		m3drect ViewportRect;	///< Active viewport rectangle.
+		m3drect RasterRect;		///< Viewport rectangle intersected with the scissor rect if scissor testing is enabled. Rasterization is clamped to it, because triangles are only clipped to the guard band and samples of pixels along edges may lie outside.
 
 		plane ClippingPlanes[m3dcp_numplanes];	///< Planes used for clipping, frustum planes are initialized at device creation time.
 		bool bClippingPlaneEnabled[m3dcp_numplanes]; ///< Signals if a particular clipping plane is enabled.
-		plane ScissorPlanes[4];					///< Scissor planes used for clipping created from m_ScissorRect;
+		plane GuardBandPlanes[4];				///< Planes used for clipping instead of the left, right, top and bottom frustum planes, see c_fGuardBand.
+		uint32 iClippingPlaneMask;				///< Bitmask of the enabled clipping planes, bit i corresponds to plane i of m3dclippingplanes.
+		float32 fViewportOrientation;			///< Determinant of the upper-left 2x2 part of the viewport matrix; relates the orientation of triangles in clip space to their orientation in screen space.
+
+		uint32 iSetupComponents[c_iPixelShaderRegisters * 4];	///< Offsets of the interpolated shader register components in multiples of sizeof( float32 ); their gradients are computed during triangle setup.
+		uint32 iNumSetupComponents;				///< Number of interpolated shader register components.
 
 	} m_RenderInfo;	///< Contains information that serves as the base for rendering-processes.
 
@@ -605,6 +1043,17 @@ private:
 	m3dvsoutput m_ClipVertices[20];	///< Storage for vertices, that are created during clipping.
 	uint32		m_iNextFreeClipVertex;	///< Keeps the next index of m_ClipVertices that can be used for the creation of vertices during clipping.
 	m3dvsoutput *m_pClipVertices[2][20];	///< Pointers to polygon vertices, two stages: ping-pong during clipping.
+
+	uint8		*m_pDepthBoundsTiles;		///< Classification of depthbuffer tiles for the depth bounds-test - reset before each draw-call.
+	uint32		m_iNumDepthBoundsTiles;		///< Number of allocated tile-classifications.
+
+	m3dvsoutput m_SetupVertices[c_iTriangleSetupBatchSize][3];	///< Copies of the projected vertices of the queued triangles; clipping and the vertex cache reuse their storage before a batch is set up.
+	m3dtrianglesetup m_TriangleSetups[c_iTriangleSetupBatchSize];	///< Setup records of the queued triangles.
+	uint32		m_iNumSetupTriangles;		///< Number of queued triangles awaiting triangle setup.
+
+	subdivpatch	m_SubdivisionPatches[c_iSubdivisionBatchSize];	///< Triangles queued for subdivision.
+	uint32		m_iNumSubdivisionPatches;	///< Number of triangles queued for subdivision.
+	subdivcacheshard m_SubdivisionCache[c_iSubdivisionCacheShards];	///< Cache holding the vertices generated on the edges of triangles during subdivision, which may be shared by adjacent triangles - reset after each draw-call or once it holds more than c_iSubdivisionCacheSize vertices.
 };
 
 #endif // __M3DCORE_DEVICE_H__
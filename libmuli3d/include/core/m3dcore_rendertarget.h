@@ -40,8 +40,8 @@ protected:
 public:
 	class CMuli3DDevice *pGetDevice(); ///< Returns a pointer to the associated device. Calling this function will increase the internal reference count of the device. Failure to call Release() when finished using the pointer will result in a memory leak.
 
-	/// Clears the colorbuffer, which is associated with this rendertarget, to a given color.
-	/// @param[in] i_vColor color to clear the colorbuffer to.
+	/// Clears the colorbuffers, which are associated with this rendertarget, to a given color.
+	/// @param[in] i_vColor color to clear the colorbuffers to.
 	/// @param[in] i_pRect rectangle to restrict clearing to.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidstate if no colorbuffer has been set.
@@ -56,13 +56,32 @@ public:
 	/// @return e_invalidparameters if the clear-rectangle exceeds the depthbuffer's dimensions.
 	result ClearDepthBuffer( float32 i_fDepth, const m3drect *i_pRect );
 
+	/// Clears the stencil buffer, which is associated with this rendertarget, to a given value.
+	/// @param[in] i_iValue value to clear the stencil buffer to.
+	/// @param[in] i_pRect rectangle to restrict clearing to.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidstate if no stencil buffer has been set.
+	/// @return e_invalidparameters if the clear-rectangle exceeds the stencil buffer's dimensions.
+	result ClearStencilBuffer( uint8 i_iValue, const m3drect *i_pRect );
+
 	/// Associates a CMuli3DSurface as colorbuffer with this rendertarget, releasing the currently set colorbuffer.
 	/// Calling this function will increase the internal reference count of the surface.
 	/// @param[in] i_pColorBuffer new colorbuffer.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidformat if an invalid format was encountered.
+	/// @note Equivalent to SetColorBuffer( 0, i_pColorBuffer ).
 	result SetColorBuffer( class CMuli3DSurface *i_pColorBuffer );
 
+	/// Associates a CMuli3DSurface as colorbuffer with one of the rendertarget's colorbuffer-slots, releasing the colorbuffer currently set in this slot.
+	/// Pixel shaders write to all colorbuffers at once, see IMuli3DPixelShader::bExecuteMRT(). Slots have to be filled consecutively starting at 0 and all colorbuffers must have the same dimensions and sample counts; their formats may differ.
+	/// Calling this function will increase the internal reference count of the surface.
+	/// @param[in] i_iIndex colorbuffer-slot, e [0,c_iMaxColorBuffers).
+	/// @param[in] i_pColorBuffer new colorbuffer.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if the slot is invalid or if the surface is already set in another slot.
+	/// @return e_invalidformat if an invalid format was encountered.
+	result SetColorBuffer( uint32 i_iIndex, class CMuli3DSurface *i_pColorBuffer );
+
 	/// Associates a CMuli3DSurface as depthbuffer with this rendertarget, releasing the currently set depthbuffer.
 	/// Calling this function will increase the internal reference count of the surface.
 	/// @param[in] i_pDepthBuffer new depthbuffer.
@@ -70,19 +89,39 @@ public:
 	/// @return e_invalidformat if an invalid format was encountered.
 	result SetDepthBuffer( class CMuli3DSurface *i_pDepthBuffer );
 	
-	class CMuli3DSurface *pGetColorBuffer(); ///< Returns a pointer to the rendertarget's colorbuffer. Calling this function will increase the internal reference count of the texture. Failure to call Release() when finished using the pointer will result in a memory leak.
+	/// Associates a CMuli3DStencilBuffer with this rendertarget, releasing the currently set stencil buffer.
+	/// Calling this function will increase the internal reference count of the stencil buffer.
+	/// @param[in] i_pStencilBuffer new stencil buffer.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidformat if the dimensions don't match the colorbuffer or depthbuffer.
+	result SetStencilBuffer( class CMuli3DStencilBuffer *i_pStencilBuffer );
+
+	class CMuli3DSurface *pGetColorBuffer(); ///< Returns a pointer to the rendertarget's colorbuffer in slot 0. Calling this function will increase the internal reference count of the texture. Failure to call Release() when finished using the pointer will result in a memory leak.
+
+	/// Returns a pointer to the rendertarget's colorbuffer in a given slot. Calling this function will increase the internal reference count of the texture. Failure to call Release() when finished using the pointer will result in a memory leak.
+	/// @param[in] i_iIndex colorbuffer-slot, e [0,c_iMaxColorBuffers).
+	/// @return the colorbuffer or 0 if the slot is empty or invalid.
+	class CMuli3DSurface *pGetColorBuffer( uint32 i_iIndex );
 	
 	class CMuli3DSurface *pGetDepthBuffer(); ///< Returns a pointer to the rendertarget's depthbuffer. Calling this function will increase the internal reference count of the texture. Failure to call Release() when finished using the pointer will result in a memory leak.
 
+	class CMuli3DStencilBuffer *pGetStencilBuffer(); ///< Returns a pointer to the rendertarget's stencil buffer. Calling this function will increase the internal reference count of the stencil buffer. Failure to call Release() when finished using the pointer will result in a memory leak.
+
 	/// Sets the rendertarget's viewport matrix.
 	/// @param[in] i_matViewport the viewport matrix.
 	void SetViewportMatrix( const matrix44 &i_matViewport );
 	const matrix44 &matGetViewportMatrix(); ///< Returns the rendertarget's viewport matrix.
 
+private:
+	/// Returns the first colorbuffer set in any slot except the given one, which can be used as reference for the rendertarget's dimensions. Doesn't increase the reference count.
+	/// @param[in] i_iSkipIndex slot to be skipped; pass c_iMaxColorBuffers to consider all slots.
+	class CMuli3DSurface *pGetReferenceColorBuffer( uint32 i_iSkipIndex );
+
 private:
 	class CMuli3DDevice		*m_pParent;			///< Pointer to parent.
-	class CMuli3DSurface	*m_pColorBuffer;	///< Pointer to the colorbuffer.
+	class CMuli3DSurface	*m_pColorBuffers[c_iMaxColorBuffers];	///< Pointers to the colorbuffers.
 	class CMuli3DSurface	*m_pDepthBuffer;	///< Pointer to the depthbuffer.
+	class CMuli3DStencilBuffer	*m_pStencilBuffer;	///< Pointer to the stencil buffer.
 	matrix44				m_matViewport;		///< Viewport matrix.
 };
 
@@ -38,6 +38,7 @@ protected:
 	/// @param[in] i_pInput vertex shader input registers, data is loaded from the active vertex streams.
 	/// @param[out] o_vPosition vertex position transformed to homogeneous clipping space.
 	/// @param[out] o_pOutput vertex shader output registers which will be interpolated and passed to the pixel shader.
+	/// @note When subdivision is enabled, this function is called concurrently from several threads for the generated vertices and must not modify data shared between calls. The texture sampling functions may be called from several threads at once.
 	virtual void Execute( const shaderreg *i_pInput, vector4 &o_vPosition,
 		shaderreg *o_pOutput ) = 0;
 
@@ -69,6 +70,7 @@ protected:
 	friend class CMuli3DDevice;
 	virtual m3dpixelshaderoutput GetShaderOutput() { return m3dpso_coloronly; } ///< Accessible by CMuli3DDevice. Returns the type of the pixel shader; member of the enumeration m3dpixelshaderoutput. Default: m3dpso_coloronly.
 	virtual bool bMightKillPixels() { return true; }	///< Returns true incase support for pixel-killing for m3dpso_coloronly-shader-types shall be enabled.
+	virtual bool bNeedsDestinationColor() { return true; }	///< Returns true if the pixel shader reads the color in the colorbuffer, which is passed in as io_vColor to bExecute(). Return false to skip reading the colorbuffer; io_vColor is then initialized to (0,0,0,1). Blending by renderstate m3drs_blendmode does not require this.
 
 	/// Accessible by CMuli3D - Sets the triangle info.
 	/// @param[in] i_pVSOutputs pointer to the pixel shader input register-types.
@@ -78,13 +80,26 @@ protected:
 	/// Accessible by CMuli3DDevice.
 	/// This is the core function of a pixel shader: It receives interpolated register data from the vertex shader and can output a new color and depth value for the pixel currently being drawn.
 	/// @param[in] i_pInput pixel shader input registers, which have been set up in the vertex shader and interpolated during rasterization.
-	/// @param[in,out] io_vColor contains the value of the pixel in the rendertarget when Execute() is called. The pixel shader may perform blending with this value and setting it to a new color. Make sure to override GetShaderOutput() to the correct shader type.
+	/// @param[in,out] io_vColor contains the value of the pixel in the rendertarget when Execute() is called, unless bNeedsDestinationColor() returns false. The pixel shader may perform blending with this value and setting it to a new color, which is then combined with the colorbuffer according to renderstate m3drs_blendmode.
 	/// @param[in,out] io_fDepth contains the depth of the pixel in the rendertarget when Execute() is called. The pixel shader may set this to a new value. Make sure to override GetShaderOutput() to the correct shader type.
 	/// @return true if the pixel shall be written to the rendertarget, false in case it shall be killed.
 	virtual bool bExecute( const shaderreg *i_pInput, vector4 &io_vColor,
 		float32 &io_fDepth ) = 0;
 
+	/// Accessible by CMuli3DDevice.
+	/// Called instead of bExecute() if the rendertarget holds more than one colorbuffer, so that a pixel shader can output a color per colorbuffer from a single execution, e.g. to fill a g-buffer.
+	/// The default implementation calls bExecute() and writes the resulting color to all colorbuffers.
+	/// @param[in] i_pInput pixel shader input registers, which have been set up in the vertex shader and interpolated during rasterization.
+	/// @param[in,out] io_pColors one color per colorbuffer, each treated like io_vColor of bExecute().
+	/// @param[in] i_iNumColors number of colorbuffers, e [2,c_iMaxColorBuffers].
+	/// @param[in,out] io_fDepth contains the depth of the pixel in the rendertarget when Execute() is called. The pixel shader may set this to a new value. Make sure to override GetShaderOutput() to the correct shader type.
+	/// @return true if the pixel shall be written to the rendertarget, false in case it shall be killed.
+	virtual bool bExecuteMRT( const shaderreg *i_pInput, vector4 *io_pColors,
+		uint32 i_iNumColors, float32 &io_fDepth );
+
 	/// This functions computes the partial derivatives of a shader register with respect to the screen space coordinates.
+	/// Depending on renderstate m3drs_lodgranularity the derivatives are evaluated once per pixel, 2x2 pixel quad or span and shared by subsequent calls for the same quad or span.
+	/// If renderstate m3drs_quadshadingenable is set the derivatives are the finite differences of the input registers of neighbouring pixels in the current 2x2 quad.
 	/// @param[in] i_iRegister index of the source shader register.
 	/// @param[out] o_vDdx partial derivative with respect to the x-screen space coordinate.
 	/// @param[out] o_vDdy partial derivative with respect to the y-screen space coordinate.
@@ -93,6 +108,13 @@ protected:
 private:
 	const m3dshaderregtype			*m_pVSOutputs; ///< Register type info.
 	const struct m3dtriangleinfo	*m_pTriangleInfo; ///< Gradient info about the triangle that is currently being drawn.
+
+	// Cached partial derivatives for m3dlod_quad and m3dlod_span.
+	mutable uint32		m_iCachedGradientsID; ///< Gradients-ID of the triangle the cached derivatives belong to.
+	mutable uint32		m_iCachedPixelX, m_iCachedPixelY; ///< Pixel at which the cached derivatives have been evaluated.
+	mutable uint32		m_iCachedRegisters; ///< Bitmask of the registers whose derivatives are cached.
+	mutable shaderreg	m_CachedDdx[c_iPixelShaderRegisters]; ///< Cached partial derivatives with respect to the x-screen space coordinate.
+	mutable shaderreg	m_CachedDdy[c_iPixelShaderRegisters]; ///< Cached partial derivatives with respect to the y-screen space coordinate.
 };
 
 #endif // __M3DCORE_SHADERS_H__
@@ -0,0 +1,206 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/// @file m3dcore_sparsetexture.h
+///
+
+#ifndef __M3DCORE_SPARSETEXTURE_H__
+#define __M3DCORE_SPARSETEXTURE_H__
+
+#include "../m3dbase.h"
+#include "../m3dtypes.h"
+
+#include "m3dcore_basetexture.h"
+#include "m3dcore_threads.h"
+
+#include <stdio.h>
+
+const uint32 c_iSparseTextureFileID = 0x5333444d; ///< Identifies a tiled texture file ("M3DS" in little endian byte order).
+
+/// Header of a tiled texture file. It is followed by the pages of all mip-levels (largest first); the pages of a mip-level are stored row by row.
+/// Each page consists of iPageSize * iPageSize pixels; pages at the right and bottom edges of a mip-level are padded by repeating the last column/row.
+/// All values are stored in the native byte order of the machine that wrote the file.
+struct m3dsparsetexturefileheader
+{
+	uint32	iFileID;		///< Has to be c_iSparseTextureFileID.
+	uint32	iFormat;		///< Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
+	uint32	iWidth;			///< Width of the base mip-level in pixels.
+	uint32	iHeight;		///< Height of the base mip-level in pixels.
+	uint32	iMipLevels;		///< Number of mip-levels stored in the file.
+	uint32	iPageSize;		///< Edge length of a page in pixels.
+};
+
+/// CMuli3DSparseTexture implements a 2-dimensional texture, whose mip-levels are divided into pages that are streamed in from a tiled texture file on demand.
+/// Only a limited number of pages is resident in memory at any time; a page table maps the pages of each mip-level to their memory.
+/// Sampling a page that isn't resident falls back to the nearest coarser mip-level, which is resident, and records a request for the page.
+/// Requested pages are then loaded either by a loader thread or by calls to iUpdateResidency(). When the residency budget is exhausted the least recently used pages are evicted.
+/// The mip-levels that fit into a single page are always resident.
+class CMuli3DSparseTexture : public IMuli3DBaseTexture
+{
+protected:
+	~CMuli3DSparseTexture(); ///< Accessible by IBase. The destructor is called when the reference count reaches zero.
+
+	friend class CMuli3DDevice;
+	/// Accessible by CMuli3DDevice which is the only class that may create a texture.
+	/// @param[in] i_pParent a pointer to the parent CMuli3DDevice-object.
+	CMuli3DSparseTexture( class CMuli3DDevice *i_pParent );
+
+	/// Accessible by CMuli3DDevice which is the only class that may create a texture.
+	/// @param[in] i_szFilename tiled texture file, which stays open for the lifetime of the texture.
+	/// @param[in] i_iMaxResidentPages maximum number of pages that are resident in memory, apart from the mip-levels that fit into a single page.
+	/// @param[in] i_bLoaderThread true to start a thread that loads requested pages in the background.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid or the file couldn't be read.
+	/// @return e_outofmemory if memory allocation failed.
+	/// @return e_invalidformat if an invalid format was encountered.
+	result Create( const char *i_szFilename, uint32 i_iMaxResidentPages, bool i_bLoaderThread );
+
+	m3dtexsampleinput eGetTexSampleInput(); ///< Sampling this texture requires 2 floating point coordinates.
+
+	/// Accessible by CMuli3DDevice.
+	/// Samples the texture and returns the looked-up color.
+	/// @param[out] o_vColor receives the color of the pixel to be looked up.
+	/// @param[in] i_fU u-component of the lookup-vector.
+	/// @param[in] i_fV v-component of the lookup-vector.
+	/// @param[in] i_fW w-component of the lookup-vector (unused).
+	/// @param[in] i_pXGradient partial derivatives of the texture coordinates with respect to the screen-space x coordinate. If 0 the base mip-level will be chosen and the minification filter will be used for texture sampling.
+	/// @param[in] i_pYGradient partial derivatives of the texture coordinates with respect to the screen-space y coordinate. If 0 the base mip-level will be chosen and the minification filter will be used for texture sampling.
+	/// @param[in] i_pSamplerStates texture sampler states.
+	/// @return s_ok if the function succeeds.
+	result SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i_fV,
+		float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient,
+		const uint32 *i_pSamplerStates );
+
+public:
+	/// Writes the mip-levels of a texture to a tiled texture file, which can then be used to create a sparse texture.
+	/// @param[in] i_szFilename name of the file to be written.
+	/// @param[in] i_pTexture texture whose mip-levels will be written.
+	/// @param[in] i_iPageSize edge length of a page in pixels; 64 is a good choice.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid or the file couldn't be written.
+	static result WriteTiledTextureFile( const char *i_szFilename,
+		class CMuli3DTexture *i_pTexture, uint32 i_iPageSize );
+
+	/// Marks the beginning of a new frame. Pages used during the last frames are evicted last, pages used during the current frame are never evicted.
+	/// Must not be called while the texture is being sampled, i.e. only between frames.
+	void NextFrame();
+
+	/// Loads requested pages on the calling thread. Call this once per frame if no loader thread is running.
+	/// @param[in] i_iMaxPages maximum number of pages to be loaded.
+	/// @return number of pages that have been loaded.
+	uint32 iUpdateResidency( uint32 i_iMaxPages );
+
+	m3dformat fmtGetFormat();			///< Returns the format of the texture. Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
+	uint32 iGetFormatFloats();			///< Returns the number of floats of the format, e [1,4].
+	uint32 iGetMipLevels();				///< Returns the number of mip-levels this texture consists of.
+	uint32 iGetPageSize();				///< Returns the edge length of a page in pixels.
+	uint32 iGetNumResidentPages();		///< Returns the number of pages that are currently resident in memory.
+	uint32 iGetNumRequestedPages();		///< Returns the number of pages that have been requested, but haven't been loaded yet.
+
+	/// Returns the width of the given mip-level in pixels.
+	/// @param[in] i_iMipLevel the mip-level whose width is requested.
+	uint32 iGetWidth( uint32 i_iMipLevel = 0 );
+
+	/// Returns the height of the given mip-level in pixels.
+	/// @param[in] i_iMipLevel the mip-level whose height is requested.
+	uint32 iGetHeight( uint32 i_iMipLevel = 0 );
+
+private:
+	/// Looks up a pixel and records a request for its page if it isn't resident. The page stays resident until the end of the current frame.
+	/// @param[in] i_iMipLevel mip-level.
+	/// @param[in] i_iX x-coordinate of the pixel.
+	/// @param[in] i_iY y-coordinate of the pixel.
+	/// @return pointer to the pixel or 0 if its page isn't resident.
+	const float32 *pGetPixel( uint32 i_iMipLevel, uint32 i_iX, uint32 i_iY );
+
+	/// Samples a mip-level, if the required pages are resident.
+	/// @param[out] o_vColor receives the color.
+	/// @param[in] i_iMipLevel mip-level to be sampled.
+	/// @param[in] i_fU u-component of the lookup-vector.
+	/// @param[in] i_fV v-component of the lookup-vector.
+	/// @param[in] i_bLinear true for bi-linear filtering, false for nearest point sampling.
+	/// @return true if the mip-level could be sampled.
+	bool bSampleMipLevel( vector4 &o_vColor, uint32 i_iMipLevel, float32 i_fU,
+		float32 i_fV, bool i_bLinear );
+
+	/// Samples the given mip-level or, if its pages aren't resident, the nearest coarser mip-level that is.
+	/// @param[out] o_vColor receives the color.
+	/// @param[in] i_iMipLevel preferred mip-level.
+	/// @param[in] i_fU u-component of the lookup-vector.
+	/// @param[in] i_fV v-component of the lookup-vector.
+	/// @param[in] i_bLinear true for bi-linear filtering, false for nearest point sampling.
+	void SampleResidentMipLevel( vector4 &o_vColor, uint32 i_iMipLevel,
+		float32 i_fU, float32 i_fV, bool i_bLinear );
+
+	void RequestPage( uint32 i_iPage );				///< Adds a page to the request queue, unless it has already been requested.
+	result LoadPage( uint32 i_iPage, uint32 i_iSlot );	///< Reads a page from the file into a memory slot.
+	int32 iAllocateSlot();							///< Returns a free memory slot, evicting the least recently used page if necessary; -1 if all slots are in use.
+
+	static void LoaderThread( void *i_pSparseTexture ); ///< Entry point of the loader thread.
+
+private:
+	/// Describes the page layout of a mip-level.
+	struct sparsemiplevel
+	{
+		uint32	iWidth, iHeight;	///< Dimensions in pixels.
+		uint32	iPagesX, iPagesY;	///< Number of pages in x- and y-direction.
+		uint32	iFirstPage;			///< Index of the mip-level's first page.
+	};
+
+	/// Describes a memory slot, which holds the data of a page.
+	struct sparsepageslot
+	{
+		int32			iPage;		///< Index of the page held by this slot or -1 if the slot is free.
+		volatile uint32	iLastUse;	///< Frame in which the page has last been sampled; samplers and the loader claim the slot by changing it with bAtomicCompareExchange().
+		bool			bPinned;	///< True if the page may not be evicted.
+	};
+
+	FILE				*m_pFile;				///< Tiled texture file.
+	m3dformat			m_fmtFormat;			///< Format of the texture.
+	uint32				m_iFloats;				///< Number of floats per pixel.
+	uint32				m_iPageSize;			///< Edge length of a page in pixels.
+	uint32				m_iPageFloats;			///< Number of floats per page.
+	float32				m_fSquaredWidth, m_fSquaredHeight; ///< Squared dimensions of the base mip-level, used for mip-calculations.
+
+	uint32				m_iMipLevels;			///< Number of mip-levels.
+	sparsemiplevel		*m_pMipLevels;			///< Page layout of the mip-levels.
+
+	uint32				m_iNumPages;			///< Total number of pages of all mip-levels.
+	volatile int32		*m_pPageTable;			///< Maps each page to the memory slot holding it or -1 if the page isn't resident.
+	volatile bool		*m_pPageRequested;		///< True for each page that is in the request queue.
+
+	uint32				m_iNumSlots;			///< Number of memory slots.
+	sparsepageslot		*m_pSlots;				///< Memory slots.
+	float32				*m_pSlotData;			///< Memory of all slots.
+	uint32				m_iNumResidentPages;	///< Number of slots that hold a page.
+
+	uint32				*m_pRequestQueue;		///< Ring-buffer of requested pages; holds each page at most once.
+	uint32				m_iRequestHead;			///< Index of the oldest request.
+	volatile uint32		m_iNumRequests;			///< Number of requests in the queue.
+	CMuli3DMutex		m_RequestMutex;			///< Protects the request queue.
+
+	volatile uint32		m_iFrame;				///< Current frame, used for LRU-eviction.
+	CMuli3DMutex		m_LoadMutex;			///< Serializes loading and eviction of pages.
+
+	CMuli3DThread		m_LoaderThread;			///< Thread loading requested pages in the background.
+	CMuli3DEvent		m_LoaderEvent;			///< Wakes up the loader thread when pages have been requested.
+	volatile bool		m_bStopLoader;			///< Tells the loader thread to exit.
+};
+
+#endif // __M3DCORE_SPARSETEXTURE_H__
@@ -0,0 +1,77 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+/// @file m3dcore_stencilbuffer.h
+///
+
+#ifndef __M3DCORE_STENCILBUFFER_H__
+#define __M3DCORE_STENCILBUFFER_H__
+
+#include "../m3dbase.h"
+#include "../m3dtypes.h"
+
+/// Stencil buffers store an 8-bit stencil value per pixel. They are attached to rendertargets and used for stencil-testing, see renderstate m3drs_stencilenable.
+class CMuli3DStencilBuffer : public IBase
+{
+protected:
+	~CMuli3DStencilBuffer(); ///< Accessible by IBase. The destructor is called when the reference count reaches zero.
+
+	friend class CMuli3DDevice;
+	/// Accessible by CMuli3DDevice which is the only class that may create a stencil buffer.
+	/// @param[in] i_pParent a pointer to the parent CMuli3DDevice-object.
+	CMuli3DStencilBuffer( class CMuli3DDevice *i_pParent );
+
+	/// Accessible by CMuli3DDevice which is the only class that may create a stencil buffer.
+	/// @param[in] i_iWidth width of the stencil buffer in pixels.
+	/// @param[in] i_iHeight height of the stencil buffer in pixels.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	result Create( uint32 i_iWidth, uint32 i_iHeight );
+
+public:
+	class CMuli3DDevice *pGetDevice(); ///< Returns a pointer to the associated device. Calling this function will increase the internal reference count of the device. Failure to call Release() when finished using the pointer will result in a memory leak.
+
+	/// Clears the stencil buffer to a given value.
+	/// @param[in] i_iValue value to clear the stencil buffer to.
+	/// @param[in] i_pRect rectangle to restrict clearing to.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if the clear-rectangle exceeds the stencil buffer's dimensions.
+	result Clear( uint8 i_iValue, const m3drect *i_pRect );
+
+	/// Returns a pointer to the stencil value of a pixel. Stencil values are stored row by row, the pitch equals the width.
+	/// @param[in] i_iX x-coordinate of the pixel.
+	/// @param[in] i_iY y-coordinate of the pixel.
+	/// @param[out] o_ppData receives the pointer.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	result GetPointer( uint32 i_iX, uint32 i_iY, uint8 **o_ppData );
+
+	uint32 iGetWidth();		///< Returns the width of the stencil buffer in pixels.
+	uint32 iGetHeight();	///< Returns the height of the stencil buffer in pixels.
+
+private:
+	class CMuli3DDevice	*m_pParent;		///< Pointer to parent.
+	uint32				m_iWidth;		///< Width of the stencil buffer in pixels.
+	uint32				m_iHeight;		///< Height of the stencil buffer in pixels.
+	uint8				*m_pData;		///< Pointer to the stencil values.
+};
+
+#endif // __M3DCORE_STENCILBUFFER_H__
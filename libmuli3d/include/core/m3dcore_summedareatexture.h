@@ -0,0 +1,118 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/// @file m3dcore_summedareatexture.h
+///
+
+#ifndef __M3DCORE_SUMMEDAREATEXTURE_H__
+#define __M3DCORE_SUMMEDAREATEXTURE_H__
+
+#include "../m3dbase.h"
+#include "../m3dtypes.h"
+
+#include "m3dcore_basetexture.h"
+
+/// CMuli3DSummedAreaTexture implements a 2-dimensional texture, which stores a summed-area table of its pixels instead of a mip-chain.
+/// Every lookup returns the average of the pixels within an axis-aligned rectangle in constant time, no matter how large the rectangle is:
+/// SampleTexture() derives the rectangle from the texture coordinate gradients, IMuli3DBaseShader::SampleTextureRect() takes it explicitly.
+/// With point filtering the rectangle is snapped to pixel boundaries and looked up in 4 fetches; with linear filtering the table is interpolated, so that rectangles may have fractional extents (16 fetches).
+/// Rectangles are clamped to the texture; texture coordinate wrapping only applies to their center.
+class CMuli3DSummedAreaTexture : public IMuli3DBaseTexture
+{
+protected:
+	~CMuli3DSummedAreaTexture(); ///< Accessible by IBase. The destructor is called when the reference count reaches zero.
+
+	friend class CMuli3DDevice;
+	/// Accessible by CMuli3DDevice which is the only class that may create a texture.
+	/// @param[in] i_pParent a pointer to the parent CMuli3DDevice-object.
+	CMuli3DSummedAreaTexture( class CMuli3DDevice *i_pParent );
+
+	/// Accessible by CMuli3DDevice which is the only class that may create a texture.
+	/// @param[in] i_pSourceTexture texture whose base mip-level the summed-area table is built from.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	result Create( class CMuli3DTexture *i_pSourceTexture );
+
+	m3dtexsampleinput eGetTexSampleInput(); ///< Sampling this texture requires 2 floating point coordinates.
+
+	/// Accessible by CMuli3DDevice.
+	/// Returns the average color of the rectangle covered by the texture coordinate gradients. If no gradients are passed in a single pixel is looked up.
+	/// @param[out] o_vColor receives the color of the pixel to be looked up.
+	/// @param[in] i_fU u-component of the lookup-vector.
+	/// @param[in] i_fV v-component of the lookup-vector.
+	/// @param[in] i_fW w-component of the lookup-vector (unused).
+	/// @param[in] i_pXGradient partial derivatives of the texture coordinates with respect to the screen-space x coordinate.
+	/// @param[in] i_pYGradient partial derivatives of the texture coordinates with respect to the screen-space y coordinate.
+	/// @param[in] i_pSamplerStates texture sampler states.
+	/// @return s_ok if the function succeeds.
+	result SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i_fV,
+		float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient,
+		const uint32 *i_pSamplerStates );
+
+	/// Accessible by CMuli3DDevice.
+	/// Returns the average color of the given rectangle.
+	/// @param[out] o_vColor receives the average color.
+	/// @param[in] i_fU0 left border of the rectangle.
+	/// @param[in] i_fV0 top border of the rectangle.
+	/// @param[in] i_fU1 right border of the rectangle.
+	/// @param[in] i_fV1 bottom border of the rectangle.
+	/// @param[in] i_pSamplerStates texture sampler states.
+	/// @return s_ok if the function succeeds.
+	result SampleTextureRect( vector4 &o_vColor, float32 i_fU0, float32 i_fV0,
+		float32 i_fU1, float32 i_fV1, const uint32 *i_pSamplerStates );
+
+public:
+	/// Rebuilds the summed-area table from a texture's base mip-level.
+	/// @param[in] i_pSourceTexture source texture; its dimensions and format have to match the summed-area texture.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	result Update( class CMuli3DTexture *i_pSourceTexture );
+
+	m3dformat fmtGetFormat();	///< Returns the format of the texture. Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
+	uint32 iGetFormatFloats();	///< Returns the number of floats of the format, e [1,4].
+	uint32 iGetWidth();			///< Returns the width of the texture in pixels.
+	uint32 iGetHeight();		///< Returns the height of the texture in pixels.
+
+private:
+	/// Averages a rectangle given in pixel coordinates, which has already been clamped to the texture.
+	/// @param[out] o_vColor receives the average color.
+	/// @param[in] i_fX0 left border of the rectangle, e [0,width].
+	/// @param[in] i_fY0 top border of the rectangle, e [0,height].
+	/// @param[in] i_fX1 right border of the rectangle, e [i_fX0,width].
+	/// @param[in] i_fY1 bottom border of the rectangle, e [i_fY0,height].
+	/// @param[in] i_bLinear true to interpolate the table, false to snap the rectangle to pixel boundaries.
+	void AverageRect( vector4 &o_vColor, float32 i_fX0, float32 i_fY0,
+		float32 i_fX1, float32 i_fY1, bool i_bLinear );
+
+	/// Accumulates the weighted table entry at integer coordinates.
+	void AddTableEntry( float32 *io_pSum, uint32 i_iX, uint32 i_iY, float32 i_fWeight );
+
+	/// Accumulates the weighted, bi-linearly interpolated table entry at fractional coordinates.
+	void AddInterpolatedTableEntry( float32 *io_pSum, float32 i_fX, float32 i_fY, float32 i_fWeight );
+
+private:
+	m3dformat	m_fmtFormat;		///< Format of the texture.
+	uint32		m_iFloats;			///< Number of floats per pixel.
+	uint32		m_iWidth, m_iHeight; ///< Dimensions in pixels.
+	float32		m_fMean[4];			///< Mean color, which is subtracted from the pixels before summing them up to preserve precision.
+	float32		*m_pTable;			///< Summed-area table of ( m_iWidth + 1 ) * ( m_iHeight + 1 ) entries; the first row and column are 0.
+};
+
+#endif // __M3DCORE_SUMMEDAREATEXTURE_H__
@@ -27,6 +27,8 @@
 #include "../m3dtypes.h"
 
 /// CMuli3DSurface implements a 2-dimensional image.
+/// Multisampled surfaces store several samples per pixel, see CMuli3DDevice::CreateMultiSampleSurface(). The samples of a pixel are stored next to each other, i.e. sample s of pixel (x,y) is located at float-offset ( ( y * width + x ) * samples + s ) * floats.
+/// Sampling, partial locking and CopyToSurface() are only supported for surfaces with a single sample per pixel; multisampled surfaces have to be resolved by ResolveToSurface().
 class CMuli3DSurface : public IBase
 {
 protected:
@@ -41,11 +43,12 @@ protected:
 	/// @param[in] i_iWidth width of the surface to be created in pixels.
 	/// @param[in] i_iHeight height of the surface to be created in pixels.
 	/// @param[in] i_fmtFormat format of the surface to be created. Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
+	/// @param[in] i_iSamples number of samples per pixel; 1, 2, 4 or 8.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_outofmemory if memory allocation failed.
 	/// @return e_invalidformat if an invalid format was encountered.
-	result Create( uint32 i_iWidth, uint32 i_iHeight, m3dformat i_fmtFormat );
+	result Create( uint32 i_iWidth, uint32 i_iHeight, m3dformat i_fmtFormat, uint32 i_iSamples );
 
 public:
 	/// Samples the surface using nearest point sampling.
@@ -60,6 +63,19 @@ public:
 	/// @param[in] i_fV v-component of the lookup-vector.
 	void SampleLinear( vector4 &o_vColor, float32 i_fU, float32 i_fV );
 
+	/// Performs a depth-comparison lookup with percentage closer filtering: compares a reference value to the red channel of the pixels within a kernel around the lookup-position and returns the weighted fraction of pixels that pass.
+	/// With linear filtering the kernel covers a box of i_iKernelSize - 1 pixels centered at the lookup-position, i.e. the outer pixels are weighted by their coverage (a kernel of 2x2 pixels results in bi-linear weights); otherwise all pixels of the kernel around the nearest pixel are weighted equally.
+	/// Pixels outside the surface are clamped to its edges.
+	/// @param[in] i_fU u-component of the lookup-vector.
+	/// @param[in] i_fV v-component of the lookup-vector.
+	/// @param[in] i_fReference reference value, e.g. the depth of the pixel to be shadowed.
+	/// @param[in] i_CmpFunc compare-function: a pixel passes if i_fReference <i_CmpFunc> pixel-value.
+	/// @param[in] i_iKernelSize edge length of the kernel in pixels, e [1,c_iMaxPCFKernelSize].
+	/// @param[in] i_bLinear true for linear filtering, false for nearest point sampling.
+	/// @return fraction of passing pixels, e [0,1].
+	float32 fSampleCompare( float32 i_fU, float32 i_fV, float32 i_fReference,
+		m3dcmpfunc i_CmpFunc, uint32 i_iKernelSize, bool i_bLinear );
+
 	/// Clears the surface to a given color.
 	/// @param[in] i_vColor color to clear the surface to.
 	/// @param[in] i_pRect rectangle to restrict clearing to.
@@ -78,9 +94,27 @@ public:
 	result CopyToSurface( const m3drect *i_pSrcRect, CMuli3DSurface *i_pDestSurface,
 		const m3drect *i_pDestRect, m3dtexturefilter i_Filter );
 
+	/// Resolves the samples of a multisampled surface to a surface with a single sample per pixel.
+	/// @param[in] i_pDestSurface destination surface; must have the same dimensions and a single sample per pixel. The formats may differ.
+	/// @param[in] i_Filter resolve filter. Member of the enumeration m3dresolvefilter.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if the destination surface or the filter is invalid.
+	/// @return e_invalidstate if the destination surface couldn't be locked.
+	result ResolveToSurface( CMuli3DSurface *i_pDestSurface, m3dresolvefilter i_Filter );
+
+	/// Reconstructs the pixels, which don't belong to a given phase of an interleave pattern, from the neighbouring pixels of the phase. Use this after an interleaved frame (see renderstate m3drs_interleave), if the pixels of the other phases, which stem from previous frames, are outdated.
+	/// Checkerboard pixels are set to the average of their horizontal and vertical neighbours; for the other patterns the grid of the phase's pixels is interpolated bilinearly.
+	/// @param[in] i_Interleave interleave pattern. Member of the enumeration m3dinterleave.
+	/// @param[in] i_iPhase phase of the interleave pattern, whose pixels are valid.
+	/// @param[in] i_pRect rectangle to restrict reconstruction to, usually the viewport. Pass in 0 to reconstruct the entire surface.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if the pattern or the rectangle is invalid.
+	/// @return e_invalidstate if the surface is multisampled or locked.
+	result ReconstructInterleaved( m3dinterleave i_Interleave, uint32 i_iPhase, const m3drect *i_pRect );
+
 	/// Returns a pointer to the contents of the surface.
 	/// @param[out] o_ppData receives the pointer to the surface-data.
-	/// @param[in] i_pRect area that will be locked and accessible. (Pass in 0 to lock the entire surface.)
+	/// @param[in] i_pRect area that will be locked and accessible. (Pass in 0 to lock the entire surface; multisampled surfaces can only be locked entirely.)
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_invalidstate if the surface is already locked.
@@ -98,6 +132,28 @@ public:
 	
 	uint32 iGetWidth(); ///< Returns the width of the surface in pixels.
 	uint32 iGetHeight(); ///< Returns the height of the surface in pixels.
+	uint32 iGetSamples(); ///< Returns the number of samples per pixel; 1 for surfaces that aren't multisampled.
+
+	/// Returns the position of a sample within a pixel for a given sample count. The patterns distribute the samples over rows and columns, so that near-horizontal and near-vertical edges get as many coverage levels as possible.
+	/// @param[in] i_iSamples number of samples per pixel; 1, 2, 4 or 8.
+	/// @param[in] i_iSample index of the sample, e [0,i_iSamples).
+	/// @param[out] o_fX receives the x-offset of the sample relative to the pixel's center, e (-0.5,0.5).
+	/// @param[out] o_fY receives the y-offset of the sample relative to the pixel's center, e (-0.5,0.5).
+	static void GetSamplePosition( uint32 i_iSamples, uint32 i_iSample, float32 &o_fX, float32 &o_fY );
+
+	/// Returns the number of phases of an interleave pattern.
+	/// @param[in] i_Interleave interleave pattern. Member of the enumeration m3dinterleave.
+	/// @return the number of phases; 1 for m3dil_none.
+	static uint32 iGetInterleavePhases( m3dinterleave i_Interleave );
+
+	/// Returns the pixels of a row, which belong to a phase of an interleave pattern: these are located at x = o_iOffsetX + k * o_iStepX. The phases of the 2x2 and 4x4 patterns are ordered like a Bayer-matrix, so that consecutive phases are spread evenly.
+	/// @param[in] i_Interleave interleave pattern. Member of the enumeration m3dinterleave.
+	/// @param[in] i_iPhase phase of the interleave pattern, e [0,iGetInterleavePhases()).
+	/// @param[in] i_iY row.
+	/// @param[out] o_iOffsetX receives the x-position of the row's first pixel of the phase, e [0,o_iStepX).
+	/// @param[out] o_iStepX receives the distance between the row's pixels of the phase.
+	/// @return false if no pixel of the row belongs to the phase.
+	static bool bGetInterleaveRow( m3dinterleave i_Interleave, uint32 i_iPhase, uint32 i_iY, uint32 &o_iOffsetX, uint32 &o_iStepX );
 
 	/// Returns a pointer to the associated device. Calling this function will increase the internal reference count of the device. Failure to call Release() when finished using the pointer will result in a memory leak.
 	class CMuli3DDevice *pGetDevice();
@@ -110,6 +166,7 @@ private:
 	uint32		m_iHeight;		///< Height of the surface in pixels.
 	uint32		m_iWidthMin1;	///< Width - 1 of the surface in pixels.
 	uint32		m_iHeightMin1;	///< Height - 1 of the surface in pixels.
+	uint32		m_iSamples;		///< Number of samples per pixel.
 
 	bool	m_bLockedComplete;		///< True if the whole surface has been locked.
 	m3drect	m_PartialLockRect;		///< Information about the locked rectangle.
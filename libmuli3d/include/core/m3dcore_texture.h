@@ -27,6 +27,7 @@
 #include "../m3dtypes.h"
 
 #include "m3dcore_basetexture.h"
+#include "m3dcore_threads.h"
 
 /// CMuli3DTexture implements a standard 2-dimensional texture.
 class CMuli3DTexture : public IMuli3DBaseTexture
@@ -54,7 +55,8 @@ protected:
 	m3dtexsampleinput eGetTexSampleInput(); ///< Sampling this texture requires 2 floating point coordinates.
 
 	friend class CMuli3DCubeTexture;
-	/// Accessible by CMuli3DDevice and CMuli3DCubeTexture. (A cube-texture consists of six standard 2d textures and needs access to their sampling function.)
+	friend class CMuli3DTextureArray;
+	/// Accessible by CMuli3DDevice, CMuli3DCubeTexture and CMuli3DTextureArray. (Cube-textures and texture arrays consist of standard 2d textures and need access to their sampling function.)
 	/// Samples the texture and returns the looked-up color.
 	/// @param[out] o_vColor receives the color of the pixel to be looked up.
 	/// @param[in] i_fU u-component of the lookup-vector.
@@ -68,12 +70,35 @@ protected:
 		float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient,
 		const uint32 *i_pSamplerStates );
 
+	/// Accessible by CMuli3DDevice.
+	/// Performs a depth-comparison lookup with percentage closer filtering on the base mip-level; see CMuli3DSurface::fSampleCompare().
+	/// @param[out] o_fResult receives the fraction of texels that pass the comparison, e [0,1].
+	/// @param[in] i_fU u-component of the lookup-vector.
+	/// @param[in] i_fV v-component of the lookup-vector.
+	/// @param[in] i_fReference reference value, which is compared to the texels' red channel.
+	/// @param[in] i_pSamplerStates texture sampler states.
+	/// @return s_ok if the function succeeds.
+	result SampleTextureCmp( float32 &o_fResult, float32 i_fU, float32 i_fV,
+		float32 i_fReference, const uint32 *i_pSamplerStates );
+
 public:
-	/// Generates mip-sublevels through downsampling (using a box-filter) a given source mip-level.
+	/// Generates mip-sublevels through downsampling a given source mip-level. The rows of each mip-level are distributed across worker threads.
+	/// If automatic mip-sublevel generation is enabled the mip-sublevels are only marked invalid and will be generated the first time they are accessed.
 	/// @param[in] i_iSrcLevel the mip-level which will be taken as the starting point.
+	/// @param[in] i_Filter downsampling filter. Member of the enumeration m3dmipfilter; m3dmf_tent gives smoother results at higher cost.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	result GenerateMipSubLevels( uint32 i_iSrcLevel, m3dmipfilter i_Filter = m3dmf_box );
+
+	/// Enables or disables automatic (on-demand) generation of mip-sublevels.
+	/// When enabled, updating a mip-level through UnlockRect() or Clear() marks all smaller mip-levels invalid. An invalid mip-level is generated from its predecessor the first time it is sampled or accessed; mip-levels that are never used take up no memory.
+	/// @param[in] i_bAutoGen true to enable automatic generation. Enabling discards the contents of all mip-sublevels, disabling generates all invalid mip-sublevels.
+	/// @param[in] i_Filter downsampling filter used for generation. Member of the enumeration m3dmipfilter.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
-	result GenerateMipSubLevels( uint32 i_iSrcLevel );
+	/// @return e_outofmemory if memory allocation failed.
+	/// @note Generation is guarded by a mutex, so that a texture may be sampled from multiple threads.
+	result SetAutoGenMipSubLevels( bool i_bAutoGen, m3dmipfilter i_Filter = m3dmf_box );
 
 	/// Clears the texture to a given color.
 	/// @param[in] i_iMipLevel the mip-level to be cleared.
@@ -117,10 +142,31 @@ public:
 	/// @param[in] i_iMipLevel the mip-level whose height is requested.
 	uint32 iGetHeight( uint32 i_iMipLevel = 0 );
 
+private:
+	/// Downsamples a mip-level from its predecessor, creating its surface if necessary.
+	/// @param[in] i_iMipLevel mip-level to be generated, > 0.
+	/// @param[in] i_Filter downsampling filter.
+	/// @return s_ok if the function succeeds.
+	result GenerateMipLevel( uint32 i_iMipLevel, m3dmipfilter i_Filter );
+
+	/// Makes sure that the mip-levels up to the given one are valid, generating them if necessary. Does nothing if automatic mip-sublevel generation is disabled.
+	/// @param[in] i_iMipLevel mip-level that is about to be accessed.
+	/// @return s_ok if the function succeeds.
+	result ValidateMipLevel( uint32 i_iMipLevel );
+
+	/// Called after a mip-level has been modified; marks all smaller mip-levels invalid if automatic mip-sublevel generation is enabled.
+	/// @param[in] i_iMipLevel modified mip-level.
+	void InvalidateMipSubLevels( uint32 i_iMipLevel );
+
 private:
 	uint32					m_iMipLevels;			///< Number of mip-levels.
 	float32					m_fSquaredWidth, m_fSquaredHeight; ///< Squared dimensions of the base mip-level, used for mip-calculations.
-	class CMuli3DSurface	**m_ppMipLevels;		///< Pointer to the mip-level data.
+	class CMuli3DSurface	**m_ppMipLevels;		///< Pointer to the mip-level data. With automatic mip-sublevel generation, surfaces of mip-levels that have never been accessed are 0.
+
+	bool					m_bAutoGenMipSubLevels;	///< True if mip-sublevels are generated on demand.
+	m3dmipfilter			m_AutoGenFilter;		///< Filter used for on-demand generation.
+	volatile uint32			m_iValidMipLevels;		///< Mip-levels [0,m_iValidMipLevels[ hold valid data; only written while m_MipLevelMutex is held, always through AtomicStoreRelease() and read lock-free through iAtomicLoadAcquire().
+	CMuli3DMutex			m_MipLevelMutex;		///< Serializes on-demand generation of mip-levels.
 };
 
 #endif // __M3DCORE_TEXTURE_H__
@@ -0,0 +1,139 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/// @file m3dcore_texturearray.h
+///
+
+#ifndef __M3DCORE_TEXTUREARRAY_H__
+#define __M3DCORE_TEXTUREARRAY_H__
+
+#include "../m3dbase.h"
+#include "../m3dtypes.h"
+
+#include "m3dcore_basetexture.h"
+
+/// CMuli3DTextureArray implements an array of 2-dimensional textures (layers), which all have the same dimensions, format and number of mip-levels.
+/// Each layer is a CMuli3DTexture of its own, including its mip-level surfaces and, with automatic mip-sublevel generation, its own record of which mip-levels are valid; layers can therefore be updated independently.
+/// The layer is selected by the w-component of the lookup-vector, which is rounded to the nearest layer and clamped to the available ones. Bound to a single sampler, a texture array lets objects with different textures be drawn without switching textures in between.
+class CMuli3DTextureArray : public IMuli3DBaseTexture
+{
+protected:
+	~CMuli3DTextureArray(); ///< Accessible by IBase. The destructor is called when the reference count reaches zero.
+
+	friend class CMuli3DDevice;
+	/// Accessible by CMuli3DDevice which is the only class that may create a texture array.
+	/// @param[in] i_pParent a pointer to the parent CMuli3DDevice-object.
+	CMuli3DTextureArray( class CMuli3DDevice *i_pParent );
+
+	/// Accessible by CMuli3DDevice which is the only class that may create a texture array.
+	/// @param[in] i_iWidth width of the layers in pixels.
+	/// @param[in] i_iHeight height of the layers in pixels.
+	/// @param[in] i_iNumLayers number of layers to be created.
+	/// @param[in] i_iMipLevels number of mip-levels to be created. Specify 0 to create a full mip-chain.
+	/// @param[in] i_fmtFormat format of the texture to be created. Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	/// @return e_invalidformat if an invalid format was encountered.
+	result Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iNumLayers,
+		uint32 i_iMipLevels, m3dformat i_fmtFormat );
+
+	m3dtexsampleinput eGetTexSampleInput(); ///< Sampling this texture requires 2 floating point coordinates and a layer index.
+
+	/// Accessible by CMuli3DDevice.
+	/// Samples the texture and returns the looked-up color.
+	/// @param[out] o_vColor receives the color of the pixel to be looked up.
+	/// @param[in] i_fU u-component of the lookup-vector.
+	/// @param[in] i_fV v-component of the lookup-vector.
+	/// @param[in] i_fW layer index.
+	/// @param[in] i_pXGradient partial derivatives of the texture coordinates with respect to the screen-space x coordinate. If 0 the base mip-level will be chosen and the minification filter will be used for texture sampling.
+	/// @param[in] i_pYGradient partial derivatives of the texture coordinates with respect to the screen-space y coordinate. If 0 the base mip-level will be chosen and the minification filter will be used for texture sampling.
+	/// @param[in] i_pSamplerStates texture sampler states.
+	/// @return s_ok if the function succeeds.
+	result SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i_fV,
+		float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient,
+		const uint32 *i_pSamplerStates );
+
+public:
+	/// Generates mip-sublevels of all layers through downsampling a given source mip-level. The rows of all layers are distributed across worker threads.
+	/// If automatic mip-sublevel generation is enabled the mip-sublevels are only marked invalid and will be generated the first time they are accessed.
+	/// @param[in] i_iSrcLevel the mip-level which will be taken as the starting point.
+	/// @param[in] i_Filter downsampling filter. Member of the enumeration m3dmipfilter; m3dmf_tent gives smoother results at higher cost.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	result GenerateMipSubLevels( uint32 i_iSrcLevel, m3dmipfilter i_Filter = m3dmf_box );
+
+	/// Enables or disables automatic (on-demand) generation of mip-sublevels for all layers. See CMuli3DTexture::SetAutoGenMipSubLevels().
+	/// @param[in] i_bAutoGen true to enable automatic generation.
+	/// @param[in] i_Filter downsampling filter used for generation. Member of the enumeration m3dmipfilter.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	result SetAutoGenMipSubLevels( bool i_bAutoGen, m3dmipfilter i_Filter = m3dmf_box );
+
+	/// Returns a pointer to the contents of a given mip-level.
+	/// @param[in] i_iLayer layer that is requested.
+	/// @param[in] i_iMipLevel mip-level that is requested, 0 being the largest mip-level.
+	/// @param[out] o_ppData receives the pointer to the texture-data.
+	/// @param[in] i_pRect area that will be locked and accessible. (Pass in 0 to lock entire texture.)
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidstate if the texture is already locked.
+	/// @note Locking the entire texture is a lot faster than locking a sub-region, because no lock-buffer has to be created and the application may write to the texture directly.
+	result LockRect( uint32 i_iLayer, uint32 i_iMipLevel, void **o_ppData,
+		const m3drect *i_pRect );
+
+	/// Unlocks the given mip-level; modifications to the texture will become active.
+	/// @param[in] i_iLayer layer.
+	/// @param[in] i_iMipLevel mip-level, 0 being the largest mip-level.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	result UnlockRect( uint32 i_iLayer, uint32 i_iMipLevel );
+
+	m3dformat fmtGetFormat();	///< Returns the format of the texture. Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
+	uint32 iGetFormatFloats();	///< Returns the number of floats of the format, e [1,4].
+	uint32 iGetMipLevels();		///< Returns the number of mip-levels this texture consists of.
+	uint32 iGetNumLayers();		///< Returns the number of layers.
+
+	/// Returns the width of the given mip-level in pixels.
+	/// @param[in] i_iMipLevel the mip-level whose width is requested.
+	uint32 iGetWidth( uint32 i_iMipLevel = 0 );
+
+	/// Returns the height of the given mip-level in pixels.
+	/// @param[in] i_iMipLevel the mip-level whose height is requested.
+	uint32 iGetHeight( uint32 i_iMipLevel = 0 );
+
+	/// Fails, because texture arrays record sampler feedback per layer: enable it on the textures returned by pGetLayer().
+	/// @param[in] i_bEnable true to enable sampler feedback.
+	/// @return s_ok if sampler feedback is to be disabled.
+	/// @return e_invalidstate if sampler feedback is to be enabled.
+	result SetSamplerFeedback( bool i_bEnable );
+
+	/// Returns a pointer to a layer which can then be accessed like a normal 2d texture.
+	/// Calling this function will increase the internal reference count of the texture. Failure to call Release() when finished using the pointer will result in a memory leak.
+	/// @param[in] i_iLayer layer that is requested.
+	class CMuli3DTexture *pGetLayer( uint32 i_iLayer );
+
+private:
+	uint32					m_iNumLayers;	///< Number of layers.
+	class CMuli3DTexture	**m_ppLayers;	///< Pointer to the layers.
+};
+
+#endif // __M3DCORE_TEXTUREARRAY_H__
@@ -0,0 +1,144 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/// @file m3dcore_threads.h
+///
+
+#ifndef __M3DCORE_THREADS_H__
+#define __M3DCORE_THREADS_H__
+
+#include "../m3dbase.h"
+
+/// Work-function called by ParallelFor(): processes the items [i_iBegin,i_iEnd[.
+typedef void (*m3dparallelfunc)( uint32 i_iBegin, uint32 i_iEnd, void *i_pUserData );
+
+/// Returns the number of threads ParallelFor() distributes work across; this is the number of available processors or 1 on platforms without thread-support.
+uint32 iGetNumWorkerThreads();
+
+/// Distributes the items [0,i_iNumItems[ in contiguous ranges across worker threads and returns once all items have been processed. The calling thread processes the first range itself.
+/// The worker threads are created on the first call and reused afterwards. They serve one call at a time: calls made from within a work-function, or from another thread while the workers are busy, process all items on the calling thread.
+/// @param[in] i_iNumItems number of items.
+/// @param[in] i_iMinItemsPerThread minimum number of items a thread has to be given; keeps small workloads from paying for waking up workers.
+/// @param[in] i_fpFunc function processing a range of items. It must not modify data that is used by other ranges.
+/// @param[in] i_pUserData pointer passed to i_fpFunc.
+void ParallelFor( uint32 i_iNumItems, uint32 i_iMinItemsPerThread,
+	m3dparallelfunc i_fpFunc, void *i_pUserData );
+
+/// Atomically replaces a value with a new one if it equals an expected value. Acts as a full memory barrier.
+/// @param[in,out] io_pValue value to be updated.
+/// @param[in] i_iExpected value io_pValue has to hold for the exchange to take place.
+/// @param[in] i_iNewValue new value.
+/// @return true if the value has been replaced.
+bool bAtomicCompareExchange( volatile uint32 *io_pValue, uint32 i_iExpected, uint32 i_iNewValue );
+
+/// Reads a value with acquire-semantics: memory operations following the load cannot be moved before it, so data published by a matching AtomicStoreRelease() is visible afterwards.
+/// @param[in] i_pValue value to be read.
+/// @return the value.
+inline uint32 iAtomicLoadAcquire( const volatile uint32 *i_pValue )
+{
+#if defined( __GNUC__ )
+	return __atomic_load_n( i_pValue, __ATOMIC_ACQUIRE );
+#else
+	return *i_pValue; // Visual C++ gives accesses to volatile variables acquire- and release-semantics.
+#endif
+}
+
+/// Writes a value with release-semantics: memory operations preceding the store cannot be moved after it.
+/// @param[out] o_pValue value to be written.
+/// @param[in] i_iValue new value.
+inline void AtomicStoreRelease( volatile uint32 *o_pValue, uint32 i_iValue )
+{
+#if defined( __GNUC__ )
+	__atomic_store_n( o_pValue, i_iValue, __ATOMIC_RELEASE );
+#else
+	*o_pValue = i_iValue;
+#endif
+}
+
+/// Atomically replaces a value with the minimum of the value and a given one. There is no ordering guarantee with respect to other memory operations.
+/// @param[in,out] io_pValue value to be updated.
+/// @param[in] i_iValue value to compare with.
+void AtomicMin( volatile uint32 *io_pValue, uint32 i_iValue );
+
+/// CMuli3DMutex implements a simple non-recursive mutual exclusion lock.
+class CMuli3DMutex
+{
+public:
+	CMuli3DMutex();
+	~CMuli3DMutex();
+
+	void Lock();	///< Blocks until the mutex has been acquired.
+	void Unlock();	///< Releases the mutex.
+
+private:
+	CMuli3DMutex( const CMuli3DMutex & ) {}								///< Private copy-operator to avoid object copying.
+	CMuli3DMutex &operator =( const CMuli3DMutex & ) { return *this; }	///< Private assignment-operator to avoid object copying.
+
+private:
+	void	*m_pHandle;	///< Platform-specific mutex object.
+};
+
+/// Function executed by a CMuli3DThread.
+typedef void (*m3dthreadfunc)( void *i_pUserData );
+
+/// CMuli3DThread runs a function on a separate thread.
+class CMuli3DThread
+{
+public:
+	CMuli3DThread();
+	~CMuli3DThread();	///< Waits for a running thread to finish.
+
+	/// Starts executing a function on a new thread.
+	/// @param[in] i_fpFunc function to be executed.
+	/// @param[in] i_pUserData pointer passed to i_fpFunc.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidstate if a thread has already been started.
+	/// @return e_unknown if thread creation failed or the platform doesn't support threads. The caller has to do the work itself then.
+	result Start( m3dthreadfunc i_fpFunc, void *i_pUserData );
+
+	void Join();		///< Blocks until the thread has finished. Does nothing if no thread has been started.
+	bool bIsStarted();	///< Returns true if a thread has been started and not yet joined.
+
+private:
+	CMuli3DThread( const CMuli3DThread & ) {}								///< Private copy-operator to avoid object copying.
+	CMuli3DThread &operator =( const CMuli3DThread & ) { return *this; }	///< Private assignment-operator to avoid object copying.
+
+private:
+	void	*m_pHandle;	///< Platform-specific thread object.
+};
+
+/// CMuli3DEvent implements an auto-resetting signal threads can wait for.
+class CMuli3DEvent
+{
+public:
+	CMuli3DEvent();
+	~CMuli3DEvent();
+
+	void Set();		///< Signals the event, waking up one waiting thread.
+	void Wait();	///< Blocks until the event is signaled and resets it. Returns immediately on platforms without thread-support.
+
+private:
+	CMuli3DEvent( const CMuli3DEvent & ) {}								///< Private copy-operator to avoid object copying.
+	CMuli3DEvent &operator =( const CMuli3DEvent & ) { return *this; }	///< Private assignment-operator to avoid object copying.
+
+private:
+	void	*m_pHandle;	///< Platform-specific event object.
+};
+
+#endif // __M3DCORE_THREADS_H__
@@ -26,7 +26,13 @@
 #include "../m3dbase.h"
 #include "../m3dtypes.h"
 
+const uint32 c_iVolumeBrickShift = 3; ///< Log2 of the edge length of a volume brick in voxels.
+const uint32 c_iVolumeBrickSize = 1 << c_iVolumeBrickShift; ///< Edge length of a volume brick in voxels.
+const uint32 c_iVolumeBrickMask = c_iVolumeBrickSize - 1; ///< Masks the position of a voxel within its brick.
+
 /// CMuli3DVolume implements a 3-dimensional image.
+/// Voxels are stored in bricks of c_iVolumeBrickSize^3 voxels, so that neighbouring voxels in all three directions are close in memory.
+/// For each brick the minimum and maximum values are kept, which allows volume renderers to skip empty regions.
 class CMuli3DVolume : public IBase
 {
 protected:
@@ -57,7 +63,7 @@ public:
 	/// @param[in] i_fW w-component of the lookup-vector.
 	void SamplePoint( vector4 &o_vColor, float32 i_fU, float32 i_fV, float32 i_fW );
 
-	/// Samples the volume using bi-linear filtering.
+	/// Samples the volume using tri-linear filtering. If all 8 voxels lie within the same brick they are addressed relative to the first one.
 	/// @param[out] o_vColor receives the color of the pixel to be looked up.
 	/// @param[in] i_fU u-component of the lookup-vector.
 	/// @param[in] i_fV v-component of the lookup-vector.
@@ -89,7 +95,7 @@ public:
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_invalidstate if the volume is already locked.
 	/// @return e_outofmemory if memory allocation failed.
-	/// @note Locking the entire volume is a lot faster than locking a sub-region, because no lock-buffer has to be created and the application may write to the volume directly.
+	/// @note The box is copied to a linear lock-buffer. Unlocking copies it back to the bricked storage and updates the minimum and maximum values of the affected bricks.
 	result LockBox( void **o_ppData, const m3dbox *i_pBox );
 
 	/// Unlocks the volume; modifications to its contents will become active.
@@ -104,10 +110,74 @@ public:
 	uint32 iGetHeight(); ///< Returns the height of the volume in pixels.
 	uint32 iGetDepth(); ///< Returns the depth of the volume in pixels.
 
+	uint32 iGetNumBricksX(); ///< Returns the number of bricks in x-direction.
+	uint32 iGetNumBricksY(); ///< Returns the number of bricks in y-direction.
+	uint32 iGetNumBricksZ(); ///< Returns the number of bricks in z-direction.
+
+	/// Returns the minimum and maximum values of a brick. They cover all voxels a tri-linear lookup within the brick may access, i.e. the brick's voxels and the adjacent voxels of the next bricks in positive x-, y- and z-direction.
+	/// Color channels that aren't part of the volume's format are reported as they are returned by sampling: 0 for green and blue, 1 for alpha.
+	/// @param[out] o_vMin receives the minimum value of each channel.
+	/// @param[out] o_vMax receives the maximum value of each channel.
+	/// @param[in] i_iBrickX x-coordinate of the brick.
+	/// @param[in] i_iBrickY y-coordinate of the brick.
+	/// @param[in] i_iBrickZ z-coordinate of the brick.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if the brick doesn't exist.
+	result GetBrickMinMax( vector4 &o_vMin, vector4 &o_vMax, uint32 i_iBrickX,
+		uint32 i_iBrickY, uint32 i_iBrickZ );
+
+	/// Returns true if a channel of a brick exceeds a threshold anywhere, i.e. tri-linear lookups within the brick may return values larger than the threshold.
+	/// @param[in] i_iBrickX x-coordinate of the brick; has to be smaller than iGetNumBricksX().
+	/// @param[in] i_iBrickY y-coordinate of the brick; has to be smaller than iGetNumBricksY().
+	/// @param[in] i_iBrickZ z-coordinate of the brick; has to be smaller than iGetNumBricksZ().
+	/// @param[in] i_iChannel color channel to be tested, e [0,3].
+	/// @param[in] i_fThreshold values up to the threshold are considered empty.
+	/// @return false if the brick or the channel doesn't exist.
+	bool bIsBrickOccupied( uint32 i_iBrickX, uint32 i_iBrickY, uint32 i_iBrickZ,
+		uint32 i_iChannel, float32 i_fThreshold );
+
+	/// Determines the occupancy of all bricks; see bIsBrickOccupied().
+	/// @param[out] o_pOccupied receives one value per brick, ordered by z, y and x (x varies fastest). The array has to hold iGetNumBricksX() * iGetNumBricksY() * iGetNumBricksZ() values.
+	/// @param[in] i_iChannel color channel to be tested, e [0,3].
+	/// @param[in] i_fThreshold values up to the threshold are considered empty.
+	/// @return number of occupied bricks; 0 if o_pOccupied is null or the channel doesn't exist.
+	uint32 iGetBrickOccupancy( bool *o_pOccupied, uint32 i_iChannel, float32 i_fThreshold );
+
 	/// Returns a pointer to the associated device. Calling this function will increase the internal reference count of the device. Failure to call Release() when finished using the pointer will result in a memory leak.
 	class CMuli3DDevice *pGetDevice();
 
 private:
+	/// Returns the offset of a voxel's first float in the bricked volume-data.
+	inline uint32 iGetVoxelOffset( uint32 i_iX, uint32 i_iY, uint32 i_iZ )
+	{
+		const uint32 iBrick = ( ( i_iZ >> c_iVolumeBrickShift ) * m_iBricksY +
+			( i_iY >> c_iVolumeBrickShift ) ) * m_iBricksX + ( i_iX >> c_iVolumeBrickShift );
+		const uint32 iVoxel = ( ( ( ( i_iZ & c_iVolumeBrickMask ) << c_iVolumeBrickShift ) +
+			( i_iY & c_iVolumeBrickMask ) ) << c_iVolumeBrickShift ) + ( i_iX & c_iVolumeBrickMask );
+		return ( ( iBrick << ( 3 * c_iVolumeBrickShift ) ) + iVoxel ) * m_iFloats;
+	}
+
+	/// Copies a row of voxels between a linear buffer and the bricked volume-data.
+	/// @param[in,out] io_pLinearData linear buffer holding the voxels [i_iLeft,i_iRight[.
+	/// @param[in] i_iLeft x-coordinate of the first voxel.
+	/// @param[in] i_iRight x-coordinate of the voxel after the last one.
+	/// @param[in] i_iY y-coordinate of the row.
+	/// @param[in] i_iZ z-coordinate of the row.
+	/// @param[in] i_bToBricks true to copy from the linear buffer to the volume, false to copy from the volume to the buffer.
+	void CopyRow( float32 *io_pLinearData, uint32 i_iLeft, uint32 i_iRight,
+		uint32 i_iY, uint32 i_iZ, bool i_bToBricks );
+
+	/// Recomputes the minimum and maximum values of all bricks, which access voxels of the given box.
+	void UpdateBrickMinMax( const m3dbox &i_Box );
+
+private:
+	/// Minimum and maximum values of a brick.
+	struct volumebrick
+	{
+		vector4	vMin;	///< Minimum value of each channel.
+		vector4	vMax;	///< Maximum value of each channel.
+	};
+
 	class CMuli3DDevice	*m_pParent;	///< Pointer to parent.
 
 	m3dformat	m_fmtFormat;	///< Format of the volume. Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
@@ -117,12 +187,16 @@ private:
 	uint32		m_iWidthMin1;	///< Width - 1 of the volume in pixels.
 	uint32		m_iHeightMin1;	///< Height - 1 of the volume in pixels.
 	uint32		m_iDepthMin1;	///< Depth - 1 of the volume in pixels.
+	uint32		m_iFloats;		///< Number of floats per voxel.
+	uint32		m_iBricksX;		///< Number of bricks in x-direction.
+	uint32		m_iBricksY;		///< Number of bricks in y-direction.
+	uint32		m_iBricksZ;		///< Number of bricks in z-direction.
 
-	bool	m_bLockedComplete;		///< True if the whole volume has been locked.
-	m3dbox	m_PartialLockBox;		///< Information about the locked box.
-	float32	*m_pPartialLockData;	///< Not null if a sub-box of the volume has been locked.
+	m3dbox	m_LockBox;		///< Information about the locked box.
+	float32	*m_pLockData;	///< Not null if the volume has been locked.
 
-	float32	*m_pData;	///< Pointer to volume data.
+	float32		*m_pData;	///< Pointer to bricked volume data. Bricks at the borders of the volume are padded.
+	volumebrick	*m_pBricks;	///< Minimum and maximum values of the bricks.
 };
 
 #endif // __M3DCORE_VOLUME_H__
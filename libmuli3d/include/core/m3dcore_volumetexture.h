@@ -69,11 +69,27 @@ protected:
 		const uint32 *i_pSamplerStates );
 
 public:
-	/// Generates mip-sublevels through downsampling (using a box-filter) a given source mip-level.
+	/// Integrates color and opacity along a ray through the base mip-level front to back.
+	/// The ray is clipped to the volume and marched brick by brick: bricks whose maximum opacity doesn't exceed the empty-threshold are skipped, the step size within the other bricks is chosen by their maximum opacity.
+	/// Opacities are corrected for the step size, so that the result doesn't depend on it. Marching stops as soon as the accumulated opacity reaches the opacity-threshold.
+	/// The minification filter determines whether the volume is sampled with tri-linear filtering or nearest point sampling.
+	/// @param[out] o_vColor receives the accumulated color, premultiplied by the accumulated opacity, which is returned in alpha.
+	/// @param[in] i_vOrigin origin of the ray in texture space; the volume covers [0,1] in each direction.
+	/// @param[in] i_vDirection direction of the ray in texture space; doesn't have to be normalized.
+	/// @param[in] i_Integration parameters of the integration.
+	/// @param[in] i_pSamplerStates texture sampler states.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	result IntegrateRay( vector4 &o_vColor, const vector3 &i_vOrigin,
+		const vector3 &i_vDirection, const m3dvolumeintegration &i_Integration,
+		const uint32 *i_pSamplerStates );
+
+	/// Generates mip-sublevels through downsampling a given source mip-level. The rows of each mip-level are distributed across worker threads.
 	/// @param[in] i_iSrcLevel the mip-level which will be taken as the starting point.
+	/// @param[in] i_Filter downsampling filter. Member of the enumeration m3dmipfilter; m3dmf_tent gives smoother results at higher cost.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
-	result GenerateMipSubLevels( uint32 i_iSrcLevel );
+	result GenerateMipSubLevels( uint32 i_iSrcLevel, m3dmipfilter i_Filter = m3dmf_box );
 
 	/// Clears the texture to a given color.
 	/// @param[in] i_iMipLevel the mip-level to be cleared.
@@ -91,7 +107,7 @@ public:
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_invalidstate if the texture is already locked.
 	/// @return e_outofmemory if memory allocation failed.
-	/// @note Locking the entire texture is a lot faster than locking a sub-region, because no lock-buffer has to be created and the application may write to the texture directly.
+	/// @note The box is copied to a linear lock-buffer, because mip-levels are stored in bricks; see CMuli3DVolume::LockBox().
 	result LockBox( uint32 i_iMipLevel, void **o_ppData, const m3dbox *i_pBox );
 
 	/// Unlocks the given mip-level; modifications to the texture will become active.
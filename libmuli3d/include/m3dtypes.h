@@ -34,6 +34,18 @@ const uint32 c_iPixelShaderRegisters = 8;	///< Specifies the amount of available
 const uint32 c_iNumShaderConstants = 32;	///< Specifies the amount of available shader constants-registers for both vertex and pixel shaders.
 const uint32 c_iMaxVertexStreams = 8;		///< Specifies the amount of available vertex streams.
 const uint32 c_iMaxTextureSamplers = 16;	///< Specifies the amount of available texture samplers.
+const uint32 c_iMaxColorBuffers = 4;		///< Specifies the amount of colorbuffers a rendertarget can hold for rendering to multiple render targets at once.
+const uint32 c_iMaxMultiSamples = 8;		///< Specifies the maximum number of samples per pixel of multisampled surfaces.
+const uint32 c_iShadingRateTileSize = 16;	///< Specifies the edge length in pixels of the screen tiles, which are assigned a shading rate by the shading rate image.
+const uint32 c_iSamplerFeedbackSize = 32;	///< Specifies the number of cells per row/column of the sampler feedback map of a texture.
+const uint32 c_iSamplerFeedbackNotSampled = 0xffffffff; ///< Sampler feedback value of regions that haven't been sampled.
+const uint32 c_iMaxPCFKernelSize = 8;		///< Specifies the maximum edge length of the percentage closer filtering kernel of depth-comparison lookups.
+const float32 c_fGuardBand = 16.0f;			///< Specifies the extent of the guard band in normalized device coordinates: triangles are only clipped to the left, right, top and bottom frustum planes, if they extend beyond [-c_fGuardBand,c_fGuardBand]; the rasterizer restricts all other triangles to the viewport.
+const uint32 c_iTriangleSetupBatchSize = 8;	///< Specifies the number of triangles, whose gradients are computed at once during triangle setup.
+const uint32 c_iMaxSubdivisionLevels = 15;	///< Specifies the maximum number of recursive subdivisions of triangles' edges.
+const uint32 c_iSubdivisionBatchSize = 64;	///< Specifies the number of triangles, which are tessellated at once and in parallel during subdivision.
+const uint32 c_iSubdivisionCacheShards = 16;	///< Specifies the number of independently locked parts of the cache that holds the vertices generated on shared triangle edges during subdivision.
+const uint32 c_iSubdivisionCacheSize = 2048;	///< Specifies the number of vertices the cache of shared triangle edges may hold before it is emptied; vertices evicted from the cache are generated again, bit for bit identical.
 
 // Enumerations ---------------------------------------------------------------
 
@@ -44,13 +56,13 @@ enum m3drenderstate
 	m3drs_zwriteenable,		///< Set this to true(default) to enable writing to the depth-buffer during rasterization. If no depth-buffer is available or has been disabled by setting m3drs_zenable to false, this renderstate has no effect.
 	m3drs_zfunc,			///< Compare-function used for depth-buffer. Set this renderstate to a member of the enumeration m3dcmpfunc. Default: m3dcmp_less.
 
-	m3drs_colorwriteenable,	///< Set this to true(default) to enable writing to the color-buffer during rasteriation. If no color-buffer is available this renderstate has no effect.
+	m3drs_colorwriteenable,	///< Set this to true(default) to enable writing to the color-buffer during rasteriation. If no color-buffer is available this renderstate has no effect. Disabling it selects depth-only rendering, which skips the pixel shader, if the shader neither outputs depth nor might kill pixels (see IMuli3DPixelShader::bMightKillPixels()).
 	m3drs_fillmode,			///< Fillmode. Set this renderstate to a member of the enumeration m3dfill. Default: m3dfill_solid.
 
 	m3drs_cullmode,			///< Cullmode. Set this renderstate to a member of the enumeration m3dcull. Default: m3dcull_ccw.
 
 	m3drs_subdivisionmode,				///< Subdivisionmode. Set this renderstate to a member of the enumeration m3dsubdiv. Default: m3dsubdiv_none.
-	m3drs_subdivisionlevels,			///< This renderstate specifies the number of recursive subdivision when using simple or smooth subdivision. It specifies the maximum number of recursive subdivisions of triangles' edges when using adaptive subdivision. In case subdivision has been disabled, this renderstate has no effect. Valid values are integers > 0 - if this renderstate has been set to 0, DrawPrimitive()-calls will fail. Default: 1.
+	m3drs_subdivisionlevels,			///< This renderstate specifies the number of recursive subdivision when using simple or smooth subdivision. It specifies the maximum number of recursive subdivisions of triangles' edges when using adaptive subdivision. In case subdivision has been disabled, this renderstate has no effect. Valid values are integers e [1,c_iMaxSubdivisionLevels] - if this renderstate has been set to 0, DrawPrimitive()-calls will fail. Default: 1.
 	m3drs_subdivisionpositionregister,	///< This renderstate is only used when using smooth subdivision. It specifies the vertex shader input register which holds position-data. Make sure vertex positions have been homogenized (w=1)! In case subdivision has been disabled, this renderstate has no effect. Valid values are integers e [0,c_iVertexShaderRegisters[. Default: 0.
 	m3drs_subdivisionnormalregister,	///< This renderstate is only used when using smooth subdivision. It specifies the vertex shader input register which holds normal-data. For best results make sure that the normals have been normalized. In case subdivision has been disabled, this renderstate has no effect. Valid values are integers e [0,c_iVertexShaderRegisters[. Default: 1.
 	m3drs_subdivisionmaxscreenarea,		///< This renderstate is only used when using adaptive subdivision. Triangles, which cover more than the set area in screenspace (rendertarget's viewport is respected), are recursivly subdividied. In case subdivision has been disabled, this renderstate has no effect. Valid values are floats > 0.0f - if this renderstate has been set to 0.0f, DrawPrimitive()-calls will fail. Default: 1.0f.
@@ -60,6 +72,25 @@ enum m3drenderstate
 	
 	m3drs_linethickness,			///< Controls the thickness of rendered lines Valid values are integers >= 1. Default: 1.
 
+	m3drs_lodgranularity,	///< Granularity at which IMuli3DPixelShader::GetDerivatives() evaluates partial derivatives and thereby the mip-level used for texture sampling. Set this renderstate to a member of the enumeration m3dlodgranularity. Default: m3dlod_pixel.
+	m3drs_quadshadingenable,	///< Set this to true to shade triangles in 2x2 pixel quads. Pixels of a quad that are not covered by the triangle are set up as helper pixels, which are never shaded or written, and IMuli3DPixelShader::GetDerivatives() returns the finite differences of the input registers within the quad. Set this to false(default) to shade pixels along scanlines.
+
+	m3drs_blendmode,		///< Blend-function used to combine the color outputted by the pixel shader with the color in the colorbuffer. Set this renderstate to a member of the enumeration m3dblend. Default: m3dblend_opaque.
+
+	m3drs_stencilenable,	///< Set this to true to enable stencil-testing. The test is performed before the pixel shader is executed, so pixels that fail are never shaded. If the rendertarget has no stencil buffer this renderstate has no effect. Default: false.
+	m3drs_stencilfunc,		///< Compare-function used for stencil-testing: a pixel passes if ( reference & mask ) <stencilfunc> ( stencil-value & mask ). Set this renderstate to a member of the enumeration m3dcmpfunc. Default: m3dcmp_always.
+	m3drs_stencilref,		///< Reference value for stencil-testing, e [0,255]. Default: 0.
+	m3drs_stencilmask,		///< Mask applied to the reference value and the stencil-value before comparing them, e [0,255]. Default: 0xff.
+	m3drs_stencilwritemask,	///< Mask of the stencil bits that may be modified by stencil-operations, e [0,255]. Default: 0xff.
+	m3drs_stencilfail,		///< Stencil-operation for pixels that fail the stencil-test. Set this renderstate to a member of the enumeration m3dstencilop. Default: m3dsop_keep.
+	m3drs_stencilzfail,		///< Stencil-operation for pixels that pass the stencil-test, but fail the depth-test. Set this renderstate to a member of the enumeration m3dstencilop. Default: m3dsop_keep.
+	m3drs_stencilpass,		///< Stencil-operation for pixels that pass both the stencil- and the depth-test and are not killed by the pixel shader. Set this renderstate to a member of the enumeration m3dstencilop. Default: m3dsop_keep.
+
+	m3drs_shadingrate,		///< Size of the blocks of pixels, which are shaded by a single pixel shader execution when filling triangles. The shader is executed at the block's center and its color is written to all covered pixels of the block, while depth- and stencil-testing are still performed per pixel. If a shading rate image has been set (see CMuli3DDevice::SetShadingRateImage()), the coarser rate of both is used along each axis. Coarse shading takes precedence over m3drs_quadshadingenable and is not available for multisampled rendertargets. Set this renderstate to a member of the enumeration m3dshadingrate. Default: m3dsr_1x1.
+
+	m3drs_interleave,		///< Interleave pattern for progressive rendering of expensive pixel shaders. When filling triangles only the pixels of the phase set by m3drs_interleavephase are processed; all other pixels keep the contents of the rendertarget's buffers, i.e. the results of previous frames. Cycling the phase every frame makes a static image converge after CMuli3DSurface::iGetInterleavePhases() frames; when the image changes, CMuli3DSurface::ReconstructInterleaved() fills the other pixels from their neighbours instead. Interleaving takes precedence over m3drs_shadingrate and m3drs_quadshadingenable, is not available for multisampled rendertargets and is ignored by depth-only rendering. Set this renderstate to a member of the enumeration m3dinterleave. Default: m3dil_none.
+	m3drs_interleavephase,	///< Phase of the interleave pattern whose pixels are processed, see m3drs_interleave. The value is taken modulo the pattern's number of phases. Default: 0.
+
 	m3drs_numrenderstates
 };
 
@@ -76,6 +107,19 @@ enum m3dcmpfunc
     m3dcmp_always			///< Compares will always pass.
 };
 
+/// Defines the supported stencil-operations.
+enum m3dstencilop
+{
+	m3dsop_keep,	///< Keeps the stencil-value.
+	m3dsop_zero,	///< Sets the stencil-value to 0.
+	m3dsop_replace,	///< Sets the stencil-value to the reference value.
+	m3dsop_incrsat,	///< Increments the stencil-value, clamping it to 255.
+	m3dsop_decrsat,	///< Decrements the stencil-value, clamping it to 0.
+	m3dsop_invert,	///< Inverts the bits of the stencil-value.
+	m3dsop_incr,	///< Increments the stencil-value, wrapping around to 0.
+	m3dsop_decr		///< Decrements the stencil-value, wrapping around to 255.
+};
+
 /// Defines the supported culling modes.
 enum m3dcull
 {
@@ -91,6 +135,45 @@ enum m3dfill
 	m3dfill_wireframe	///< Only triangle's edges are drawn.
 };
 
+/// Defines the supported granularities for partial derivative and mip-level computation.
+enum m3dlodgranularity
+{
+	m3dlod_pixel,	///< Derivatives are computed for every pixel (default).
+	m3dlod_quad,	///< Derivatives are computed once per 2x2 pixel quad at its upper left pixel and shared by all pixels of the quad.
+	m3dlod_span		///< Derivatives are computed once per scanline-span at its first pixel and shared by all pixels of the span.
+};
+
+/// Defines the supported shading rates: the width x height of the blocks of pixels, which are shaded by a single pixel shader execution.
+enum m3dshadingrate
+{
+	m3dsr_1x1,	///< Every pixel is shaded (default).
+	m3dsr_1x2,	///< One pixel shader execution per block of 1x2 pixels.
+	m3dsr_2x1,	///< One pixel shader execution per block of 2x1 pixels.
+	m3dsr_2x2,	///< One pixel shader execution per block of 2x2 pixels.
+	m3dsr_4x4	///< One pixel shader execution per block of 4x4 pixels.
+};
+
+/// Defines the supported interleave patterns for progressive rendering, see renderstate m3drs_interleave.
+enum m3dinterleave
+{
+	m3dil_none,			///< Every pixel is processed (default).
+	m3dil_checkerboard,	///< Two phases, each processes every other pixel of a checkerboard.
+	m3dil_2x2,			///< Four phases, each processes one pixel of every block of 2x2 pixels.
+	m3dil_4x4			///< Sixteen phases, each processes one pixel of every block of 4x4 pixels.
+};
+
+/// Defines the supported blend-functions, which combine the color outputted by the pixel shader (source) with the color in the colorbuffer (destination).
+/// All channels of the colorbuffer, including alpha, are blended the same way.
+enum m3dblend
+{
+	m3dblend_opaque,	///< Result = source (default).
+	m3dblend_alpha,		///< Result = source * source.a + destination * ( 1 - source.a ).
+	m3dblend_additive,	///< Result = source + destination.
+	m3dblend_multiply,	///< Result = source * destination.
+	m3dblend_min,		///< Result = min( source, destination ).
+	m3dblend_max		///< Result = max( source, destination ).
+};
+
 /// Defines the available texturesamplerstates.
 enum m3dtexturesamplerstate
 {
@@ -102,6 +185,8 @@ enum m3dtexturesamplerstate
 	m3dtss_mipfilter,		///< Mipmap filtering mode. Set this renderstate to a member of the enumeration m3dtf. Default: m3dtf_point.
 	m3dtss_miplodbias,		///< Floating point value added to the mip-level when sampling textures. Default: 0.0f.
 	m3dtss_maxmiplevel,		///< Floating point value which specifies the smallest mip-level to be used, e.g. 3.0f would mean that the third mip-level is the smallest to be used. Set this to 0.0f to force the use of the largest mip-level. default: 16.0f
+	m3dtss_comparefunc,		///< Compare-function used by depth-comparison lookups (IMuli3DBaseShader::SampleTextureCmp()): a texel passes if reference-value <comparefunc> texel-value. Set this renderstate to a member of the enumeration m3dcmpfunc. Default: m3dcmp_lessequal.
+	m3dtss_pcfkernelsize,	///< Edge length in texels of the percentage closer filtering kernel used by depth-comparison lookups, e [1,c_iMaxPCFKernelSize]. Default: 2.
 
 	m3dtss_numtexturesamplerstates
 };
@@ -120,6 +205,20 @@ enum m3dtexturefilter
 	m3dtf_linear	///< Specifies linear filtering.
 };
 
+/// Defines the supported filters for mip-level generation.
+enum m3dmipfilter
+{
+	m3dmf_box,	///< Averages 2x2 (2x2x2 for volumes) pixels (default).
+	m3dmf_tent	///< Separable 4-tap filter with weights [1 3 3 1] / 8; blurs slightly more than the box-filter, but shows less aliasing.
+};
+
+/// Defines the supported filters for resolving multisampled surfaces.
+enum m3dresolvefilter
+{
+	m3drf_box,	///< Averages the samples of each pixel.
+	m3drf_tent	///< Weights the samples of each pixel and its 8 neighbours by a tent of 1 pixel radius around the pixel's center; smoother edges at the cost of slight blurring.
+};
+
 /// Specifies the supported subdivision modes.
 enum m3dsubdiv
 {
@@ -176,7 +275,8 @@ enum m3dtexsampleinput
 {
 	m3dtsi_2coords,	///< 2 floating point coordinates used for standard 2d texture-sampling.
 	m3dtsi_3coords,	///< 3 floating point coordinates used for volume texture-sampling.
-	m3dtsi_vector	///< 3-dimensional vector used for cubemap-sampling.
+	m3dtsi_vector,	///< 3-dimensional vector used for cubemap-sampling.
+	m3dtsi_layer	///< 2 floating point coordinates and a layer index used for texture array-sampling.
 };
 
 /// Specifies indices for the 6 cubemap faces.
@@ -241,6 +341,16 @@ struct m3dbox
 	uint32 iRight, iBottom, iBack;
 };
 
+/// Describes how a ray is integrated through a volume texture; see CMuli3DVolumeTexture::IntegrateRay().
+struct m3dvolumeintegration
+{
+	float32	fMinStepSize;		///< Distance between samples in voxels within bricks, which contain fully opaque voxels.
+	float32	fMaxStepSize;		///< Distance between samples in voxels within nearly transparent bricks. The step size of a brick is interpolated between both values by the brick's maximum opacity.
+	uint32	iOpacityChannel;	///< Color channel that holds the opacity of a voxel, e [0,3]. The opacity is specified for a distance of 1 voxel.
+	float32	fEmptyThreshold;	///< Bricks whose maximum opacity doesn't exceed this value are skipped. Pass 0 to skip fully transparent bricks only.
+	float32	fOpacityThreshold;	///< The ray is terminated as soon as the accumulated opacity reaches this value, e.g. 0.99.
+};
+
 /// Describes a vertex element.
 struct m3dvertexelement
 {
@@ -274,6 +384,23 @@ struct m3dvsoutput
 	m3dvsinput	SourceInput;	///< Original vertex shader input fetched from vertex streams; added for triangle subdivision.
 };
 
+/// Describes a structure that holds the result of triangle setup, which is consumed by the rasterizer.
+/// @note This structure is used internally by devices.
+struct m3dtrianglesetup
+{
+	const m3dvsoutput	*pVertices[3];		///< Projected vertices of the triangle; the first one is the base vertex for gradient computations.
+	float32				fCommonGradient;	///< Gradient constant.
+
+	/// z partial derivatives with respect to the screen-space x- and y-coordinates.
+	float32		fZDdx, fZDdy;
+
+	/// w partial derivatives with respect to the screen-space x- and y-coordinates.
+	float32		fWDdx, fWDdy;
+
+	shaderreg	ShaderOutputsDdx[c_iPixelShaderRegisters];	///< Shader register partial derivatives with respect to the screen-space x-coordinate.
+	shaderreg	ShaderOutputsDdy[c_iPixelShaderRegisters];	///< Shader register partial derivatives with respect to the screen-space y-coordinate.
+};
+
 /// Describes a structure that is used for triangle gradient storage.
 /// @note This structure is used internally by devices.
 struct m3dtriangleinfo
@@ -294,6 +421,14 @@ struct m3dtriangleinfo
 	uint32 iCurPixelX, iCurPixelY;
 
 	float32 fCurPixelInvW; ///< 1.0f / w of the current pixel; needed by pixel shader for computation of partial derivatives.
+
+	uint32 iCurSpanX; ///< Integer x-coordinate of the first pixel of the current span; needed by pixel shader for computation of partial derivatives.
+	uint32 iLODGranularity; ///< Member of the enumeration m3dlodgranularity.
+	uint32 iGradientsID; ///< Incremented whenever the gradients change; used by pixel shaders to invalidate cached partial derivatives.
+
+	bool bQuadShading; ///< True if triangles are shaded in 2x2 pixel quads.
+	uint32 iCurQuadPixel; ///< Index of the current pixel in its quad: 0 = upper left, 1 = upper right, 2 = lower left, 3 = lower right.
+	const shaderreg *pQuadShaderInputs[4]; ///< Pixel shader input registers of the four pixels of the current quad, including helper pixels.
 };
 
 /// Describes a structure that is used for vertex caching.
@@ -90,4 +90,17 @@ inline float32 fLerp( const float32 i_fValA, const float32 i_fValB,
 	return i_fValA + ( i_fValB - i_fValA ) * i_fInterpolation;
 }
 
+/// Approximates the base-2 logarithm of a floating-point value.
+/// The integer part is taken straight from the exponent bits, the mantissa is used to linearly interpolate between two powers of two (max. error ~0.086).
+/// @param[in] i_fVal value to compute the logarithm of, > 0.0f.
+/// @return approximation of log2( i_fVal ).
+inline float32 fFastLog2( const float32 i_fVal )
+{
+	union { float32 f; uint32 i; } Val;
+	Val.f = i_fVal;
+	const int32 iExponent = (int32)( ( Val.i >> 23 ) & 255 ) - 128;
+	Val.i = ( Val.i & 0x007fffff ) | 0x3f800000; // mantissa e [1.0f,2.0f[
+	return (float32)iExponent + Val.f;
+}
+
 #endif // __M3DMATH_COMMON_H__
@@ -62,3 +62,23 @@ result IMuli3DBaseShader::SampleTexture( vector4 &o_vColor, uint32 i_iSamplerNum
 	
 	return m_pDevice->SampleTexture( o_vColor, i_iSamplerNumber, i_fU, i_fV, i_fW, i_pXGradient, i_pYGradient );
 }
+
+result IMuli3DBaseShader::SampleTexture4( vector4 *o_pColors, uint32 i_iSamplerNumber, const vector4 *i_pCoords, const vector4 *i_pXGradients, const vector4 *i_pYGradients )
+{
+	return m_pDevice->SampleTexture4( o_pColors, i_iSamplerNumber, i_pCoords, i_pXGradients, i_pYGradients );
+}
+
+result IMuli3DBaseShader::SampleTextureRect( vector4 &o_vColor, uint32 i_iSamplerNumber, float32 i_fU0, float32 i_fV0, float32 i_fU1, float32 i_fV1 )
+{
+	return m_pDevice->SampleTextureRect( o_vColor, i_iSamplerNumber, i_fU0, i_fV0, i_fU1, i_fV1 );
+}
+
+result IMuli3DBaseShader::SampleTextureCmp( float32 &o_fResult, uint32 i_iSamplerNumber, float32 i_fU, float32 i_fV, float32 i_fReference )
+{
+	return m_pDevice->SampleTextureCmp( o_fResult, i_iSamplerNumber, i_fU, i_fV, i_fReference );
+}
+
+result IMuli3DBaseShader::IntegrateVolume( vector4 &o_vColor, uint32 i_iSamplerNumber, const vector3 &i_vOrigin, const vector3 &i_vDirection, const m3dvolumeintegration &i_Integration )
+{
+	return m_pDevice->IntegrateVolume( o_vColor, i_iSamplerNumber, i_vOrigin, i_vDirection, i_Integration );
+}
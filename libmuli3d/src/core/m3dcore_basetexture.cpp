@@ -19,15 +19,18 @@
 
 #include "../../include/core/m3dcore_basetexture.h"
 #include "../../include/core/m3dcore_device.h"
+#include "../../include/core/m3dcore_threads.h"
 
 IMuli3DBaseTexture::IMuli3DBaseTexture( CMuli3DDevice *i_pParent ) :
-	m_pParent( i_pParent )
+	m_pParent( i_pParent ), m_pSamplerFeedback( 0 ),
+	m_iMinSampledMipLevel( c_iSamplerFeedbackNotSampled )
 {
 	m_pParent->AddRef();
 }
 
 IMuli3DBaseTexture::~IMuli3DBaseTexture()
 {
+	delete[] (uint32 *)m_pSamplerFeedback;
 	SAFE_RELEASE( m_pParent );
 }
 
@@ -38,3 +41,252 @@ CMuli3DDevice *IMuli3DBaseTexture::pGetDevice()
 	
 	return m_pParent;
 }
+
+result IMuli3DBaseTexture::SampleTexture4( vector4 *o_pColors, const vector4 *i_pCoords, const vector4 *i_pXGradients, const vector4 *i_pYGradients, const uint32 *i_pSamplerStates )
+{
+	for( uint32 iLookup = 0; iLookup < 4; ++iLookup )
+	{
+		result resSample = SampleTexture( o_pColors[iLookup], i_pCoords[iLookup].x, i_pCoords[iLookup].y, i_pCoords[iLookup].z,
+			i_pXGradients ? &i_pXGradients[iLookup] : 0, i_pYGradients ? &i_pYGradients[iLookup] : 0, i_pSamplerStates );
+		if( FUNC_FAILED( resSample ) )
+			return resSample;
+	}
+	return s_ok;
+}
+
+result IMuli3DBaseTexture::SampleTextureRect( vector4 &o_vColor, float32 i_fU0, float32 i_fV0, float32 i_fU1, float32 i_fV1, const uint32 *i_pSamplerStates )
+{
+	const vector4 vXGradient( i_fU1 - i_fU0, 0, 0, 0 );
+	const vector4 vYGradient( 0, i_fV1 - i_fV0, 0, 0 );
+	return SampleTexture( o_vColor, ( i_fU0 + i_fU1 ) * 0.5f, ( i_fV0 + i_fV1 ) * 0.5f, 0.0f,
+		&vXGradient, &vYGradient, i_pSamplerStates );
+}
+
+result IMuli3DBaseTexture::SampleTextureCmp( float32 &o_fResult, float32 i_fU, float32 i_fV, float32 i_fReference, const uint32 *i_pSamplerStates )
+{
+	o_fResult = 0.0f;
+	FUNC_FAILING( "IMuli3DBaseTexture::SampleTextureCmp: texture doesn't support depth-comparison lookups.\n" );
+	return e_invalidstate;
+}
+
+result IMuli3DBaseTexture::IntegrateRay( vector4 &o_vColor, const vector3 &i_vOrigin, const vector3 &i_vDirection, const m3dvolumeintegration &i_Integration, const uint32 *i_pSamplerStates )
+{
+	o_vColor = vector4( 0, 0, 0, 0 );
+	FUNC_FAILING( "IMuli3DBaseTexture::IntegrateRay: texture doesn't support ray integration.\n" );
+	return e_invalidstate;
+}
+
+// Sampler feedback -----------------------------------------------------------
+
+result IMuli3DBaseTexture::SetSamplerFeedback( bool i_bEnable )
+{
+	if( !i_bEnable )
+	{
+		delete[] (uint32 *)m_pSamplerFeedback;
+		m_pSamplerFeedback = 0;
+		m_iMinSampledMipLevel = c_iSamplerFeedbackNotSampled;
+		return s_ok;
+	}
+
+	if( !m_pSamplerFeedback )
+	{
+		m_pSamplerFeedback = new uint32[c_iSamplerFeedbackSize * c_iSamplerFeedbackSize];
+		if( !m_pSamplerFeedback )
+		{
+			FUNC_FAILING( "IMuli3DBaseTexture::SetSamplerFeedback: out of memory, cannot create sampler feedback map.\n" );
+			return e_outofmemory;
+		}
+	}
+
+	ClearSamplerFeedback();
+	return s_ok;
+}
+
+void IMuli3DBaseTexture::ClearSamplerFeedback()
+{
+	if( !m_pSamplerFeedback )
+		return;
+
+	for( uint32 iCell = 0; iCell < c_iSamplerFeedbackSize * c_iSamplerFeedbackSize; ++iCell )
+		m_pSamplerFeedback[iCell] = c_iSamplerFeedbackNotSampled;
+	m_iMinSampledMipLevel = c_iSamplerFeedbackNotSampled;
+}
+
+result IMuli3DBaseTexture::GetSamplerFeedback( uint32 *o_pMinMipLevels )
+{
+	if( !o_pMinMipLevels )
+	{
+		FUNC_FAILING( "IMuli3DBaseTexture::GetSamplerFeedback: parameter o_pMinMipLevels points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	if( !m_pSamplerFeedback )
+	{
+		FUNC_FAILING( "IMuli3DBaseTexture::GetSamplerFeedback: sampler feedback is disabled.\n" );
+		return e_invalidstate;
+	}
+
+	for( uint32 iCell = 0; iCell < c_iSamplerFeedbackSize * c_iSamplerFeedbackSize; ++iCell )
+		o_pMinMipLevels[iCell] = m_pSamplerFeedback[iCell];
+
+	return s_ok;
+}
+
+uint32 IMuli3DBaseTexture::iGetMinSampledMipLevel()
+{
+	return m_iMinSampledMipLevel;
+}
+
+void IMuli3DBaseTexture::RecordSamplerFeedback( float32 i_fU, float32 i_fV, float32 i_fMipLevel )
+{
+	uint32 iCellX = ftol( i_fU * c_iSamplerFeedbackSize ), iCellY = ftol( i_fV * c_iSamplerFeedbackSize );
+	if( iCellX >= c_iSamplerFeedbackSize ) iCellX = c_iSamplerFeedbackSize - 1;
+	if( iCellY >= c_iSamplerFeedbackSize ) iCellY = c_iSamplerFeedbackSize - 1;
+
+	// Most lookups hit cells that already hold the mip-level, so check before doing an atomic operation.
+	const uint32 iMipLevel = ftol( i_fMipLevel );
+	volatile uint32 *pCell = &m_pSamplerFeedback[iCellY * c_iSamplerFeedbackSize + iCellX];
+	if( iMipLevel < *pCell )
+	{
+		AtomicMin( pCell, iMipLevel );
+		if( iMipLevel < m_iMinSampledMipLevel )
+			AtomicMin( &m_iMinSampledMipLevel, iMipLevel );
+	}
+}
+
+// Mip-level downsampling -----------------------------------------------------
+
+/// @internal Computes the source pixels and weights that contribute to a destination pixel along one axis.
+/// @return number of taps.
+static uint32 iGetMipFilterTaps( m3dmipfilter i_Filter, uint32 i_iDest, uint32 i_iSrcSize, uint32 *o_pTaps, float32 *o_pWeights )
+{
+	if( i_iSrcSize == 1 )
+	{
+		o_pTaps[0] = 0; o_pWeights[0] = 1.0f;
+		return 1;
+	}
+
+	const int32 iSrc = 2 * i_iDest, iSrcMax = i_iSrcSize - 1;
+	if( i_Filter == m3dmf_tent )
+	{
+		static const float32 fTentWeights[4] = { 0.125f, 0.375f, 0.375f, 0.125f };
+		for( int32 iTap = 0; iTap < 4; ++iTap )
+		{
+			o_pTaps[iTap] = iClamp( iSrc - 1 + iTap, 0, iSrcMax );
+			o_pWeights[iTap] = fTentWeights[iTap];
+		}
+		return 4;
+	}
+
+	o_pTaps[0] = iClamp( iSrc, 0, iSrcMax ); o_pWeights[0] = 0.5f;
+	o_pTaps[1] = iClamp( iSrc + 1, 0, iSrcMax ); o_pWeights[1] = 0.5f;
+	return 2;
+}
+
+void IMuli3DBaseTexture::DownsampleMipRows( uint32 i_iBegin, uint32 i_iEnd, void *i_pUserData )
+{
+	const mipdownsampleinfo *pInfo = (const mipdownsampleinfo *)i_pUserData;
+
+	float32 *pAccumRow = new float32[pInfo->iMaxSrcRowFloats];
+	if( !pAccumRow )
+		return;
+
+	uint32 iDownsample = 0;
+	for( uint32 iRow = i_iBegin; iRow < i_iEnd; ++iRow )
+	{
+		while( iRow >= pInfo->pFirstRows[iDownsample + 1] )
+			++iDownsample;
+
+		const mipdownsample &Downsample = pInfo->pDownsamples[iDownsample];
+		const uint32 iFloats = Downsample.iFloats;
+		const uint32 iDestWidth = Downsample.iSrcWidth > 1 ? Downsample.iSrcWidth >> 1 : 1;
+		const uint32 iDestHeight = Downsample.iSrcHeight > 1 ? Downsample.iSrcHeight >> 1 : 1;
+		const uint32 iDestRow = iRow - pInfo->pFirstRows[iDownsample];
+		const uint32 iSrcRowFloats = Downsample.iSrcWidth * iFloats;
+
+		uint32 iTapsY[4], iTapsZ[4];
+		float32 fWeightsY[4], fWeightsZ[4];
+		const uint32 iNumTapsY = iGetMipFilterTaps( Downsample.Filter, iDestRow % iDestHeight, Downsample.iSrcHeight, iTapsY, fWeightsY );
+		const uint32 iNumTapsZ = iGetMipFilterTaps( Downsample.Filter, iDestRow / iDestHeight, Downsample.iSrcDepth, iTapsZ, fWeightsZ );
+
+		// Vertical pass: weighted sum of the contributing source rows. The inner loop
+		// runs over contiguous floats and is vectorized by the compiler.
+		memset( pAccumRow, 0, sizeof( float32 ) * iSrcRowFloats );
+		for( uint32 iTapZ = 0; iTapZ < iNumTapsZ; ++iTapZ )
+		{
+			for( uint32 iTapY = 0; iTapY < iNumTapsY; ++iTapY )
+			{
+				const float32 fWeight = fWeightsZ[iTapZ] * fWeightsY[iTapY];
+				const float32 *pSrcRow = &Downsample.pSrcData[( iTapsZ[iTapZ] * Downsample.iSrcHeight + iTapsY[iTapY] ) * iSrcRowFloats];
+				for( uint32 iFloat = 0; iFloat < iSrcRowFloats; ++iFloat )
+					pAccumRow[iFloat] += pSrcRow[iFloat] * fWeight;
+			}
+		}
+
+		// Horizontal pass.
+		float32 *pDestData = &Downsample.pDestData[iDestRow * iDestWidth * iFloats];
+		if( Downsample.Filter == m3dmf_box && Downsample.iSrcWidth > 1 )
+		{
+			// Both pixels of a pair always lie within the source row.
+			const float32 *pSrcPair = pAccumRow;
+			for( uint32 iX = 0; iX < iDestWidth; ++iX, pDestData += iFloats, pSrcPair += 2 * iFloats )
+			{
+				for( uint32 iFloat = 0; iFloat < iFloats; ++iFloat )
+					pDestData[iFloat] = ( pSrcPair[iFloat] + pSrcPair[iFloat + iFloats] ) * 0.5f;
+			}
+		}
+		else
+		{
+			for( uint32 iX = 0; iX < iDestWidth; ++iX, pDestData += iFloats )
+			{
+				uint32 iTapsX[4];
+				float32 fWeightsX[4];
+				const uint32 iNumTapsX = iGetMipFilterTaps( Downsample.Filter, iX, Downsample.iSrcWidth, iTapsX, fWeightsX );
+
+				for( uint32 iFloat = 0; iFloat < iFloats; ++iFloat )
+				{
+					float32 fSum = 0.0f;
+					for( uint32 iTapX = 0; iTapX < iNumTapsX; ++iTapX )
+						fSum += pAccumRow[iTapsX[iTapX] * iFloats + iFloat] * fWeightsX[iTapX];
+					pDestData[iFloat] = fSum;
+				}
+			}
+		}
+	}
+
+	delete[] pAccumRow;
+}
+
+void IMuli3DBaseTexture::DownsampleMipLevels( const mipdownsample *i_pDownsamples, uint32 i_iNumDownsamples )
+{
+	if( !i_iNumDownsamples )
+		return;
+
+	uint32 *pFirstRows = new uint32[i_iNumDownsamples + 1];
+	if( !pFirstRows )
+		return;
+
+	mipdownsampleinfo Info;
+	Info.pDownsamples = i_pDownsamples;
+	Info.iNumDownsamples = i_iNumDownsamples;
+	Info.pFirstRows = pFirstRows;
+	Info.iMaxSrcRowFloats = 0;
+
+	pFirstRows[0] = 0;
+	for( uint32 iDownsample = 0; iDownsample < i_iNumDownsamples; ++iDownsample )
+	{
+		const mipdownsample &Downsample = i_pDownsamples[iDownsample];
+		const uint32 iDestHeight = Downsample.iSrcHeight > 1 ? Downsample.iSrcHeight >> 1 : 1;
+		const uint32 iDestDepth = Downsample.iSrcDepth > 1 ? Downsample.iSrcDepth >> 1 : 1;
+		pFirstRows[iDownsample + 1] = pFirstRows[iDownsample] + iDestHeight * iDestDepth;
+
+		if( Downsample.iSrcWidth * Downsample.iFloats > Info.iMaxSrcRowFloats )
+			Info.iMaxSrcRowFloats = Downsample.iSrcWidth * Downsample.iFloats;
+	}
+
+	// Give each thread at least ~16k source floats to process, smaller mip-levels aren't worth a thread.
+	const uint32 iMinRowsPerThread = 1 + 16384 / Info.iMaxSrcRowFloats;
+	ParallelFor( pFirstRows[i_iNumDownsamples], iMinRowsPerThread, DownsampleMipRows, &Info );
+
+	delete[] pFirstRows;
+}
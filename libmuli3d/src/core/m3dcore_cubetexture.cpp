@@ -64,12 +64,81 @@ m3dtexsampleinput CMuli3DCubeTexture::eGetTexSampleInput()
 	return m3dtsi_vector;
 }
 
-result CMuli3DCubeTexture::GenerateMipSubLevels( uint32 i_iSrcLevel )
+result CMuli3DCubeTexture::GenerateMipSubLevels( uint32 i_iSrcLevel, m3dmipfilter i_Filter )
+{
+	const uint32 iMipLevels = iGetMipLevels();
+	if( i_iSrcLevel + 1 >= iMipLevels )
+	{
+		FUNC_FAILING( "CMuli3DCubeTexture::GenerateMipSubLevels: i_iSrcLevel refers either to last mip-level or is larger than the number of mip-levels.\n" );
+		return e_invalidparameters;
+	}
+
+	if( i_Filter != m3dmf_box && i_Filter != m3dmf_tent )
+	{
+		FUNC_FAILING( "CMuli3DCubeTexture::GenerateMipSubLevels: invalid filter specified.\n" );
+		return e_invalidparameters;
+	}
+
+	if( m_ppCubeFaces[0]->m_bAutoGenMipSubLevels )
+	{
+		// The faces defer generation until their mip-sublevels are accessed.
+		for( uint32 iFace = m3dcf_positive_x; iFace <= m3dcf_negative_z; ++iFace )
+		{
+			result resFace = m_ppCubeFaces[iFace]->GenerateMipSubLevels( i_iSrcLevel, i_Filter );
+			if( FUNC_FAILED( resFace ) )
+				return resFace;
+		}
+		return s_ok;
+	}
+
+	// All six faces of a mip-level are downsampled in one go, which gives the worker threads more rows to share.
+	for( uint32 iLevel = i_iSrcLevel + 1; iLevel < iMipLevels; ++iLevel )
+	{
+		mipdownsample Downsamples[6];
+		uint32 iFace;
+		result resLock = s_ok;
+		for( iFace = m3dcf_positive_x; iFace <= m3dcf_negative_z; ++iFace )
+		{
+			resLock = LockRect( (m3dcubefaces)iFace, iLevel - 1, (void **)&Downsamples[iFace].pSrcData, 0 );
+			if( FUNC_FAILED( resLock ) )
+				break;
+
+			resLock = LockRect( (m3dcubefaces)iFace, iLevel, (void **)&Downsamples[iFace].pDestData, 0 );
+			if( FUNC_FAILED( resLock ) )
+			{
+				UnlockRect( (m3dcubefaces)iFace, iLevel - 1 );
+				break;
+			}
+
+			Downsamples[iFace].iFloats = iGetFormatFloats();
+			Downsamples[iFace].iSrcWidth = iGetEdgeLength( iLevel - 1 );
+			Downsamples[iFace].iSrcHeight = Downsamples[iFace].iSrcWidth;
+			Downsamples[iFace].iSrcDepth = 1;
+			Downsamples[iFace].Filter = i_Filter;
+		}
+
+		if( !FUNC_FAILED( resLock ) )
+			DownsampleMipLevels( Downsamples, 6 );
+
+		while( iFace-- > m3dcf_positive_x )
+		{
+			UnlockRect( (m3dcubefaces)iFace, iLevel );
+			UnlockRect( (m3dcubefaces)iFace, iLevel - 1 );
+		}
+
+		if( FUNC_FAILED( resLock ) )
+			return resLock;
+	}
+
+	return s_ok;
+}
+
+result CMuli3DCubeTexture::SetAutoGenMipSubLevels( bool i_bAutoGen, m3dmipfilter i_Filter )
 {
 	for( uint32 iFace = m3dcf_positive_x; iFace <= m3dcf_negative_z; ++iFace )
 	{
-		result resFace = m_ppCubeFaces[iFace]->GenerateMipSubLevels( i_iSrcLevel );
-		if( resFace != s_ok )
+		result resFace = m_ppCubeFaces[iFace]->SetAutoGenMipSubLevels( i_bAutoGen, i_Filter );
+		if( FUNC_FAILED( resFace ) )
 			return resFace;
 	}
 	return s_ok;
@@ -97,7 +166,7 @@ result CMuli3DCubeTexture::UnlockRect( m3dcubefaces i_Face, uint32 i_iMipLevel )
 	return m_ppCubeFaces[i_Face]->UnlockRect( i_iMipLevel );
 }
 
-result CMuli3DCubeTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i_fV, float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient, const uint32 *i_pSamplerStates )
+void CMuli3DCubeTexture::ProjectToFaces( cubelookups &io_Lookups, uint32 i_iNumLookups, bool i_bGradients )
 {
 	// Determine face and local u/v coordinates ...
 	// source: http://developer.nvidia.com/object/cube_map_ogl_tutorial.html
@@ -111,66 +180,123 @@ result CMuli3DCubeTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, float
 	//  -ry          GL_TEXTURE_CUBE_MAP_NEGATIVE_Y_EXT   +rx    -rz   ry 
 	//  +rz          GL_TEXTURE_CUBE_MAP_POSITIVE_Z_EXT   +rx    -ry   rz 
 	//  -rz          GL_TEXTURE_CUBE_MAP_NEGATIVE_Z_EXT   -rx    -ry   rz
-	float32 fCU, fCV, fInvMag;
-	m3dcubefaces Face;
 
-	const float32 fAbsU = fabsf( i_fU );
-	const float32 fAbsV = fabsf( i_fV );
-	const float32 fAbsW = fabsf( i_fW );
-
-	if( fAbsU >= fAbsV && fAbsU >= fAbsW )
+	// The table is evaluated with selects instead of branches:
+	// sc = x-major ? -sign( rx ) * rz : ( y-major ? rx : sign( rz ) * rx )
+	// tc = y-major ? sign( ry ) * rz : -ry
+	for( uint32 i = 0; i < i_iNumLookups; ++i )
 	{
-		if( i_fU >= 0.0f )
-		{
-			// major axis direction: +rx
-			Face = m3dcf_positive_x;
-			fCU = -i_fW; fCV = -i_fV; fInvMag = 1.0f / fAbsU;
-		}
-		else
+		const float32 fX = io_Lookups.fX[i], fY = io_Lookups.fY[i], fZ = io_Lookups.fZ[i];
+		const float32 fAbsX = fabsf( fX ), fAbsY = fabsf( fY ), fAbsZ = fabsf( fZ );
+		const float32 fSignX = fX >= 0.0f ? 1.0f : -1.0f;
+		const float32 fSignY = fY >= 0.0f ? 1.0f : -1.0f;
+		const float32 fSignZ = fZ >= 0.0f ? 1.0f : -1.0f;
+
+		const bool bMajorX = fAbsX >= fAbsY && fAbsX >= fAbsZ;
+		const bool bMajorY = !bMajorX && fAbsY >= fAbsZ;
+
+		const float32 fAbsMa = bMajorX ? fAbsX : ( bMajorY ? fAbsY : fAbsZ );
+		const float32 fSignMa = bMajorX ? fSignX : ( bMajorY ? fSignY : fSignZ );
+		const float32 fScFromZ = bMajorX ? -fSignX : 0.0f, fScFromX = bMajorX ? 0.0f : ( bMajorY ? 1.0f : fSignZ );
+		const float32 fTcFromZ = bMajorY ? fSignY : 0.0f, fTcFromY = bMajorY ? 0.0f : -1.0f;
+
+		const float32 fSc = fScFromZ * fZ + fScFromX * fX;
+		const float32 fTc = fTcFromZ * fZ + fTcFromY * fY;
+
+		// s = ( sc/|ma| + 1 ) / 2
+		// t = ( tc/|ma| + 1 ) / 2
+		const float32 fInvMag = 1.0f / fAbsMa;
+		const float32 fHalfInvMag = 0.5f * fInvMag;
+		io_Lookups.iFace[i] = ( bMajorX ? m3dcf_positive_x : ( bMajorY ? m3dcf_positive_y : m3dcf_positive_z ) ) + ( fSignMa < 0.0f ? 1 : 0 );
+		io_Lookups.fS[i] = fSc * fHalfInvMag + 0.5f;
+		io_Lookups.fT[i] = fTc * fHalfInvMag + 0.5f;
+
+		if( i_bGradients )
 		{
-			// major axis direction: -rx
-			Face = m3dcf_negative_x;
-			fCU = i_fW; fCV = -i_fV; fInvMag = 1.0f / fAbsU;
+			// ds = ( dsc - sc/|ma| * d|ma| ) / ( 2 * |ma| ), likewise for t; the face is assumed to be constant across the pixel.
+			const float32 fScPerMa = fSc * fInvMag, fTcPerMa = fTc * fInvMag;
+			const float32 fMaFromX = bMajorX ? fSignX : 0.0f, fMaFromY = bMajorY ? fSignY : 0.0f, fMaFromZ = ( bMajorX || bMajorY ) ? 0.0f : fSignZ;
+
+			const float32 fDX = io_Lookups.fXGradX[i], fDY = io_Lookups.fXGradY[i], fDZ = io_Lookups.fXGradZ[i];
+			const float32 fDAbsMaX = fMaFromX * fDX + fMaFromY * fDY + fMaFromZ * fDZ;
+			io_Lookups.fXGradS[i] = ( fScFromZ * fDZ + fScFromX * fDX - fScPerMa * fDAbsMaX ) * fHalfInvMag;
+			io_Lookups.fXGradT[i] = ( fTcFromZ * fDZ + fTcFromY * fDY - fTcPerMa * fDAbsMaX ) * fHalfInvMag;
+
+			const float32 fEX = io_Lookups.fYGradX[i], fEY = io_Lookups.fYGradY[i], fEZ = io_Lookups.fYGradZ[i];
+			const float32 fDAbsMaY = fMaFromX * fEX + fMaFromY * fEY + fMaFromZ * fEZ;
+			io_Lookups.fYGradS[i] = ( fScFromZ * fEZ + fScFromX * fEX - fScPerMa * fDAbsMaY ) * fHalfInvMag;
+			io_Lookups.fYGradT[i] = ( fTcFromZ * fEZ + fTcFromY * fEY - fTcPerMa * fDAbsMaY ) * fHalfInvMag;
 		}
 	}
-	else if( fAbsV >= fAbsU && fAbsV >= fAbsW )
+}
+
+result CMuli3DCubeTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i_fV, float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient, const uint32 *i_pSamplerStates )
+{
+	const bool bGradients = i_pXGradient && i_pYGradient;
+
+	cubelookups Lookups;
+	Lookups.fX[0] = i_fU; Lookups.fY[0] = i_fV; Lookups.fZ[0] = i_fW;
+	if( bGradients )
+	{
+		Lookups.fXGradX[0] = i_pXGradient->x; Lookups.fXGradY[0] = i_pXGradient->y; Lookups.fXGradZ[0] = i_pXGradient->z;
+		Lookups.fYGradX[0] = i_pYGradient->x; Lookups.fYGradY[0] = i_pYGradient->y; Lookups.fYGradZ[0] = i_pYGradient->z;
+	}
+	else
+	{
+		Lookups.fXGradX[0] = Lookups.fXGradY[0] = Lookups.fXGradZ[0] = 0.0f;
+		Lookups.fYGradX[0] = Lookups.fYGradY[0] = Lookups.fYGradZ[0] = 0.0f;
+	}
+
+	ProjectToFaces( Lookups, 1, bGradients );
+
+	if( !bGradients )
+		return m_ppCubeFaces[Lookups.iFace[0]]->SampleTexture( o_vColor, Lookups.fS[0], Lookups.fT[0], 0, 0, 0, i_pSamplerStates );
+
+	const vector4 vXGradient( Lookups.fXGradS[0], Lookups.fXGradT[0], 0, 0 );
+	const vector4 vYGradient( Lookups.fYGradS[0], Lookups.fYGradT[0], 0, 0 );
+	return m_ppCubeFaces[Lookups.iFace[0]]->SampleTexture( o_vColor, Lookups.fS[0], Lookups.fT[0], 0, &vXGradient, &vYGradient, i_pSamplerStates );
+}
+
+result CMuli3DCubeTexture::SampleTexture4( vector4 *o_pColors, const vector4 *i_pCoords, const vector4 *i_pXGradients, const vector4 *i_pYGradients, const uint32 *i_pSamplerStates )
+{
+	const bool bGradients = i_pXGradients && i_pYGradients;
+
+	cubelookups Lookups;
+	uint32 i;
+	for( i = 0; i < 4; ++i )
 	{
-		if( i_fV >= 0.0f )
+		Lookups.fX[i] = i_pCoords[i].x; Lookups.fY[i] = i_pCoords[i].y; Lookups.fZ[i] = i_pCoords[i].z;
+		if( bGradients )
 		{
-			// major axis direction: +ry
-			Face = m3dcf_positive_y;
-			fCU = i_fU; fCV = i_fW; fInvMag = 1.0f / fAbsV;
+			Lookups.fXGradX[i] = i_pXGradients[i].x; Lookups.fXGradY[i] = i_pXGradients[i].y; Lookups.fXGradZ[i] = i_pXGradients[i].z;
+			Lookups.fYGradX[i] = i_pYGradients[i].x; Lookups.fYGradY[i] = i_pYGradients[i].y; Lookups.fYGradZ[i] = i_pYGradients[i].z;
 		}
 		else
 		{
-			// major axis direction: -ry
-			Face = m3dcf_negative_y;
-			fCU = i_fU; fCV = -i_fW; fInvMag = 1.0f / fAbsV;
+			Lookups.fXGradX[i] = Lookups.fXGradY[i] = Lookups.fXGradZ[i] = 0.0f;
+			Lookups.fYGradX[i] = Lookups.fYGradY[i] = Lookups.fYGradZ[i] = 0.0f;
 		}
 	}
-	else //if( fAbsW >= fAbsU && fAbsW >= fAbsV )
+
+	ProjectToFaces( Lookups, 4, bGradients );
+
+	for( i = 0; i < 4; ++i )
 	{
-		if( i_fW >= 0.0f )
+		result resSample;
+		if( bGradients )
 		{
-			// major axis direction: +rz
-			Face = m3dcf_positive_z;
-			fCU = i_fU; fCV = -i_fV; fInvMag = 1.0f / fAbsW;
+			const vector4 vXGradient( Lookups.fXGradS[i], Lookups.fXGradT[i], 0, 0 );
+			const vector4 vYGradient( Lookups.fYGradS[i], Lookups.fYGradT[i], 0, 0 );
+			resSample = m_ppCubeFaces[Lookups.iFace[i]]->SampleTexture( o_pColors[i], Lookups.fS[i], Lookups.fT[i], 0, &vXGradient, &vYGradient, i_pSamplerStates );
 		}
 		else
-		{
-			// major axis direction: -rz
-			Face = m3dcf_negative_z;
-			fCU = -i_fU; fCV = -i_fV; fInvMag = 1.0f / fAbsW;
-		}
-	}
+			resSample = m_ppCubeFaces[Lookups.iFace[i]]->SampleTexture( o_pColors[i], Lookups.fS[i], Lookups.fT[i], 0, 0, 0, i_pSamplerStates );
 
-	// s   =   ( sc/|ma| + 1 ) / 2 
-	// t   =   ( tc/|ma| + 1 ) / 2
-	fInvMag *= 0.5f;
-	const float32 fU = /*fSaturate*/( fCU * fInvMag + 0.5f );
-	const float32 fV = /*fSaturate*/( fCV * fInvMag + 0.5f );
+		if( FUNC_FAILED( resSample ) )
+			return resSample;
+	}
 
-	return m_ppCubeFaces[Face]->SampleTexture( o_vColor, fU, fV, 0, i_pXGradient, i_pYGradient, i_pSamplerStates );
+	return s_ok;
 }
 
 m3dformat CMuli3DCubeTexture::fmtGetFormat()
@@ -193,6 +319,15 @@ uint32 CMuli3DCubeTexture::iGetEdgeLength( uint32 i_iMipLevel )
 	return m_ppCubeFaces[0]->iGetWidth( i_iMipLevel );
 }
 
+result CMuli3DCubeTexture::SetSamplerFeedback( bool i_bEnable )
+{
+	if( !i_bEnable )
+		return IMuli3DBaseTexture::SetSamplerFeedback( false );
+
+	FUNC_FAILING( "CMuli3DCubeTexture::SetSamplerFeedback: cube textures record sampler feedback per face, enable it on the textures returned by pGetCubeFace().\n" );
+	return e_invalidstate;
+}
+
 CMuli3DTexture *CMuli3DCubeTexture::pGetCubeFace( m3dcubefaces i_Face )
 {
 	if( i_Face < 0 || i_Face >= 6 )
@@ -24,6 +24,10 @@
 #include "../../include/core/m3dcore_indexbuffer.h"
 #include "../../include/core/m3dcore_rendertarget.h"
 #include "../../include/core/m3dcore_shaders.h"
+#include "../../include/core/m3dcore_sparsetexture.h"
+#include "../../include/core/m3dcore_stencilbuffer.h"
+#include "../../include/core/m3dcore_summedareatexture.h"
+#include "../../include/core/m3dcore_texturearray.h"
 #include "../../include/core/m3dcore_surface.h"
 #include "../../include/core/m3dcore_texture.h"
 #include "../../include/core/m3dcore_primitiveassembler.h"
@@ -50,10 +54,38 @@ uint32 FLOAT_AS_INT( float32 i_f ) {
   return v.i;
 }
 
+/// Edge length in pixels of the depthbuffer tiles classified for the depth bounds-test.
+const uint32 c_iDepthBoundsTileSize = 8;
+
+/// Minimum number of triangles a thread tessellates during subdivision; smaller batches aren't worth a thread.
+const uint32 c_iMinSubdivisionPatchesPerThread = 16;
+
+/// Number of vertices per chunk of storage of subdivision vertex caches.
+const uint32 c_iSubdivisionVertexChunkSize = 64;
+
+/// Hashes the key of a vertex generated during subdivision.
+static inline uint32 iHashSubdivisionKey( const uint32 *i_pKey )
+{
+	const uint32 iHash = ( i_pKey[0] * 0x9e3779b1 ) ^ ( i_pKey[1] * 0x85ebca77 ) ^ ( i_pKey[2] * 0xc2b2ae3d );
+	return iHash ^ ( iHash >> 16 );
+}
+
+/// Classifications of depthbuffer tiles for the depth bounds-test.
+enum m3ddepthboundstile
+{
+	m3ddbt_unknown = 0,	///< The tile has not been accessed during the current draw-call yet.
+	m3ddbt_rejected,	///< The stored depth of every pixel of the tile lies outside the depth bounds.
+	m3ddbt_accepted		///< At least one pixel of the tile has a stored depth within the depth bounds.
+};
+
+/// Width and height of the pixel blocks of each member of the enumeration m3dshadingrate as powers of 2.
+static const uint32 c_iShadingRateShifts[m3dsr_4x4 + 1][2] = { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 }, { 2, 2 } };
+
 CMuli3DDevice::CMuli3DDevice( CMuli3D *i_pParent )
 	: m_pParent( i_pParent ), m_pVertexFormat( 0 ), m_pPrimitiveAssembler( 0 ),
 	  m_pVertexShader( 0 ), m_pTriangleShader( 0 ), m_pPixelShader( 0 ), m_pIndexBuffer( 0 ),
-	  m_pRenderTarget( 0 )
+	  m_pRenderTarget( 0 ), m_pShadingRateImage( 0 ), m_pDepthBoundsTiles( 0 ), m_iNumDepthBoundsTiles( 0 ),
+	  m_iNumSetupTriangles( 0 ), m_iNumSubdivisionPatches( 0 )
 {
 	m_pParent->AddRef();
 
@@ -68,13 +100,34 @@ CMuli3DDevice::CMuli3DDevice( CMuli3D *i_pParent )
 	memset( &m_ClipVertices, 0, sizeof( m_ClipVertices ) );
 	memset( &m_pClipVertices, 0, sizeof( m_pClipVertices ) );
 
+	for( uint32 iPatch = 0; iPatch < c_iSubdivisionBatchSize; ++iPatch )
+		m_SubdivisionPatches[iPatch].InnerVertices.iNumEntries = m_SubdivisionPatches[iPatch].InnerVertices.iNumVertices = 0;
+	for( uint32 iShard = 0; iShard < c_iSubdivisionCacheShards; ++iShard )
+		m_SubdivisionCache[iShard].Vertices.iNumEntries = m_SubdivisionCache[iShard].Vertices.iNumVertices = 0;
+
 	SetDefaultRenderStates();
 	SetDefaultTextureSamplerStates();
 	SetDefaultClippingPlanes();
+	SetDepthBounds( 0.0f, 1.0f );
 }
 
 CMuli3DDevice::~CMuli3DDevice()
 {
+	SAFE_DELETE_ARRAY( m_pDepthBoundsTiles );
+
+	for( uint32 iPatch = 0; iPatch < c_iSubdivisionBatchSize; ++iPatch )
+	{
+		std::vector<m3dvsoutput *> &Chunks = m_SubdivisionPatches[iPatch].InnerVertices.Chunks;
+		for( uint32 iChunk = 0; iChunk < (uint32)Chunks.size(); ++iChunk )
+			SAFE_DELETE_ARRAY( Chunks[iChunk] );
+	}
+	for( uint32 iShard = 0; iShard < c_iSubdivisionCacheShards; ++iShard )
+	{
+		std::vector<m3dvsoutput *> &Chunks = m_SubdivisionCache[iShard].Vertices.Chunks;
+		for( uint32 iChunk = 0; iChunk < (uint32)Chunks.size(); ++iChunk )
+			SAFE_DELETE_ARRAY( Chunks[iChunk] );
+	}
+
 	SAFE_RELEASE( m_pParent );
 }
 
@@ -104,6 +157,24 @@ void CMuli3DDevice::SetDefaultRenderStates()
 	SetRenderState( m3drs_scissortestenable, false );
 
 	SetRenderState( m3drs_linethickness, 1 );
+
+	SetRenderState( m3drs_lodgranularity, m3dlod_pixel );
+	SetRenderState( m3drs_quadshadingenable, false );
+	SetRenderState( m3drs_blendmode, m3dblend_opaque );
+
+	SetRenderState( m3drs_stencilenable, false );
+	SetRenderState( m3drs_stencilfunc, m3dcmp_always );
+	SetRenderState( m3drs_stencilref, 0 );
+	SetRenderState( m3drs_stencilmask, 0xff );
+	SetRenderState( m3drs_stencilwritemask, 0xff );
+	SetRenderState( m3drs_stencilfail, m3dsop_keep );
+	SetRenderState( m3drs_stencilzfail, m3dsop_keep );
+	SetRenderState( m3drs_stencilpass, m3dsop_keep );
+
+	SetRenderState( m3drs_shadingrate, m3dsr_1x1 );
+
+	SetRenderState( m3drs_interleave, m3dil_none );
+	SetRenderState( m3drs_interleavephase, 0 );
 }
 
 void CMuli3DDevice::SetDefaultTextureSamplerStates()
@@ -119,6 +190,8 @@ void CMuli3DDevice::SetDefaultTextureSamplerStates()
 		SetTextureSamplerState( iTextureSampler, m3dtss_mipfilter, m3dtf_point );
 		SetTextureSamplerState( iTextureSampler, m3dtss_miplodbias, FLOAT_AS_INT(fMipLODBias) );
 		SetTextureSamplerState( iTextureSampler, m3dtss_maxmiplevel, FLOAT_AS_INT(fMaxMipLevel) );
+		SetTextureSamplerState( iTextureSampler, m3dtss_comparefunc, m3dcmp_lessequal );
+		SetTextureSamplerState( iTextureSampler, m3dtss_pcfkernelsize, 2 );
 	}
 }
 
@@ -131,6 +204,12 @@ void CMuli3DDevice::SetDefaultClippingPlanes()
 	m_RenderInfo.ClippingPlanes[m3dcp_near] = plane( 0, 0, 1, 0 );
 	m_RenderInfo.ClippingPlanes[m3dcp_far] = plane( 0, 0, -1, 1 );
 
+	// Guard band planes replace the left, right, top and bottom planes for clipping
+	m_RenderInfo.GuardBandPlanes[m3dcp_left] = plane( 1, 0, 0, c_fGuardBand );
+	m_RenderInfo.GuardBandPlanes[m3dcp_right] = plane( -1, 0, 0, c_fGuardBand );
+	m_RenderInfo.GuardBandPlanes[m3dcp_top] = plane( 0, -1, 0, c_fGuardBand );
+	m_RenderInfo.GuardBandPlanes[m3dcp_bottom] = plane( 0, 1, 0, c_fGuardBand );
+
 	// Enable the default clipping planes ...
 	for( uint32 iPlane = m3dcp_left; iPlane <= m3dcp_far; ++iPlane )
 		m_RenderInfo.bClippingPlaneEnabled[iPlane] = true;
@@ -408,31 +487,16 @@ result CMuli3DDevice::GetTextureSamplerState( uint32 i_iSamplerNumber, m3dtextur
 	return s_ok;
 }
 
-result CMuli3DDevice::SampleTexture( vector4 &o_vColor, uint32 i_iSamplerNumber, float32 i_fU, float32 i_fV, float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient )
+result CMuli3DDevice::AddressTextureCoords( uint32 i_iSamplerNumber, float32 &io_fU, float32 &io_fV, float32 &io_fW )
 {
-	if( i_iSamplerNumber >= c_iMaxTextureSamplers )
-	{
-		o_vColor = vector4( 0, 0, 0, 0 );
-		FUNC_FAILING( "CMuli3DDevice::SampleTexture: i_iSamplerNumber exceeds number of available texture samplers.\n" );
-		return e_invalidparameters;
-	}
-
 	const texturesampler &TextureSampler = m_TextureSamplers[i_iSamplerNumber];
 
-	IMuli3DBaseTexture *pTexture = TextureSampler.pTexture;
-	if( !pTexture )
-	{
-		o_vColor = vector4( 0, 0, 0, 0 );
-		return s_ok;
-	}
-
 	switch( TextureSampler.TextureSampleInput )
 	{
 	case m3dtsi_vector:
-		if( i_fU == 0.0f && i_fV == 0.0f && i_fW == 0.0f )
+		if( io_fU == 0.0f && io_fV == 0.0f && io_fW == 0.0f )
 		{
-			o_vColor = vector4( 0, 0, 0, 0 );
-			FUNC_FAILING( "CMuli3DDevice::SampleTexture: sampling vector [u,v,w] = [0,0,0].\n" );
+			FUNC_FAILING( "CMuli3DDevice::AddressTextureCoords: sampling vector [u,v,w] = [0,0,0].\n" );
 			return e_invalidparameters;
 		}
 		break;
@@ -440,37 +504,210 @@ result CMuli3DDevice::SampleTexture( vector4 &o_vColor, uint32 i_iSamplerNumber,
 	case m3dtsi_3coords:
 		switch( TextureSampler.iTextureSamplerStates[m3dtss_addressw] )
 		{
-		case m3dta_wrap: i_fW -= ftol( i_fW );
-		case m3dta_clamp: i_fW = fSaturate( i_fW ); break;
-		default: o_vColor = vector4( 0, 0, 0, 0 ); FUNC_FAILING( "CMuli3DDevice::SampleTexture: value of texture sampler state m3dtss_addressw is invalid.\n" ); return e_invalidstate;
+		case m3dta_wrap: io_fW -= ftol( io_fW );
+		case m3dta_clamp: io_fW = fSaturate( io_fW ); break;
+		default: FUNC_FAILING( "CMuli3DDevice::AddressTextureCoords: value of texture sampler state m3dtss_addressw is invalid.\n" ); return e_invalidstate;
 		}
 
+	case m3dtsi_layer: // the layer index is clamped by the texture array
 	case m3dtsi_2coords:
 		switch( TextureSampler.iTextureSamplerStates[m3dtss_addressu] )
 		{
-		case m3dta_wrap: i_fU -= ftol( i_fU );
-		case m3dta_clamp: i_fU = fSaturate( i_fU ); break;
-		default: o_vColor = vector4( 0, 0, 0, 0 ); FUNC_FAILING( "CMuli3DDevice::SampleTexture: value of texture sampler state m3dtss_addressu is invalid.\n" ); return e_invalidstate;
+		case m3dta_wrap: io_fU -= ftol( io_fU );
+		case m3dta_clamp: io_fU = fSaturate( io_fU ); break;
+		default: FUNC_FAILING( "CMuli3DDevice::AddressTextureCoords: value of texture sampler state m3dtss_addressu is invalid.\n" ); return e_invalidstate;
 		}
 
 		switch( TextureSampler.iTextureSamplerStates[m3dtss_addressv] )
 		{
-		case m3dta_wrap: i_fV -= ftol( i_fV );
-		case m3dta_clamp: i_fV = fSaturate( i_fV ); break;
-		default: o_vColor = vector4( 0, 0, 0, 0 ); FUNC_FAILING( "CMuli3DDevice::SampleTexture: value of texture sampler state m3dtss_addressv is invalid.\n" ); return e_invalidstate;
+		case m3dta_wrap: io_fV -= ftol( io_fV );
+		case m3dta_clamp: io_fV = fSaturate( io_fV ); break;
+		default: FUNC_FAILING( "CMuli3DDevice::AddressTextureCoords: value of texture sampler state m3dtss_addressv is invalid.\n" ); return e_invalidstate;
 		}
 		break;
 
 	default:
-		o_vColor = vector4( 0, 0, 0, 0 );
-		FUNC_FAILING( "CMuli3DDevice::SampleTexture: invalid texture-sampling input!\n" );
+		FUNC_FAILING( "CMuli3DDevice::AddressTextureCoords: invalid texture-sampling input!\n" );
 		return e_invalidstate;
 	}
 
+	return s_ok;
+}
+
+result CMuli3DDevice::SampleTexture( vector4 &o_vColor, uint32 i_iSamplerNumber, float32 i_fU, float32 i_fV, float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient )
+{
+	if( i_iSamplerNumber >= c_iMaxTextureSamplers )
+	{
+		o_vColor = vector4( 0, 0, 0, 0 );
+		FUNC_FAILING( "CMuli3DDevice::SampleTexture: i_iSamplerNumber exceeds number of available texture samplers.\n" );
+		return e_invalidparameters;
+	}
+
+	const texturesampler &TextureSampler = m_TextureSamplers[i_iSamplerNumber];
+
+	IMuli3DBaseTexture *pTexture = TextureSampler.pTexture;
+	if( !pTexture )
+	{
+		o_vColor = vector4( 0, 0, 0, 0 );
+		return s_ok;
+	}
+
+	result resAddress = AddressTextureCoords( i_iSamplerNumber, i_fU, i_fV, i_fW );
+	if( FUNC_FAILED( resAddress ) )
+	{
+		o_vColor = vector4( 0, 0, 0, 0 );
+		return resAddress;
+	}
+
 	return pTexture->SampleTexture( o_vColor, i_fU, i_fV, i_fW,
 		i_pXGradient, i_pYGradient, TextureSampler.iTextureSamplerStates );
 }
 
+result CMuli3DDevice::SampleTexture4( vector4 *o_pColors, uint32 i_iSamplerNumber, const vector4 *i_pCoords, const vector4 *i_pXGradients, const vector4 *i_pYGradients )
+{
+	if( !o_pColors || !i_pCoords )
+	{
+		FUNC_FAILING( "CMuli3DDevice::SampleTexture4: parameters o_pColors or i_pCoords point to null.\n" );
+		return e_invalidparameters;
+	}
+
+	uint32 iLookup;
+	if( i_iSamplerNumber >= c_iMaxTextureSamplers )
+	{
+		for( iLookup = 0; iLookup < 4; ++iLookup )
+			o_pColors[iLookup] = vector4( 0, 0, 0, 0 );
+		FUNC_FAILING( "CMuli3DDevice::SampleTexture4: i_iSamplerNumber exceeds number of available texture samplers.\n" );
+		return e_invalidparameters;
+	}
+
+	IMuli3DBaseTexture *pTexture = m_TextureSamplers[i_iSamplerNumber].pTexture;
+	if( !pTexture )
+	{
+		for( iLookup = 0; iLookup < 4; ++iLookup )
+			o_pColors[iLookup] = vector4( 0, 0, 0, 0 );
+		return s_ok;
+	}
+
+	vector4 vCoords[4];
+	for( iLookup = 0; iLookup < 4; ++iLookup )
+	{
+		vCoords[iLookup] = i_pCoords[iLookup];
+		result resAddress = AddressTextureCoords( i_iSamplerNumber, vCoords[iLookup].x, vCoords[iLookup].y, vCoords[iLookup].z );
+		if( FUNC_FAILED( resAddress ) )
+		{
+			for( iLookup = 0; iLookup < 4; ++iLookup )
+				o_pColors[iLookup] = vector4( 0, 0, 0, 0 );
+			return resAddress;
+		}
+	}
+
+	if( !i_pXGradients || !i_pYGradients )
+		i_pXGradients = i_pYGradients = 0;
+
+	return pTexture->SampleTexture4( o_pColors, vCoords, i_pXGradients, i_pYGradients,
+		m_TextureSamplers[i_iSamplerNumber].iTextureSamplerStates );
+}
+
+result CMuli3DDevice::SampleTextureRect( vector4 &o_vColor, uint32 i_iSamplerNumber, float32 i_fU0, float32 i_fV0, float32 i_fU1, float32 i_fV1 )
+{
+	if( i_iSamplerNumber >= c_iMaxTextureSamplers )
+	{
+		o_vColor = vector4( 0, 0, 0, 0 );
+		FUNC_FAILING( "CMuli3DDevice::SampleTextureRect: i_iSamplerNumber exceeds number of available texture samplers.\n" );
+		return e_invalidparameters;
+	}
+
+	const texturesampler &TextureSampler = m_TextureSamplers[i_iSamplerNumber];
+
+	IMuli3DBaseTexture *pTexture = TextureSampler.pTexture;
+	if( !pTexture )
+	{
+		o_vColor = vector4( 0, 0, 0, 0 );
+		return s_ok;
+	}
+
+	if( TextureSampler.TextureSampleInput != m3dtsi_2coords )
+	{
+		o_vColor = vector4( 0, 0, 0, 0 );
+		FUNC_FAILING( "CMuli3DDevice::SampleTextureRect: texture has to be sampled with 2 coordinates.\n" );
+		return e_invalidstate;
+	}
+
+	// Address the center of the rectangle and move the rectangle along.
+	float32 fCenterU = ( i_fU0 + i_fU1 ) * 0.5f, fCenterV = ( i_fV0 + i_fV1 ) * 0.5f, fCenterW = 0.0f;
+	const float32 fOrigCenterU = fCenterU, fOrigCenterV = fCenterV;
+
+	result resAddress = AddressTextureCoords( i_iSamplerNumber, fCenterU, fCenterV, fCenterW );
+	if( FUNC_FAILED( resAddress ) )
+	{
+		o_vColor = vector4( 0, 0, 0, 0 );
+		return resAddress;
+	}
+
+	const float32 fOffsetU = fCenterU - fOrigCenterU, fOffsetV = fCenterV - fOrigCenterV;
+	return pTexture->SampleTextureRect( o_vColor, i_fU0 + fOffsetU, i_fV0 + fOffsetV,
+		i_fU1 + fOffsetU, i_fV1 + fOffsetV, TextureSampler.iTextureSamplerStates );
+}
+
+result CMuli3DDevice::SampleTextureCmp( float32 &o_fResult, uint32 i_iSamplerNumber, float32 i_fU, float32 i_fV, float32 i_fReference )
+{
+	o_fResult = 0.0f;
+
+	if( i_iSamplerNumber >= c_iMaxTextureSamplers )
+	{
+		FUNC_FAILING( "CMuli3DDevice::SampleTextureCmp: i_iSamplerNumber exceeds number of available texture samplers.\n" );
+		return e_invalidparameters;
+	}
+
+	const texturesampler &TextureSampler = m_TextureSamplers[i_iSamplerNumber];
+
+	IMuli3DBaseTexture *pTexture = TextureSampler.pTexture;
+	if( !pTexture )
+		return s_ok;
+
+	if( TextureSampler.TextureSampleInput != m3dtsi_2coords )
+	{
+		FUNC_FAILING( "CMuli3DDevice::SampleTextureCmp: texture has to be sampled with 2 coordinates.\n" );
+		return e_invalidstate;
+	}
+
+	if( TextureSampler.iTextureSamplerStates[m3dtss_comparefunc] > m3dcmp_always )
+	{
+		FUNC_FAILING( "CMuli3DDevice::SampleTextureCmp: value of texture sampler state m3dtss_comparefunc is invalid.\n" );
+		return e_invalidstate;
+	}
+
+	float32 fW = 0.0f;
+	result resAddress = AddressTextureCoords( i_iSamplerNumber, i_fU, i_fV, fW );
+	if( FUNC_FAILED( resAddress ) )
+		return resAddress;
+
+	return pTexture->SampleTextureCmp( o_fResult, i_fU, i_fV, i_fReference,
+		TextureSampler.iTextureSamplerStates );
+}
+
+result CMuli3DDevice::IntegrateVolume( vector4 &o_vColor, uint32 i_iSamplerNumber, const vector3 &i_vOrigin, const vector3 &i_vDirection, const m3dvolumeintegration &i_Integration )
+{
+	if( i_iSamplerNumber >= c_iMaxTextureSamplers )
+	{
+		o_vColor = vector4( 0, 0, 0, 0 );
+		FUNC_FAILING( "CMuli3DDevice::IntegrateVolume: i_iSamplerNumber exceeds number of available texture samplers.\n" );
+		return e_invalidparameters;
+	}
+
+	const texturesampler &TextureSampler = m_TextureSamplers[i_iSamplerNumber];
+
+	IMuli3DBaseTexture *pTexture = TextureSampler.pTexture;
+	if( !pTexture )
+	{
+		o_vColor = vector4( 0, 0, 0, 0 );
+		return s_ok;
+	}
+
+	return pTexture->IntegrateRay( o_vColor, i_vOrigin, i_vDirection, i_Integration,
+		TextureSampler.iTextureSamplerStates );
+}
+
 void CMuli3DDevice::SetRenderTarget( CMuli3DRenderTarget *i_pRenderTarget )
 {
 	m_pRenderTarget = i_pRenderTarget;
@@ -495,12 +732,6 @@ result CMuli3DDevice::SetScissorRect( const m3drect &i_ScissorRect )
 
 	m_ScissorRect = i_ScissorRect;
 
-	// Construct planes for clipping to the scissor rect.
-	m_RenderInfo.ScissorPlanes[0] = plane(  1,  0,  0, -(float32)m_ScissorRect.iLeft );
-	m_RenderInfo.ScissorPlanes[1] = plane( -1,  0,  0, (float32)m_ScissorRect.iRight );
-	m_RenderInfo.ScissorPlanes[2] = plane(  0,  1,  0, -(float32)m_ScissorRect.iTop );
-	m_RenderInfo.ScissorPlanes[3] = plane(  0, -1,  0, (float32)m_ScissorRect.iBottom );
-
 	return s_ok;
 }
 
@@ -519,15 +750,35 @@ result CMuli3DDevice::SetDepthBounds( float32 i_fMinZ, float32 i_fMaxZ )
 		return e_invalidparameters;
 	}
 
-	m_RenderInfo.ClippingPlanes[m3dcp_near].d = i_fMinZ;
-	m_RenderInfo.ClippingPlanes[m3dcp_far].d = i_fMaxZ;
+	m_RenderInfo.fMinDepthBound = i_fMinZ;
+	m_RenderInfo.fMaxDepthBound = i_fMaxZ;
 	return s_ok;
 }
 
 void CMuli3DDevice::GetDepthBounds( float32 &o_fMinZ, float32 &o_fMaxZ )
 {
-	o_fMinZ = m_RenderInfo.ClippingPlanes[m3dcp_near].d;
-	o_fMaxZ = m_RenderInfo.ClippingPlanes[m3dcp_far].d;
+	o_fMinZ = m_RenderInfo.fMinDepthBound;
+	o_fMaxZ = m_RenderInfo.fMaxDepthBound;
+}
+
+result CMuli3DDevice::SetShadingRateImage( CMuli3DSurface *i_pShadingRateImage )
+{
+	if( i_pShadingRateImage && ( i_pShadingRateImage->fmtGetFormat() != m3dfmt_r32f || i_pShadingRateImage->iGetSamples() != 1 ) )
+	{
+		FUNC_FAILING( "CMuli3DDevice::SetShadingRateImage: shading rate image must be a single-sampled m3dfmt_r32f surface.\n" );
+		return e_invalidformat;
+	}
+
+	m_pShadingRateImage = i_pShadingRateImage;
+	return s_ok;
+}
+
+CMuli3DSurface *CMuli3DDevice::pGetShadingRateImage()
+{
+	if( m_pShadingRateImage )
+		m_pShadingRateImage->AddRef();
+
+	return m_pShadingRateImage;
 }
 
 result CMuli3DDevice::SetClippingPlane( m3dclippingplanes i_eIndex, const plane *i_pPlane )
@@ -653,7 +904,32 @@ result CMuli3DDevice::CreateSurface( CMuli3DSurface **o_ppSurface, uint32 i_iWid
 		return e_outofmemory;
 	}
 
-	result resCreate = (*o_ppSurface)->Create( i_iWidth, i_iHeight, i_fmtFormat );
+	result resCreate = (*o_ppSurface)->Create( i_iWidth, i_iHeight, i_fmtFormat, 1 );
+	if( FUNC_FAILED( resCreate ) )
+	{
+		SAFE_RELEASE( *o_ppSurface );
+		return resCreate;
+	}
+
+	return s_ok;
+}
+
+result CMuli3DDevice::CreateMultiSampleSurface( CMuli3DSurface **o_ppSurface, uint32 i_iWidth, uint32 i_iHeight, m3dformat i_fmtFormat, uint32 i_iSamples )
+{
+	if( !o_ppSurface )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateMultiSampleSurface: parameter o_ppSurface points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	*o_ppSurface = new CMuli3DSurface( this );
+	if( !(*o_ppSurface) )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateMultiSampleSurface: out of memory, cannot create surface.\n" );
+		return e_outofmemory;
+	}
+
+	result resCreate = (*o_ppSurface)->Create( i_iWidth, i_iHeight, i_fmtFormat, i_iSamples );
 	if( FUNC_FAILED( resCreate ) )
 	{
 		SAFE_RELEASE( *o_ppSurface );
@@ -663,6 +939,31 @@ result CMuli3DDevice::CreateSurface( CMuli3DSurface **o_ppSurface, uint32 i_iWid
 	return s_ok;
 }
 
+result CMuli3DDevice::CreateStencilBuffer( CMuli3DStencilBuffer **o_ppStencilBuffer, uint32 i_iWidth, uint32 i_iHeight )
+{
+	if( !o_ppStencilBuffer )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateStencilBuffer: parameter o_ppStencilBuffer points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	*o_ppStencilBuffer = new CMuli3DStencilBuffer( this );
+	if( !(*o_ppStencilBuffer) )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateStencilBuffer: out of memory, cannot create stencil buffer.\n" );
+		return e_outofmemory;
+	}
+
+	result resCreate = (*o_ppStencilBuffer)->Create( i_iWidth, i_iHeight );
+	if( FUNC_FAILED( resCreate ) )
+	{
+		SAFE_RELEASE( *o_ppStencilBuffer );
+		return resCreate;
+	}
+
+	return s_ok;
+}
+
 result CMuli3DDevice::CreateTexture( CMuli3DTexture **o_ppTexture, uint32 i_iWidth, uint32 i_iHeight, uint32 i_iMipLevels, m3dformat i_fmtFormat )
 {
 	if( !o_ppTexture )
@@ -713,6 +1014,81 @@ result CMuli3DDevice::CreateCubeTexture( CMuli3DCubeTexture **o_ppCubeTexture, u
 	return s_ok;
 }
 
+result CMuli3DDevice::CreateTextureArray( CMuli3DTextureArray **o_ppTextureArray, uint32 i_iWidth, uint32 i_iHeight, uint32 i_iNumLayers, uint32 i_iMipLevels, m3dformat i_fmtFormat )
+{
+	if( !o_ppTextureArray )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateTextureArray: parameter o_ppTextureArray points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	*o_ppTextureArray = new CMuli3DTextureArray( this );
+	if( !(*o_ppTextureArray) )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateTextureArray: out of memory, cannot create texture array.\n" );
+		return e_outofmemory;
+	}
+
+	result resCreate = (*o_ppTextureArray)->Create( i_iWidth, i_iHeight, i_iNumLayers, i_iMipLevels, i_fmtFormat );
+	if( FUNC_FAILED( resCreate ) )
+	{
+		SAFE_RELEASE( *o_ppTextureArray );
+		return resCreate;
+	}
+
+	return s_ok;
+}
+
+result CMuli3DDevice::CreateSparseTexture( CMuli3DSparseTexture **o_ppSparseTexture, const char *i_szFilename, uint32 i_iMaxResidentPages, bool i_bLoaderThread )
+{
+	if( !o_ppSparseTexture )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateSparseTexture: parameter o_ppSparseTexture points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	*o_ppSparseTexture = new CMuli3DSparseTexture( this );
+	if( !(*o_ppSparseTexture) )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateSparseTexture: out of memory, cannot create sparse texture.\n" );
+		return e_outofmemory;
+	}
+
+	result resCreate = (*o_ppSparseTexture)->Create( i_szFilename, i_iMaxResidentPages, i_bLoaderThread );
+	if( FUNC_FAILED( resCreate ) )
+	{
+		SAFE_RELEASE( *o_ppSparseTexture );
+		return resCreate;
+	}
+
+	return s_ok;
+}
+
+result CMuli3DDevice::CreateSummedAreaTexture( CMuli3DSummedAreaTexture **o_ppSummedAreaTexture, CMuli3DTexture *i_pSourceTexture )
+{
+	if( !o_ppSummedAreaTexture )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateSummedAreaTexture: parameter o_ppSummedAreaTexture points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	*o_ppSummedAreaTexture = new CMuli3DSummedAreaTexture( this );
+	if( !(*o_ppSummedAreaTexture) )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateSummedAreaTexture: out of memory, cannot create summed-area texture.\n" );
+		return e_outofmemory;
+	}
+
+	result resCreate = (*o_ppSummedAreaTexture)->Create( i_pSourceTexture );
+	if( FUNC_FAILED( resCreate ) )
+	{
+		SAFE_RELEASE( *o_ppSummedAreaTexture );
+		return resCreate;
+	}
+
+	return s_ok;
+}
+
 result CMuli3DDevice::CreateVolume( CMuli3DVolume **o_ppSurface, uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth, m3dformat i_fmtFormat )
 {
 	if( !o_ppSurface )
@@ -802,12 +1178,6 @@ result CMuli3DDevice::PreRender()
 		return e_invalidstate;
 	}
 
-	if( !m_pPixelShader )
-	{
-		FUNC_FAILING( "CMuli3DDevice::PreRender: no pixel shader has been set.\n" );
-		return e_invalidstate;
-	}
-
 	if( !m_pRenderTarget )
 	{
 		FUNC_FAILING( "CMuli3DDevice::PreRender: no rendertarget has been set.\n" );
@@ -835,6 +1205,24 @@ result CMuli3DDevice::PreRender()
 		return e_invalidstate;
 	}
 
+	// Pixel shaders address the colorbuffers of multiple render targets by index, so slots must not be left empty.
+	bool bEmptySlot = !pColorBuffer;
+	for( uint32 iBuffer = 1; iBuffer < c_iMaxColorBuffers; ++iBuffer )
+	{
+		CMuli3DSurface *pBuffer = m_pRenderTarget->pGetColorBuffer( iBuffer );
+		const bool bGap = pBuffer && bEmptySlot;
+		if( !pBuffer ) bEmptySlot = true;
+		SAFE_RELEASE( pBuffer );
+
+		if( bGap )
+		{
+			FUNC_FAILING( "CMuli3DDevice::PreRender: colorbuffers have not been set consecutively starting at slot 0.\n" );
+			SAFE_RELEASE( pColorBuffer );
+			SAFE_RELEASE( pDepthBuffer );
+			return e_invalidstate;
+		}
+	}
+
 	if( pColorBuffer && ( pColorBuffer->iGetWidth() < m_RenderInfo.ViewportRect.iRight ||
 		pColorBuffer->iGetHeight() < m_RenderInfo.ViewportRect.iBottom ) )
 	{
@@ -853,9 +1241,44 @@ result CMuli3DDevice::PreRender()
 		return e_invalidstate;
 	}
 
+	if( !m_pPixelShader && pColorBuffer && m_iRenderStates[m3drs_colorwriteenable] )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: no pixel shader has been set.\n" );
+		SAFE_RELEASE( pColorBuffer );
+		SAFE_RELEASE( pDepthBuffer );
+		return e_invalidstate;
+	}
+
+	// The rendertarget guarantees that all of its surfaces have the same number of samples.
+	m_RenderInfo.iSamples = pColorBuffer ? pColorBuffer->iGetSamples() : pDepthBuffer->iGetSamples();
+
 	SAFE_RELEASE( pColorBuffer );
 	SAFE_RELEASE( pDepthBuffer );
 
+	CMuli3DStencilBuffer *pStencilBuffer = m_pRenderTarget->pGetStencilBuffer();
+	if( pStencilBuffer && ( pStencilBuffer->iGetWidth() < m_RenderInfo.ViewportRect.iRight ||
+		pStencilBuffer->iGetHeight() < m_RenderInfo.ViewportRect.iBottom ) )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: stencil buffer's dimensions are smaller than set viewport.\n" );
+		SAFE_RELEASE( pStencilBuffer );
+		return e_invalidstate;
+	}
+
+	if( pStencilBuffer && m_iRenderStates[m3drs_stencilenable] && m_RenderInfo.iSamples > 1 )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: stencil-testing isn't supported for multisampled rendertargets.\n" );
+		SAFE_RELEASE( pStencilBuffer );
+		return e_invalidstate;
+	}
+
+	SAFE_RELEASE( pStencilBuffer );
+
+	if( m_iRenderStates[m3drs_interleave] != m3dil_none && m_RenderInfo.iSamples > 1 )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: interleaved rendering isn't supported for multisampled rendertargets.\n" );
+		return e_invalidstate;
+	}
+
 	const vertexstream *pCurVertexStream = m_VertexStreams;
 	for( uint32 iStream = 0; iStream <= m_pVertexFormat->iGetHighestStream(); ++iStream, ++pCurVertexStream )
 	{
@@ -877,8 +1300,22 @@ result CMuli3DDevice::PreRender()
 			FUNC_FAILING( "CMuli3DDevice::PreRender: scissor rect exceeds viewport's dimensions.\n" );
 			return e_invalidstate;
 		}
+
+		m_RenderInfo.RasterRect = m_ScissorRect;
+	}
+	else
+		m_RenderInfo.RasterRect = m_RenderInfo.ViewportRect;
+
+	// Prepare early culling of triangles -------------------------------------
+	m_RenderInfo.iClippingPlaneMask = 0;
+	for( uint32 iPlane = 0; iPlane < m3dcp_numplanes; ++iPlane )
+	{
+		if( m_RenderInfo.bClippingPlaneEnabled[iPlane] )
+			m_RenderInfo.iClippingPlaneMask |= 1 << iPlane;
 	}
 
+	m_RenderInfo.fViewportOrientation = matViewportMatrix._11 * matViewportMatrix._22 - matViewportMatrix._12 * matViewportMatrix._21;
+
 	// Check line-thickness ---------------------------------------------------
 	if( m_iRenderStates[m3drs_linethickness] == 0 )
 	{
@@ -887,6 +1324,55 @@ result CMuli3DDevice::PreRender()
 	}
 
 
+	// Check granularity of derivative computation ---------------------------
+	switch( m_iRenderStates[m3drs_lodgranularity] )
+	{
+	case m3dlod_pixel:
+	case m3dlod_quad:
+	case m3dlod_span:
+		break;
+	default: FUNC_FAILING( "CMuli3DDevice::PreRender: value of renderstate m3drs_lodgranularity is invalid.\n" ); return e_invalidstate;
+	}
+
+	// Check blend-function ---------------------------------------------------
+	if( m_iRenderStates[m3drs_blendmode] > m3dblend_max )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: value of renderstate m3drs_blendmode is invalid.\n" );
+		return e_invalidstate;
+	}
+
+	// Check shading rate -----------------------------------------------------
+	if( m_iRenderStates[m3drs_shadingrate] > m3dsr_4x4 )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: value of renderstate m3drs_shadingrate is invalid.\n" );
+		return e_invalidstate;
+	}
+
+	// Check interleave pattern ----------------------------------------------
+	if( m_iRenderStates[m3drs_interleave] > m3dil_4x4 )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: value of renderstate m3drs_interleave is invalid.\n" );
+		return e_invalidstate;
+	}
+
+	// Check stencil-states ---------------------------------------------------
+	if( m_iRenderStates[m3drs_stencilenable] )
+	{
+		if( m_iRenderStates[m3drs_stencilfunc] > m3dcmp_always )
+		{
+			FUNC_FAILING( "CMuli3DDevice::PreRender: value of renderstate m3drs_stencilfunc is invalid.\n" );
+			return e_invalidstate;
+		}
+
+		if( m_iRenderStates[m3drs_stencilfail] > m3dsop_decr ||
+			m_iRenderStates[m3drs_stencilzfail] > m3dsop_decr ||
+			m_iRenderStates[m3drs_stencilpass] > m3dsop_decr )
+		{
+			FUNC_FAILING( "CMuli3DDevice::PreRender: value of a stencil-operation renderstate is invalid.\n" );
+			return e_invalidstate;
+		}
+	}
+
 	// Check if renderstates for subdivision-mode are valid -------------------
 	switch( m_iRenderStates[m3drs_subdivisionmode] )
 	{
@@ -936,6 +1422,12 @@ result CMuli3DDevice::PreRender()
 	default: FUNC_FAILING( "CMuli3DDevice::PreRender: value of renderstate m3drs_subdivisionmode is invalid.\n" ); return e_invalidstate;
 	}
 
+	if( m_iRenderStates[m3drs_subdivisionmode] != m3dsubdiv_none && m_iRenderStates[m3drs_subdivisionlevels] > c_iMaxSubdivisionLevels )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: subdivisionlevels exceed c_iMaxSubdivisionLevels.\n" );
+		return e_invalidstate;
+	}
+
 	// Check for valid device-states, which won't produce any output ----------
 	if( m_iRenderStates[m3drs_zenable] && m_iRenderStates[m3drs_zfunc] == m3dcmp_never )
 	{
@@ -986,15 +1478,48 @@ result CMuli3DDevice::PreRender()
 			return e_unknown;
 		}
 
-		m_RenderInfo.iColorBufferPitch = pColorBuffer->iGetWidth() * m_RenderInfo.iColorFloats;
+		m_RenderInfo.iColorBufferPitch = pColorBuffer->iGetWidth() * m_RenderInfo.iSamples * m_RenderInfo.iColorFloats;
 		m_RenderInfo.bColorWrite = m_iRenderStates[m3drs_colorwriteenable] ? true : false;
+		m_RenderInfo.BlendMode = (m3dblend)m_iRenderStates[m3drs_blendmode];
+		m_RenderInfo.bReadDestColor = m_pPixelShader && m_pPixelShader->bNeedsDestinationColor();
+
+		m_RenderInfo.iNumColorBuffers = 1;
+		m_RenderInfo.pMRTData[0] = m_RenderInfo.pFrameData;
+		m_RenderInfo.iMRTFloats[0] = m_RenderInfo.iColorFloats;
+		m_RenderInfo.iMRTPitch[0] = m_RenderInfo.iColorBufferPitch;
+
+		// Lock the additional colorbuffers of multiple render targets.
+		for( uint32 iBuffer = 1; iBuffer < c_iMaxColorBuffers; ++iBuffer )
+		{
+			CMuli3DSurface *pBuffer = m_pRenderTarget->pGetColorBuffer( iBuffer );
+			if( !pBuffer )
+				break;
+
+			resBuffer = pBuffer->LockRect( (void **)&m_RenderInfo.pMRTData[iBuffer], 0 );
+			if( FUNC_FAILED( resBuffer ) )
+			{
+				FUNC_NOTIFY( "CMuli3DDevice::PreRender: couldn't access colorbuffer.\n" );
+				UnlockColorBuffers();
+				SAFE_RELEASE( pBuffer );
+				SAFE_RELEASE( pColorBuffer );
+				return resBuffer;
+			}
+
+			m_RenderInfo.iMRTFloats[iBuffer] = pBuffer->iGetFormatFloats();
+			m_RenderInfo.iMRTPitch[iBuffer] = pBuffer->iGetWidth() * m_RenderInfo.iSamples * m_RenderInfo.iMRTFloats[iBuffer];
+			++m_RenderInfo.iNumColorBuffers;
+			SAFE_RELEASE( pBuffer );
+		}
 	}
 	else
 	{
+		m_RenderInfo.iNumColorBuffers = 0;
 		m_RenderInfo.pFrameData = 0;
 		m_RenderInfo.iColorFloats = 0;
 		m_RenderInfo.iColorBufferPitch = 0;
 		m_RenderInfo.bColorWrite = false;
+		m_RenderInfo.BlendMode = m3dblend_opaque;
+		m_RenderInfo.bReadDestColor = false;
 	}
 
 	// Get depthbuffer-related states -----------------------------------------
@@ -1005,15 +1530,42 @@ result CMuli3DDevice::PreRender()
 		if( FUNC_FAILED( resBuffer ) )
 		{
 			FUNC_NOTIFY( "CMuli3DDevice::PreRender: couldn't access depthbuffer.\n" );
-			if( m_RenderInfo.pFrameData ) pColorBuffer->UnlockRect();
+			UnlockColorBuffers();
 			SAFE_RELEASE( pColorBuffer );
 			SAFE_RELEASE( pDepthBuffer );
 			return resBuffer;
 		}
 
-		m_RenderInfo.iDepthBufferPitch = pDepthBuffer->iGetWidth();
+		m_RenderInfo.iDepthBufferPitch = pDepthBuffer->iGetWidth() * m_RenderInfo.iSamples;
 		m_RenderInfo.DepthCompare = (m3dcmpfunc)m_iRenderStates[m3drs_zfunc];
 		m_RenderInfo.bDepthWrite = m_iRenderStates[m3drs_zwriteenable] ? true : false;
+
+		m_RenderInfo.bDepthBoundsTest = m_RenderInfo.fMinDepthBound > 0.0f || m_RenderInfo.fMaxDepthBound < 1.0f;
+		if( m_RenderInfo.bDepthBoundsTest )
+		{
+			// Tiles are classified when they are accessed first. A rejected tile stays rejected during
+			// the draw-call, because only pixels passing the depth bounds-test may update the depthbuffer.
+			m_RenderInfo.iDepthBoundsTilesX = ( pDepthBuffer->iGetWidth() + c_iDepthBoundsTileSize - 1 ) / c_iDepthBoundsTileSize;
+			const uint32 iNumTiles = m_RenderInfo.iDepthBoundsTilesX * ( ( pDepthBuffer->iGetHeight() + c_iDepthBoundsTileSize - 1 ) / c_iDepthBoundsTileSize );
+			if( iNumTiles > m_iNumDepthBoundsTiles )
+			{
+				SAFE_DELETE_ARRAY( m_pDepthBoundsTiles );
+				m_iNumDepthBoundsTiles = 0;
+
+				m_pDepthBoundsTiles = new uint8[iNumTiles];
+				if( !m_pDepthBoundsTiles )
+				{
+					UnlockColorBuffers();
+					pDepthBuffer->UnlockRect();
+					SAFE_RELEASE( pColorBuffer );
+					SAFE_RELEASE( pDepthBuffer );
+					return e_outofmemory;
+				}
+				m_iNumDepthBoundsTiles = iNumTiles;
+			}
+
+			memset( m_pDepthBoundsTiles, m3ddbt_unknown, iNumTiles );
+		}
 	}
 	else
 	{
@@ -1021,38 +1573,147 @@ result CMuli3DDevice::PreRender()
 		m_RenderInfo.iDepthBufferPitch = 0;
 		m_RenderInfo.DepthCompare = m3dcmp_always;
 		m_RenderInfo.bDepthWrite = false;
+		m_RenderInfo.bDepthBoundsTest = false;
 	}
 
 	SAFE_RELEASE( pColorBuffer );
 	SAFE_RELEASE( pDepthBuffer );
 
+	// Get stencilbuffer-related states ---------------------------------------
+	pStencilBuffer = m_iRenderStates[m3drs_stencilenable] ? m_pRenderTarget->pGetStencilBuffer() : 0;
+	if( pStencilBuffer )
+	{
+		pStencilBuffer->GetPointer( 0, 0, &m_RenderInfo.pStencilData );
+		m_RenderInfo.iStencilBufferPitch = pStencilBuffer->iGetWidth();
+		m_RenderInfo.bStencilTest = true;
+		m_RenderInfo.StencilCompare = (m3dcmpfunc)m_iRenderStates[m3drs_stencilfunc];
+		m_RenderInfo.iStencilRef = m_iRenderStates[m3drs_stencilref] & 0xff;
+		m_RenderInfo.iStencilMask = m_iRenderStates[m3drs_stencilmask] & 0xff;
+		m_RenderInfo.iStencilWriteMask = m_iRenderStates[m3drs_stencilwritemask] & 0xff;
+		m_RenderInfo.StencilFail = (m3dstencilop)m_iRenderStates[m3drs_stencilfail];
+		m_RenderInfo.StencilZFail = (m3dstencilop)m_iRenderStates[m3drs_stencilzfail];
+		m_RenderInfo.StencilPass = (m3dstencilop)m_iRenderStates[m3drs_stencilpass];
+	}
+	else
+	{
+		m_RenderInfo.pStencilData = 0;
+		m_RenderInfo.iStencilBufferPitch = 0;
+		m_RenderInfo.bStencilTest = false;
+	}
+
+	SAFE_RELEASE( pStencilBuffer );
+
 	// reset pixel-counter to 0
 	m_RenderInfo.iRenderedPixels = 0;
 
+	// If no color is written, the pixel shader only matters if it can kill pixels
+	// or output depth - otherwise render depth only and skip it altogether.
+	m_RenderInfo.bDepthOnly = !m_RenderInfo.bColorWrite && ( !m_pPixelShader ||
+		( m_pPixelShader->GetShaderOutput() == m3dpso_coloronly && !m_pPixelShader->bMightKillPixels() ) );
+
 	// Depending on m_pPixelShader->GetShaderOutput() chose the appropriate
 	// RasterizeScanline-function and assign it to the function pointer
-	switch( m_pPixelShader->GetShaderOutput() )
+	if( m_RenderInfo.bDepthOnly )
+	{
+		// Triangles call RasterizeScanline_DepthOnly() directly.
+		m_RenderInfo.fpRasterizeScanline = 0;
+		m_RenderInfo.fpDrawPixel = &CMuli3DDevice::DrawPixel_DepthOnly;
+		m_RenderInfo.bEarlyDepthTest = true;
+		m_RenderInfo.bMightKillPixels = false;
+
+		// No register has to be interpolated, neither during clipping nor during rasterization.
+		for( uint32 iReg = 0; iReg < c_iPixelShaderRegisters; ++iReg )
+			m_RenderInfo.VSOutputs[iReg] = m3dsrt_unused;
+	}
+	else switch( m_pPixelShader->GetShaderOutput() )
 	{
 	case m3dpso_coloronly:
 		m_RenderInfo.fpRasterizeScanline = m_pPixelShader->bMightKillPixels() ? &CMuli3DDevice::RasterizeScanline_ColorOnly_MightKillPixels : &CMuli3DDevice::RasterizeScanline_ColorOnly;
 		m_RenderInfo.fpDrawPixel = &CMuli3DDevice::DrawPixel_ColorOnly;
+		m_RenderInfo.bEarlyDepthTest = true;
+		m_RenderInfo.bMightKillPixels = m_pPixelShader->bMightKillPixels();
 		break;
 	case m3dpso_colordepth:
 		m_RenderInfo.fpRasterizeScanline = &CMuli3DDevice::RasterizeScanline_ColorDepth;
 		m_RenderInfo.fpDrawPixel = &CMuli3DDevice::DrawPixel_ColorDepth;
+		m_RenderInfo.bEarlyDepthTest = false;
+		m_RenderInfo.bMightKillPixels = true;
 		break;
 	default: FUNC_FAILING( "CMuli3DDevice::PreRender: type of pixelshader is invalid.\n" ); return e_invalidstate;
 	}
 
+	// Collect the shader register components, whose gradients are computed during triangle setup.
+	m_RenderInfo.iNumSetupComponents = 0;
+	for( uint32 iReg = 0; iReg < c_iPixelShaderRegisters; ++iReg )
+	{
+		uint32 iComponents;
+		switch( m_RenderInfo.VSOutputs[iReg] )
+		{
+		case m3dsrt_float32: iComponents = 1; break;
+		case m3dsrt_vector2: iComponents = 2; break;
+		case m3dsrt_vector3: iComponents = 3; break;
+		case m3dsrt_vector4: iComponents = 4; break;
+		default: iComponents = 0; break;
+		}
+
+		for( uint32 iComponent = 0; iComponent < iComponents; ++iComponent )
+			m_RenderInfo.iSetupComponents[m_RenderInfo.iNumSetupComponents++] = iReg * 4 + iComponent;
+	}
+
+	// Multisampled rendertargets are drawn by RasterizeTriangle_MultiSample() and DrawPixel_MultiSample().
+	for( uint32 iSample = 0; iSample < m_RenderInfo.iSamples; ++iSample )
+		CMuli3DSurface::GetSamplePosition( m_RenderInfo.iSamples, iSample, m_RenderInfo.fSampleOffsets[iSample][0], m_RenderInfo.fSampleOffsets[iSample][1] );
+
+	if( m_RenderInfo.iSamples > 1 )
+		m_RenderInfo.fpDrawPixel = &CMuli3DDevice::DrawPixel_MultiSample;
+
+	// Get interleave-related states ------------------------------------------
+	m_RenderInfo.Interleave = m_RenderInfo.bDepthOnly ? m3dil_none : (m3dinterleave)m_iRenderStates[m3drs_interleave];
+	m_RenderInfo.iInterleavePhase = m_iRenderStates[m3drs_interleavephase] % CMuli3DSurface::iGetInterleavePhases( m_RenderInfo.Interleave );
+
+	// Get shading rate-related states ----------------------------------------
+	m_RenderInfo.pShadingRateData = 0;
+	m_RenderInfo.iShadingRate = m_iRenderStates[m3drs_shadingrate];
+	m_RenderInfo.bCoarseShading = ( m_RenderInfo.iShadingRate != m3dsr_1x1 || m_pShadingRateImage ) &&
+		!m_RenderInfo.bDepthOnly && m_RenderInfo.iSamples == 1 && m_iRenderStates[m3drs_fillmode] == m3dfill_solid &&
+		m_RenderInfo.Interleave == m3dil_none;
+	m_RenderInfo.bCoarseRowPending = false;
+	if( m_RenderInfo.bCoarseShading && m_pShadingRateImage )
+	{
+		if( m_pShadingRateImage->iGetWidth() * c_iShadingRateTileSize < m_RenderInfo.ViewportRect.iRight ||
+			m_pShadingRateImage->iGetHeight() * c_iShadingRateTileSize < m_RenderInfo.ViewportRect.iBottom )
+		{
+			FUNC_FAILING( "CMuli3DDevice::PreRender: shading rate image doesn't cover the viewport.\n" );
+			PostRender();
+			return e_invalidstate;
+		}
+
+		float32 *pShadingRateData;
+		result resImage = m_pShadingRateImage->LockRect( (void **)&pShadingRateData, 0 );
+		if( FUNC_FAILED( resImage ) )
+		{
+			FUNC_NOTIFY( "CMuli3DDevice::PreRender: couldn't access shading rate image.\n" );
+			PostRender();
+			return resImage;
+		}
+
+		m_RenderInfo.pShadingRateData = pShadingRateData;
+		m_RenderInfo.iShadingRateImageWidth = m_pShadingRateImage->iGetWidth();
+	}
+
 	// Initialize shaders' pointer to the rendering device --------------------
 	// have to do this right before drawing and not at set-time, because a shader
 	// may be used with different devices ...
 	m_pVertexShader->SetDevice( this );
 	if( m_pTriangleShader ) m_pTriangleShader->SetDevice( this );
-	m_pPixelShader->SetDevice( this );
+	if( m_pPixelShader ) m_pPixelShader->SetDevice( this );
 
 	// Initialize pixel shader's pointers to info structures ------------------
-	m_pPixelShader->SetInfo( m_RenderInfo.VSOutputs, &m_TriangleInfo );
+	m_TriangleInfo.iLODGranularity = m_iRenderStates[m3drs_lodgranularity];
+	m_TriangleInfo.bQuadShading = m_iRenderStates[m3drs_quadshadingenable] && m_iRenderStates[m3drs_fillmode] == m3dfill_solid && !m_RenderInfo.bDepthOnly && m_RenderInfo.iSamples == 1 && !m_RenderInfo.bCoarseShading &&
+		m_RenderInfo.Interleave == m3dil_none;
+	m_RenderInfo.bQuadRowPending = false;
+	if( m_pPixelShader ) m_pPixelShader->SetInfo( m_RenderInfo.VSOutputs, &m_TriangleInfo );
 
 	// Initialize vertex cache ------------------------------------------------
 	m_iNumValidCacheEntries = 0;
@@ -1063,14 +1724,22 @@ result CMuli3DDevice::PreRender()
 
 void CMuli3DDevice::PostRender()
 {
-	if( m_RenderInfo.pFrameData )
-	{
-		CMuli3DSurface *pColorBuffer = m_pRenderTarget->pGetColorBuffer();
+	// Tessellate the triangles, which are still queued for subdivision, and free the shared edge vertices.
+	if( m_iNumSubdivisionPatches )
+		SubdivideTriangleBatch();
 
-		if( pColorBuffer )
-			pColorBuffer->UnlockRect();
+	ClearSubdivisionCache();
 
-		SAFE_RELEASE( pColorBuffer );
+	// Rasterize the triangles, which are still awaiting triangle setup.
+	if( m_iNumSetupTriangles )
+		SetupTriangleBatch();
+
+	UnlockColorBuffers();
+
+	if( m_RenderInfo.pShadingRateData )
+	{
+		m_pShadingRateImage->UnlockRect();
+		m_RenderInfo.pShadingRateData = 0;
 	}
 
 	if( m_RenderInfo.pDepthData )
@@ -1084,6 +1753,21 @@ void CMuli3DDevice::PostRender()
 	}
 }
 
+void CMuli3DDevice::UnlockColorBuffers()
+{
+	for( uint32 iBuffer = 0; iBuffer < m_RenderInfo.iNumColorBuffers; ++iBuffer )
+	{
+		CMuli3DSurface *pColorBuffer = m_pRenderTarget->pGetColorBuffer( iBuffer );
+
+		if( pColorBuffer )
+			pColorBuffer->UnlockRect();
+
+		SAFE_RELEASE( pColorBuffer );
+	}
+
+	m_RenderInfo.iNumColorBuffers = 0;
+}
+
 result CMuli3DDevice::DecodeVertexStream( m3dvsinput &o_VertexShaderInput, uint32 i_iVertex )
 {
 	const byte *pVertex[c_iMaxVertexStreams];
@@ -1187,16 +1871,25 @@ result CMuli3DDevice::FetchVertex( m3dvertexcacheentry **io_ppVertex, uint32 i_i
 	return s_ok;
 }
 
-inline void CMuli3DDevice::ProcessTriangle( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
+inline void CMuli3DDevice::ProcessTriangle( const m3dvertexcacheentry *i_pVertex0, const m3dvertexcacheentry *i_pVertex1, const m3dvertexcacheentry *i_pVertex2 )
 {
-	switch( m_iRenderStates[m3drs_subdivisionmode] )
+	if( m_iRenderStates[m3drs_subdivisionmode] == m3dsubdiv_none )
 	{
-	case m3dsubdiv_none: DrawTriangle( i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 ); break;
-	case m3dsubdiv_simple: SubdivideTriangle_Simple( 0, i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 ); break;
-	case m3dsubdiv_smooth: SubdivideTriangle_Smooth( 0, i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 ); break;
-	case m3dsubdiv_adaptive: SubdivideTriangle_Adaptive( i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 ); break;
-	default: /* cannot happen */ break;
+		DrawTriangle( &i_pVertex0->VertexOutput, &i_pVertex1->VertexOutput, &i_pVertex2->VertexOutput );
+		return;
+	}
+
+	// Queue the triangle for subdivision: copy its vertices, because the vertex cache entries may be replaced before the batch is tessellated.
+	subdivpatch &Patch = m_SubdivisionPatches[m_iNumSubdivisionPatches];
+	const m3dvertexcacheentry *pVertices[3] = { i_pVertex0, i_pVertex1, i_pVertex2 };
+	for( uint32 iVertex = 0; iVertex < 3; ++iVertex )
+	{
+		Patch.VSOutputs[iVertex] = pVertices[iVertex]->VertexOutput;
+		Patch.iVertexIndices[iVertex] = pVertices[iVertex]->iVertexIndex;
 	}
+
+	if( ++m_iNumSubdivisionPatches == c_iSubdivisionBatchSize )
+		SubdivideTriangleBatch();
 }
 
 result CMuli3DDevice::DrawPrimitive( m3dprimitivetype i_PrimitiveType, uint32 i_iStartVertex, uint32 i_iPrimitiveCount )
@@ -1238,9 +1931,9 @@ result CMuli3DDevice::DrawPrimitive( m3dprimitivetype i_PrimitiveType, uint32 i_
 		}
 
 		if( bFlip )
-			ProcessTriangle( &pVertices[0]->VertexOutput, &pVertices[2]->VertexOutput, &pVertices[1]->VertexOutput );
+			ProcessTriangle( pVertices[0], pVertices[2], pVertices[1] );
 		else
-			ProcessTriangle( &pVertices[0]->VertexOutput, &pVertices[1]->VertexOutput, &pVertices[2]->VertexOutput );
+			ProcessTriangle( pVertices[0], pVertices[1], pVertices[2] );
 
 		// Prepare vertex-indices for the next triangle ...
 		switch( i_PrimitiveType )
@@ -1327,9 +2020,9 @@ result CMuli3DDevice::DrawIndexedPrimitive( m3dprimitivetype i_PrimitiveType, in
 		}
 
 		if( bFlip )
-			ProcessTriangle( &pVertices[0]->VertexOutput, &pVertices[2]->VertexOutput, &pVertices[1]->VertexOutput );
+			ProcessTriangle( pVertices[0], pVertices[2], pVertices[1] );
 		else
-			ProcessTriangle( &pVertices[0]->VertexOutput, &pVertices[1]->VertexOutput, &pVertices[2]->VertexOutput );
+			ProcessTriangle( pVertices[0], pVertices[1], pVertices[2] );
 
 		// Prepare vertex-indices for the next triangle ...
 		switch( i_PrimitiveType )
@@ -1411,9 +2104,9 @@ result CMuli3DDevice::DrawDynamicPrimitive( uint32 i_iStartVertex, uint32 i_iNum
 		}
 
 		if( bFlip )
-			ProcessTriangle( &pVertices[0]->VertexOutput, &pVertices[2]->VertexOutput, &pVertices[1]->VertexOutput );
+			ProcessTriangle( pVertices[0], pVertices[2], pVertices[1] );
 		else
-			ProcessTriangle( &pVertices[0]->VertexOutput, &pVertices[1]->VertexOutput, &pVertices[2]->VertexOutput );
+			ProcessTriangle( pVertices[0], pVertices[1], pVertices[2] );
 
 		// Prepare vertex-indices for the next triangle ...
 		switch( PrimitiveType )
@@ -1555,115 +2248,263 @@ inline void CMuli3DDevice::ProjectVertex( m3dvsoutput *io_pVSOutput )
 
 // TRIANGLES ------------------------------------------------------------------
 
-void CMuli3DDevice::SubdivideTriangle_Simple( uint32 i_iSubdivisionLevel, const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
+void CMuli3DDevice::SubdivideTriangleBatch()
 {
-	// In case the triangle has been subdivided to the requested level, draw it ...
-	if( i_iSubdivisionLevel >= m_iRenderStates[m3drs_subdivisionlevels] )
+	// Tessellate the queued triangles in parallel; this only reads device-state ...
+	ParallelFor( m_iNumSubdivisionPatches, c_iMinSubdivisionPatchesPerThread, SubdivideTriangleRange, this );
+
+	// ... and draw the generated triangles in submission order.
+	for( uint32 iPatch = 0; iPatch < m_iNumSubdivisionPatches; ++iPatch )
 	{
-		DrawTriangle( i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 );
-		return;
+		subdivpatch &Patch = m_SubdivisionPatches[iPatch];
+		for( uint32 iVertex = 0; iVertex < (uint32)Patch.Triangles.size(); iVertex += 3 )
+			DrawTriangle( Patch.Triangles[iVertex], Patch.Triangles[iVertex + 1], Patch.Triangles[iVertex + 2] );
+
+		Patch.Triangles.clear();
+		ClearSubdivisionVertexCache( Patch.InnerVertices );
 	}
 
-	++i_iSubdivisionLevel;
+	m_iNumSubdivisionPatches = 0;
 
-	// Generate three new vertices: in the middle of each edge
-	// Interpolate inputs for the new vertices (we're splitting the triangle's edges)
-	m3dvsoutput NewVSOutputs[3];
-	InterpolateVertexShaderInput( &NewVSOutputs[0].SourceInput, &i_pVSOutput0->SourceInput, &i_pVSOutput1->SourceInput, 0.5f ); // Edge between v0 and v1
-	InterpolateVertexShaderInput( &NewVSOutputs[1].SourceInput, &i_pVSOutput1->SourceInput, &i_pVSOutput2->SourceInput, 0.5f ); // Edge between v0 and v1
-	InterpolateVertexShaderInput( &NewVSOutputs[2].SourceInput, &i_pVSOutput2->SourceInput, &i_pVSOutput0->SourceInput, 0.5f ); // Edge between v0 and v1
+	// Shared edge vertices are mostly reused by triangles submitted shortly after each other, so the cache is bounded instead of growing with the draw-call.
+	uint32 iNumCachedVertices = 0;
+	for( uint32 iShard = 0; iShard < c_iSubdivisionCacheShards; ++iShard )
+		iNumCachedVertices += m_SubdivisionCache[iShard].Vertices.iNumVertices;
 
-	// Calculate new vertex shader outputs ------------------------------------
-	m3dvsoutput *pCurVSOutput = NewVSOutputs;
-	for( uint32 i = 0; i < 3; ++i, ++pCurVSOutput )
-		m_pVertexShader->Execute( pCurVSOutput->SourceInput.ShaderInputs, pCurVSOutput->vPosition, pCurVSOutput->ShaderOutputs );
+	if( iNumCachedVertices > c_iSubdivisionCacheSize )
+		ClearSubdivisionCache();
+}
 
-	SubdivideTriangle_Simple( i_iSubdivisionLevel, i_pVSOutput0, &NewVSOutputs[0], &NewVSOutputs[2] );
-	SubdivideTriangle_Simple( i_iSubdivisionLevel, i_pVSOutput1, &NewVSOutputs[1], &NewVSOutputs[0] );
-	SubdivideTriangle_Simple( i_iSubdivisionLevel, i_pVSOutput2, &NewVSOutputs[2], &NewVSOutputs[1] );
-	SubdivideTriangle_Simple( i_iSubdivisionLevel, &NewVSOutputs[0], &NewVSOutputs[1], &NewVSOutputs[2] );
+void CMuli3DDevice::ClearSubdivisionCache()
+{
+	for( uint32 iShard = 0; iShard < c_iSubdivisionCacheShards; ++iShard )
+		ClearSubdivisionVertexCache( m_SubdivisionCache[iShard].Vertices );
 }
 
-void CMuli3DDevice::SubdivideTriangle_Smooth( uint32 i_iSubdivisionLevel, const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
+void CMuli3DDevice::ClearSubdivisionVertexCache( subdivvertexcache &io_Cache )
 {
-	static const float32 c_fMultDivideBySix = 1.0f / 6.0f;
+	if( io_Cache.iNumEntries )
+	{
+		memset( &io_Cache.Entries[0], 0, sizeof( subdivcacheentry ) * io_Cache.Entries.size() );
+		io_Cache.iNumEntries = 0;
+	}
 
-	// In case the triangle has been subdivided to the requested level, draw it ...
-	if( i_iSubdivisionLevel >= m_iRenderStates[m3drs_subdivisionlevels] )
+	io_Cache.iNumVertices = 0;
+}
+
+const m3dvsoutput *CMuli3DDevice::pFindSubdivisionVertex( const subdivvertexcache &i_Cache, const uint32 *i_pKey )
+{
+	if( !i_Cache.iNumEntries )
+		return 0;
+
+	// The hash table is at most half full, so there is always an empty entry ending the search.
+	const uint32 iMask = (uint32)i_Cache.Entries.size() - 1;
+	for( uint32 iEntry = iHashSubdivisionKey( i_pKey ) & iMask; ; iEntry = ( iEntry + 1 ) & iMask )
 	{
-		DrawTriangle( i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 );
-		return;
+		const subdivcacheentry &Entry = i_Cache.Entries[iEntry];
+		if( !Entry.pVSOutput )
+			return 0;
+
+		if( Entry.iKey[0] == i_pKey[0] && Entry.iKey[1] == i_pKey[1] && Entry.iKey[2] == i_pKey[2] )
+			return Entry.pVSOutput;
+	}
+}
+
+void CMuli3DDevice::InsertSubdivisionVertex( subdivvertexcache &io_Cache, const uint32 *i_pKey, const m3dvsoutput *i_pVSOutput )
+{
+	if( ( io_Cache.iNumEntries + 1 ) * 2 > (uint32)io_Cache.Entries.size() )
+	{
+		// Double the size of the hash table and re-insert the entries.
+		std::vector<subdivcacheentry> Entries( io_Cache.Entries.size() ? io_Cache.Entries.size() * 2 : 64 );
+		Entries.swap( io_Cache.Entries );
+		io_Cache.iNumEntries = 0;
+
+		for( uint32 iEntry = 0; iEntry < (uint32)Entries.size(); ++iEntry )
+		{
+			if( Entries[iEntry].pVSOutput )
+				InsertSubdivisionVertex( io_Cache, Entries[iEntry].iKey, Entries[iEntry].pVSOutput );
+		}
 	}
 
-	++i_iSubdivisionLevel;
+	const uint32 iMask = (uint32)io_Cache.Entries.size() - 1;
+	uint32 iEntry = iHashSubdivisionKey( i_pKey ) & iMask;
+	while( io_Cache.Entries[iEntry].pVSOutput )
+		iEntry = ( iEntry + 1 ) & iMask;
 
-	// Generate three new vertices: in the middle of each edge
-	// Interpolate inputs for the new vertices (we're splitting the triangle's edges)
-	m3dvsoutput NewVSOutputs[3];
-	InterpolateVertexShaderInput( &NewVSOutputs[0].SourceInput, &i_pVSOutput0->SourceInput, &i_pVSOutput1->SourceInput, 0.5f ); // Edge between v0 and v1
-	InterpolateVertexShaderInput( &NewVSOutputs[1].SourceInput, &i_pVSOutput1->SourceInput, &i_pVSOutput2->SourceInput, 0.5f ); // Edge between v0 and v1
-	InterpolateVertexShaderInput( &NewVSOutputs[2].SourceInput, &i_pVSOutput2->SourceInput, &i_pVSOutput0->SourceInput, 0.5f ); // Edge between v0 and v1
+	subdivcacheentry &Entry = io_Cache.Entries[iEntry];
+	Entry.iKey[0] = i_pKey[0]; Entry.iKey[1] = i_pKey[1]; Entry.iKey[2] = i_pKey[2];
+	Entry.pVSOutput = i_pVSOutput;
+	++io_Cache.iNumEntries;
+}
 
-	// Offset positions using normals as a base ...
-	const uint32 iPos = m_iRenderStates[m3drs_subdivisionpositionregister];
-	const uint32 iNormal = m_iRenderStates[m3drs_subdivisionnormalregister];
+m3dvsoutput *CMuli3DDevice::pAllocateSubdivisionVertex( subdivvertexcache &io_Cache )
+{
+	const uint32 iChunk = io_Cache.iNumVertices / c_iSubdivisionVertexChunkSize;
+	if( iChunk == (uint32)io_Cache.Chunks.size() )
+		io_Cache.Chunks.push_back( new m3dvsoutput[c_iSubdivisionVertexChunkSize] );
 
-	// Normal-vectors should be re-normalized (they're not unit-length anymore due
-	// to linear-interpolation) for best results, but because the error is very small
-	// this step is skipped.
+	return &io_Cache.Chunks[iChunk][io_Cache.iNumVertices++ % c_iSubdivisionVertexChunkSize];
+}
 
-	const shaderreg *pShaderInputs[3] = { i_pVSOutput0->SourceInput.ShaderInputs,
-		i_pVSOutput1->SourceInput.ShaderInputs, i_pVSOutput2->SourceInput.ShaderInputs };
+void CMuli3DDevice::SubdivideTriangleRange( uint32 i_iBegin, uint32 i_iEnd, void *i_pUserData )
+{
+	CMuli3DDevice *pDevice = (CMuli3DDevice *)i_pUserData;
+	const uint32 iSubdivisionMode = pDevice->m_iRenderStates[m3drs_subdivisionmode];
+	const uint32 iOne = 1 << pDevice->m_iRenderStates[m3drs_subdivisionlevels];
 
-	// offset middle of edge between v0 and v1
+	for( uint32 iPatch = i_iBegin; iPatch < i_iEnd; ++iPatch )
 	{
-		const vector3 vNormalA = pShaderInputs[0][iNormal] * fVector3Dot( (vector3)pShaderInputs[1][iPos] - (vector3)pShaderInputs[0][iPos], pShaderInputs[0][iNormal] );
-		const vector3 vNormalB = pShaderInputs[1][iNormal] * fVector3Dot( (vector3)pShaderInputs[0][iPos] - (vector3)pShaderInputs[1][iPos], pShaderInputs[1][iNormal] );
-		vector4 &vPos = NewVSOutputs[0].SourceInput.ShaderInputs[iPos];
-		vPos -= (vNormalA + vNormalB) * c_fMultDivideBySix;
+		subdivpatch &Patch = pDevice->m_SubdivisionPatches[iPatch];
+
+		subdivvertex Vertices[3];
+		for( uint32 iVertex = 0; iVertex < 3; ++iVertex )
+		{
+			Vertices[iVertex].pVSOutput = &Patch.VSOutputs[iVertex];
+			Vertices[iVertex].iBarycentrics[0] = Vertices[iVertex].iBarycentrics[1] = Vertices[iVertex].iBarycentrics[2] = 0;
+			Vertices[iVertex].iBarycentrics[iVertex] = iOne;
+		}
+
+		switch( iSubdivisionMode )
+		{
+		case m3dsubdiv_simple: pDevice->SubdivideTriangle_Simple( Patch, 0, Vertices[0], Vertices[1], Vertices[2], false ); break;
+		case m3dsubdiv_smooth: pDevice->SubdivideTriangle_Simple( Patch, 0, Vertices[0], Vertices[1], Vertices[2], true ); break;
+		case m3dsubdiv_adaptive: pDevice->SubdivideTriangle_Adaptive( Patch, Vertices[0], Vertices[1], Vertices[2] ); break;
+		default: /* cannot happen */ break;
+		}
+	}
+}
+
+void CMuli3DDevice::GetEdgeVertex( subdivvertex &o_Vertex, subdivpatch &io_Patch, const subdivvertex &i_VertexA, const subdivvertex &i_VertexB, bool i_bSmooth )
+{
+	// Weights are multiples of a power of two until the requested level has been reached, so halving them is exact.
+	uint32 iOpposite = 3;
+	for( uint32 i = 0; i < 3; ++i )
+	{
+		o_Vertex.iBarycentrics[i] = ( i_VertexA.iBarycentrics[i] + i_VertexB.iBarycentrics[i] ) >> 1;
+		if( !o_Vertex.iBarycentrics[i] )
+			iOpposite = i;
 	}
 
-	// offset middle of edge between v1 and v2
+	if( iOpposite == 3 )
 	{
-		const vector3 vNormalA = pShaderInputs[1][iNormal] * fVector3Dot( (vector3)pShaderInputs[2][iPos] - (vector3)pShaderInputs[1][iPos], pShaderInputs[1][iNormal] );
-		const vector3 vNormalB = pShaderInputs[2][iNormal] * fVector3Dot( (vector3)pShaderInputs[1][iPos] - (vector3)pShaderInputs[2][iPos], pShaderInputs[2][iNormal] );
-		vector4 &vPos = NewVSOutputs[1].SourceInput.ShaderInputs[iPos];
-		vPos -= (vNormalA + vNormalB) * c_fMultDivideBySix;
+		// The vertex lies inside the input triangle: it is only shared by triangles of the same patch.
+		const uint32 iKey[3] = { o_Vertex.iBarycentrics[0], o_Vertex.iBarycentrics[1], 0 };
+		o_Vertex.pVSOutput = pFindSubdivisionVertex( io_Patch.InnerVertices, iKey );
+		if( !o_Vertex.pVSOutput )
+		{
+			m3dvsoutput *pVSOutput = pAllocateSubdivisionVertex( io_Patch.InnerVertices );
+			GenerateEdgeVertex( pVSOutput, i_VertexA.pVSOutput, i_VertexB.pVSOutput, i_bSmooth );
+			InsertSubdivisionVertex( io_Patch.InnerVertices, iKey, pVSOutput );
+			o_Vertex.pVSOutput = pVSOutput;
+		}
+		return;
 	}
 
-	// offset middle of edge between v2 and v0
+	// The vertex lies on an edge of the input triangle, which may be shared with an adjacent triangle:
+	// identify it by the edge's vertex indices and its position along the edge ...
+	uint32 iFirst = ( iOpposite + 1 ) % 3, iSecond = ( iOpposite + 2 ) % 3;
+	if( io_Patch.iVertexIndices[iSecond] < io_Patch.iVertexIndices[iFirst] )
 	{
-		const vector3 vNormalA = pShaderInputs[2][iNormal] * fVector3Dot( (vector3)pShaderInputs[0][iPos] - (vector3)pShaderInputs[2][iPos], pShaderInputs[2][iNormal] );
-		const vector3 vNormalB = pShaderInputs[0][iNormal] * fVector3Dot( (vector3)pShaderInputs[2][iPos] - (vector3)pShaderInputs[0][iPos], pShaderInputs[0][iNormal] );
-		vector4 &vPos = NewVSOutputs[2].SourceInput.ShaderInputs[iPos];
-		vPos -= (vNormalA + vNormalB) * c_fMultDivideBySix;
+		const uint32 iTemp = iFirst;
+		iFirst = iSecond; iSecond = iTemp;
 	}
 
-	// Calculate new vertex shader outputs ------------------------------------
-	m3dvsoutput *pCurVSOutput = NewVSOutputs;
-	for( uint32 i = 0; i < 3; ++i, ++pCurVSOutput )
-		m_pVertexShader->Execute( pCurVSOutput->SourceInput.ShaderInputs, pCurVSOutput->vPosition, pCurVSOutput->ShaderOutputs );
+	const uint32 iKey[3] = { io_Patch.iVertexIndices[iFirst], io_Patch.iVertexIndices[iSecond], o_Vertex.iBarycentrics[iSecond] };
+	subdivcacheshard &Shard = m_SubdivisionCache[( iHashSubdivisionKey( iKey ) >> 24 ) % c_iSubdivisionCacheShards];
 
-	SubdivideTriangle_Smooth( i_iSubdivisionLevel, i_pVSOutput0, &NewVSOutputs[0], &NewVSOutputs[2] );
-	SubdivideTriangle_Smooth( i_iSubdivisionLevel, i_pVSOutput1, &NewVSOutputs[1], &NewVSOutputs[0] );
-	SubdivideTriangle_Smooth( i_iSubdivisionLevel, i_pVSOutput2, &NewVSOutputs[2], &NewVSOutputs[1] );
-	SubdivideTriangle_Smooth( i_iSubdivisionLevel, &NewVSOutputs[0], &NewVSOutputs[1], &NewVSOutputs[2] );
+	Shard.Mutex.Lock();
+	o_Vertex.pVSOutput = pFindSubdivisionVertex( Shard.Vertices, iKey );
+	Shard.Mutex.Unlock();
+
+	if( o_Vertex.pVSOutput )
+		return;
+
+	// ... and always generate it starting at the end of the subdivided edge, which is closer to the edge's first vertex.
+	// This way adjacent triangles agree on the vertex bit for bit and no cracks can open up between them, even if the vertex has been evicted from the cache.
+	// The vertex shader is executed without holding the lock; in case another thread has generated the vertex in the meantime, its copy is used.
+	const bool bSwap = i_VertexB.iBarycentrics[iSecond] < i_VertexA.iBarycentrics[iSecond];
+	m3dvsoutput VSOutput;
+	GenerateEdgeVertex( &VSOutput, bSwap ? i_VertexB.pVSOutput : i_VertexA.pVSOutput,
+		bSwap ? i_VertexA.pVSOutput : i_VertexB.pVSOutput, i_bSmooth );
+
+	Shard.Mutex.Lock();
+	o_Vertex.pVSOutput = pFindSubdivisionVertex( Shard.Vertices, iKey );
+	if( !o_Vertex.pVSOutput )
+	{
+		m3dvsoutput *pVSOutput = pAllocateSubdivisionVertex( Shard.Vertices );
+		*pVSOutput = VSOutput;
+		InsertSubdivisionVertex( Shard.Vertices, iKey, pVSOutput );
+		o_Vertex.pVSOutput = pVSOutput;
+	}
+	Shard.Mutex.Unlock();
 }
 
-void CMuli3DDevice::SubdivideTriangle_Adaptive_SubdivideInnerPart( uint32 i_iSubdivisionLevel, const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
+void CMuli3DDevice::GenerateEdgeVertex( m3dvsoutput *o_pVSOutput, const m3dvsoutput *i_pVSOutputA, const m3dvsoutput *i_pVSOutputB, bool i_bSmooth )
 {
-	static const float32 c_fMultDivideByThree = 1.0f / 3.0f;
+	static const float32 c_fMultDivideBySix = 1.0f / 6.0f;
 
-	// Info about i_iSubdivisionLevel: here we are counting the maximum inner subdivisions
-	if( i_iSubdivisionLevel >= m_iRenderStates[m3drs_subdivisionmaxinnerlevels] )
+	// Interpolate inputs for the new vertex (we're splitting the edge)
+	InterpolateVertexShaderInput( &o_pVSOutput->SourceInput, &i_pVSOutputA->SourceInput, &i_pVSOutputB->SourceInput, 0.5f );
+
+	if( i_bSmooth )
+	{
+		// Offset position using normals as a base ...
+		const uint32 iPos = m_iRenderStates[m3drs_subdivisionpositionregister];
+		const uint32 iNormal = m_iRenderStates[m3drs_subdivisionnormalregister];
+
+		// Normal-vectors should be re-normalized (they're not unit-length anymore due
+		// to linear-interpolation) for best results, but because the error is very small
+		// this step is skipped.
+
+		const shaderreg *pShaderInputsA = i_pVSOutputA->SourceInput.ShaderInputs;
+		const shaderreg *pShaderInputsB = i_pVSOutputB->SourceInput.ShaderInputs;
+
+		const vector3 vNormalA = pShaderInputsA[iNormal] * fVector3Dot( (vector3)pShaderInputsB[iPos] - (vector3)pShaderInputsA[iPos], pShaderInputsA[iNormal] );
+		const vector3 vNormalB = pShaderInputsB[iNormal] * fVector3Dot( (vector3)pShaderInputsA[iPos] - (vector3)pShaderInputsB[iPos], pShaderInputsB[iNormal] );
+		vector4 &vPos = o_pVSOutput->SourceInput.ShaderInputs[iPos];
+		vPos -= (vNormalA + vNormalB) * c_fMultDivideBySix;
+	}
+
+	// Calculate new vertex shader outputs
+	m_pVertexShader->Execute( o_pVSOutput->SourceInput.ShaderInputs, o_pVSOutput->vPosition, o_pVSOutput->ShaderOutputs );
+}
+
+void CMuli3DDevice::SubdivideTriangle_Simple( subdivpatch &io_Patch, uint32 i_iSubdivisionLevel, const subdivvertex &i_Vertex0, const subdivvertex &i_Vertex1, const subdivvertex &i_Vertex2, bool i_bSmooth )
+{
+	// In case the triangle has been subdivided to the requested level, emit it ...
+	if( i_iSubdivisionLevel >= m_iRenderStates[m3drs_subdivisionlevels] )
 	{
-		DrawTriangle( i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 );
+		io_Patch.Triangles.push_back( i_Vertex0.pVSOutput );
+		io_Patch.Triangles.push_back( i_Vertex1.pVSOutput );
+		io_Patch.Triangles.push_back( i_Vertex2.pVSOutput );
 		return;
 	}
 
+	++i_iSubdivisionLevel;
+
+	// Generate three new vertices: in the middle of each edge
+	subdivvertex NewVertices[3];
+	GetEdgeVertex( NewVertices[0], io_Patch, i_Vertex0, i_Vertex1, i_bSmooth ); // Edge between v0 and v1
+	GetEdgeVertex( NewVertices[1], io_Patch, i_Vertex1, i_Vertex2, i_bSmooth ); // Edge between v1 and v2
+	GetEdgeVertex( NewVertices[2], io_Patch, i_Vertex2, i_Vertex0, i_bSmooth ); // Edge between v2 and v0
+
+	SubdivideTriangle_Simple( io_Patch, i_iSubdivisionLevel, i_Vertex0, NewVertices[0], NewVertices[2], i_bSmooth );
+	SubdivideTriangle_Simple( io_Patch, i_iSubdivisionLevel, i_Vertex1, NewVertices[1], NewVertices[0], i_bSmooth );
+	SubdivideTriangle_Simple( io_Patch, i_iSubdivisionLevel, i_Vertex2, NewVertices[2], NewVertices[1], i_bSmooth );
+	SubdivideTriangle_Simple( io_Patch, i_iSubdivisionLevel, NewVertices[0], NewVertices[1], NewVertices[2], i_bSmooth );
+}
+
+void CMuli3DDevice::SubdivideTriangle_Adaptive_SubdivideInnerPart( subdivpatch &io_Patch, uint32 i_iSubdivisionLevel, const subdivvertex &i_Vertex0, const subdivvertex &i_Vertex1, const subdivvertex &i_Vertex2 )
+{
+	static const float32 c_fMultDivideByThree = 1.0f / 3.0f;
+
+	// Info about i_iSubdivisionLevel: here we are counting the maximum inner subdivisions
+	bool bEmit = ( i_iSubdivisionLevel >= m_iRenderStates[m3drs_subdivisionmaxinnerlevels] );
+
 	// check area of triangle in screen space
+	if( !bEmit )
 	{
-		vector4 vPos[3] = { i_pVSOutput0->vPosition, i_pVSOutput1->vPosition, i_pVSOutput2->vPosition };
+		vector4 vPos[3] = { i_Vertex0.pVSOutput->vPosition, i_Vertex1.pVSOutput->vPosition, i_Vertex2.pVSOutput->vPosition };
 
 		for( uint32 iVertex = 0; iVertex < 3; ++iVertex )
 		{
@@ -1679,74 +2520,83 @@ void CMuli3DDevice::SubdivideTriangle_Adaptive_SubdivideInnerPart( uint32 i_iSub
 		vector3 vNormal; vVector3Cross( vNormal, v0To1, v0To2 );
 		const float32 fArea = 0.5f * vNormal.length();
 
-		if( fArea < INT_AS_FLOAT(m_iRenderStates[m3drs_subdivisionmaxscreenarea]) )
-		{
-			DrawTriangle( i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 );
-			return;
-		}
+		bEmit = ( fArea < INT_AS_FLOAT(m_iRenderStates[m3drs_subdivisionmaxscreenarea]) );
+	}
+
+	if( bEmit )
+	{
+		io_Patch.Triangles.push_back( i_Vertex0.pVSOutput );
+		io_Patch.Triangles.push_back( i_Vertex1.pVSOutput );
+		io_Patch.Triangles.push_back( i_Vertex2.pVSOutput );
+		return;
 	}
 
 	// Continue splitting: find center vertex and call SubdivideInnerPart for the three new vertices ...
 	++i_iSubdivisionLevel;
 
 	// Average inputs for the center vertex
-	const vector4 *pShaderInputs[3] = { i_pVSOutput0->SourceInput.ShaderInputs,
-		i_pVSOutput1->SourceInput.ShaderInputs, i_pVSOutput2->SourceInput.ShaderInputs };
+	const vector4 *pShaderInputs[3] = { i_Vertex0.pVSOutput->SourceInput.ShaderInputs,
+		i_Vertex1.pVSOutput->SourceInput.ShaderInputs, i_Vertex2.pVSOutput->SourceInput.ShaderInputs };
 
-	m3dvsoutput VSOutputCenter;
+	m3dvsoutput &VSOutputCenter = *pAllocateSubdivisionVertex( io_Patch.InnerVertices );
 	for( uint32 i = 0; i < c_iVertexShaderRegisters; ++i )
 		VSOutputCenter.SourceInput.ShaderInputs[i] = ( pShaderInputs[0][i] + pShaderInputs[1][i] + pShaderInputs[2][i] ) * c_fMultDivideByThree;
 
 	// call vertex shader
 	m_pVertexShader->Execute( VSOutputCenter.SourceInput.ShaderInputs, VSOutputCenter.vPosition, VSOutputCenter.ShaderOutputs );
 
+	subdivvertex VertexCenter;
+	VertexCenter.pVSOutput = &VSOutputCenter;
+	VertexCenter.iBarycentrics[0] = VertexCenter.iBarycentrics[1] = VertexCenter.iBarycentrics[2] = 0;
+
 	// split outer triangle-edges
-	SubdivideTriangle_Adaptive_SubdivideInnerPart( i_iSubdivisionLevel, i_pVSOutput0, i_pVSOutput1, &VSOutputCenter );
-	SubdivideTriangle_Adaptive_SubdivideInnerPart( i_iSubdivisionLevel, i_pVSOutput1, i_pVSOutput2, &VSOutputCenter );
-	SubdivideTriangle_Adaptive_SubdivideInnerPart( i_iSubdivisionLevel, i_pVSOutput2, i_pVSOutput0, &VSOutputCenter );
+	SubdivideTriangle_Adaptive_SubdivideInnerPart( io_Patch, i_iSubdivisionLevel, i_Vertex0, i_Vertex1, VertexCenter );
+	SubdivideTriangle_Adaptive_SubdivideInnerPart( io_Patch, i_iSubdivisionLevel, i_Vertex1, i_Vertex2, VertexCenter );
+	SubdivideTriangle_Adaptive_SubdivideInnerPart( io_Patch, i_iSubdivisionLevel, i_Vertex2, i_Vertex0, VertexCenter );
 }
 
-void CMuli3DDevice::SubdivideTriangle_Adaptive_SubdivideEdges( uint32 i_iSubdivisionLevel, const m3dvsoutput *i_pVSOutputEdge0, const m3dvsoutput *i_pVSOutputEdge1, const m3dvsoutput *i_pVSOutputCenter )
+void CMuli3DDevice::SubdivideTriangle_Adaptive_SubdivideEdges( subdivpatch &io_Patch, uint32 i_iSubdivisionLevel, const subdivvertex &i_VertexEdge0, const subdivvertex &i_VertexEdge1, const subdivvertex &i_VertexCenter )
 {
 	// In case the triangle-edges have been subdivided to the requested level, begin adaptive-subdivision of inner part
 	if( i_iSubdivisionLevel >= m_iRenderStates[m3drs_subdivisionlevels] )
 	{
-		SubdivideTriangle_Adaptive_SubdivideInnerPart( 0, i_pVSOutputEdge0, i_pVSOutputEdge1, i_pVSOutputCenter );
+		SubdivideTriangle_Adaptive_SubdivideInnerPart( io_Patch, 0, i_VertexEdge0, i_VertexEdge1, i_VertexCenter );
 		return;
 	}
 
 	++i_iSubdivisionLevel;
 
 	// split edge and call subdivideedges recursively
-	m3dvsoutput VSOutputMiddleEdge;
-	InterpolateVertexShaderInput( &VSOutputMiddleEdge.SourceInput, &i_pVSOutputEdge0->SourceInput, &i_pVSOutputEdge1->SourceInput, 0.5f ); // Edge between v0 and v1
-
-	// call vertex shader
-	m_pVertexShader->Execute( VSOutputMiddleEdge.SourceInput.ShaderInputs, VSOutputMiddleEdge.vPosition, VSOutputMiddleEdge.ShaderOutputs );
+	subdivvertex VertexMiddleEdge;
+	GetEdgeVertex( VertexMiddleEdge, io_Patch, i_VertexEdge0, i_VertexEdge1, false );
 
-	SubdivideTriangle_Adaptive_SubdivideEdges( i_iSubdivisionLevel, i_pVSOutputEdge0, &VSOutputMiddleEdge, i_pVSOutputCenter );
-	SubdivideTriangle_Adaptive_SubdivideEdges( i_iSubdivisionLevel, &VSOutputMiddleEdge, i_pVSOutputEdge1, i_pVSOutputCenter );
+	SubdivideTriangle_Adaptive_SubdivideEdges( io_Patch, i_iSubdivisionLevel, i_VertexEdge0, VertexMiddleEdge, i_VertexCenter );
+	SubdivideTriangle_Adaptive_SubdivideEdges( io_Patch, i_iSubdivisionLevel, VertexMiddleEdge, i_VertexEdge1, i_VertexCenter );
 }
 
-void CMuli3DDevice::SubdivideTriangle_Adaptive( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
+void CMuli3DDevice::SubdivideTriangle_Adaptive( subdivpatch &io_Patch, const subdivvertex &i_Vertex0, const subdivvertex &i_Vertex1, const subdivvertex &i_Vertex2 )
 {
 	static const float32 c_fMultDivideByThree = 1.0f / 3.0f;
 
 	// Average inputs for the center vertex
-	const shaderreg *pShaderInputs[3] = { i_pVSOutput0->SourceInput.ShaderInputs,
-		i_pVSOutput1->SourceInput.ShaderInputs, i_pVSOutput2->SourceInput.ShaderInputs };
+	const shaderreg *pShaderInputs[3] = { i_Vertex0.pVSOutput->SourceInput.ShaderInputs,
+		i_Vertex1.pVSOutput->SourceInput.ShaderInputs, i_Vertex2.pVSOutput->SourceInput.ShaderInputs };
 
-	m3dvsoutput VSOutputCenter;
+	m3dvsoutput &VSOutputCenter = *pAllocateSubdivisionVertex( io_Patch.InnerVertices );
 	for( uint32 i = 0; i < c_iVertexShaderRegisters; ++i )
 		VSOutputCenter.SourceInput.ShaderInputs[i] = ( pShaderInputs[0][i] + pShaderInputs[1][i] + pShaderInputs[2][i] ) * c_fMultDivideByThree;
 
 	// call vertex shader
 	m_pVertexShader->Execute( VSOutputCenter.SourceInput.ShaderInputs, VSOutputCenter.vPosition, VSOutputCenter.ShaderOutputs );
 
+	subdivvertex VertexCenter;
+	VertexCenter.pVSOutput = &VSOutputCenter;
+	VertexCenter.iBarycentrics[0] = VertexCenter.iBarycentrics[1] = VertexCenter.iBarycentrics[2] = 0;
+
 	// Split outer triangle-edges
-	SubdivideTriangle_Adaptive_SubdivideEdges( 0, i_pVSOutput0, i_pVSOutput1, &VSOutputCenter );
-	SubdivideTriangle_Adaptive_SubdivideEdges( 0, i_pVSOutput1, i_pVSOutput2, &VSOutputCenter );
-	SubdivideTriangle_Adaptive_SubdivideEdges( 0, i_pVSOutput2, i_pVSOutput0, &VSOutputCenter );
+	SubdivideTriangle_Adaptive_SubdivideEdges( io_Patch, 0, i_Vertex0, i_Vertex1, VertexCenter );
+	SubdivideTriangle_Adaptive_SubdivideEdges( io_Patch, 0, i_Vertex1, i_Vertex2, VertexCenter );
+	SubdivideTriangle_Adaptive_SubdivideEdges( io_Patch, 0, i_Vertex2, i_Vertex0, VertexCenter );
 }
 
 inline bool CMuli3DDevice::bCullTriangle( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
@@ -1774,34 +2624,122 @@ inline bool CMuli3DDevice::bCullTriangle( const m3dvsoutput *i_pVSOutput0, const
 	return false;
 }
 
-uint32 CMuli3DDevice::iClipToPlane( uint32 i_iNumVertices, uint32 i_iSrcIndex, const plane &i_plane, bool i_bHomogenous )
+bool CMuli3DDevice::bEarlyCullTriangle( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2, uint32 &o_iClipMask, bool &o_bFacingTested )
 {
-	m3dvsoutput **ppSrcVertices = m_pClipVertices[i_iSrcIndex];
-	m3dvsoutput **ppDestVertices = m_pClipVertices[(i_iSrcIndex + 1) & 1];
+	const vector4 *pPositions[3] = { &i_pVSOutput0->vPosition, &i_pVSOutput1->vPosition, &i_pVSOutput2->vPosition };
 
-	uint32 iNumClippedVertices = 0;
-	for( uint32 i = 0, j = 1; i < i_iNumVertices; ++i, ++j )
+	// Compute outcodes -------------------------------------------------------
+	// Bit i of a vertex' outcode is set if the vertex lies behind clipping plane i. The clipcode is built the same way,
+	// but uses the guard band planes in place of the left, right, top and bottom planes, because only those are clipped to.
+	uint32 iOutCodeAnd = m_RenderInfo.iClippingPlaneMask, iClipCodeOr = 0;
+	for( uint32 iVertex = 0; iVertex < 3; ++iVertex )
 	{
-		if( j == i_iNumVertices ) // wrap over
-			j = 0;
+		const vector4 &vPosition = *pPositions[iVertex];
 
-		float32 di, dj; // Distances of current and next vertex to clipping plane.
-		if( i_bHomogenous )
-		{
-			di = i_plane * ppSrcVertices[i]->vPosition;
-			dj = i_plane * ppSrcVertices[j]->vPosition;
-		}
-		else
-		{
-			di = i_plane * ( *(vector3 *)&ppSrcVertices[i]->vPosition );
-			dj = i_plane * ( *(vector3 *)&ppSrcVertices[j]->vPosition );
-		}
+		uint32 iOutCode = 0, iClipCode = 0;
+		for( uint32 iPlane = 0; iPlane < m3dcp_numplanes; ++iPlane )
+			iOutCode |= (uint32)( m_RenderInfo.ClippingPlanes[iPlane] * vPosition < 0.0f ) << iPlane;
+		for( uint32 iPlane = m3dcp_left; iPlane <= m3dcp_bottom; ++iPlane )
+			iClipCode |= (uint32)( m_RenderInfo.GuardBandPlanes[iPlane] * vPosition < 0.0f ) << iPlane;
 
-		if( di >= 0.0f )
-		{
-			ppDestVertices[iNumClippedVertices++] = ppSrcVertices[i];
-			if( dj < 0.0f )
-			{
+		iOutCodeAnd &= iOutCode;
+		iClipCodeOr |= iClipCode | ( iOutCode & ~( ( 1 << m3dcp_near ) - 1 ) );
+	}
+
+	// Trivial rejection: all vertices lie behind the same plane.
+	if( iOutCodeAnd )
+		return true;
+
+	// Trivial acceptance if the mask is 0: no vertex lies behind any of the planes that are clipped to.
+	o_iClipMask = iClipCodeOr & m_RenderInfo.iClippingPlaneMask;
+	o_bFacingTested = false;
+
+	// The remaining tests require all vertices to lie in front of the viewer, see ProjectVertex().
+	if( pPositions[0]->w < FLT_EPSILON || pPositions[1]->w < FLT_EPSILON || pPositions[2]->w < FLT_EPSILON )
+		return false;
+
+	// Do backface-culling using the homogeneous determinant ------------------
+	// As all w are positive, det( x y w ) has the sign of the triangle's orientation after projection. Its product
+	// with the viewport's orientation matches fDirTest of bCullTriangle().
+	const vector4 &v0 = *pPositions[0], &v1 = *pPositions[1], &v2 = *pPositions[2];
+	const float32 fDirTest = ( v0.x * ( v1.y * v2.w - v2.y * v1.w ) - v0.y * ( v1.x * v2.w - v2.x * v1.w ) +
+		v0.w * ( v1.x * v2.y - v2.x * v1.y ) ) * m_RenderInfo.fViewportOrientation;
+
+	switch( m_iRenderStates[m3drs_cullmode] )
+	{
+	case m3dcull_ccw: if( fDirTest <= 0.0f ) return true; o_bFacingTested = true; break;
+	case m3dcull_cw: if( fDirTest >= 0.0f ) return true; o_bFacingTested = true; break;
+	default: break;
+	}
+
+	// Wireframe triangles are drawn even if they cover no area.
+	if( m_iRenderStates[m3drs_fillmode] != m3dfill_solid )
+		return false;
+
+	if( fDirTest == 0.0f )
+		return true; // Zero-area triangle.
+
+	// Do small-primitive culling ---------------------------------------------
+	// Multisampled rasterization doesn't sample at pixel centers.
+	if( m_RenderInfo.iSamples > 1 )
+		return false;
+
+	// Project the vertices the same way ProjectVertex() does and compute their bounding box.
+	const matrix44 &matViewport = m_pRenderTarget->matGetViewportMatrix();
+	float32 fMin[2] = { FLT_MAX, FLT_MAX }, fMax[2] = { -FLT_MAX, -FLT_MAX };
+	for( uint32 iVertex = 0; iVertex < 3; ++iVertex )
+	{
+		const float32 fInvW = 1.0f / pPositions[iVertex]->w;
+		vector4 vScreen( pPositions[iVertex]->x * fInvW, pPositions[iVertex]->y * fInvW, pPositions[iVertex]->z * fInvW, 1.0f );
+		vScreen *= matViewport;
+
+		if( vScreen.x < fMin[0] ) fMin[0] = vScreen.x;
+		if( vScreen.x > fMax[0] ) fMax[0] = vScreen.x;
+		if( vScreen.y < fMin[1] ) fMin[1] = vScreen.y;
+		if( vScreen.y > fMax[1] ) fMax[1] = vScreen.y;
+	}
+
+	// The rasterizer covers the pixels [ceil(left),ceil(right)) of the scanlines [ceil(top),ceil(bottom)), restricted to the
+	// rasterization-rectangle. If the bounding box doesn't contain any of them, neither does the triangle.
+	const m3drect &RasterRect = m_RenderInfo.RasterRect;
+	const float32 fLeft = ( fMin[0] > (float32)RasterRect.iLeft ) ? fMin[0] : (float32)RasterRect.iLeft;
+	const float32 fRight = ( fMax[0] < (float32)RasterRect.iRight ) ? fMax[0] : (float32)RasterRect.iRight;
+	const float32 fTop = ( fMin[1] > (float32)RasterRect.iTop ) ? fMin[1] : (float32)RasterRect.iTop;
+	const float32 fBottom = ( fMax[1] < (float32)RasterRect.iBottom ) ? fMax[1] : (float32)RasterRect.iBottom;
+	if( ceilf( fLeft ) >= ceilf( fRight ) || ceilf( fTop ) >= ceilf( fBottom ) )
+		return true;
+
+	return false;
+}
+
+uint32 CMuli3DDevice::iClipToPlane( uint32 i_iNumVertices, uint32 i_iSrcIndex, const plane &i_plane, bool i_bHomogenous )
+{
+	m3dvsoutput **ppSrcVertices = m_pClipVertices[i_iSrcIndex];
+	m3dvsoutput **ppDestVertices = m_pClipVertices[(i_iSrcIndex + 1) & 1];
+
+	uint32 iNumClippedVertices = 0;
+	for( uint32 i = 0, j = 1; i < i_iNumVertices; ++i, ++j )
+	{
+		if( j == i_iNumVertices ) // wrap over
+			j = 0;
+
+		float32 di, dj; // Distances of current and next vertex to clipping plane.
+		if( i_bHomogenous )
+		{
+			di = i_plane * ppSrcVertices[i]->vPosition;
+			dj = i_plane * ppSrcVertices[j]->vPosition;
+		}
+		else
+		{
+			di = i_plane * ( *(vector3 *)&ppSrcVertices[i]->vPosition );
+			dj = i_plane * ( *(vector3 *)&ppSrcVertices[j]->vPosition );
+		}
+
+		if( di >= 0.0f )
+		{
+			ppDestVertices[iNumClippedVertices++] = ppSrcVertices[i];
+			if( dj < 0.0f )
+			{
 				InterpolateVertexShaderOutput( &m_ClipVertices[m_iNextFreeClipVertex], ppSrcVertices[i], ppSrcVertices[j], di / (di - dj) );
 				ppDestVertices[iNumClippedVertices++] = &m_ClipVertices[m_iNextFreeClipVertex];
 				m_iNextFreeClipVertex = ( m_iNextFreeClipVertex + 1 ) % 20; // TODO: 20 enough?
@@ -1833,6 +2771,12 @@ uint32 CMuli3DDevice::iClipToPlane( uint32 i_iNumVertices, uint32 i_iSrcIndex, c
 
 void CMuli3DDevice::DrawTriangle( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
 {
+	// Cull invisible triangles before they are copied, clipped and projected -
+	uint32 iClipMask;
+	bool bFacingTested;
+	if( bEarlyCullTriangle( i_pVSOutput0, i_pVSOutput1, i_pVSOutput2, iClipMask, bFacingTested ) )
+		return;
+
 	// Prepare triangle for homogenous clipping -------------------------------
 	uint32 iNumVertices = 3;
 	memcpy( &m_ClipVertices[0], i_pVSOutput0, sizeof( m3dvsoutput ) );
@@ -1856,12 +2800,15 @@ void CMuli3DDevice::DrawTriangle( const m3dvsoutput *i_pVSOutput0, const m3dvsou
 	}
 
 	// Perform clipping to the frustum planes ---------------------------------
-	for( uint32 iPlane = 0; iPlane < m3dcp_numplanes; ++iPlane )
+	// The rasterizer restricts triangles to the viewport, so instead of the left, right, top and bottom planes only the
+	// guard band planes are clipped to. Planes, which all vertices lie in front of, aren't part of the clip mask.
+	for( uint32 iPlane = 0; iClipMask; ++iPlane, iClipMask >>= 1 )
 	{
-		if( !m_RenderInfo.bClippingPlaneEnabled[iPlane] )
+		if( !( iClipMask & 1 ) )
 			continue;
 
-		iNumVertices = iClipToPlane( iNumVertices, iStage, m_RenderInfo.ClippingPlanes[iPlane], true );
+		const plane &plClip = ( iPlane <= m3dcp_bottom ) ? m_RenderInfo.GuardBandPlanes[iPlane] : m_RenderInfo.ClippingPlanes[iPlane];
+		iNumVertices = iClipToPlane( iNumVertices, iStage, plClip, true );
 		if( iNumVertices < 3 )
 			return;
 
@@ -1879,86 +2826,123 @@ void CMuli3DDevice::DrawTriangle( const m3dvsoutput *i_pVSOutput0, const m3dvsou
 	// We do not have to check for culling for each sub-polygon of the triangle, as they
 	// are all in the same plane. If the first polygon is culled then all other polygons
 	// would be culled, too.
-	if( bCullTriangle( ppSrc[0], ppSrc[1], ppSrc[2] ) )
+	if( !bFacingTested && bCullTriangle( ppSrc[0], ppSrc[1], ppSrc[2] ) )
 		return;
 
 	// Project the remaining vertices
 	for( iVertex = 3; iVertex < iNumVertices; ++iVertex )
 		ProjectVertex( ppSrc[iVertex] );
 
-	// Perform clipping (in screenspace) to the scissor rectangle if enabled --
-	if( m_iRenderStates[m3drs_scissortestenable] )
-	{
-		for( uint32 iPlane = 0; iPlane < 4; ++iPlane, iStage = ( iStage + 1 ) & 1 )
-		{
-			iNumVertices = iClipToPlane( iNumVertices, iStage, m_RenderInfo.ScissorPlanes[iPlane], false );
-			if( iNumVertices < 3 )
-				return;
-		}
+	// The scissor rectangle is part of the rasterization-rectangle, which the rasterizer restricts triangles to.
+	for( iVertex = 1; iVertex < iNumVertices - 1; ++iVertex )
+		SetupTriangle( ppSrc[0], ppSrc[iVertex], ppSrc[iVertex + 1] );
+}
 
-		// New source for rasterization after scissoring ...
-		ppSrc = m_pClipVertices[iStage];
+void CMuli3DDevice::SetupTriangle( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
+{
+	if( m_RenderInfo.bDepthBoundsTest && bDepthBoundsCullTriangle( i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 ) )
+		return;
+
+	// Copy the vertices: clipping and the vertex cache reuse their storage before the batch is set up.
+	const m3dvsoutput *pSrcVertices[3] = { i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 };
+	m3dvsoutput *pDestVertices = m_SetupVertices[m_iNumSetupTriangles];
+	m3dtrianglesetup &Setup = m_TriangleSetups[m_iNumSetupTriangles];
+	for( uint32 iVertex = 0; iVertex < 3; ++iVertex )
+	{
+		for( uint32 iRegister = 0; iRegister < c_iPixelShaderRegisters; ++iRegister )
+			pDestVertices[iVertex].ShaderOutputs[iRegister] = pSrcVertices[iVertex]->ShaderOutputs[iRegister];
+		pDestVertices[iVertex].vPosition = pSrcVertices[iVertex]->vPosition;
+		Setup.pVertices[iVertex] = &pDestVertices[iVertex];
 	}
 
-	for( iVertex = 1; iVertex < iNumVertices - 1; ++iVertex )
-		RasterizeTriangle( ppSrc[0], ppSrc[iVertex], ppSrc[iVertex + 1] );
+	if( ++m_iNumSetupTriangles == c_iTriangleSetupBatchSize )
+		SetupTriangleBatch();
 }
 
-void CMuli3DDevice::CalculateTriangleGradients( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
+void CMuli3DDevice::SetupTriangleBatch()
 {
-	const float32 fDeltaX[2] = { i_pVSOutput1->vPosition.x - i_pVSOutput0->vPosition.x, i_pVSOutput2->vPosition.x - i_pVSOutput0->vPosition.x };
-	const float32 fDeltaY[2] = { i_pVSOutput1->vPosition.y - i_pVSOutput0->vPosition.y, i_pVSOutput2->vPosition.y - i_pVSOutput0->vPosition.y };
-	m_TriangleInfo.fCommonGradient = 1.0f / ( fDeltaX[0] * fDeltaY[1] - fDeltaX[1] * fDeltaY[0] );
-	m_TriangleInfo.pBaseVertex = i_pVSOutput0;
+	const uint32 iNumTriangles = m_iNumSetupTriangles;
+	m_iNumSetupTriangles = 0;
+
+	// The batch is processed in structure-of-arrays form: values are gathered from the vertices into arrays indexed by
+	// triangle, so that the loops computing the gradients run over contiguous memory without branches and can be
+	// vectorized by the compiler. Results are scattered to the setup records afterwards.
+	float32 fDeltaX[2][c_iTriangleSetupBatchSize], fDeltaY[2][c_iTriangleSetupBatchSize];
+	float32 fDeltaZ[2][c_iTriangleSetupBatchSize], fDeltaW[2][c_iTriangleSetupBatchSize];
+	float32 fCommonGradient[c_iTriangleSetupBatchSize];
+	float32 fDdx[c_iTriangleSetupBatchSize], fDdy[c_iTriangleSetupBatchSize];
+
+	uint32 iTriangle;
+	for( iTriangle = 0; iTriangle < iNumTriangles; ++iTriangle )
+	{
+		const vector4 &vPos0 = m_TriangleSetups[iTriangle].pVertices[0]->vPosition;
+		const vector4 &vPos1 = m_TriangleSetups[iTriangle].pVertices[1]->vPosition;
+		const vector4 &vPos2 = m_TriangleSetups[iTriangle].pVertices[2]->vPosition;
+		fDeltaX[0][iTriangle] = vPos1.x - vPos0.x; fDeltaX[1][iTriangle] = vPos2.x - vPos0.x;
+		fDeltaY[0][iTriangle] = vPos1.y - vPos0.y; fDeltaY[1][iTriangle] = vPos2.y - vPos0.y;
+		fDeltaZ[0][iTriangle] = vPos1.z - vPos0.z; fDeltaZ[1][iTriangle] = vPos2.z - vPos0.z;
+		fDeltaW[0][iTriangle] = vPos1.w - vPos0.w; fDeltaW[1][iTriangle] = vPos2.w - vPos0.w;
+
+		// Computed here, because vectorized divisions are only approximated when compiling with -ffast-math.
+		fCommonGradient[iTriangle] = 1.0f / ( fDeltaX[0][iTriangle] * fDeltaY[1][iTriangle] - fDeltaX[1][iTriangle] * fDeltaY[0][iTriangle] );
+	}
 
 	// The derivatives with respect to the y-coordinate are negated, because in screen-space the y-axis is reversed.
 
-	const float32 fDeltaZ[2] = { i_pVSOutput1->vPosition.z - i_pVSOutput0->vPosition.z, i_pVSOutput2->vPosition.z - i_pVSOutput0->vPosition.z };
-	m_TriangleInfo.fZDdx = ( fDeltaZ[0] * fDeltaY[1] - fDeltaZ[1] * fDeltaY[0] ) * m_TriangleInfo.fCommonGradient;
-	m_TriangleInfo.fZDdy = -( fDeltaZ[0] * fDeltaX[1] - fDeltaZ[1] * fDeltaX[0] ) * m_TriangleInfo.fCommonGradient;
+	for( iTriangle = 0; iTriangle < iNumTriangles; ++iTriangle )
+	{
+		m3dtrianglesetup &Setup = m_TriangleSetups[iTriangle];
+		Setup.fCommonGradient = fCommonGradient[iTriangle];
+		Setup.fZDdx = ( fDeltaZ[0][iTriangle] * fDeltaY[1][iTriangle] - fDeltaZ[1][iTriangle] * fDeltaY[0][iTriangle] ) * fCommonGradient[iTriangle];
+		Setup.fZDdy = -( fDeltaZ[0][iTriangle] * fDeltaX[1][iTriangle] - fDeltaZ[1][iTriangle] * fDeltaX[0][iTriangle] ) * fCommonGradient[iTriangle];
+		Setup.fWDdx = ( fDeltaW[0][iTriangle] * fDeltaY[1][iTriangle] - fDeltaW[1][iTriangle] * fDeltaY[0][iTriangle] ) * fCommonGradient[iTriangle];
+		Setup.fWDdy = -( fDeltaW[0][iTriangle] * fDeltaX[1][iTriangle] - fDeltaW[1][iTriangle] * fDeltaX[0][iTriangle] ) * fCommonGradient[iTriangle];
+	}
+
+	// Shader register components are processed one after another across the batch, replacing the per-register switch.
+	for( uint32 iComponent = 0; iComponent < m_RenderInfo.iNumSetupComponents; ++iComponent )
+	{
+		const uint32 iOffset = m_RenderInfo.iSetupComponents[iComponent];
+
+		float32 fDeltaRegVal[2][c_iTriangleSetupBatchSize];
+		for( iTriangle = 0; iTriangle < iNumTriangles; ++iTriangle )
+		{
+			const float32 *pRegVal0 = (const float32 *)m_TriangleSetups[iTriangle].pVertices[0]->ShaderOutputs;
+			const float32 *pRegVal1 = (const float32 *)m_TriangleSetups[iTriangle].pVertices[1]->ShaderOutputs;
+			const float32 *pRegVal2 = (const float32 *)m_TriangleSetups[iTriangle].pVertices[2]->ShaderOutputs;
+			fDeltaRegVal[0][iTriangle] = pRegVal1[iOffset] - pRegVal0[iOffset];
+			fDeltaRegVal[1][iTriangle] = pRegVal2[iOffset] - pRegVal0[iOffset];
+		}
+
+		for( iTriangle = 0; iTriangle < iNumTriangles; ++iTriangle )
+		{
+			fDdx[iTriangle] = ( fDeltaRegVal[0][iTriangle] * fDeltaY[1][iTriangle] - fDeltaRegVal[1][iTriangle] * fDeltaY[0][iTriangle] ) * fCommonGradient[iTriangle];
+			fDdy[iTriangle] = -( fDeltaRegVal[0][iTriangle] * fDeltaX[1][iTriangle] - fDeltaRegVal[1][iTriangle] * fDeltaX[0][iTriangle] ) * fCommonGradient[iTriangle];
+		}
 
-	const float32 fDeltaW[2] = { i_pVSOutput1->vPosition.w - i_pVSOutput0->vPosition.w, i_pVSOutput2->vPosition.w - i_pVSOutput0->vPosition.w };
-	m_TriangleInfo.fWDdx = ( fDeltaW[0] * fDeltaY[1] - fDeltaW[1] * fDeltaY[0] ) * m_TriangleInfo.fCommonGradient;
-	m_TriangleInfo.fWDdy = -( fDeltaW[0] * fDeltaX[1] - fDeltaW[1] * fDeltaX[0] ) * m_TriangleInfo.fCommonGradient;
+		for( iTriangle = 0; iTriangle < iNumTriangles; ++iTriangle )
+		{
+			( (float32 *)m_TriangleSetups[iTriangle].ShaderOutputsDdx )[iOffset] = fDdx[iTriangle];
+			( (float32 *)m_TriangleSetups[iTriangle].ShaderOutputsDdy )[iOffset] = fDdy[iTriangle];
+		}
+	}
 
-	shaderreg *pDestDdx = m_TriangleInfo.ShaderOutputsDdx;
-	shaderreg *pDestDdy = m_TriangleInfo.ShaderOutputsDdy;
-	for( uint32 iReg = 0; iReg < c_iPixelShaderRegisters; ++iReg, ++pDestDdx, ++pDestDdy )
+	// Rasterize the triangles in the order they have been queued ------------
+	for( iTriangle = 0; iTriangle < iNumTriangles; ++iTriangle )
 	{
-		switch( m_RenderInfo.VSOutputs[iReg] )
+		const m3dtrianglesetup &Setup = m_TriangleSetups[iTriangle];
+		m_TriangleInfo.fCommonGradient = Setup.fCommonGradient;
+		m_TriangleInfo.pBaseVertex = Setup.pVertices[0];
+		m_TriangleInfo.fZDdx = Setup.fZDdx; m_TriangleInfo.fZDdy = Setup.fZDdy;
+		m_TriangleInfo.fWDdx = Setup.fWDdx; m_TriangleInfo.fWDdy = Setup.fWDdy;
+		for( uint32 iRegister = 0; iRegister < c_iPixelShaderRegisters; ++iRegister )
 		{
-		case m3dsrt_vector4:
-			{
-				const float32 fDeltaRegVal[2] = { i_pVSOutput1->ShaderOutputs[iReg].w - i_pVSOutput0->ShaderOutputs[iReg].w,
-					i_pVSOutput2->ShaderOutputs[iReg].w - i_pVSOutput0->ShaderOutputs[iReg].w };
-				pDestDdx->w = ( fDeltaRegVal[0] * fDeltaY[1] - fDeltaRegVal[1] * fDeltaY[0] ) * m_TriangleInfo.fCommonGradient;
-				pDestDdy->w = -( fDeltaRegVal[0] * fDeltaX[1] - fDeltaRegVal[1] * fDeltaX[0] ) * m_TriangleInfo.fCommonGradient;
-			}
-		case m3dsrt_vector3:
-			{
-				const float32 fDeltaRegVal[2] = { i_pVSOutput1->ShaderOutputs[iReg].z - i_pVSOutput0->ShaderOutputs[iReg].z,
-					i_pVSOutput2->ShaderOutputs[iReg].z - i_pVSOutput0->ShaderOutputs[iReg].z };
-				pDestDdx->z = ( fDeltaRegVal[0] * fDeltaY[1] - fDeltaRegVal[1] * fDeltaY[0] ) * m_TriangleInfo.fCommonGradient;
-				pDestDdy->z = -( fDeltaRegVal[0] * fDeltaX[1] - fDeltaRegVal[1] * fDeltaX[0] ) * m_TriangleInfo.fCommonGradient;
-			}
-		case m3dsrt_vector2:
-			{
-				const float32 fDeltaRegVal[2] = { i_pVSOutput1->ShaderOutputs[iReg].y - i_pVSOutput0->ShaderOutputs[iReg].y,
-					i_pVSOutput2->ShaderOutputs[iReg].y - i_pVSOutput0->ShaderOutputs[iReg].y };
-				pDestDdx->y = ( fDeltaRegVal[0] * fDeltaY[1] - fDeltaRegVal[1] * fDeltaY[0] ) * m_TriangleInfo.fCommonGradient;
-				pDestDdy->y = -( fDeltaRegVal[0] * fDeltaX[1] - fDeltaRegVal[1] * fDeltaX[0] ) * m_TriangleInfo.fCommonGradient;
-			}
-		case m3dsrt_float32:
-			{
-				const float32 fDeltaRegVal[2] = { i_pVSOutput1->ShaderOutputs[iReg].x - i_pVSOutput0->ShaderOutputs[iReg].x,
-					i_pVSOutput2->ShaderOutputs[iReg].x - i_pVSOutput0->ShaderOutputs[iReg].x };
-				pDestDdx->x = ( fDeltaRegVal[0] * fDeltaY[1] - fDeltaRegVal[1] * fDeltaY[0] ) * m_TriangleInfo.fCommonGradient;
-				pDestDdy->x = -( fDeltaRegVal[0] * fDeltaX[1] - fDeltaRegVal[1] * fDeltaX[0] ) * m_TriangleInfo.fCommonGradient;
-			}
-		case m3dsrt_unused:
-		default: // cannot happen
-			break;
+			m_TriangleInfo.ShaderOutputsDdx[iRegister] = Setup.ShaderOutputsDdx[iRegister];
+			m_TriangleInfo.ShaderOutputsDdy[iRegister] = Setup.ShaderOutputsDdy[iRegister];
 		}
+		++m_TriangleInfo.iGradientsID;
+
+		RasterizeTriangle( Setup.pVertices[0], Setup.pVertices[1], Setup.pVertices[2] );
 	}
 }
 
@@ -2028,8 +3012,6 @@ inline void CMuli3DDevice::StepXVSOutputFromGradient( m3dvsoutput *io_pVSOutput
 
 void CMuli3DDevice::RasterizeTriangle( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
 {
-	CalculateTriangleGradients( i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 );
-
 	// If in wireframe mode draw triangle edges as lines.
 	if( m_iRenderStates[m3drs_fillmode] == m3dfill_wireframe )
 	{
@@ -2039,6 +3021,12 @@ void CMuli3DDevice::RasterizeTriangle( const m3dvsoutput *i_pVSOutput0, const m3
 		return;
 	}
 
+	if( m_RenderInfo.iSamples > 1 )
+	{
+		RasterizeTriangle_MultiSample( i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 );
+		return;
+	}
+
 	// Sort vertices by y-coordinate ------------------------------------------
 	const m3dvsoutput *pVertices[3] = { i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 };
 	if( i_pVSOutput1->vPosition.y < pVertices[0]->vPosition.y ) { pVertices[1] = pVertices[0]; pVertices[0] = i_pVSOutput1; }
@@ -2058,9 +3046,10 @@ void CMuli3DDevice::RasterizeTriangle( const m3dvsoutput *i_pVSOutput0, const m3
 
 	// Begin rasterization ----------------------------------------------------
 	float32 fX[2] = { vA.x, vA.x };
+	const m3drect &RasterRect = m_RenderInfo.RasterRect;
 	for( uint32 iPart = 0; iPart < 2; ++iPart )
 	{
-		uint32 iY[2];
+		int32 iY[2];
 		float32 fDeltaX[2];
 
 		switch( iPart )
@@ -2109,241 +3098,1149 @@ void CMuli3DDevice::RasterizeTriangle( const m3dvsoutput *i_pVSOutput0, const m3
 			break;
 		}
 
+		// Restrict scanlines to the rasterization-rectangle: triangles within the guard band haven't been clipped to the viewport.
+		if( iY[0] < (int32)RasterRect.iTop )
+		{
+			const int32 iSkip = ( iY[1] < (int32)RasterRect.iTop ? iY[1] : (int32)RasterRect.iTop ) - iY[0];
+			if( iSkip > 0 )
+			{
+				iY[0] += iSkip;
+				fX[0] += fDeltaX[0] * iSkip;
+				fX[1] += fDeltaX[1] * iSkip;
+			}
+		}
+
+		if( iY[1] > (int32)RasterRect.iBottom )
+			iY[1] = RasterRect.iBottom;
+
 		for( ; iY[0] < iY[1]; ++iY[0], fX[0] += fDeltaX[0], fX[1] += fDeltaX[1] )
 		{
-			const int32 iX[2] = { ftol( ceilf( fX[0] ) ), ftol( ceilf( fX[1] ) ) };
+			int32 iX[2] = { ftol( ceilf( fX[0] ) ), ftol( ceilf( fX[1] ) ) };
 			// const float32 fPreStepX = (float32)iX[0] - fX[0];
 
-			m3dvsoutput VSOutput;
-			SetVSOutputFromGradient( &VSOutput, (float32)iX[0], (float32)iY[0] );
-			m_TriangleInfo.iCurPixelY = iY[0];
-			(*this.*m_RenderInfo.fpRasterizeScanline)( iY[0], iX[0], iX[1], &VSOutput );
+			if( iX[0] < (int32)RasterRect.iLeft ) iX[0] = RasterRect.iLeft;
+			if( iX[1] > (int32)RasterRect.iRight ) iX[1] = RasterRect.iRight;
+			if( iX[0] >= iX[1] )
+				continue;
+
+			if( m_RenderInfo.bDepthBoundsTest )
+				RasterizeSpan_DepthBounds( iY[0], iX[0], iX[1] );
+			else
+				RasterizeSpan( iY[0], iX[0], iX[1] );
 		}
 	}
+
+	if( m_RenderInfo.bQuadRowPending )
+		RasterizeQuadRow();
+	else if( m_RenderInfo.bCoarseRowPending )
+		RasterizeCoarseRow();
 }
 
-void CMuli3DDevice::RasterizeScanline_ColorOnly( uint32 i_iY, uint32 i_iX, uint32 i_iX2, m3dvsoutput *io_pVSOutput )
+void CMuli3DDevice::RasterizeTriangle_MultiSample( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
 {
-	float32 *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats);
-	float32 *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX);
-	//float32 *pFrameData = m_RenderInfo.pFrameData ? &m_RenderInfo.pFrameData[i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats ] : 0;
-	//float32 *pDepthData = m_RenderInfo.pDepthData ? &m_RenderInfo.pDepthData[i_iY * m_RenderInfo.iDepthBufferPitch + i_iX ] : 0;
+	// Sort vertices by y-coordinate ------------------------------------------
+	const m3dvsoutput *pVertices[3] = { i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 };
+	if( i_pVSOutput1->vPosition.y < pVertices[0]->vPosition.y ) { pVertices[1] = pVertices[0]; pVertices[0] = i_pVSOutput1; }
+	if( i_pVSOutput2->vPosition.y < pVertices[0]->vPosition.y ) { pVertices[2] = pVertices[1]; pVertices[1] = pVertices[0]; pVertices[0] = i_pVSOutput2; }
+	else if( i_pVSOutput2->vPosition.y < pVertices[1]->vPosition.y ) { pVertices[2] = pVertices[1]; pVertices[1] = i_pVSOutput2; }
 
-	for( ; i_iX < i_iX2; ++i_iX,
-		pFrameData += m_RenderInfo.iColorFloats, ++pDepthData,
-		StepXVSOutputFromGradient( io_pVSOutput ) )
+	const vector4 &vA = pVertices[0]->vPosition;
+	const vector4 &vB = pVertices[1]->vPosition;
+	const vector4 &vC = pVertices[2]->vPosition;
+
+	// Calculate slopes of the edges AB, AC and BC ----------------------------
+	const float32 fStepX[3] = {
+		( vB.y - vA.y > 0.0f ) ? ( vB.x - vA.x ) / ( vB.y - vA.y ) : 0.0f,
+		( vC.y - vA.y > 0.0f ) ? ( vC.x - vA.x ) / ( vC.y - vA.y ) : 0.0f,
+		( vC.y - vB.y > 0.0f ) ? ( vC.x - vB.x ) / ( vC.y - vB.y ) : 0.0f };
+
+	// Determine the scanlines, which contain covered samples -----------------
+	const uint32 iSamples = m_RenderInfo.iSamples;
+	float32 fMinOffsetY = 0.0f, fMaxOffsetY = 0.0f;
+	uint32 iSample;
+	for( iSample = 0; iSample < iSamples; ++iSample )
 	{
-		// Get depth of current pixel
-		float32 fDepth = io_pVSOutput->vPosition.z;
+		const float32 fOffsetY = m_RenderInfo.fSampleOffsets[iSample][1];
+		if( fOffsetY < fMinOffsetY ) fMinOffsetY = fOffsetY;
+		if( fOffsetY > fMaxOffsetY ) fMaxOffsetY = fOffsetY;
+	}
 
-		// Perform depth-test
-		switch( m_RenderInfo.DepthCompare )
+	const m3drect &RasterRect = m_RenderInfo.RasterRect;
+	int32 iY = ftol( ceilf( vA.y - fMaxOffsetY ) ), iY2 = ftol( ceilf( vC.y - fMinOffsetY ) );
+	if( iY < (int32)RasterRect.iTop ) iY = RasterRect.iTop;
+	if( iY2 > (int32)RasterRect.iBottom ) iY2 = RasterRect.iBottom;
+
+	// Begin rasterization ----------------------------------------------------
+	for( ; iY < iY2; ++iY )
+	{
+		// A sample is covered, if it lies within [left;right) of the triangle at the sample's y-coordinate,
+		// which lies within [top;bottom) - like pixel centers in RasterizeTriangle().
+		int32 iSampleX[c_iMaxMultiSamples][2];
+		int32 iX = RasterRect.iRight, iX2 = RasterRect.iLeft;
+		for( iSample = 0; iSample < iSamples; ++iSample )
 		{
-		case m3dcmp_never: return;
-		case m3dcmp_equal: if( fabsf( fDepth - *pDepthData ) < FLT_EPSILON ) break; else continue;
-		case m3dcmp_notequal: if( fabsf( fDepth - *pDepthData ) >= FLT_EPSILON ) break; else continue;
-		case m3dcmp_less: if( fDepth < *pDepthData ) break; else continue;
-		case m3dcmp_lessequal: if( fDepth <= *pDepthData ) break; else continue;
-		case m3dcmp_greaterequal: if( fDepth >= *pDepthData ) break; else continue;
-		case m3dcmp_greater: if( fDepth > *pDepthData ) break; else continue;
-		case m3dcmp_always: break;
+			iSampleX[iSample][0] = iSampleX[iSample][1] = 0;
+
+			const float32 fSampleY = (float32)iY + m_RenderInfo.fSampleOffsets[iSample][1];
+			if( fSampleY < vA.y || fSampleY >= vC.y )
+				continue;
+
+			const float32 fLongX = vA.x + ( fSampleY - vA.y ) * fStepX[1];
+			const float32 fShortX = ( fSampleY < vB.y ) ? vA.x + ( fSampleY - vA.y ) * fStepX[0] : vB.x + ( fSampleY - vB.y ) * fStepX[2];
+			const float32 fOffsetX = m_RenderInfo.fSampleOffsets[iSample][0];
+
+			int32 iLeft = ftol( ceilf( ( fLongX < fShortX ? fLongX : fShortX ) - fOffsetX ) );
+			int32 iRight = ftol( ceilf( ( fLongX < fShortX ? fShortX : fLongX ) - fOffsetX ) );
+			if( iLeft < (int32)RasterRect.iLeft ) iLeft = RasterRect.iLeft;
+			if( iRight > (int32)RasterRect.iRight ) iRight = RasterRect.iRight;
+			if( iLeft >= iRight )
+				continue;
+
+			iSampleX[iSample][0] = iLeft; iSampleX[iSample][1] = iRight;
+			if( iLeft < iX ) iX = iLeft;
+			if( iRight > iX2 ) iX2 = iRight;
 		}
 
-		// passed depth test - update depthbuffer!
-		if( m_RenderInfo.bDepthWrite )
-			*pDepthData = fDepth;
-
-		if( m_RenderInfo.bColorWrite )
-		{
-			m3dvsoutput PSInput;
-			m_TriangleInfo.fCurPixelInvW = 1.0f / io_pVSOutput->vPosition.w;
-			MultiplyVertexShaderOutputRegisters( &PSInput, io_pVSOutput, m_TriangleInfo.fCurPixelInvW );
-			// note: PSInput now only contains valid register data, position etc. are not initialized!
+		if( iX >= iX2 )
+			continue;
 
-			// Read in current pixel's color in the colorbuffer
-			vector4 vPixelColor( 0, 0, 0, 1 );
-			switch( m_RenderInfo.iColorFloats )
-			{
-			case 4: vPixelColor.a = pFrameData[3];
-			case 3: vPixelColor.b = pFrameData[2];
-			case 2: vPixelColor.g = pFrameData[1];
-			case 1: vPixelColor.r = pFrameData[0];
-			}
+		m3dvsoutput VSOutput;
+		SetVSOutputFromGradient( &VSOutput, (float32)iX, (float32)iY );
+		m_TriangleInfo.iCurPixelY = iY;
+		m_TriangleInfo.iCurSpanX = iX;
 
-			// Execute the pixel shader
-			m_TriangleInfo.iCurPixelX = i_iX;
-			m_pPixelShader->bExecute( PSInput.ShaderOutputs, vPixelColor, fDepth );
+		for( ; iX < iX2; ++iX, StepXVSOutputFromGradient( &VSOutput ) )
+		{
+			uint32 iCoverage = 0;
+			for( iSample = 0; iSample < iSamples; ++iSample )
+				iCoverage |= ( iX >= iSampleX[iSample][0] && iX < iSampleX[iSample][1] ) ? ( 1 << iSample ) : 0;
 
-			// Write the new color to the colorbuffer
-			switch( m_RenderInfo.iColorFloats )
-			{
-			case 4: pFrameData[3] = vPixelColor.a;
-			case 3: pFrameData[2] = vPixelColor.b;
-			case 2: pFrameData[1] = vPixelColor.g;
-			case 1: pFrameData[0] = vPixelColor.r;
-			}
+			if( iCoverage )
+				ShadeMultiSamplePixel( iX, iY, iCoverage, &VSOutput, true );
 		}
-
-		++m_RenderInfo.iRenderedPixels;
 	}
 }
 
-void CMuli3DDevice::RasterizeScanline_ColorOnly_MightKillPixels( uint32 i_iY, uint32 i_iX, uint32 i_iX2, m3dvsoutput *io_pVSOutput )
+void CMuli3DDevice::ShadeMultiSamplePixel( uint32 i_iX, uint32 i_iY, uint32 i_iCoverage, const m3dvsoutput *i_pVSOutput, bool i_bTriangle )
 {
-	float32 *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats);
-	float32 *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX);
-	//float32 *pFrameData = m_RenderInfo.pFrameData ? &m_RenderInfo.pFrameData[i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats ] : 0;
-	//float32 *pDepthData = m_RenderInfo.pDepthData ? &m_RenderInfo.pDepthData[i_iY * m_RenderInfo.iDepthBufferPitch + i_iX ] : 0;
-
-	for( ; i_iX < i_iX2; ++i_iX,
-		pFrameData += m_RenderInfo.iColorFloats, ++pDepthData,
-		StepXVSOutputFromGradient( io_pVSOutput ) )
+	const uint32 iSamples = m_RenderInfo.iSamples;
+	const uint32 iFirstSample = i_iX * iSamples; // index of the pixel's first sample within the scanline
+	float32 *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + iFirstSample);
+
+	// Interpolate depth to the covered samples and perform depth bounds- and depth-test
+	const float32 fZDdx = i_bTriangle ? m_TriangleInfo.fZDdx : 0.0f;
+	const float32 fZDdy = i_bTriangle ? m_TriangleInfo.fZDdy : 0.0f;
+	float32 fSampleDepths[c_iMaxMultiSamples];
+	uint32 iPassed = 0, iSample;
+	for( iSample = 0; iSample < iSamples; ++iSample )
 	{
-		// Get depth of current pixel
-		float32 fDepth = io_pVSOutput->vPosition.z;
-
-		// Perform depth-test
-		switch( m_RenderInfo.DepthCompare )
-		{
-		case m3dcmp_never: return;
-		case m3dcmp_equal: if( fabsf( fDepth - *pDepthData ) < FLT_EPSILON ) break; else continue;
-		case m3dcmp_notequal: if( fabsf( fDepth - *pDepthData ) >= FLT_EPSILON ) break; else continue;
-		case m3dcmp_less: if( fDepth < *pDepthData ) break; else continue;
-		case m3dcmp_lessequal: if( fDepth <= *pDepthData ) break; else continue;
-		case m3dcmp_greaterequal: if( fDepth >= *pDepthData ) break; else continue;
-		case m3dcmp_greater: if( fDepth > *pDepthData ) break; else continue;
-		case m3dcmp_always: break;
-		}
-
-		if( m_RenderInfo.bColorWrite || m_RenderInfo.bDepthWrite )
-		{
-			m3dvsoutput PSInput;
-			m_TriangleInfo.fCurPixelInvW = 1.0f / io_pVSOutput->vPosition.w;
-			MultiplyVertexShaderOutputRegisters( &PSInput, io_pVSOutput, m_TriangleInfo.fCurPixelInvW );
-			// note: PSInput now only contains valid register data, position etc. are not initialized!
-
-			// Read in current pixel's color in the colorbuffer
-			vector4 vPixelColor( 0, 0, 0, 1 );
-			switch( m_RenderInfo.iColorFloats )
-			{
-			case 4: vPixelColor.a = pFrameData[3];
-			case 3: vPixelColor.b = pFrameData[2];
-			case 2: vPixelColor.g = pFrameData[1];
-			case 1: vPixelColor.r = pFrameData[0];
-			}
+		if( !( i_iCoverage & ( 1 << iSample ) ) )
+			continue;
 
-			// Execute the pixel shader
-			m_TriangleInfo.iCurPixelX = i_iX;
-			if( !m_pPixelShader->bExecute( PSInput.ShaderOutputs, vPixelColor, fDepth ) )
-				continue; // pixel got killed
+		fSampleDepths[iSample] = i_pVSOutput->vPosition.z +
+			fZDdx * m_RenderInfo.fSampleOffsets[iSample][0] + fZDdy * m_RenderInfo.fSampleOffsets[iSample][1];
 
-			// Passed depth-test and pixel was not killed, so update depthbuffer
-			if( m_RenderInfo.bDepthWrite )
-				*pDepthData = fDepth;
+		if( !bDepthBoundsTest( &pDepthData[iSample] ) )
+			continue;
 
-			// Write the new color to the colorbuffer
-			if( m_RenderInfo.bColorWrite )
-			{
-				switch( m_RenderInfo.iColorFloats )
-				{
-				case 4: pFrameData[3] = vPixelColor.a;
-				case 3: pFrameData[2] = vPixelColor.b;
-				case 2: pFrameData[1] = vPixelColor.g;
-				case 1: pFrameData[0] = vPixelColor.r;
-				}
-			}
-		}
+		if( m_RenderInfo.bEarlyDepthTest && !bDepthTest( fSampleDepths[iSample], &pDepthData[iSample] ) )
+			continue;
 
-		++m_RenderInfo.iRenderedPixels;
+		iPassed |= 1 << iSample;
 	}
-}
 
-void CMuli3DDevice::RasterizeScanline_ColorDepth( uint32 i_iY, uint32 i_iX, uint32 i_iX2, m3dvsoutput *io_pVSOutput )
-{
-	float32 *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats);
-	float32 *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX);
-	//float32 *pFrameData = m_RenderInfo.pFrameData ? &m_RenderInfo.pFrameData[i_iY * m_RenderInfo.iColorBufferPitch + i_iX] : 0;
-	//float32 *pDepthData = m_RenderInfo.pDepthData ? &m_RenderInfo.pDepthData[i_iY * m_RenderInfo.iDepthBufferPitch + i_iX] : 0;
+	if( !iPassed )
+		return;
 
-	for( ; i_iX < i_iX2; ++i_iX,
-		pFrameData += m_RenderInfo.iColorFloats, ++pDepthData,
-		StepXVSOutputFromGradient( io_pVSOutput ) )
+	vector4 vPixelColors[c_iMaxColorBuffers];
+	if( !m_RenderInfo.bDepthOnly )
 	{
 		m3dvsoutput PSInput;
-		m_TriangleInfo.fCurPixelInvW = 1.0f / io_pVSOutput->vPosition.w;
-		MultiplyVertexShaderOutputRegisters( &PSInput, io_pVSOutput, m_TriangleInfo.fCurPixelInvW );
-		// note: PSInput now only contains valid register data, position etc. are not initialized!
-
-		// Read in current colorbuffer-color
-		vector4 vPixelColor( 0, 0, 0, 1 );
-		switch( m_RenderInfo.iColorFloats )
+		const shaderreg *pShaderInputs = i_pVSOutput->ShaderOutputs;
+		if( i_bTriangle )
 		{
-		case 4: vPixelColor.a = pFrameData[3];
-		case 3: vPixelColor.b = pFrameData[2];
-		case 2: vPixelColor.g = pFrameData[1];
-		case 1: vPixelColor.r = pFrameData[0];
+			m_TriangleInfo.fCurPixelInvW = 1.0f / i_pVSOutput->vPosition.w;
+			MultiplyVertexShaderOutputRegisters( &PSInput, i_pVSOutput, m_TriangleInfo.fCurPixelInvW );
+			pShaderInputs = PSInput.ShaderOutputs;
 		}
 
-		// Get depth of current pixel
-		float32 fDepth = io_pVSOutput->vPosition.z;
+		// The pixel shader reads the color of the first sample that passed
+		uint32 iReadSample = 0;
+		while( !( iPassed & ( 1 << iReadSample ) ) )
+			++iReadSample;
 
-		// Execute pixel shader
+		float32 *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + ( iFirstSample + iReadSample ) * m_RenderInfo.iColorFloats);
+		ReadPixelColors( vPixelColors, pFrameData, iFirstSample + iReadSample, i_iY );
+
+		// Execute the pixel shader once for all samples
+		float32 fPSDepth = i_pVSOutput->vPosition.z;
 		m_TriangleInfo.iCurPixelX = i_iX;
-		if( !m_pPixelShader->bExecute( PSInput.ShaderOutputs, vPixelColor, fDepth ) )
-			continue; // pixel got killed
+		if( !bExecutePixelShader( pShaderInputs, vPixelColors, fPSDepth ) )
+			return; // pixel got killed
 
-		// Perform depth-test
-		switch( m_RenderInfo.DepthCompare )
+		// The depth outputted by the pixel shader applies to all samples
+		if( !m_RenderInfo.bEarlyDepthTest )
 		{
-		case m3dcmp_never: return;
-		case m3dcmp_equal: if( fabsf( fDepth - *pDepthData ) < FLT_EPSILON ) break; else continue;
-		case m3dcmp_notequal: if( fabsf( fDepth - *pDepthData ) >= FLT_EPSILON ) break; else continue;
-		case m3dcmp_less: if( fDepth < *pDepthData ) break; else continue;
-		case m3dcmp_lessequal: if( fDepth <= *pDepthData ) break; else continue;
-		case m3dcmp_greaterequal: if( fDepth >= *pDepthData ) break; else continue;
-		case m3dcmp_greater: if( fDepth > *pDepthData ) break; else continue;
-		case m3dcmp_always: break;
+			for( iSample = 0; iSample < iSamples; ++iSample )
+			{
+				if( !( iPassed & ( 1 << iSample ) ) )
+					continue;
+
+				fSampleDepths[iSample] = fPSDepth;
+				if( !bDepthTest( fPSDepth, &pDepthData[iSample] ) )
+					iPassed &= ~( 1 << iSample );
+			}
+
+			if( !iPassed )
+				return;
 		}
+	}
+
+	// Update depthbuffer and colorbuffers of the samples that passed
+	for( iSample = 0; iSample < iSamples; ++iSample )
+	{
+		if( !( iPassed & ( 1 << iSample ) ) )
+			continue;
 
-		// Passed depth-test, so update depthbuffer
 		if( m_RenderInfo.bDepthWrite )
-			*pDepthData = fDepth;
+			pDepthData[iSample] = fSampleDepths[iSample];
 
-		// Write new color to colorbuffer
 		if( m_RenderInfo.bColorWrite )
 		{
-			switch( m_RenderInfo.iColorFloats )
-			{
-			case 4: pFrameData[3] = vPixelColor.a;
-			case 3: pFrameData[2] = vPixelColor.b;
-			case 2: pFrameData[1] = vPixelColor.g;
-			case 1: pFrameData[0] = vPixelColor.r;
-			}
+			float32 *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + ( iFirstSample + iSample ) * m_RenderInfo.iColorFloats);
+			WritePixelColors( pFrameData, iFirstSample + iSample, i_iY, vPixelColors );
 		}
-
-		++m_RenderInfo.iRenderedPixels;
 	}
-}
 
-// LINES & POINTS -------------------------------------------------------------
+	++m_RenderInfo.iRenderedPixels;
+}
 
-void CMuli3DDevice::RasterizeLine( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1 )
+bool CMuli3DDevice::bDepthBoundsCullTriangle( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
 {
-	const vector4 &vA = i_pVSOutput0->vPosition;
-	const vector4 &vB = i_pVSOutput1->vPosition;
+	// Pixel shaders outputting depth may move the triangle anywhere.
+	if( !m_RenderInfo.bEarlyDepthTest )
+		return false;
 
-	const uint32 iIntCoordsA[2] = { ftol( vA.x ), ftol( vA.y ) };
-	const float32 fDeltaX = vB.x - vA.x, fDeltaY = vB.y - vA.y;
+	// Pixels within the bounds that fail the depth-test still have to update the stencil-buffer.
+	if( m_RenderInfo.bStencilTest && m_RenderInfo.StencilZFail != m3dsop_keep )
+		return false;
 
-	const int32 iLineThicknessHalf = -((int32)(m_iRenderStates[m3drs_linethickness] / 2));
-	const int32 iPosOffset = ( m_iRenderStates[m3drs_linethickness] & 1 ) ? 0 : 1;
+	float32 fMinZ = i_pVSOutput0->vPosition.z, fMaxZ = i_pVSOutput0->vPosition.z;
+	if( i_pVSOutput1->vPosition.z < fMinZ ) fMinZ = i_pVSOutput1->vPosition.z; else if( i_pVSOutput1->vPosition.z > fMaxZ ) fMaxZ = i_pVSOutput1->vPosition.z;
+	if( i_pVSOutput2->vPosition.z < fMinZ ) fMinZ = i_pVSOutput2->vPosition.z; else if( i_pVSOutput2->vPosition.z > fMaxZ ) fMaxZ = i_pVSOutput2->vPosition.z;
 
-	if( fabsf( fDeltaX ) > fabsf( fDeltaY ) )
+	// A pixel of the triangle can only pass the depth-test, if the stored depth is related to the
+	// pixel's depth in a certain way - this can't be the case if all stored depths within the bounds aren't.
+	switch( m_RenderInfo.DepthCompare )
 	{
-		// drawing a line which is more horizontal than vertical
-		const int32 iPixelsX = ftol( fDeltaX );
-		if( !iPixelsX )
-			return;
+	case m3dcmp_less: case m3dcmp_lessequal: return fMinZ > m_RenderInfo.fMaxDepthBound;
+	case m3dcmp_greater: case m3dcmp_greaterequal: return fMaxZ < m_RenderInfo.fMinDepthBound;
+	case m3dcmp_equal: return fMinZ > m_RenderInfo.fMaxDepthBound + FLT_EPSILON || fMaxZ < m_RenderInfo.fMinDepthBound - FLT_EPSILON;
+	default: return false;
+	}
+}
+
+void CMuli3DDevice::RasterizeSpan( uint32 i_iY, int32 i_iX, int32 i_iX2 )
+{
+	if( m_RenderInfo.bDepthOnly )
+	{
+		// No registers are interpolated; using the same function as for shaded spans
+		// guarantees that depth matches a later shaded pass exactly (e.g. z-prepass).
+		m3dvsoutput VSOutput;
+		SetVSOutputFromGradient( &VSOutput, (float32)i_iX, (float32)i_iY );
+		RasterizeScanline_DepthOnly( i_iY, i_iX, i_iX2, VSOutput.vPosition.z );
+		return;
+	}
+
+	if( m_RenderInfo.Interleave != m3dil_none )
+	{
+		RasterizeSpan_Interleaved( i_iY, i_iX, i_iX2 );
+		return;
+	}
+
+	if( m_TriangleInfo.bQuadShading )
+	{
+		AddQuadSpan( i_iY, i_iX, i_iX2 );
+		return;
+	}
+
+	if( m_RenderInfo.bCoarseShading )
+	{
+		AddCoarseSpan( i_iY, i_iX, i_iX2 );
+		return;
+	}
+
+	m3dvsoutput VSOutput;
+	SetVSOutputFromGradient( &VSOutput, (float32)i_iX, (float32)i_iY );
+	m_TriangleInfo.iCurPixelY = i_iY;
+	m_TriangleInfo.iCurSpanX = i_iX;
+	(*this.*m_RenderInfo.fpRasterizeScanline)( i_iY, i_iX, i_iX2, &VSOutput );
+}
+
+void CMuli3DDevice::RasterizeSpan_Interleaved( uint32 i_iY, int32 i_iX, int32 i_iX2 )
+{
+	uint32 iOffsetX, iStepX;
+	if( !CMuli3DSurface::bGetInterleaveRow( m_RenderInfo.Interleave, m_RenderInfo.iInterleavePhase, i_iY, iOffsetX, iStepX ) )
+		return;
+
+	// Move to the first pixel of the phase and rasterize the phase's pixels one by one.
+	int32 iX = i_iX + (int32)( ( iOffsetX + iStepX - (uint32)i_iX % iStepX ) % iStepX );
+	m_TriangleInfo.iCurPixelY = i_iY;
+	for( ; iX < i_iX2; iX += iStepX )
+	{
+		m3dvsoutput VSOutput;
+		SetVSOutputFromGradient( &VSOutput, (float32)iX, (float32)i_iY );
+		m_TriangleInfo.iCurSpanX = iX;
+		(*this.*m_RenderInfo.fpRasterizeScanline)( i_iY, iX, iX + 1, &VSOutput );
+	}
+}
+
+void CMuli3DDevice::RasterizeSpan_DepthBounds( uint32 i_iY, int32 i_iX, int32 i_iX2 )
+{
+	const uint32 iTileY = i_iY / c_iDepthBoundsTileSize;
+
+	// Quad-rows take a single span per scanline, so rejected tiles are only trimmed off its ends.
+	int32 iQuadSpanX[2] = { i_iX2, i_iX };
+
+	int32 iX = i_iX;
+	while( iX < i_iX2 )
+	{
+		// Skip rejected tiles.
+		while( iX < i_iX2 && !bDepthBoundsTile( iX / c_iDepthBoundsTileSize, iTileY ) )
+			iX = ( iX / c_iDepthBoundsTileSize + 1 ) * c_iDepthBoundsTileSize;
+
+		if( iX >= i_iX2 )
+			break;
+
+		// Collect accepted tiles.
+		int32 iX2 = iX;
+		while( iX2 < i_iX2 && bDepthBoundsTile( iX2 / c_iDepthBoundsTileSize, iTileY ) )
+			iX2 = ( iX2 / c_iDepthBoundsTileSize + 1 ) * c_iDepthBoundsTileSize;
+
+		if( iX2 > i_iX2 )
+			iX2 = i_iX2;
+
+		if( m_TriangleInfo.bQuadShading )
+		{
+			if( iX < iQuadSpanX[0] ) iQuadSpanX[0] = iX;
+			iQuadSpanX[1] = iX2;
+		}
+		else
+			RasterizeSpan( i_iY, iX, iX2 );
+
+		iX = iX2;
+	}
+
+	if( m_TriangleInfo.bQuadShading && iQuadSpanX[0] < iQuadSpanX[1] )
+		AddQuadSpan( i_iY, iQuadSpanX[0], iQuadSpanX[1] );
+}
+
+bool CMuli3DDevice::bDepthBoundsTile( uint32 i_iTileX, uint32 i_iTileY )
+{
+	uint8 &iTile = m_pDepthBoundsTiles[i_iTileY * m_RenderInfo.iDepthBoundsTilesX + i_iTileX];
+	if( iTile != m3ddbt_unknown )
+		return iTile == m3ddbt_accepted;
+
+	// Only pixels within the viewport are ever rasterized.
+	const m3drect &Viewport = m_RenderInfo.ViewportRect;
+	uint32 iX = i_iTileX * c_iDepthBoundsTileSize, iX2 = iX + c_iDepthBoundsTileSize;
+	uint32 iY = i_iTileY * c_iDepthBoundsTileSize, iY2 = iY + c_iDepthBoundsTileSize;
+	if( iX < Viewport.iLeft ) iX = Viewport.iLeft;
+	if( iY < Viewport.iTop ) iY = Viewport.iTop;
+	if( iX2 > Viewport.iRight ) iX2 = Viewport.iRight;
+	if( iY2 > Viewport.iBottom ) iY2 = Viewport.iBottom;
+
+	iTile = m3ddbt_rejected;
+	for( ; iY < iY2; ++iY )
+	{
+		const float32 *pDepthData = m_RenderInfo.pDepthData + (iY * m_RenderInfo.iDepthBufferPitch + iX);
+		for( uint32 iPixel = iX; iPixel < iX2; ++iPixel, ++pDepthData )
+		{
+			if( bDepthBoundsTest( pDepthData ) )
+			{
+				iTile = m3ddbt_accepted;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void CMuli3DDevice::AddQuadSpan( uint32 i_iY, int32 i_iX, int32 i_iX2 )
+{
+	const uint32 iQuadRowY = i_iY & ~1;
+	if( m_RenderInfo.bQuadRowPending && m_RenderInfo.iQuadRowY != iQuadRowY )
+		RasterizeQuadRow();
+
+	if( !m_RenderInfo.bQuadRowPending )
+	{
+		m_RenderInfo.iQuadRowY = iQuadRowY;
+		m_RenderInfo.iQuadSpans[0][0] = m_RenderInfo.iQuadSpans[0][1] = 0;
+		m_RenderInfo.iQuadSpans[1][0] = m_RenderInfo.iQuadSpans[1][1] = 0;
+		m_RenderInfo.bQuadRowPending = true;
+	}
+
+	m_RenderInfo.iQuadSpans[i_iY & 1][0] = i_iX;
+	m_RenderInfo.iQuadSpans[i_iY & 1][1] = i_iX2;
+}
+
+void CMuli3DDevice::RasterizeQuadRow()
+{
+	m_RenderInfo.bQuadRowPending = false;
+
+	const int32 (*pSpans)[2] = m_RenderInfo.iQuadSpans;
+	int32 iLeft, iRight;
+	if( pSpans[0][0] >= pSpans[0][1] )
+	{
+		if( pSpans[1][0] >= pSpans[1][1] )
+			return;
+
+		iLeft = pSpans[1][0]; iRight = pSpans[1][1];
+	}
+	else
+	{
+		iLeft = pSpans[0][0]; iRight = pSpans[0][1];
+		if( pSpans[1][0] < pSpans[1][1] )
+		{
+			if( pSpans[1][0] < iLeft ) iLeft = pSpans[1][0];
+			if( pSpans[1][1] > iRight ) iRight = pSpans[1][1];
+		}
+	}
+
+	const uint32 iY = m_RenderInfo.iQuadRowY;
+	m3dvsoutput QuadPixels[4];
+	for( uint32 iPixel = 0; iPixel < 4; ++iPixel )
+		m_TriangleInfo.pQuadShaderInputs[iPixel] = QuadPixels[iPixel].ShaderOutputs;
+
+	for( int32 iX = iLeft & ~1; iX < iRight; iX += 2 )
+	{
+		uint32 iCoverage = 0;
+		for( uint32 iPixel = 0; iPixel < 4; ++iPixel )
+		{
+			const int32 iPixelX = iX + ( iPixel & 1 );
+			const int32 *pSpan = pSpans[iPixel >> 1];
+			if( iPixelX >= pSpan[0] && iPixelX < pSpan[1] )
+				iCoverage |= 1 << iPixel;
+		}
+
+		if( !iCoverage )
+			continue;
+
+		// Set up all four pixels - uncovered pixels serve as helper pixels for partial derivatives.
+		float32 fPixelInvW[4];
+		for( uint32 iPixel = 0; iPixel < 4; ++iPixel )
+		{
+			SetVSOutputFromGradient( &QuadPixels[iPixel], (float32)( iX + ( iPixel & 1 ) ), (float32)( iY + ( iPixel >> 1 ) ) );
+			fPixelInvW[iPixel] = 1.0f / QuadPixels[iPixel].vPosition.w;
+			MultiplyVertexShaderOutputRegisters( &QuadPixels[iPixel], &QuadPixels[iPixel], fPixelInvW[iPixel] );
+		}
+
+		for( uint32 iPixel = 0; iPixel < 4; ++iPixel )
+		{
+			if( !( iCoverage & ( 1 << iPixel ) ) )
+				continue; // helper pixel
+
+			const uint32 iPixelX = iX + ( iPixel & 1 ), iPixelY = iY + ( iPixel >> 1 );
+			float32 *pFrameData = m_RenderInfo.pFrameData + (iPixelY * m_RenderInfo.iColorBufferPitch + iPixelX * m_RenderInfo.iColorFloats);
+			float32 *pDepthData = m_RenderInfo.pDepthData + (iPixelY * m_RenderInfo.iDepthBufferPitch + iPixelX);
+			uint8 *pStencilData = m_RenderInfo.pStencilData + (iPixelY * m_RenderInfo.iStencilBufferPitch + iPixelX);
+
+			float32 fDepth = QuadPixels[iPixel].vPosition.z;
+			if( m_RenderInfo.bEarlyDepthTest )
+			{
+				if( !bStencilDepthTest( fDepth, pDepthData, pStencilData ) )
+					continue;
+
+				if( !m_RenderInfo.bMightKillPixels )
+				{
+					if( m_RenderInfo.bDepthWrite )
+						*pDepthData = fDepth;
+					if( m_RenderInfo.bStencilTest )
+						UpdateStencil( pStencilData, m_RenderInfo.StencilPass );
+				}
+
+				if( !m_RenderInfo.bColorWrite && !( m_RenderInfo.bMightKillPixels && ( m_RenderInfo.bDepthWrite || m_RenderInfo.bStencilTest ) ) )
+				{
+					++m_RenderInfo.iRenderedPixels;
+					continue;
+				}
+			}
+			else if( !bDepthBoundsTest( pDepthData ) || ( m_RenderInfo.bStencilTest && !bStencilTest( pStencilData ) ) )
+				continue;
+
+			// Read in current pixel's color in the colorbuffer
+			vector4 vPixelColors[c_iMaxColorBuffers];
+			ReadPixelColors( vPixelColors, pFrameData, iPixelX, iPixelY );
+
+			// Execute the pixel shader
+			m_TriangleInfo.iCurPixelX = iPixelX;
+			m_TriangleInfo.iCurPixelY = iPixelY;
+			m_TriangleInfo.iCurSpanX = iPixelX;
+			m_TriangleInfo.fCurPixelInvW = fPixelInvW[iPixel];
+			m_TriangleInfo.iCurQuadPixel = iPixel;
+			if( !bExecutePixelShader( QuadPixels[iPixel].ShaderOutputs, vPixelColors, fDepth ) )
+				continue; // pixel got killed
+
+			if( !m_RenderInfo.bEarlyDepthTest && !bDepthTest( fDepth, pDepthData ) )
+			{
+				if( m_RenderInfo.bStencilTest )
+					UpdateStencil( pStencilData, m_RenderInfo.StencilZFail );
+				continue;
+			}
+
+			// Passed depth-test and pixel was not killed, so update depth- and stencilbuffer
+			if( m_RenderInfo.bMightKillPixels )
+			{
+				if( m_RenderInfo.bDepthWrite )
+					*pDepthData = fDepth;
+				if( m_RenderInfo.bStencilTest )
+					UpdateStencil( pStencilData, m_RenderInfo.StencilPass );
+			}
+
+			// Write the new color to the colorbuffer
+			if( m_RenderInfo.bColorWrite )
+				WritePixelColors( pFrameData, iPixelX, iPixelY, vPixelColors );
+
+			++m_RenderInfo.iRenderedPixels;
+		}
+	}
+}
+
+void CMuli3DDevice::AddCoarseSpan( uint32 i_iY, int32 i_iX, int32 i_iX2 )
+{
+	const uint32 iCoarseRowY = i_iY & ~3;
+	if( m_RenderInfo.bCoarseRowPending && m_RenderInfo.iCoarseRowY != iCoarseRowY )
+		RasterizeCoarseRow();
+
+	if( !m_RenderInfo.bCoarseRowPending )
+	{
+		m_RenderInfo.iCoarseRowY = iCoarseRowY;
+		for( uint32 iRow = 0; iRow < 4; ++iRow )
+			m_RenderInfo.iCoarseSpans[iRow][0] = m_RenderInfo.iCoarseSpans[iRow][1] = 0;
+		m_RenderInfo.bCoarseRowPending = true;
+	}
+
+	// RasterizeSpan_DepthBounds() may pass several spans per scanline - merge them.
+	int32 *pSpan = m_RenderInfo.iCoarseSpans[i_iY & 3];
+	if( pSpan[0] >= pSpan[1] )
+	{
+		pSpan[0] = i_iX;
+		pSpan[1] = i_iX2;
+	}
+	else
+	{
+		if( i_iX < pSpan[0] ) pSpan[0] = i_iX;
+		if( i_iX2 > pSpan[1] ) pSpan[1] = i_iX2;
+	}
+}
+
+void CMuli3DDevice::RasterizeCoarseRow()
+{
+	m_RenderInfo.bCoarseRowPending = false;
+
+	const int32 (*pSpans)[2] = m_RenderInfo.iCoarseSpans;
+	int32 iLeft = 0, iRight = 0;
+	uint32 iRow;
+	for( iRow = 0; iRow < 4; ++iRow )
+	{
+		if( pSpans[iRow][0] >= pSpans[iRow][1] )
+			continue;
+
+		if( iLeft >= iRight || pSpans[iRow][0] < iLeft ) iLeft = pSpans[iRow][0];
+		if( pSpans[iRow][1] > iRight ) iRight = pSpans[iRow][1];
+	}
+
+	if( iLeft >= iRight )
+		return;
+
+	const uint32 iY = m_RenderInfo.iCoarseRowY;
+
+	// Depth is stepped along the scanlines like in RasterizeSpan(), so that it matches a depth-only pass exactly.
+	float32 fSpanDepths[4];
+	int32 iSpanDepthX[4];
+	for( iRow = 0; iRow < 4; ++iRow )
+	{
+		iSpanDepthX[iRow] = pSpans[iRow][0];
+		fSpanDepths[iRow] = m_TriangleInfo.pBaseVertex->vPosition.z +
+			m_TriangleInfo.fZDdx * ( (float32)pSpans[iRow][0] - m_TriangleInfo.pBaseVertex->vPosition.x ) +
+			m_TriangleInfo.fZDdy * ( (float32)( iY + iRow ) - m_TriangleInfo.pBaseVertex->vPosition.y );
+	}
+
+	// Cells of 4x4 pixels never straddle shading rate tiles.
+	for( int32 iCellX = iLeft & ~3; iCellX < iRight; iCellX += 4 )
+	{
+		uint32 iShiftX = c_iShadingRateShifts[m_RenderInfo.iShadingRate][0];
+		uint32 iShiftY = c_iShadingRateShifts[m_RenderInfo.iShadingRate][1];
+		if( m_RenderInfo.pShadingRateData )
+		{
+			const float32 fTileRate = m_RenderInfo.pShadingRateData[( iY / c_iShadingRateTileSize ) * m_RenderInfo.iShadingRateImageWidth + iCellX / c_iShadingRateTileSize];
+			int32 iTileRate = ftol( fTileRate );
+			if( iTileRate < m3dsr_1x1 ) iTileRate = m3dsr_1x1;
+			else if( iTileRate > m3dsr_4x4 ) iTileRate = m3dsr_4x4;
+
+			if( c_iShadingRateShifts[iTileRate][0] > iShiftX ) iShiftX = c_iShadingRateShifts[iTileRate][0];
+			if( c_iShadingRateShifts[iTileRate][1] > iShiftY ) iShiftY = c_iShadingRateShifts[iTileRate][1];
+		}
+
+		const uint32 iBlockWidth = 1 << iShiftX, iBlockHeight = 1 << iShiftY;
+		for( uint32 iBlockY = 0; iBlockY < 4; iBlockY += iBlockHeight )
+		{
+			for( uint32 iBlockX = 0; iBlockX < 4; iBlockX += iBlockWidth )
+			{
+				// Test the covered pixels of the block before shading it
+				float32 fDepths[16];
+				uint32 iPassed = 0, iPixel;
+				for( iRow = iBlockY; iRow < iBlockY + iBlockHeight; ++iRow )
+				{
+					const uint32 iPixelY = iY + iRow;
+					for( int32 iPixelX = iCellX + iBlockX; iPixelX < iCellX + (int32)( iBlockX + iBlockWidth ); ++iPixelX )
+					{
+						if( iPixelX < pSpans[iRow][0] || iPixelX >= pSpans[iRow][1] )
+							continue;
+
+						for( ; iSpanDepthX[iRow] < iPixelX; ++iSpanDepthX[iRow] )
+							fSpanDepths[iRow] += m_TriangleInfo.fZDdx;
+
+						iPixel = iRow * 4 + ( iPixelX - iCellX );
+						fDepths[iPixel] = fSpanDepths[iRow];
+
+						float32 *pDepthData = m_RenderInfo.pDepthData + (iPixelY * m_RenderInfo.iDepthBufferPitch + iPixelX);
+						uint8 *pStencilData = m_RenderInfo.pStencilData + (iPixelY * m_RenderInfo.iStencilBufferPitch + iPixelX);
+						if( m_RenderInfo.bEarlyDepthTest )
+						{
+							if( !bStencilDepthTest( fDepths[iPixel], pDepthData, pStencilData ) )
+								continue;
+						}
+						else if( !bDepthBoundsTest( pDepthData ) || ( m_RenderInfo.bStencilTest && !bStencilTest( pStencilData ) ) )
+							continue;
+
+						iPassed |= 1 << iPixel;
+					}
+				}
+
+				if( !iPassed )
+					continue;
+
+				// Execute the pixel shader once at the block's center
+				const uint32 iBlockPixelX = iCellX + iBlockX, iBlockPixelY = iY + iBlockY;
+				m3dvsoutput PSInput;
+				SetVSOutputFromGradient( &PSInput, (float32)iBlockPixelX + 0.5f * ( iBlockWidth - 1 ), (float32)iBlockPixelY + 0.5f * ( iBlockHeight - 1 ) );
+				m_TriangleInfo.fCurPixelInvW = 1.0f / PSInput.vPosition.w;
+				MultiplyVertexShaderOutputRegisters( &PSInput, &PSInput, m_TriangleInfo.fCurPixelInvW );
+
+				// The pixel shader reads the color of the first pixel that passed
+				iPixel = 0;
+				while( !( iPassed & ( 1 << iPixel ) ) )
+					++iPixel;
+
+				const uint32 iReadX = iCellX + ( iPixel & 3 ), iReadY = iY + ( iPixel >> 2 );
+				vector4 vPixelColors[c_iMaxColorBuffers];
+				ReadPixelColors( vPixelColors, m_RenderInfo.pFrameData + (iReadY * m_RenderInfo.iColorBufferPitch + iReadX * m_RenderInfo.iColorFloats), iReadX, iReadY );
+
+				float32 fPSDepth = PSInput.vPosition.z;
+				m_TriangleInfo.iCurPixelX = iBlockPixelX;
+				m_TriangleInfo.iCurPixelY = iBlockPixelY;
+				m_TriangleInfo.iCurSpanX = iBlockPixelX;
+				if( !bExecutePixelShader( PSInput.ShaderOutputs, vPixelColors, fPSDepth ) )
+					continue; // block got killed
+
+				// Broadcast the color to the pixels that passed
+				for( iPixel = 0; iPixel < 16; ++iPixel )
+				{
+					if( !( iPassed & ( 1 << iPixel ) ) )
+						continue;
+
+					const uint32 iPixelX = iCellX + ( iPixel & 3 ), iPixelY = iY + ( iPixel >> 2 );
+					float32 *pFrameData = m_RenderInfo.pFrameData + (iPixelY * m_RenderInfo.iColorBufferPitch + iPixelX * m_RenderInfo.iColorFloats);
+					float32 *pDepthData = m_RenderInfo.pDepthData + (iPixelY * m_RenderInfo.iDepthBufferPitch + iPixelX);
+					uint8 *pStencilData = m_RenderInfo.pStencilData + (iPixelY * m_RenderInfo.iStencilBufferPitch + iPixelX);
+
+					// The depth outputted by the pixel shader applies to the whole block
+					if( !m_RenderInfo.bEarlyDepthTest )
+					{
+						fDepths[iPixel] = fPSDepth;
+						if( !bDepthTest( fPSDepth, pDepthData ) )
+						{
+							if( m_RenderInfo.bStencilTest )
+								UpdateStencil( pStencilData, m_RenderInfo.StencilZFail );
+							continue;
+						}
+					}
+
+					if( m_RenderInfo.bDepthWrite )
+						*pDepthData = fDepths[iPixel];
+					if( m_RenderInfo.bStencilTest )
+						UpdateStencil( pStencilData, m_RenderInfo.StencilPass );
+					if( m_RenderInfo.bColorWrite )
+						WritePixelColors( pFrameData, iPixelX, iPixelY, vPixelColors );
+
+					++m_RenderInfo.iRenderedPixels;
+				}
+			}
+		}
+	}
+}
+
+inline bool CMuli3DDevice::bDepthTest( float32 i_fDepth, const float32 *i_pDepthData )
+{
+	switch( m_RenderInfo.DepthCompare )
+	{
+	case m3dcmp_never: return false;
+	case m3dcmp_equal: return fabsf( i_fDepth - *i_pDepthData ) < FLT_EPSILON;
+	case m3dcmp_notequal: return fabsf( i_fDepth - *i_pDepthData ) >= FLT_EPSILON;
+	case m3dcmp_less: return i_fDepth < *i_pDepthData;
+	case m3dcmp_lessequal: return i_fDepth <= *i_pDepthData;
+	case m3dcmp_greaterequal: return i_fDepth >= *i_pDepthData;
+	case m3dcmp_greater: return i_fDepth > *i_pDepthData;
+	case m3dcmp_always: default: return true;
+	}
+}
+
+inline bool CMuli3DDevice::bDepthBoundsTest( const float32 *i_pDepthData )
+{
+	if( !m_RenderInfo.bDepthBoundsTest )
+		return true;
+
+	return *i_pDepthData >= m_RenderInfo.fMinDepthBound && *i_pDepthData <= m_RenderInfo.fMaxDepthBound;
+}
+
+inline void CMuli3DDevice::UpdateStencil( uint8 *io_pStencilData, m3dstencilop i_Operation )
+{
+	const uint32 iValue = *io_pStencilData;
+	uint32 iNewValue;
+	switch( i_Operation )
+	{
+	case m3dsop_zero: iNewValue = 0; break;
+	case m3dsop_replace: iNewValue = m_RenderInfo.iStencilRef; break;
+	case m3dsop_incrsat: iNewValue = ( iValue < 255 ) ? iValue + 1 : 255; break;
+	case m3dsop_decrsat: iNewValue = ( iValue > 0 ) ? iValue - 1 : 0; break;
+	case m3dsop_invert: iNewValue = ~iValue; break;
+	case m3dsop_incr: iNewValue = iValue + 1; break;
+	case m3dsop_decr: iNewValue = iValue - 1; break;
+	case m3dsop_keep: default: return;
+	}
+
+	*io_pStencilData = (uint8)( ( iValue & ~m_RenderInfo.iStencilWriteMask ) | ( iNewValue & m_RenderInfo.iStencilWriteMask ) );
+}
+
+inline bool CMuli3DDevice::bStencilTest( uint8 *io_pStencilData )
+{
+	const uint32 iReference = m_RenderInfo.iStencilRef & m_RenderInfo.iStencilMask;
+	const uint32 iValue = *io_pStencilData & m_RenderInfo.iStencilMask;
+
+	bool bPassed;
+	switch( m_RenderInfo.StencilCompare )
+	{
+	case m3dcmp_never: bPassed = false; break;
+	case m3dcmp_equal: bPassed = iReference == iValue; break;
+	case m3dcmp_notequal: bPassed = iReference != iValue; break;
+	case m3dcmp_less: bPassed = iReference < iValue; break;
+	case m3dcmp_lessequal: bPassed = iReference <= iValue; break;
+	case m3dcmp_greaterequal: bPassed = iReference >= iValue; break;
+	case m3dcmp_greater: bPassed = iReference > iValue; break;
+	case m3dcmp_always: default: bPassed = true; break;
+	}
+
+	if( !bPassed )
+		UpdateStencil( io_pStencilData, m_RenderInfo.StencilFail );
+
+	return bPassed;
+}
+
+inline bool CMuli3DDevice::bStencilDepthTest( float32 i_fDepth, const float32 *i_pDepthData, uint8 *io_pStencilData )
+{
+	if( !bDepthBoundsTest( i_pDepthData ) )
+		return false;
+
+	if( !m_RenderInfo.bStencilTest )
+		return bDepthTest( i_fDepth, i_pDepthData );
+
+	if( !bStencilTest( io_pStencilData ) )
+		return false;
+
+	if( !bDepthTest( i_fDepth, i_pDepthData ) )
+	{
+		UpdateStencil( io_pStencilData, m_RenderInfo.StencilZFail );
+		return false;
+	}
+
+	return true;
+}
+
+inline void CMuli3DDevice::ReadPixelColor( vector4 &o_vColor, const float32 *i_pFrameData, uint32 i_iFloats )
+{
+	o_vColor = vector4( 0, 0, 0, 1 );
+	if( !m_RenderInfo.bReadDestColor )
+		return;
+
+	switch( i_iFloats )
+	{
+	case 4: o_vColor.a = i_pFrameData[3];
+	case 3: o_vColor.b = i_pFrameData[2];
+	case 2: o_vColor.g = i_pFrameData[1];
+	case 1: o_vColor.r = i_pFrameData[0];
+	}
+}
+
+inline void CMuli3DDevice::WritePixelColor( float32 *io_pFrameData, const vector4 &i_vColor, uint32 i_iFloats )
+{
+	// Every blend-function treats the channels alike, so that the loops can be vectorized.
+	const float32 *pSource = &i_vColor.r;
+	const uint32 iFloats = i_iFloats;
+	uint32 i;
+
+	switch( m_RenderInfo.BlendMode )
+	{
+	case m3dblend_alpha:
+		{
+			const float32 fSourceAlpha = i_vColor.a, fInvSourceAlpha = 1.0f - i_vColor.a;
+			for( i = 0; i < iFloats; ++i ) io_pFrameData[i] = pSource[i] * fSourceAlpha + io_pFrameData[i] * fInvSourceAlpha;
+		}
+		break;
+	case m3dblend_additive: for( i = 0; i < iFloats; ++i ) io_pFrameData[i] += pSource[i]; break;
+	case m3dblend_multiply: for( i = 0; i < iFloats; ++i ) io_pFrameData[i] *= pSource[i]; break;
+	case m3dblend_min: for( i = 0; i < iFloats; ++i ) io_pFrameData[i] = pSource[i] < io_pFrameData[i] ? pSource[i] : io_pFrameData[i]; break;
+	case m3dblend_max: for( i = 0; i < iFloats; ++i ) io_pFrameData[i] = pSource[i] > io_pFrameData[i] ? pSource[i] : io_pFrameData[i]; break;
+	case m3dblend_opaque: default: for( i = 0; i < iFloats; ++i ) io_pFrameData[i] = pSource[i]; break;
+	}
+}
+
+inline void CMuli3DDevice::ReadPixelColors( vector4 *o_pColors, const float32 *i_pFrameData, uint32 i_iX, uint32 i_iY )
+{
+	ReadPixelColor( o_pColors[0], i_pFrameData, m_RenderInfo.iColorFloats );
+	for( uint32 iBuffer = 1; iBuffer < m_RenderInfo.iNumColorBuffers; ++iBuffer )
+	{
+		const float32 *pFrameData = m_RenderInfo.pMRTData[iBuffer] + (i_iY * m_RenderInfo.iMRTPitch[iBuffer] + i_iX * m_RenderInfo.iMRTFloats[iBuffer]);
+		ReadPixelColor( o_pColors[iBuffer], pFrameData, m_RenderInfo.iMRTFloats[iBuffer] );
+	}
+}
+
+inline void CMuli3DDevice::WritePixelColors( float32 *io_pFrameData, uint32 i_iX, uint32 i_iY, const vector4 *i_pColors )
+{
+	WritePixelColor( io_pFrameData, i_pColors[0], m_RenderInfo.iColorFloats );
+	for( uint32 iBuffer = 1; iBuffer < m_RenderInfo.iNumColorBuffers; ++iBuffer )
+	{
+		float32 *pFrameData = m_RenderInfo.pMRTData[iBuffer] + (i_iY * m_RenderInfo.iMRTPitch[iBuffer] + i_iX * m_RenderInfo.iMRTFloats[iBuffer]);
+		WritePixelColor( pFrameData, i_pColors[iBuffer], m_RenderInfo.iMRTFloats[iBuffer] );
+	}
+}
+
+inline bool CMuli3DDevice::bExecutePixelShader( const shaderreg *i_pInput, vector4 *io_pColors, float32 &io_fDepth )
+{
+	if( m_RenderInfo.iNumColorBuffers > 1 )
+		return m_pPixelShader->bExecuteMRT( i_pInput, io_pColors, m_RenderInfo.iNumColorBuffers, io_fDepth );
+
+	return m_pPixelShader->bExecute( i_pInput, io_pColors[0], io_fDepth );
+}
+
+void CMuli3DDevice::RasterizeScanline_ColorOnly( uint32 i_iY, uint32 i_iX, uint32 i_iX2, m3dvsoutput *io_pVSOutput )
+{
+	float32 *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats);
+	float32 *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX);
+	uint8 *pStencilData = m_RenderInfo.pStencilData + (i_iY * m_RenderInfo.iStencilBufferPitch + i_iX);
+	//float32 *pFrameData = m_RenderInfo.pFrameData ? &m_RenderInfo.pFrameData[i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats ] : 0;
+	//float32 *pDepthData = m_RenderInfo.pDepthData ? &m_RenderInfo.pDepthData[i_iY * m_RenderInfo.iDepthBufferPitch + i_iX ] : 0;
+
+	for( ; i_iX < i_iX2; ++i_iX,
+		pFrameData += m_RenderInfo.iColorFloats, ++pDepthData, ++pStencilData,
+		StepXVSOutputFromGradient( io_pVSOutput ) )
+	{
+		// Get depth of current pixel
+		float32 fDepth = io_pVSOutput->vPosition.z;
+
+		// Perform stencil- and depth-test
+		if( !bStencilDepthTest( fDepth, pDepthData, pStencilData ) )
+			continue;
+
+		// passed depth test - update depth- and stencilbuffer!
+		if( m_RenderInfo.bDepthWrite )
+			*pDepthData = fDepth;
+		if( m_RenderInfo.bStencilTest )
+			UpdateStencil( pStencilData, m_RenderInfo.StencilPass );
+
+		if( m_RenderInfo.bColorWrite )
+		{
+			m3dvsoutput PSInput;
+			m_TriangleInfo.fCurPixelInvW = 1.0f / io_pVSOutput->vPosition.w;
+			MultiplyVertexShaderOutputRegisters( &PSInput, io_pVSOutput, m_TriangleInfo.fCurPixelInvW );
+			// note: PSInput now only contains valid register data, position etc. are not initialized!
+
+			// Read in current pixel's color in the colorbuffer
+			vector4 vPixelColors[c_iMaxColorBuffers];
+			ReadPixelColors( vPixelColors, pFrameData, i_iX, i_iY );
+
+			// Execute the pixel shader
+			m_TriangleInfo.iCurPixelX = i_iX;
+			bExecutePixelShader( PSInput.ShaderOutputs, vPixelColors, fDepth );
+
+			// Write the new color to the colorbuffer
+			WritePixelColors( pFrameData, i_iX, i_iY, vPixelColors );
+		}
+
+		++m_RenderInfo.iRenderedPixels;
+	}
+}
+
+void CMuli3DDevice::RasterizeScanline_ColorOnly_MightKillPixels( uint32 i_iY, uint32 i_iX, uint32 i_iX2, m3dvsoutput *io_pVSOutput )
+{
+	float32 *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats);
+	float32 *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX);
+	uint8 *pStencilData = m_RenderInfo.pStencilData + (i_iY * m_RenderInfo.iStencilBufferPitch + i_iX);
+	//float32 *pFrameData = m_RenderInfo.pFrameData ? &m_RenderInfo.pFrameData[i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats ] : 0;
+	//float32 *pDepthData = m_RenderInfo.pDepthData ? &m_RenderInfo.pDepthData[i_iY * m_RenderInfo.iDepthBufferPitch + i_iX ] : 0;
+
+	for( ; i_iX < i_iX2; ++i_iX,
+		pFrameData += m_RenderInfo.iColorFloats, ++pDepthData, ++pStencilData,
+		StepXVSOutputFromGradient( io_pVSOutput ) )
+	{
+		// Get depth of current pixel
+		float32 fDepth = io_pVSOutput->vPosition.z;
+
+		// Perform stencil- and depth-test
+		if( !bStencilDepthTest( fDepth, pDepthData, pStencilData ) )
+			continue;
+
+		if( m_RenderInfo.bColorWrite || m_RenderInfo.bDepthWrite || m_RenderInfo.bStencilTest )
+		{
+			m3dvsoutput PSInput;
+			m_TriangleInfo.fCurPixelInvW = 1.0f / io_pVSOutput->vPosition.w;
+			MultiplyVertexShaderOutputRegisters( &PSInput, io_pVSOutput, m_TriangleInfo.fCurPixelInvW );
+			// note: PSInput now only contains valid register data, position etc. are not initialized!
+
+			// Read in current pixel's color in the colorbuffer
+			vector4 vPixelColors[c_iMaxColorBuffers];
+			ReadPixelColors( vPixelColors, pFrameData, i_iX, i_iY );
+
+			// Execute the pixel shader
+			m_TriangleInfo.iCurPixelX = i_iX;
+			if( !bExecutePixelShader( PSInput.ShaderOutputs, vPixelColors, fDepth ) )
+				continue; // pixel got killed
+
+			// Passed depth-test and pixel was not killed, so update depth- and stencilbuffer
+			if( m_RenderInfo.bDepthWrite )
+				*pDepthData = fDepth;
+			if( m_RenderInfo.bStencilTest )
+				UpdateStencil( pStencilData, m_RenderInfo.StencilPass );
+
+			// Write the new color to the colorbuffer
+			if( m_RenderInfo.bColorWrite )
+				WritePixelColors( pFrameData, i_iX, i_iY, vPixelColors );
+		}
+
+		++m_RenderInfo.iRenderedPixels;
+	}
+}
+
+void CMuli3DDevice::RasterizeScanline_ColorDepth( uint32 i_iY, uint32 i_iX, uint32 i_iX2, m3dvsoutput *io_pVSOutput )
+{
+	float32 *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats);
+	float32 *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX);
+	uint8 *pStencilData = m_RenderInfo.pStencilData + (i_iY * m_RenderInfo.iStencilBufferPitch + i_iX);
+	//float32 *pFrameData = m_RenderInfo.pFrameData ? &m_RenderInfo.pFrameData[i_iY * m_RenderInfo.iColorBufferPitch + i_iX] : 0;
+	//float32 *pDepthData = m_RenderInfo.pDepthData ? &m_RenderInfo.pDepthData[i_iY * m_RenderInfo.iDepthBufferPitch + i_iX] : 0;
+
+	for( ; i_iX < i_iX2; ++i_iX,
+		pFrameData += m_RenderInfo.iColorFloats, ++pDepthData, ++pStencilData,
+		StepXVSOutputFromGradient( io_pVSOutput ) )
+	{
+		// Perform depth bounds- and stencil-test - the depth-test has to wait for the pixel shader
+		if( !bDepthBoundsTest( pDepthData ) || ( m_RenderInfo.bStencilTest && !bStencilTest( pStencilData ) ) )
+			continue;
+
+		m3dvsoutput PSInput;
+		m_TriangleInfo.fCurPixelInvW = 1.0f / io_pVSOutput->vPosition.w;
+		MultiplyVertexShaderOutputRegisters( &PSInput, io_pVSOutput, m_TriangleInfo.fCurPixelInvW );
+		// note: PSInput now only contains valid register data, position etc. are not initialized!
+
+		// Read in current colorbuffer-color
+		vector4 vPixelColors[c_iMaxColorBuffers];
+		ReadPixelColors( vPixelColors, pFrameData, i_iX, i_iY );
+
+		// Get depth of current pixel
+		float32 fDepth = io_pVSOutput->vPosition.z;
+
+		// Execute pixel shader
+		m_TriangleInfo.iCurPixelX = i_iX;
+		if( !bExecutePixelShader( PSInput.ShaderOutputs, vPixelColors, fDepth ) )
+			continue; // pixel got killed
+
+		// Perform depth-test
+		if( !bDepthTest( fDepth, pDepthData ) )
+		{
+			if( m_RenderInfo.bStencilTest )
+				UpdateStencil( pStencilData, m_RenderInfo.StencilZFail );
+			continue;
+		}
+
+		// Passed depth-test, so update depth- and stencilbuffer
+		if( m_RenderInfo.bDepthWrite )
+			*pDepthData = fDepth;
+		if( m_RenderInfo.bStencilTest )
+			UpdateStencil( pStencilData, m_RenderInfo.StencilPass );
+
+		// Write new color to colorbuffer
+		if( m_RenderInfo.bColorWrite )
+			WritePixelColors( pFrameData, i_iX, i_iY, vPixelColors );
+
+		++m_RenderInfo.iRenderedPixels;
+	}
+}
+
+/// Number of pixels RasterizeScanline_DepthOnly() processes at once.
+const uint32 c_iDepthOnlyBlockSize = 8;
+
+/// Depth-tests a block of pixels and writes the depth of the pixels that pass, if requested.
+/// The loops have a fixed trip count and are free of branches, which allows the compiler to vectorize them.
+/// @param[in,out] io_pDepthData depthbuffer data of the block; at least i_iPixels entries have to be accessible.
+/// @param[in] i_pDepths interpolated depths of the pixels.
+/// @param[in] i_iPixels number of pixels to be processed, e [1,c_iDepthOnlyBlockSize]; remaining entries are neither read nor written.
+/// @param[in] i_DepthCompare depth compare-function.
+/// @param[in] i_bDepthWrite true to write the depth of the pixels that passed.
+/// @return number of pixels that passed the depth-test.
+static uint32 iDepthTestBlock( float32 *io_pDepthData, const float32 *i_pDepths, uint32 i_iPixels,
+	m3dcmpfunc i_DepthCompare, bool i_bDepthWrite )
+{
+	float32 fDepthData[c_iDepthOnlyBlockSize];
+	uint32 iPassed[c_iDepthOnlyBlockSize];
+	uint32 i;
+
+	if( i_iPixels == c_iDepthOnlyBlockSize )
+		for( i = 0; i < c_iDepthOnlyBlockSize; ++i ) fDepthData[i] = io_pDepthData[i];
+	else
+	{
+		// Partial block: pad with the block's own depths; the results of the padding are masked out below.
+		for( i = 0; i < c_iDepthOnlyBlockSize; ++i ) fDepthData[i] = i_pDepths[i];
+		for( i = 0; i < i_iPixels; ++i ) fDepthData[i] = io_pDepthData[i];
+	}
+
+	switch( i_DepthCompare )
+	{
+	case m3dcmp_equal: for( i = 0; i < c_iDepthOnlyBlockSize; ++i ) iPassed[i] = fabsf( i_pDepths[i] - fDepthData[i] ) < FLT_EPSILON; break;
+	case m3dcmp_notequal: for( i = 0; i < c_iDepthOnlyBlockSize; ++i ) iPassed[i] = fabsf( i_pDepths[i] - fDepthData[i] ) >= FLT_EPSILON; break;
+	case m3dcmp_less: for( i = 0; i < c_iDepthOnlyBlockSize; ++i ) iPassed[i] = i_pDepths[i] < fDepthData[i]; break;
+	case m3dcmp_lessequal: for( i = 0; i < c_iDepthOnlyBlockSize; ++i ) iPassed[i] = i_pDepths[i] <= fDepthData[i]; break;
+	case m3dcmp_greaterequal: for( i = 0; i < c_iDepthOnlyBlockSize; ++i ) iPassed[i] = i_pDepths[i] >= fDepthData[i]; break;
+	case m3dcmp_greater: for( i = 0; i < c_iDepthOnlyBlockSize; ++i ) iPassed[i] = i_pDepths[i] > fDepthData[i]; break;
+	case m3dcmp_always: for( i = 0; i < c_iDepthOnlyBlockSize; ++i ) iPassed[i] = 1; break;
+	default: return 0; // m3dcmp_never
+	}
+
+	uint32 iNumPassed = 0;
+	for( i = 0; i < c_iDepthOnlyBlockSize; ++i )
+	{
+		if( i >= i_iPixels ) iPassed[i] = 0;
+		iNumPassed += iPassed[i];
+	}
+
+	if( i_bDepthWrite && iNumPassed )
+	{
+		for( i = 0; i < c_iDepthOnlyBlockSize; ++i )
+			fDepthData[i] = iPassed[i] ? i_pDepths[i] : fDepthData[i];
+
+		for( i = 0; i < i_iPixels; ++i ) io_pDepthData[i] = fDepthData[i];
+	}
+
+	return iNumPassed;
+}
+
+void CMuli3DDevice::RasterizeScanline_DepthOnly( uint32 i_iY, uint32 i_iX, uint32 i_iX2, float32 i_fDepth )
+{
+	if( (int32)i_iX >= (int32)i_iX2 )
+		return;
+
+	uint32 iPixels = i_iX2 - i_iX;
+	if( m_RenderInfo.bStencilTest || m_RenderInfo.bDepthBoundsTest )
+	{
+		// The stencil-operations and the depth bounds-test depend on each pixel, so pixels are processed individually.
+		float32 *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX);
+		uint8 *pStencilData = m_RenderInfo.pStencilData + (i_iY * m_RenderInfo.iStencilBufferPitch + i_iX);
+		float32 fDepth = i_fDepth;
+		for( ; iPixels; --iPixels, ++pDepthData, ++pStencilData, fDepth += m_TriangleInfo.fZDdx )
+		{
+			if( !bStencilDepthTest( fDepth, pDepthData, pStencilData ) )
+				continue;
+
+			if( m_RenderInfo.bDepthWrite )
+				*pDepthData = fDepth;
+			if( m_RenderInfo.bStencilTest )
+				UpdateStencil( pStencilData, m_RenderInfo.StencilPass );
+
+			++m_RenderInfo.iRenderedPixels;
+		}
+		return;
+	}
+
+	if( !m_RenderInfo.pDepthData )
+	{
+		// No depthbuffer: every pixel passes and there is nothing to be written.
+		m_RenderInfo.iRenderedPixels += iPixels;
+		return;
+	}
+
+	float32 *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX);
+	const m3dcmpfunc DepthCompare = m_RenderInfo.DepthCompare;
+	const bool bDepthWrite = m_RenderInfo.bDepthWrite;
+	const float32 fZDdx = m_TriangleInfo.fZDdx;
+
+	float32 fDepth = i_fDepth;
+	float32 fDepths[c_iDepthOnlyBlockSize];
+	while( iPixels )
+	{
+		const uint32 iBlockPixels = iPixels < c_iDepthOnlyBlockSize ? iPixels : c_iDepthOnlyBlockSize;
+
+		// Step depth exactly like StepXVSOutputFromGradient() does.
+		for( uint32 i = 0; i < c_iDepthOnlyBlockSize; ++i, fDepth += fZDdx )
+			fDepths[i] = fDepth;
+
+		m_RenderInfo.iRenderedPixels += iDepthTestBlock( pDepthData, fDepths, iBlockPixels, DepthCompare, bDepthWrite );
+
+		pDepthData += iBlockPixels;
+		iPixels -= iBlockPixels;
+	}
+}
+
+void CMuli3DDevice::DrawPixel_DepthOnly( uint32 i_iX, uint32 i_iY, const m3dvsoutput *i_pVSOutput )
+{
+	float32 *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX);
+	uint8 *pStencilData = m_RenderInfo.pStencilData + (i_iY * m_RenderInfo.iStencilBufferPitch + i_iX);
+	if( !bStencilDepthTest( i_pVSOutput->vPosition.z, pDepthData, pStencilData ) )
+		return;
+
+	if( m_RenderInfo.bDepthWrite )
+		*pDepthData = i_pVSOutput->vPosition.z;
+	if( m_RenderInfo.bStencilTest )
+		UpdateStencil( pStencilData, m_RenderInfo.StencilPass );
+
+	++m_RenderInfo.iRenderedPixels;
+}
+
+void CMuli3DDevice::DrawPixel_MultiSample( uint32 i_iX, uint32 i_iY, const m3dvsoutput *i_pVSOutput )
+{
+	m_TriangleInfo.iCurPixelY = i_iY;
+	m_TriangleInfo.iCurSpanX = i_iX;
+	ShadeMultiSamplePixel( i_iX, i_iY, ( 1 << m_RenderInfo.iSamples ) - 1, i_pVSOutput, false );
+}
+
+// LINES & POINTS -------------------------------------------------------------
+
+void CMuli3DDevice::RasterizeLine( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1 )
+{
+	const vector4 &vA = i_pVSOutput0->vPosition;
+	const vector4 &vB = i_pVSOutput1->vPosition;
+
+	const uint32 iIntCoordsA[2] = { ftol( vA.x ), ftol( vA.y ) };
+	const float32 fDeltaX = vB.x - vA.x, fDeltaY = vB.y - vA.y;
+
+	const int32 iLineThicknessHalf = -((int32)(m_iRenderStates[m3drs_linethickness] / 2));
+	const int32 iPosOffset = ( m_iRenderStates[m3drs_linethickness] & 1 ) ? 0 : 1;
+
+	if( fabsf( fDeltaX ) > fabsf( fDeltaY ) )
+	{
+		// drawing a line which is more horizontal than vertical
+		const int32 iPixelsX = ftol( fDeltaX );
+		if( !iPixelsX )
+			return;
 
 		const int32 iSignX = iPixelsX > 0 ? 1 : -1;
 		const float32 fSlope = fDeltaY / fDeltaX;
@@ -2355,6 +4252,8 @@ void CMuli3DDevice::RasterizeLine( const m3dvsoutput *i_pVSOutput0, const m3dvso
 		{
 			const uint32 iPixelX = iIntCoordsA[0] + i;
 			const uint32 iPixelY = iIntCoordsA[1] + ftol( fSlope * i );
+			if( (int32)iPixelX < (int32)m_RenderInfo.RasterRect.iLeft || (int32)iPixelX >= (int32)m_RenderInfo.RasterRect.iRight )
+				continue; // lines aren't clipped to the viewport
 
 			m3dvsoutput PSInput;
 			SetVSOutputFromGradient( &PSInput, (float32)iPixelX, (float32)iPixelY );
@@ -2362,14 +4261,17 @@ void CMuli3DDevice::RasterizeLine( const m3dvsoutput *i_pVSOutput0, const m3dvso
 			MultiplyVertexShaderOutputRegisters( &PSInput, &PSInput, m_TriangleInfo.fCurPixelInvW );
 
 			if( !iLineThicknessHalf )
-				(*this.*m_RenderInfo.fpDrawPixel)( iPixelX, iPixelY, &PSInput );
+			{
+				if( (int32)iPixelY >= (int32)m_RenderInfo.RasterRect.iTop && (int32)iPixelY < (int32)m_RenderInfo.RasterRect.iBottom )
+					(*this.*m_RenderInfo.fpDrawPixel)( iPixelX, iPixelY, &PSInput );
+			}
 			else
 			{
 				for( int32 j = iLineThicknessHalf + iPosOffset; j <= -iLineThicknessHalf; ++j )
 				{
 					const int32 iNewPixelY = iPixelY + j;
-					if( iNewPixelY < (int32)m_RenderInfo.ViewportRect.iTop ||
-						iNewPixelY >= (int32)m_RenderInfo.ViewportRect.iBottom )
+					if( iNewPixelY < (int32)m_RenderInfo.RasterRect.iTop ||
+						iNewPixelY >= (int32)m_RenderInfo.RasterRect.iBottom )
 					{
 						continue;
 					}
@@ -2395,6 +4297,8 @@ void CMuli3DDevice::RasterizeLine( const m3dvsoutput *i_pVSOutput0, const m3dvso
 		{
 			const uint32 iPixelX = iIntCoordsA[0] + ftol( fSlope * i );
 			const uint32 iPixelY = iIntCoordsA[1] + i;
+			if( (int32)iPixelY < (int32)m_RenderInfo.RasterRect.iTop || (int32)iPixelY >= (int32)m_RenderInfo.RasterRect.iBottom )
+				continue; // lines aren't clipped to the viewport
 
 			m3dvsoutput PSInput;
 			SetVSOutputFromGradient( &PSInput, (float32)iPixelX, (float32)iPixelY );
@@ -2402,14 +4306,17 @@ void CMuli3DDevice::RasterizeLine( const m3dvsoutput *i_pVSOutput0, const m3dvso
 			MultiplyVertexShaderOutputRegisters( &PSInput, &PSInput, m_TriangleInfo.fCurPixelInvW );
 
 			if( !iLineThicknessHalf )
-				(*this.*m_RenderInfo.fpDrawPixel)( iPixelX, iPixelY, &PSInput );
+			{
+				if( (int32)iPixelX >= (int32)m_RenderInfo.RasterRect.iLeft && (int32)iPixelX < (int32)m_RenderInfo.RasterRect.iRight )
+					(*this.*m_RenderInfo.fpDrawPixel)( iPixelX, iPixelY, &PSInput );
+			}
 			else
 			{
 				for( int32 j = iLineThicknessHalf + iPosOffset; j <= -iLineThicknessHalf; ++j )
 				{
 					const int32 iNewPixelX = iPixelX + j;
-					if( iNewPixelX < (int32)m_RenderInfo.ViewportRect.iLeft ||
-						iNewPixelX >= (int32)m_RenderInfo.ViewportRect.iRight )
+					if( iNewPixelX < (int32)m_RenderInfo.RasterRect.iLeft ||
+						iNewPixelX >= (int32)m_RenderInfo.RasterRect.iRight )
 					{
 						continue;
 					}
@@ -2425,57 +4332,38 @@ void CMuli3DDevice::DrawPixel_ColorOnly( uint32 i_iX, uint32 i_iY, const m3dvsou
 {
 	float32 *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats);
 	float32 *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX);
+	uint8 *pStencilData = m_RenderInfo.pStencilData + (i_iY * m_RenderInfo.iStencilBufferPitch + i_iX);
 	//float32 *pFrameData = m_RenderInfo.pFrameData ? &m_RenderInfo.pFrameData[i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats ] : 0;
 	//float32 *pDepthData = m_RenderInfo.pDepthData ? &m_RenderInfo.pDepthData[i_iY * m_RenderInfo.iDepthBufferPitch + i_iX ] : 0;
 
-	// Perform depth-test
-	switch( m_RenderInfo.DepthCompare )
-	{
-	case m3dcmp_never: return;
-	case m3dcmp_equal: if( fabsf( i_pVSOutput->vPosition.z - *pDepthData ) < FLT_EPSILON ) break; else return;
-	case m3dcmp_notequal: if( fabsf( i_pVSOutput->vPosition.z - *pDepthData ) >= FLT_EPSILON ) break; else return;
-	case m3dcmp_less: if( i_pVSOutput->vPosition.z < *pDepthData ) break; else return;
-	case m3dcmp_lessequal: if( i_pVSOutput->vPosition.z <= *pDepthData ) break; else return;
-	case m3dcmp_greaterequal: if( i_pVSOutput->vPosition.z >= *pDepthData ) break; else return;
-	case m3dcmp_greater: if( i_pVSOutput->vPosition.z > *pDepthData ) break; else return;
-	case m3dcmp_always: break;
-	}
+	// Perform stencil- and depth-test
+	if( !bStencilDepthTest( i_pVSOutput->vPosition.z, pDepthData, pStencilData ) )
+		return;
 
-	if( m_RenderInfo.bColorWrite || m_RenderInfo.bDepthWrite )
+	if( m_RenderInfo.bColorWrite || m_RenderInfo.bDepthWrite || m_RenderInfo.bStencilTest )
 	{
 		// Read in current pixel's color in the colorbuffer
-		vector4 vPixelColor( 0, 0, 0, 1 );
-		switch( m_RenderInfo.iColorFloats )
-		{
-		case 4: vPixelColor.a = pFrameData[3];
-		case 3: vPixelColor.b = pFrameData[2];
-		case 2: vPixelColor.g = pFrameData[1];
-		case 1: vPixelColor.r = pFrameData[0];
-		}
+		vector4 vPixelColors[c_iMaxColorBuffers];
+		ReadPixelColors( vPixelColors, pFrameData, i_iX, i_iY );
 
 		// Execute the pixel shader
 		float32 fPSDepth = i_pVSOutput->vPosition.z; // if we passed i_pVSOutput->vPosition.z directly to the pixel shader, it might modify it, which is not allowed in this function
 		m_TriangleInfo.iCurPixelX = i_iX;
 		m_TriangleInfo.iCurPixelY = i_iY;
+		m_TriangleInfo.iCurSpanX = i_iX;
 
-		if( !m_pPixelShader->bExecute( i_pVSOutput->ShaderOutputs, vPixelColor, fPSDepth ) )
+		if( !bExecutePixelShader( i_pVSOutput->ShaderOutputs, vPixelColors, fPSDepth ) )
 			return; // pixel got killed
 
-		// Passed depth-test and pixel was not killed, so update depthbuffer
+		// Passed depth-test and pixel was not killed, so update depth- and stencilbuffer
 		if( m_RenderInfo.bDepthWrite )
 			*pDepthData = i_pVSOutput->vPosition.z;
+		if( m_RenderInfo.bStencilTest )
+			UpdateStencil( pStencilData, m_RenderInfo.StencilPass );
 
 		// Write the new color to the colorbuffer
 		if( m_RenderInfo.bColorWrite )
-		{
-			switch( m_RenderInfo.iColorFloats )
-			{
-			case 4: pFrameData[3] = vPixelColor.a;
-			case 3: pFrameData[2] = vPixelColor.b;
-			case 2: pFrameData[1] = vPixelColor.g;
-			case 1: pFrameData[0] = vPixelColor.r;
-			}
-		}
+			WritePixelColors( pFrameData, i_iX, i_iY, vPixelColors );
 	}
 
 	++m_RenderInfo.iRenderedPixels;
@@ -2485,55 +4373,44 @@ void CMuli3DDevice::DrawPixel_ColorDepth( uint32 i_iX, uint32 i_iY, const m3dvso
 {
 	float32 *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats);
 	float32 *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX);
+	uint8 *pStencilData = m_RenderInfo.pStencilData + (i_iY * m_RenderInfo.iStencilBufferPitch + i_iX);
 	//float32 *pFrameData = m_RenderInfo.pFrameData ? &m_RenderInfo.pFrameData[i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats ] : 0;
 	//float32 *pDepthData = m_RenderInfo.pDepthData ? &m_RenderInfo.pDepthData[i_iY * m_RenderInfo.iDepthBufferPitch + i_iX ] : 0;
 
+	// Perform depth bounds- and stencil-test - the depth-test has to wait for the pixel shader
+	if( !bDepthBoundsTest( pDepthData ) || ( m_RenderInfo.bStencilTest && !bStencilTest( pStencilData ) ) )
+		return;
+
 	// Read in current pixel's color in the colorbuffer
-	vector4 vPixelColor( 0, 0, 0, 1 );
-	switch( m_RenderInfo.iColorFloats )
-	{
-	case 4: vPixelColor.a = pFrameData[3];
-	case 3: vPixelColor.b = pFrameData[2];
-	case 2: vPixelColor.g = pFrameData[1];
-	case 1: vPixelColor.r = pFrameData[0];
-	}
+	vector4 vPixelColors[c_iMaxColorBuffers];
+	ReadPixelColors( vPixelColors, pFrameData, i_iX, i_iY );
 
 	// Execute the pixel shader
 	float32 fPSDepth = i_pVSOutput->vPosition.z;
 	m_TriangleInfo.iCurPixelX = i_iX;
 	m_TriangleInfo.iCurPixelY = i_iY;
+	m_TriangleInfo.iCurSpanX = i_iX;
 
-	if( !m_pPixelShader->bExecute( i_pVSOutput->ShaderOutputs, vPixelColor, fPSDepth ) )
+	if( !bExecutePixelShader( i_pVSOutput->ShaderOutputs, vPixelColors, fPSDepth ) )
 		return; // pixel got killed
 
 	// Perform depth-test
-	switch( m_RenderInfo.DepthCompare )
+	if( !bDepthTest( fPSDepth, pDepthData ) )
 	{
-	case m3dcmp_never: return;
-	case m3dcmp_equal: if( fabsf( fPSDepth - *pDepthData ) < FLT_EPSILON ) break; else return;
-	case m3dcmp_notequal: if( fabsf( fPSDepth - *pDepthData ) >= FLT_EPSILON ) break; else return;
-	case m3dcmp_less: if( fPSDepth < *pDepthData ) break; else return;
-	case m3dcmp_lessequal: if( fPSDepth <= *pDepthData ) break; else return;
-	case m3dcmp_greaterequal: if( fPSDepth >= *pDepthData ) break; else return;
-	case m3dcmp_greater: if( fPSDepth > *pDepthData ) break; else return;
-	case m3dcmp_always: break;
+		if( m_RenderInfo.bStencilTest )
+			UpdateStencil( pStencilData, m_RenderInfo.StencilZFail );
+		return;
 	}
 
-	// Passed depth-test and pixel was not killed, so update depthbuffer
+	// Passed depth-test and pixel was not killed, so update depth- and stencilbuffer
 	if( m_RenderInfo.bDepthWrite )
 		*pDepthData = fPSDepth;
+	if( m_RenderInfo.bStencilTest )
+		UpdateStencil( pStencilData, m_RenderInfo.StencilPass );
 
 	// Write the new color to the colorbuffer
 	if( m_RenderInfo.bColorWrite )
-	{
-		switch( m_RenderInfo.iColorFloats )
-		{
-		case 4: pFrameData[3] = vPixelColor.a;
-		case 3: pFrameData[2] = vPixelColor.b;
-		case 2: pFrameData[1] = vPixelColor.g;
-		case 1: pFrameData[0] = vPixelColor.r;
-		}
-	}
+		WritePixelColors( pFrameData, i_iX, i_iY, vPixelColors );
 
 	++m_RenderInfo.iRenderedPixels;
 }
@@ -19,18 +19,23 @@
 
 #include "../../include/core/m3dcore_rendertarget.h"
 #include "../../include/core/m3dcore_device.h"
+#include "../../include/core/m3dcore_stencilbuffer.h"
 #include "../../include/core/m3dcore_surface.h"
 
 CMuli3DRenderTarget::CMuli3DRenderTarget( CMuli3DDevice *i_pParent )
-	: m_pParent( i_pParent ), m_pColorBuffer( 0 ), m_pDepthBuffer( 0 )
+	: m_pParent( i_pParent ), m_pDepthBuffer( 0 ), m_pStencilBuffer( 0 )
 {
 	m_pParent->AddRef();
+
+	memset( m_pColorBuffers, 0, sizeof( m_pColorBuffers ) );
 }
 
 CMuli3DRenderTarget::~CMuli3DRenderTarget()
 {
-	SAFE_RELEASE( m_pColorBuffer );
+	for( uint32 iBuffer = 0; iBuffer < c_iMaxColorBuffers; ++iBuffer )
+		SAFE_RELEASE( m_pColorBuffers[iBuffer] );
 	SAFE_RELEASE( m_pDepthBuffer );
+	SAFE_RELEASE( m_pStencilBuffer );
 
 	SAFE_RELEASE( m_pParent );
 }
@@ -44,13 +49,23 @@ CMuli3DDevice *CMuli3DRenderTarget::pGetDevice()
 
 result CMuli3DRenderTarget::ClearColorBuffer( const vector4 &i_vColor, const m3drect *i_pRect )
 {
-	if( !m_pColorBuffer )
+	if( !pGetReferenceColorBuffer( c_iMaxColorBuffers ) )
 	{
-		FUNC_FAILING( "CMuli3DRenderTarget::ClearColorBuffer: no framebuffer has been set.\n" );
+		FUNC_FAILING( "CMuli3DRenderTarget::ClearColorBuffer: no colorbuffer has been set.\n" );
 		return e_invalidstate;
 	}
 
-	return m_pColorBuffer->Clear( i_vColor, i_pRect );
+	for( uint32 iBuffer = 0; iBuffer < c_iMaxColorBuffers; ++iBuffer )
+	{
+		if( !m_pColorBuffers[iBuffer] )
+			continue;
+
+		result resClear = m_pColorBuffers[iBuffer]->Clear( i_vColor, i_pRect );
+		if( FUNC_FAILED( resClear ) )
+			return resClear;
+	}
+
+	return s_ok;
 }
 
 result CMuli3DRenderTarget::ClearDepthBuffer( float32 i_fDepth, const m3drect *i_pRect )
@@ -64,8 +79,30 @@ result CMuli3DRenderTarget::ClearDepthBuffer( float32 i_fDepth, const m3drect *i
 	return m_pDepthBuffer->Clear( vector4( i_fDepth, 0, 0, 0 ), i_pRect );
 }
 
+result CMuli3DRenderTarget::ClearStencilBuffer( uint8 i_iValue, const m3drect *i_pRect )
+{
+	if( !m_pStencilBuffer )
+	{
+		FUNC_FAILING( "CMuli3DRenderTarget::ClearStencilBuffer: no stencil buffer has been set.\n" );
+		return e_invalidstate;
+	}
+
+	return m_pStencilBuffer->Clear( i_iValue, i_pRect );
+}
+
 result CMuli3DRenderTarget::SetColorBuffer( CMuli3DSurface *i_pColorBuffer )
 {
+	return SetColorBuffer( 0, i_pColorBuffer );
+}
+
+result CMuli3DRenderTarget::SetColorBuffer( uint32 i_iIndex, CMuli3DSurface *i_pColorBuffer )
+{
+	if( i_iIndex >= c_iMaxColorBuffers )
+	{
+		FUNC_FAILING( "CMuli3DRenderTarget::SetColorBuffer: invalid colorbuffer index.\n" );
+		return e_invalidparameters;
+	}
+
 	if( i_pColorBuffer )
 	{
 		if( i_pColorBuffer->fmtGetFormat() < m3dfmt_r32f || i_pColorBuffer->fmtGetFormat() > m3dfmt_r32g32b32a32f )
@@ -74,6 +111,32 @@ result CMuli3DRenderTarget::SetColorBuffer( CMuli3DSurface *i_pColorBuffer )
 			return e_invalidformat;
 		}
 
+		for( uint32 iBuffer = 0; iBuffer < c_iMaxColorBuffers; ++iBuffer )
+		{
+			if( iBuffer != i_iIndex && m_pColorBuffers[iBuffer] == i_pColorBuffer )
+			{
+				FUNC_FAILING( "CMuli3DRenderTarget::SetColorBuffer: surface is already set as another colorbuffer.\n" );
+				return e_invalidparameters;
+			}
+		}
+
+		CMuli3DSurface *pColorBuffer = pGetReferenceColorBuffer( i_iIndex );
+		if( pColorBuffer )
+		{
+			if( pColorBuffer->iGetWidth() != i_pColorBuffer->iGetWidth() ||
+				pColorBuffer->iGetHeight() != i_pColorBuffer->iGetHeight() )
+			{
+				FUNC_FAILING( "CMuli3DDevice::SetColorBuffer: framebuffer dimensions are not equal.\n" );
+				return e_invalidformat;
+			}
+
+			if( pColorBuffer->iGetSamples() != i_pColorBuffer->iGetSamples() )
+			{
+				FUNC_FAILING( "CMuli3DDevice::SetColorBuffer: framebuffer sample counts are not equal.\n" );
+				return e_invalidformat;
+			}
+		}
+
 		if( m_pDepthBuffer )
 		{
 			if( m_pDepthBuffer->iGetWidth() != i_pColorBuffer->iGetWidth() ||
@@ -82,12 +145,28 @@ result CMuli3DRenderTarget::SetColorBuffer( CMuli3DSurface *i_pColorBuffer )
 				FUNC_FAILING( "CMuli3DDevice::SetColorBuffer: framebuffer and depthbuffer dimensions are not equal.\n" );
 				return e_invalidformat;
 			}
+
+			if( m_pDepthBuffer->iGetSamples() != i_pColorBuffer->iGetSamples() )
+			{
+				FUNC_FAILING( "CMuli3DDevice::SetColorBuffer: framebuffer and depthbuffer sample counts are not equal.\n" );
+				return e_invalidformat;
+			}
+		}
+
+		if( m_pStencilBuffer )
+		{
+			if( m_pStencilBuffer->iGetWidth() != i_pColorBuffer->iGetWidth() ||
+				m_pStencilBuffer->iGetHeight() != i_pColorBuffer->iGetHeight() )
+			{
+				FUNC_FAILING( "CMuli3DDevice::SetColorBuffer: framebuffer and stencil buffer dimensions are not equal.\n" );
+				return e_invalidformat;
+			}
 		}
 	}
 
-	SAFE_RELEASE( m_pColorBuffer );
-	m_pColorBuffer = i_pColorBuffer;
-	if( m_pColorBuffer ) m_pColorBuffer->AddRef();
+	SAFE_RELEASE( m_pColorBuffers[i_iIndex] );
+	m_pColorBuffers[i_iIndex] = i_pColorBuffer;
+	if( m_pColorBuffers[i_iIndex] ) m_pColorBuffers[i_iIndex]->AddRef();
 	return s_ok;
 }
 
@@ -101,14 +180,31 @@ result CMuli3DRenderTarget::SetDepthBuffer( CMuli3DSurface *i_pDepthBuffer )
 			return e_invalidformat;
 		}
 
-		if( m_pColorBuffer )
+		CMuli3DSurface *pColorBuffer = pGetReferenceColorBuffer( c_iMaxColorBuffers );
+		if( pColorBuffer )
 		{
-			if( i_pDepthBuffer->iGetWidth() != m_pColorBuffer->iGetWidth() ||
-				i_pDepthBuffer->iGetHeight() != m_pColorBuffer->iGetHeight() )
+			if( i_pDepthBuffer->iGetWidth() != pColorBuffer->iGetWidth() ||
+				i_pDepthBuffer->iGetHeight() != pColorBuffer->iGetHeight() )
 			{
 				FUNC_FAILING( "CMuli3DDevice::SetDepthBuffer: depthbuffer and framebuffer dimensions are not equal.\n" );
 				return e_invalidformat;
 			}
+
+			if( i_pDepthBuffer->iGetSamples() != pColorBuffer->iGetSamples() )
+			{
+				FUNC_FAILING( "CMuli3DDevice::SetDepthBuffer: depthbuffer and framebuffer sample counts are not equal.\n" );
+				return e_invalidformat;
+			}
+		}
+
+		if( m_pStencilBuffer )
+		{
+			if( m_pStencilBuffer->iGetWidth() != i_pDepthBuffer->iGetWidth() ||
+				m_pStencilBuffer->iGetHeight() != i_pDepthBuffer->iGetHeight() )
+			{
+				FUNC_FAILING( "CMuli3DDevice::SetDepthBuffer: depthbuffer and stencil buffer dimensions are not equal.\n" );
+				return e_invalidformat;
+			}
 		}
 	}
 
@@ -118,12 +214,43 @@ result CMuli3DRenderTarget::SetDepthBuffer( CMuli3DSurface *i_pDepthBuffer )
 	return s_ok;
 }
 
+result CMuli3DRenderTarget::SetStencilBuffer( CMuli3DStencilBuffer *i_pStencilBuffer )
+{
+	if( i_pStencilBuffer )
+	{
+		CMuli3DSurface *pBuffer = pGetReferenceColorBuffer( c_iMaxColorBuffers );
+		if( !pBuffer ) pBuffer = m_pDepthBuffer;
+		if( pBuffer )
+		{
+			if( i_pStencilBuffer->iGetWidth() != pBuffer->iGetWidth() ||
+				i_pStencilBuffer->iGetHeight() != pBuffer->iGetHeight() )
+			{
+				FUNC_FAILING( "CMuli3DDevice::SetStencilBuffer: stencil buffer and frame-/depthbuffer dimensions are not equal.\n" );
+				return e_invalidformat;
+			}
+		}
+	}
+
+	SAFE_RELEASE( m_pStencilBuffer );
+	m_pStencilBuffer = i_pStencilBuffer;
+	if( m_pStencilBuffer ) m_pStencilBuffer->AddRef();
+	return s_ok;
+}
+
 CMuli3DSurface *CMuli3DRenderTarget::pGetColorBuffer()
 {
-	if( m_pColorBuffer )
-		m_pColorBuffer->AddRef();
+	return pGetColorBuffer( 0 );
+}
+
+CMuli3DSurface *CMuli3DRenderTarget::pGetColorBuffer( uint32 i_iIndex )
+{
+	if( i_iIndex >= c_iMaxColorBuffers )
+		return 0;
+
+	if( m_pColorBuffers[i_iIndex] )
+		m_pColorBuffers[i_iIndex]->AddRef();
 	
-	return m_pColorBuffer;
+	return m_pColorBuffers[i_iIndex];
 }
 
 CMuli3DSurface *CMuli3DRenderTarget::pGetDepthBuffer()
@@ -134,6 +261,14 @@ CMuli3DSurface *CMuli3DRenderTarget::pGetDepthBuffer()
 	return m_pDepthBuffer;
 }
 
+CMuli3DStencilBuffer *CMuli3DRenderTarget::pGetStencilBuffer()
+{
+	if( m_pStencilBuffer )
+		m_pStencilBuffer->AddRef();
+	
+	return m_pStencilBuffer;
+}
+
 void CMuli3DRenderTarget::SetViewportMatrix( const matrix44 &i_matViewport )
 {
 	m_matViewport = i_matViewport;
@@ -143,3 +278,14 @@ const matrix44 &CMuli3DRenderTarget::matGetViewportMatrix()
 {
 	return m_matViewport;
 }
+
+CMuli3DSurface *CMuli3DRenderTarget::pGetReferenceColorBuffer( uint32 i_iSkipIndex )
+{
+	for( uint32 iBuffer = 0; iBuffer < c_iMaxColorBuffers; ++iBuffer )
+	{
+		if( iBuffer != i_iSkipIndex && m_pColorBuffers[iBuffer] )
+			return m_pColorBuffers[iBuffer];
+	}
+
+	return 0;
+}
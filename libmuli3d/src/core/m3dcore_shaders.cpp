@@ -23,6 +23,18 @@ void IMuli3DPixelShader::SetInfo( const m3dshaderregtype *i_pVSOutputs, const st
 {
 	m_pVSOutputs = i_pVSOutputs;
 	m_pTriangleInfo = i_pTriangleInfo;
+	m_iCachedRegisters = 0;
+}
+
+bool IMuli3DPixelShader::bExecuteMRT( const shaderreg *i_pInput, vector4 *io_pColors, uint32 i_iNumColors, float32 &io_fDepth )
+{
+	if( !bExecute( i_pInput, io_pColors[0], io_fDepth ) )
+		return false;
+
+	for( uint32 iColor = 1; iColor < i_iNumColors; ++iColor )
+		io_pColors[iColor] = io_pColors[0];
+
+	return true;
 }
 
 // Partial derivative equations taken from
@@ -36,6 +48,20 @@ void IMuli3DPixelShader::GetDerivatives( uint32 i_iRegister, vector4 &o_vDdx, ve
 	if( i_iRegister >= c_iPixelShaderRegisters )
 		return;
 
+	if( m_pTriangleInfo->bQuadShading )
+	{
+		// Finite differences between the pixels of the current quad; for m3dlod_quad and
+		// m3dlod_span the upper left pixel's differences are used for the whole quad.
+		uint32 iRow = m_pTriangleInfo->iCurQuadPixel & 2, iColumn = m_pTriangleInfo->iCurQuadPixel & 1;
+		if( m_pTriangleInfo->iLODGranularity != m3dlod_pixel )
+			iRow = iColumn = 0;
+
+		const shaderreg *const *ppQuad = m_pTriangleInfo->pQuadShaderInputs;
+		o_vDdx = ppQuad[iRow + 1][i_iRegister] - ppQuad[iRow][i_iRegister];
+		o_vDdy = ppQuad[iColumn + 2][i_iRegister] - ppQuad[iColumn][i_iRegister];
+		return;
+	}
+
 	const shaderreg &A = m_pTriangleInfo->ShaderOutputsDdx[i_iRegister];
 	const shaderreg &B = m_pTriangleInfo->ShaderOutputsDdy[i_iRegister];
 	const shaderreg &C = m_pTriangleInfo->pBaseVertex->ShaderOutputs[i_iRegister];
@@ -44,9 +70,42 @@ void IMuli3DPixelShader::GetDerivatives( uint32 i_iRegister, vector4 &o_vDdx, ve
 	const float32 E = m_pTriangleInfo->fWDdy;
 	const float32 F = m_pTriangleInfo->pBaseVertex->vPosition.w;
 
-	const float32 fRelPixelX = m_pTriangleInfo->iCurPixelX - m_pTriangleInfo->pBaseVertex->vPosition.x;
-	const float32 fRelPixelY = m_pTriangleInfo->iCurPixelY - m_pTriangleInfo->pBaseVertex->vPosition.y;
-	const float32 fInvWSquare = m_pTriangleInfo->fCurPixelInvW * m_pTriangleInfo->fCurPixelInvW;
+	// Determine the pixel the derivatives are evaluated at.
+	uint32 iPixelX = m_pTriangleInfo->iCurPixelX, iPixelY = m_pTriangleInfo->iCurPixelY;
+	float32 fPixelInvW = m_pTriangleInfo->fCurPixelInvW;
+	if( m_pTriangleInfo->iLODGranularity != m3dlod_pixel )
+	{
+		if( m_pTriangleInfo->iLODGranularity == m3dlod_quad )
+		{
+			iPixelX &= ~1; iPixelY &= ~1;
+		}
+		else
+			iPixelX = m_pTriangleInfo->iCurSpanX;
+
+		if( m_iCachedGradientsID != m_pTriangleInfo->iGradientsID ||
+			m_iCachedPixelX != iPixelX || m_iCachedPixelY != iPixelY )
+		{
+			m_iCachedGradientsID = m_pTriangleInfo->iGradientsID;
+			m_iCachedPixelX = iPixelX; m_iCachedPixelY = iPixelY;
+			m_iCachedRegisters = 0;
+		}
+		else if( m_iCachedRegisters & ( 1 << i_iRegister ) )
+		{
+			o_vDdx = m_CachedDdx[i_iRegister];
+			o_vDdy = m_CachedDdy[i_iRegister];
+			return;
+		}
+
+		// The quad's upper left pixel may lie outside of the triangle - only use it if w is valid there.
+		const float32 fPixelW = F + D * ( iPixelX - m_pTriangleInfo->pBaseVertex->vPosition.x ) +
+			E * ( iPixelY - m_pTriangleInfo->pBaseVertex->vPosition.y );
+		if( fPixelW > 0.0f )
+			fPixelInvW = 1.0f / fPixelW;
+	}
+
+	const float32 fRelPixelX = iPixelX - m_pTriangleInfo->pBaseVertex->vPosition.x;
+	const float32 fRelPixelY = iPixelY - m_pTriangleInfo->pBaseVertex->vPosition.y;
+	const float32 fInvWSquare = fPixelInvW * fPixelInvW;
 
 	// Compute partial derivative with respect to the x-screen space coordinate.
 	switch( m_pVSOutputs[i_iRegister] )
@@ -79,4 +138,11 @@ void IMuli3DPixelShader::GetDerivatives( uint32 i_iRegister, vector4 &o_vDdx, ve
 	default:
 		break;
 	}
+
+	if( m_pTriangleInfo->iLODGranularity != m3dlod_pixel )
+	{
+		m_CachedDdx[i_iRegister] = o_vDdx;
+		m_CachedDdy[i_iRegister] = o_vDdy;
+		m_iCachedRegisters |= ( 1 << i_iRegister );
+	}
 }
@@ -0,0 +1,635 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "../../include/core/m3dcore_sparsetexture.h"
+#include "../../include/core/m3dcore_texture.h"
+#include "../../include/core/m3dcore_device.h"
+
+#if !defined( WIN32 ) && !defined( __amigaos4__ )
+#	include <sys/types.h>
+#endif
+
+const uint32 c_iLoaderBatchPages = 16; ///< Number of pages the loader thread loads before checking whether it should exit.
+const uint32 c_iSlotEvicting = 0xffffffff; ///< Value of sparsepageslot::iLastUse while the slot's page is being evicted.
+
+/// @internal Positions the file pointer at the beginning of a page; files may exceed 2GB.
+static bool bSeekPage( FILE *i_pFile, uint32 i_iPage, uint32 i_iPageFloats )
+{
+#if defined( WIN32 )
+	const __int64 iOffset = sizeof( m3dsparsetexturefileheader ) + (__int64)i_iPage * i_iPageFloats * sizeof( float32 );
+	return _fseeki64( i_pFile, iOffset, SEEK_SET ) == 0;
+#elif defined( __amigaos4__ )
+	const long iOffset = sizeof( m3dsparsetexturefileheader ) + (long)i_iPage * i_iPageFloats * sizeof( float32 );
+	return fseek( i_pFile, iOffset, SEEK_SET ) == 0;
+#else
+	const off_t iOffset = sizeof( m3dsparsetexturefileheader ) + (off_t)i_iPage * i_iPageFloats * sizeof( float32 );
+	return fseeko( i_pFile, iOffset, SEEK_SET ) == 0;
+#endif
+}
+
+/// @internal Expands a pixel to a color like CMuli3DSurface does.
+static void PixelToColor( vector4 &o_vColor, const float32 *i_pPixel, uint32 i_iFloats )
+{
+	o_vColor = vector4( 0, 0, 0, 1 );
+	switch( i_iFloats )
+	{
+	case 4: o_vColor.a = i_pPixel[3];
+	case 3: o_vColor.b = i_pPixel[2];
+	case 2: o_vColor.g = i_pPixel[1];
+	case 1: o_vColor.r = i_pPixel[0];
+	}
+}
+
+CMuli3DSparseTexture::CMuli3DSparseTexture( CMuli3DDevice *i_pParent )
+	: IMuli3DBaseTexture( i_pParent ),
+	m_pFile( 0 ), m_iMipLevels( 0 ), m_pMipLevels( 0 ), m_iNumPages( 0 ),
+	m_pPageTable( 0 ), m_pPageRequested( 0 ), m_iNumSlots( 0 ), m_pSlots( 0 ),
+	m_pSlotData( 0 ), m_iNumResidentPages( 0 ), m_pRequestQueue( 0 ),
+	m_iRequestHead( 0 ), m_iNumRequests( 0 ), m_iFrame( 0 ), m_bStopLoader( false )
+{
+
+}
+
+CMuli3DSparseTexture::~CMuli3DSparseTexture()
+{
+	if( m_LoaderThread.bIsStarted() )
+	{
+		m_bStopLoader = true;
+		m_LoaderEvent.Set();
+		m_LoaderThread.Join();
+	}
+
+	if( m_pFile )
+		fclose( m_pFile );
+
+	SAFE_DELETE_ARRAY( m_pMipLevels );
+	delete[] (int32 *)m_pPageTable;
+	delete[] (bool *)m_pPageRequested;
+	SAFE_DELETE_ARRAY( m_pSlots );
+	SAFE_DELETE_ARRAY( m_pSlotData );
+	SAFE_DELETE_ARRAY( m_pRequestQueue );
+}
+
+result CMuli3DSparseTexture::Create( const char *i_szFilename, uint32 i_iMaxResidentPages, bool i_bLoaderThread )
+{
+	if( !i_szFilename )
+	{
+		FUNC_FAILING( "CMuli3DSparseTexture::Create: parameter i_szFilename points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	m_pFile = fopen( i_szFilename, "rb" );
+	if( !m_pFile )
+	{
+		FUNC_FAILING( "CMuli3DSparseTexture::Create: cannot open tiled texture file.\n" );
+		return e_invalidparameters;
+	}
+
+	m3dsparsetexturefileheader Header;
+	if( fread( &Header, sizeof( Header ), 1, m_pFile ) != 1 || Header.iFileID != c_iSparseTextureFileID ||
+		!Header.iWidth || !Header.iHeight || !Header.iPageSize || !Header.iMipLevels )
+	{
+		FUNC_FAILING( "CMuli3DSparseTexture::Create: invalid tiled texture file.\n" );
+		return e_invalidparameters;
+	}
+
+	if( Header.iFormat < m3dfmt_r32f || Header.iFormat > m3dfmt_r32g32b32a32f )
+	{
+		FUNC_FAILING( "CMuli3DSparseTexture::Create: invalid format specified.\n" );
+		return e_invalidformat;
+	}
+
+	m_fmtFormat = (m3dformat)Header.iFormat;
+	m_iFloats = Header.iFormat - m3dfmt_r32f + 1;
+	m_iPageSize = Header.iPageSize;
+	m_iPageFloats = m_iPageSize * m_iPageSize * m_iFloats;
+	m_fSquaredWidth = (float32)(Header.iWidth * Header.iWidth);
+	m_fSquaredHeight = (float32)(Header.iHeight * Header.iHeight);
+
+	m_pMipLevels = new sparsemiplevel[Header.iMipLevels];
+	if( !m_pMipLevels )
+	{
+		FUNC_FAILING( "CMuli3DSparseTexture::Create: out of memory, cannot create mip-levels.\n" );
+		return e_outofmemory;
+	}
+
+	// Determine the page layout of the mip-levels; the mip-levels that fit into a single page are pinned.
+	uint32 iNumPinnedPages = 0;
+	for( m_iMipLevels = 0; m_iMipLevels < Header.iMipLevels; ++m_iMipLevels )
+	{
+		sparsemiplevel &MipLevel = m_pMipLevels[m_iMipLevels];
+		MipLevel.iWidth = Header.iWidth >> m_iMipLevels;
+		MipLevel.iHeight = Header.iHeight >> m_iMipLevels;
+		if( !MipLevel.iWidth || !MipLevel.iHeight )
+		{
+			FUNC_FAILING( "CMuli3DSparseTexture::Create: tiled texture file contains too many mip-levels.\n" );
+			return e_invalidparameters;
+		}
+
+		MipLevel.iPagesX = ( MipLevel.iWidth + m_iPageSize - 1 ) / m_iPageSize;
+		MipLevel.iPagesY = ( MipLevel.iHeight + m_iPageSize - 1 ) / m_iPageSize;
+		MipLevel.iFirstPage = m_iNumPages;
+		m_iNumPages += MipLevel.iPagesX * MipLevel.iPagesY;
+
+		if( MipLevel.iPagesX * MipLevel.iPagesY == 1 )
+			++iNumPinnedPages;
+	}
+
+	if( !iNumPinnedPages )
+	{
+		FUNC_FAILING( "CMuli3DSparseTexture::Create: the smallest mip-level of the tiled texture file has to fit into a single page.\n" );
+		return e_invalidparameters;
+	}
+
+	m_iNumSlots = i_iMaxResidentPages + iNumPinnedPages;
+	m_pPageTable = new int32[m_iNumPages];
+	m_pPageRequested = new bool[m_iNumPages];
+	m_pRequestQueue = new uint32[m_iNumPages];
+	m_pSlots = new sparsepageslot[m_iNumSlots];
+	m_pSlotData = new float32[m_iNumSlots * m_iPageFloats];
+	if( !m_pPageTable || !m_pPageRequested || !m_pRequestQueue || !m_pSlots || !m_pSlotData )
+	{
+		FUNC_FAILING( "CMuli3DSparseTexture::Create: out of memory, cannot create page table.\n" );
+		return e_outofmemory;
+	}
+
+	for( uint32 iPage = 0; iPage < m_iNumPages; ++iPage )
+	{
+		m_pPageTable[iPage] = -1;
+		m_pPageRequested[iPage] = false;
+	}
+
+	for( uint32 iSlot = 0; iSlot < m_iNumSlots; ++iSlot )
+	{
+		m_pSlots[iSlot].iPage = -1;
+		m_pSlots[iSlot].iLastUse = 0;
+		m_pSlots[iSlot].bPinned = false;
+	}
+
+	// Load the pinned mip-levels; they guarantee that sampling always finds a resident mip-level.
+	uint32 iSlot = 0;
+	for( uint32 iLevel = m_iMipLevels - iNumPinnedPages; iLevel < m_iMipLevels; ++iLevel, ++iSlot )
+	{
+		const uint32 iPage = m_pMipLevels[iLevel].iFirstPage;
+		result resLoad = LoadPage( iPage, iSlot );
+		if( FUNC_FAILED( resLoad ) )
+			return resLoad;
+
+		m_pSlots[iSlot].iPage = iPage;
+		m_pSlots[iSlot].bPinned = true;
+		m_pPageTable[iPage] = iSlot;
+		++m_iNumResidentPages;
+	}
+
+	// If no thread can be started, the application has to call iUpdateResidency().
+	if( i_bLoaderThread )
+		m_LoaderThread.Start( LoaderThread, this );
+
+	return s_ok;
+}
+
+m3dtexsampleinput CMuli3DSparseTexture::eGetTexSampleInput()
+{
+	return m3dtsi_2coords;
+}
+
+result CMuli3DSparseTexture::WriteTiledTextureFile( const char *i_szFilename, CMuli3DTexture *i_pTexture, uint32 i_iPageSize )
+{
+	if( !i_szFilename || !i_pTexture || !i_iPageSize )
+	{
+		FUNC_FAILING( "CMuli3DSparseTexture::WriteTiledTextureFile: invalid parameters specified.\n" );
+		return e_invalidparameters;
+	}
+
+	m3dsparsetexturefileheader Header;
+	Header.iFileID = c_iSparseTextureFileID;
+	Header.iFormat = i_pTexture->fmtGetFormat();
+	Header.iWidth = i_pTexture->iGetWidth();
+	Header.iHeight = i_pTexture->iGetHeight();
+	Header.iMipLevels = i_pTexture->iGetMipLevels();
+	Header.iPageSize = i_iPageSize;
+
+	const uint32 iFloats = i_pTexture->iGetFormatFloats();
+	float32 *pPageData = new float32[i_iPageSize * i_iPageSize * iFloats];
+	if( !pPageData )
+	{
+		FUNC_FAILING( "CMuli3DSparseTexture::WriteTiledTextureFile: out of memory, cannot create page buffer.\n" );
+		return e_outofmemory;
+	}
+
+	FILE *pFile = fopen( i_szFilename, "wb" );
+	if( !pFile )
+	{
+		SAFE_DELETE_ARRAY( pPageData );
+		FUNC_FAILING( "CMuli3DSparseTexture::WriteTiledTextureFile: cannot open file for writing.\n" );
+		return e_invalidparameters;
+	}
+
+	result resWrite = s_ok;
+	if( fwrite( &Header, sizeof( Header ), 1, pFile ) != 1 )
+		resWrite = e_invalidparameters;
+
+	for( uint32 iLevel = 0; iLevel < Header.iMipLevels && resWrite == s_ok; ++iLevel )
+	{
+		const float32 *pLevelData = 0;
+		resWrite = i_pTexture->LockRect( iLevel, (void **)&pLevelData, 0 );
+		if( FUNC_FAILED( resWrite ) )
+			break;
+
+		const uint32 iWidth = i_pTexture->iGetWidth( iLevel );
+		const uint32 iHeight = i_pTexture->iGetHeight( iLevel );
+		for( uint32 iPageY = 0; iPageY < iHeight && resWrite == s_ok; iPageY += i_iPageSize )
+		{
+			for( uint32 iPageX = 0; iPageX < iWidth; iPageX += i_iPageSize )
+			{
+				// Copy the page, padding it with the last column/row of the mip-level.
+				float32 *pCurPageData = pPageData;
+				for( uint32 iY = iPageY; iY < iPageY + i_iPageSize; ++iY )
+				{
+					const float32 *pRow = &pLevelData[( iY < iHeight ? iY : iHeight - 1 ) * iWidth * iFloats];
+					for( uint32 iX = iPageX; iX < iPageX + i_iPageSize; ++iX, pCurPageData += iFloats )
+						memcpy( pCurPageData, &pRow[( iX < iWidth ? iX : iWidth - 1 ) * iFloats], sizeof( float32 ) * iFloats );
+				}
+
+				if( fwrite( pPageData, sizeof( float32 ) * iFloats, i_iPageSize * i_iPageSize, pFile ) != i_iPageSize * i_iPageSize )
+				{
+					resWrite = e_invalidparameters;
+					break;
+				}
+			}
+		}
+
+		i_pTexture->UnlockRect( iLevel );
+	}
+
+	fclose( pFile );
+	SAFE_DELETE_ARRAY( pPageData );
+
+	if( FUNC_FAILED( resWrite ) )
+		FUNC_FAILING( "CMuli3DSparseTexture::WriteTiledTextureFile: writing tiled texture file failed.\n" );
+
+	return resWrite;
+}
+
+void CMuli3DSparseTexture::NextFrame()
+{
+	++m_iFrame;
+
+	// Requests that couldn't be served because all pages were in use can be retried now.
+	if( m_iNumRequests && m_LoaderThread.bIsStarted() )
+		m_LoaderEvent.Set();
+}
+
+uint32 CMuli3DSparseTexture::iUpdateResidency( uint32 i_iMaxPages )
+{
+	m_LoadMutex.Lock();
+
+	uint32 iLoadedPages = 0;
+	while( iLoadedPages < i_iMaxPages )
+	{
+		m_RequestMutex.Lock();
+		if( !m_iNumRequests )
+		{
+			m_RequestMutex.Unlock();
+			break;
+		}
+
+		const uint32 iPage = m_pRequestQueue[m_iRequestHead];
+		m_iRequestHead = ( m_iRequestHead + 1 ) % m_iNumPages;
+		--m_iNumRequests;
+		m_RequestMutex.Unlock();
+
+		if( m_pPageTable[iPage] < 0 )
+		{
+			const int32 iSlot = iAllocateSlot();
+			if( iSlot < 0 )
+			{
+				// All pages are in use by the current frame. Drop the request,
+				// it is repeated if the page is still needed.
+				m_pPageRequested[iPage] = false;
+				break;
+			}
+
+			if( FUNC_SUCCESSFUL( LoadPage( iPage, iSlot ) ) )
+			{
+				m_pSlots[iSlot].iPage = iPage;
+				AtomicStoreRelease( &m_pSlots[iSlot].iLastUse, m_iFrame );
+				++m_iNumResidentPages;
+
+				// Publish the page after its data has been written.
+				AtomicStoreRelease( (volatile uint32 *)&m_pPageTable[iPage], iSlot );
+				++iLoadedPages;
+			}
+			else
+				AtomicStoreRelease( &m_pSlots[iSlot].iLastUse, 0 );
+		}
+
+		m_pPageRequested[iPage] = false;
+	}
+
+	m_LoadMutex.Unlock();
+
+	return iLoadedPages;
+}
+
+void CMuli3DSparseTexture::LoaderThread( void *i_pSparseTexture )
+{
+	CMuli3DSparseTexture *pSparseTexture = (CMuli3DSparseTexture *)i_pSparseTexture;
+	for( ;; )
+	{
+		pSparseTexture->m_LoaderEvent.Wait();
+		if( pSparseTexture->m_bStopLoader )
+			break;
+
+		while( !pSparseTexture->m_bStopLoader && pSparseTexture->iUpdateResidency( c_iLoaderBatchPages ) )
+			;
+	}
+}
+
+void CMuli3DSparseTexture::RequestPage( uint32 i_iPage )
+{
+	if( m_pPageRequested[i_iPage] )
+		return;
+
+	bool bRequested = false;
+
+	m_RequestMutex.Lock();
+	if( !m_pPageRequested[i_iPage] && m_pPageTable[i_iPage] < 0 )
+	{
+		m_pPageRequested[i_iPage] = true;
+		m_pRequestQueue[( m_iRequestHead + m_iNumRequests ) % m_iNumPages] = i_iPage;
+		++m_iNumRequests;
+		bRequested = true;
+	}
+	m_RequestMutex.Unlock();
+
+	if( bRequested && m_LoaderThread.bIsStarted() )
+		m_LoaderEvent.Set();
+}
+
+result CMuli3DSparseTexture::LoadPage( uint32 i_iPage, uint32 i_iSlot )
+{
+	if( !bSeekPage( m_pFile, i_iPage, m_iPageFloats ) ||
+		fread( &m_pSlotData[i_iSlot * m_iPageFloats], sizeof( float32 ), m_iPageFloats, m_pFile ) != m_iPageFloats )
+	{
+		FUNC_FAILING( "CMuli3DSparseTexture::LoadPage: cannot read page from tiled texture file.\n" );
+		return e_invalidparameters;
+	}
+
+	return s_ok;
+}
+
+int32 CMuli3DSparseTexture::iAllocateSlot()
+{
+	for( ;; )
+	{
+		int32 iLRUSlot = -1;
+		uint32 iLRUSlotLastUse = 0;
+		for( uint32 iSlot = 0; iSlot < m_iNumSlots; ++iSlot )
+		{
+			const sparsepageslot &Slot = m_pSlots[iSlot];
+			if( Slot.iPage < 0 )
+				return iSlot;
+
+			const uint32 iLastUse = iAtomicLoadAcquire( &Slot.iLastUse );
+			if( Slot.bPinned || iLastUse == m_iFrame )
+				continue;
+
+			if( iLRUSlot < 0 || iLastUse < iLRUSlotLastUse )
+			{
+				iLRUSlot = iSlot;
+				iLRUSlotLastUse = iLastUse;
+			}
+		}
+
+		if( iLRUSlot < 0 )
+			return -1;
+
+		// Claim the least recently used slot; this fails if a sampler has used it
+		// for the current frame in the meantime, in which case another one is chosen.
+		if( !bAtomicCompareExchange( &m_pSlots[iLRUSlot].iLastUse, iLRUSlotLastUse, c_iSlotEvicting ) )
+			continue;
+
+		// Evict the page. Samplers that looked up the slot before will notice
+		// that the page table no longer maps their page to it.
+		AtomicStoreRelease( (volatile uint32 *)&m_pPageTable[m_pSlots[iLRUSlot].iPage], (uint32)-1 );
+		m_pSlots[iLRUSlot].iPage = -1;
+		--m_iNumResidentPages;
+
+		return iLRUSlot;
+	}
+}
+
+const float32 *CMuli3DSparseTexture::pGetPixel( uint32 i_iMipLevel, uint32 i_iX, uint32 i_iY )
+{
+	const sparsemiplevel &MipLevel = m_pMipLevels[i_iMipLevel];
+	const uint32 iPage = MipLevel.iFirstPage + ( i_iY / m_iPageSize ) * MipLevel.iPagesX + i_iX / m_iPageSize;
+
+	const int32 iSlot = (int32)iAtomicLoadAcquire( (volatile uint32 *)&m_pPageTable[iPage] );
+	if( iSlot < 0 )
+	{
+		RequestPage( iPage );
+		return 0;
+	}
+
+	// Claim the slot for the current frame, which keeps the loader from evicting it until NextFrame() is called.
+	// The slot may be in the middle of being evicted or may already hold another page: treat the page as not resident then.
+	volatile uint32 *pLastUse = &m_pSlots[iSlot].iLastUse;
+	const uint32 iFrame = m_iFrame;
+	uint32 iLastUse = iAtomicLoadAcquire( pLastUse );
+	while( iLastUse != iFrame )
+	{
+		if( iLastUse == c_iSlotEvicting )
+			return 0;
+
+		if( bAtomicCompareExchange( pLastUse, iLastUse, iFrame ) )
+			break;
+
+		iLastUse = iAtomicLoadAcquire( pLastUse );
+	}
+
+	if( (int32)iAtomicLoadAcquire( (volatile uint32 *)&m_pPageTable[iPage] ) != iSlot )
+		return 0;
+
+	return &m_pSlotData[iSlot * m_iPageFloats + ( ( i_iY % m_iPageSize ) * m_iPageSize + i_iX % m_iPageSize ) * m_iFloats];
+}
+
+bool CMuli3DSparseTexture::bSampleMipLevel( vector4 &o_vColor, uint32 i_iMipLevel, float32 i_fU, float32 i_fV, bool i_bLinear )
+{
+	const sparsemiplevel &MipLevel = m_pMipLevels[i_iMipLevel];
+	const float32 fX = i_fU * ( MipLevel.iWidth - 1 ), fY = i_fV * ( MipLevel.iHeight - 1 );
+	const uint32 iPixelX = ftol( fX ), iPixelY = ftol( fY );
+
+	if( !i_bLinear )
+	{
+		const float32 *pPixel = pGetPixel( i_iMipLevel, iPixelX, iPixelY );
+		if( !pPixel )
+			return false;
+
+		PixelToColor( o_vColor, pPixel, m_iFloats );
+		return true;
+	}
+
+	uint32 iPixelX2 = iPixelX + 1, iPixelY2 = iPixelY + 1;
+	if( iPixelX2 >= MipLevel.iWidth ) iPixelX2 = MipLevel.iWidth - 1;
+	if( iPixelY2 >= MipLevel.iHeight ) iPixelY2 = MipLevel.iHeight - 1;
+
+	// The four pixels may lie on different pages; fetch all of them, so that all missing pages get requested.
+	const float32 *pPixels[4] = {
+		pGetPixel( i_iMipLevel, iPixelX, iPixelY ),
+		pGetPixel( i_iMipLevel, iPixelX2, iPixelY ),
+		pGetPixel( i_iMipLevel, iPixelX, iPixelY2 ),
+		pGetPixel( i_iMipLevel, iPixelX2, iPixelY2 ) };
+	if( !pPixels[0] || !pPixels[1] || !pPixels[2] || !pPixels[3] )
+		return false;
+
+	vector4 vColors[4];
+	for( uint32 iPixel = 0; iPixel < 4; ++iPixel )
+		PixelToColor( vColors[iPixel], pPixels[iPixel], m_iFloats );
+
+	const float32 fInterpolation[2] = { fX - iPixelX, fY - iPixelY };
+	vector4 vColorRows[2];
+	vVector4Lerp( vColorRows[0], vColors[0], vColors[1], fInterpolation[0] );
+	vVector4Lerp( vColorRows[1], vColors[2], vColors[3], fInterpolation[0] );
+	vVector4Lerp( o_vColor, vColorRows[0], vColorRows[1], fInterpolation[1] );
+
+	return true;
+}
+
+void CMuli3DSparseTexture::SampleResidentMipLevel( vector4 &o_vColor, uint32 i_iMipLevel, float32 i_fU, float32 i_fV, bool i_bLinear )
+{
+	for( uint32 iLevel = i_iMipLevel; iLevel < m_iMipLevels; ++iLevel )
+	{
+		if( bSampleMipLevel( o_vColor, iLevel, i_fU, i_fV, i_bLinear ) )
+			return;
+	}
+
+	o_vColor = vector4( 0, 0, 0, 0 ); // cannot happen, the smallest mip-level is pinned
+}
+
+result CMuli3DSparseTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i_fV, float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient, const uint32 *i_pSamplerStates )
+{
+	uint32 iTexFilter = i_pSamplerStates[m3dtss_minfilter];
+	float32 fTexMipLevel = 0.0f;
+
+	if( i_pXGradient && i_pYGradient )
+	{
+		// Compute the mip-level from the squared gradient lengths and determine the texture filter type.
+		const float32 fLenXGrad = i_pXGradient->x * i_pXGradient->x * m_fSquaredWidth + i_pXGradient->y * i_pXGradient->y * m_fSquaredHeight;
+		const float32 fLenYGrad = i_pYGradient->x * i_pYGradient->x * m_fSquaredWidth + i_pYGradient->y * i_pYGradient->y * m_fSquaredHeight;
+		const float32 fSquaredTexelsPerScreenPixel = fLenXGrad > fLenYGrad ? fLenXGrad : fLenYGrad;
+
+		if( fSquaredTexelsPerScreenPixel <= 1.0f )
+		{
+			// magnification, no mipmapping needed
+			fTexMipLevel = 0.0f;
+			iTexFilter = i_pSamplerStates[m3dtss_magfilter];
+		}
+		else
+		{
+			// minification, need mipmapping: log2( sqrt( x ) ) = 0.5f * log2( x )
+			fTexMipLevel = 0.5f * fFastLog2( fSquaredTexelsPerScreenPixel );
+			iTexFilter = i_pSamplerStates[m3dtss_minfilter];
+		}
+	}
+
+	const float32 fMipLODBias = *(float32 *)&i_pSamplerStates[m3dtss_miplodbias];
+	const float32 fMaxMipLevel = *(float32 *)&i_pSamplerStates[m3dtss_maxmiplevel];
+	fTexMipLevel = fClamp( fTexMipLevel + fMipLODBias, 0.0f, fMaxMipLevel );
+
+	// Record the mip-level that should have been sampled, not the resident fallback.
+	if( m_pSamplerFeedback )
+		RecordSamplerFeedback( i_fU, i_fV, fTexMipLevel < m_iMipLevels ? fTexMipLevel : (float32)( m_iMipLevels - 1 ) );
+
+	const bool bLinear = ( iTexFilter == m3dtf_linear );
+	if( i_pSamplerStates[m3dtss_mipfilter] == m3dtf_linear )
+	{
+		uint32 iMipLevelA = ftol( fTexMipLevel ), iMipLevelB = iMipLevelA + 1;
+		if( iMipLevelA >= m_iMipLevels ) iMipLevelA = m_iMipLevels - 1;
+		if( iMipLevelB >= m_iMipLevels ) iMipLevelB = m_iMipLevels - 1;
+
+		vector4 vColorA, vColorB;
+		SampleResidentMipLevel( vColorA, iMipLevelA, i_fU, i_fV, bLinear );
+		SampleResidentMipLevel( vColorB, iMipLevelB, i_fU, i_fV, bLinear );
+
+		const float32 fInterpolation = fTexMipLevel - iMipLevelA;
+		vVector4Lerp( o_vColor, vColorA, vColorB, fInterpolation );
+	}
+	else
+	{
+		uint32 iMipLevel = ftol( fTexMipLevel );
+		if( iMipLevel >= m_iMipLevels ) iMipLevel = m_iMipLevels - 1;
+
+		SampleResidentMipLevel( o_vColor, iMipLevel, i_fU, i_fV, bLinear );
+	}
+
+	return s_ok;
+}
+
+m3dformat CMuli3DSparseTexture::fmtGetFormat()
+{
+	return m_fmtFormat;
+}
+
+uint32 CMuli3DSparseTexture::iGetFormatFloats()
+{
+	return m_iFloats;
+}
+
+uint32 CMuli3DSparseTexture::iGetMipLevels()
+{
+	return m_iMipLevels;
+}
+
+uint32 CMuli3DSparseTexture::iGetPageSize()
+{
+	return m_iPageSize;
+}
+
+uint32 CMuli3DSparseTexture::iGetNumResidentPages()
+{
+	return m_iNumResidentPages;
+}
+
+uint32 CMuli3DSparseTexture::iGetNumRequestedPages()
+{
+	return m_iNumRequests;
+}
+
+uint32 CMuli3DSparseTexture::iGetWidth( uint32 i_iMipLevel )
+{
+	if( i_iMipLevel >= m_iMipLevels )
+	{
+		FUNC_FAILING( "CMuli3DSparseTexture::iGetWidth: invalid mip-level specified.\n" );
+		return 0;
+	}
+
+	return m_pMipLevels[i_iMipLevel].iWidth;
+}
+
+uint32 CMuli3DSparseTexture::iGetHeight( uint32 i_iMipLevel )
+{
+	if( i_iMipLevel >= m_iMipLevels )
+	{
+		FUNC_FAILING( "CMuli3DSparseTexture::iGetHeight: invalid mip-level specified.\n" );
+		return 0;
+	}
+
+	return m_pMipLevels[i_iMipLevel].iHeight;
+}
@@ -0,0 +1,127 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "../../include/core/m3dcore_stencilbuffer.h"
+#include "../../include/core/m3dcore_device.h"
+
+CMuli3DStencilBuffer::CMuli3DStencilBuffer( CMuli3DDevice *i_pParent )
+	: m_pParent( i_pParent ), m_iWidth( 0 ), m_iHeight( 0 ), m_pData( 0 )
+{
+	m_pParent->AddRef();
+}
+
+result CMuli3DStencilBuffer::Create( uint32 i_iWidth, uint32 i_iHeight )
+{
+	if( !i_iWidth || !i_iHeight )
+	{
+		FUNC_FAILING( "CMuli3DStencilBuffer::Create: parameter i_iWidth or i_iHeight is 0.\n" );
+		return e_invalidparameters;
+	}
+
+	m_iWidth = i_iWidth;
+	m_iHeight = i_iHeight;
+
+	m_pData = new uint8[i_iWidth * i_iHeight];
+	if( !m_pData )
+	{
+		FUNC_FAILING( "CMuli3DStencilBuffer::Create: out of memory, cannot create stencil buffer.\n" );
+		return e_outofmemory;
+	}
+
+	memset( m_pData, 0, i_iWidth * i_iHeight );
+	return s_ok;
+}
+
+CMuli3DStencilBuffer::~CMuli3DStencilBuffer()
+{
+	SAFE_DELETE_ARRAY( m_pData );
+
+	SAFE_RELEASE( m_pParent );
+}
+
+CMuli3DDevice *CMuli3DStencilBuffer::pGetDevice()
+{
+	if( m_pParent )
+		m_pParent->AddRef();
+	return m_pParent;
+}
+
+result CMuli3DStencilBuffer::Clear( uint8 i_iValue, const m3drect *i_pRect )
+{
+	m3drect ClearRect;
+	if( i_pRect )
+	{
+		if( i_pRect->iRight > m_iWidth ||
+			i_pRect->iBottom > m_iHeight )
+		{
+			FUNC_FAILING( "CMuli3DStencilBuffer::Clear: clear-rectangle exceeds stencil buffer's dimensions.\n" );
+			return e_invalidparameters;
+		}
+
+		if( i_pRect->iLeft >= i_pRect->iRight ||
+			i_pRect->iTop >= i_pRect->iBottom )
+		{
+			FUNC_FAILING( "CMuli3DStencilBuffer::Clear: invalid rectangle specified!\n" );
+			return e_invalidparameters;
+		}
+
+		ClearRect = *i_pRect;
+	}
+	else
+	{
+		ClearRect.iLeft = 0; ClearRect.iTop = 0;
+		ClearRect.iRight = m_iWidth; ClearRect.iBottom = m_iHeight;
+	}
+
+	uint8 *pCurData = &m_pData[ClearRect.iTop * m_iWidth + ClearRect.iLeft];
+	for( uint32 iY = ClearRect.iTop; iY < ClearRect.iBottom; ++iY, pCurData += m_iWidth )
+		memset( pCurData, i_iValue, ClearRect.iRight - ClearRect.iLeft );
+
+	return s_ok;
+}
+
+result CMuli3DStencilBuffer::GetPointer( uint32 i_iX, uint32 i_iY, uint8 **o_ppData )
+{
+	if( !o_ppData )
+	{
+		FUNC_FAILING( "CMuli3DStencilBuffer::GetPointer: parameter o_ppData points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	if( i_iX >= m_iWidth || i_iY >= m_iHeight )
+	{
+		*o_ppData = 0;
+		FUNC_FAILING( "CMuli3DStencilBuffer::GetPointer: pixel exceeds stencil buffer's dimensions.\n" );
+		return e_invalidparameters;
+	}
+
+	*o_ppData = &m_pData[i_iY * m_iWidth + i_iX];
+	return s_ok;
+}
+
+uint32 CMuli3DStencilBuffer::iGetWidth()
+{
+	return m_iWidth;
+}
+
+uint32 CMuli3DStencilBuffer::iGetHeight()
+{
+	return m_iHeight;
+}
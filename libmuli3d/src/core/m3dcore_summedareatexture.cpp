@@ -0,0 +1,268 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "../../include/core/m3dcore_summedareatexture.h"
+#include "../../include/core/m3dcore_texture.h"
+#include "../../include/core/m3dcore_device.h"
+
+CMuli3DSummedAreaTexture::CMuli3DSummedAreaTexture( CMuli3DDevice *i_pParent )
+	: IMuli3DBaseTexture( i_pParent ), m_iWidth( 0 ), m_iHeight( 0 ), m_pTable( 0 )
+{
+
+}
+
+CMuli3DSummedAreaTexture::~CMuli3DSummedAreaTexture()
+{
+	SAFE_DELETE_ARRAY( m_pTable );
+}
+
+result CMuli3DSummedAreaTexture::Create( CMuli3DTexture *i_pSourceTexture )
+{
+	if( !i_pSourceTexture )
+	{
+		FUNC_FAILING( "CMuli3DSummedAreaTexture::Create: parameter i_pSourceTexture points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	m_fmtFormat = i_pSourceTexture->fmtGetFormat();
+	m_iFloats = i_pSourceTexture->iGetFormatFloats();
+	m_iWidth = i_pSourceTexture->iGetWidth();
+	m_iHeight = i_pSourceTexture->iGetHeight();
+
+	m_pTable = new float32[( m_iWidth + 1 ) * ( m_iHeight + 1 ) * m_iFloats];
+	if( !m_pTable )
+	{
+		FUNC_FAILING( "CMuli3DSummedAreaTexture::Create: out of memory, cannot create summed-area table.\n" );
+		return e_outofmemory;
+	}
+
+	return Update( i_pSourceTexture );
+}
+
+result CMuli3DSummedAreaTexture::Update( CMuli3DTexture *i_pSourceTexture )
+{
+	if( !i_pSourceTexture )
+	{
+		FUNC_FAILING( "CMuli3DSummedAreaTexture::Update: parameter i_pSourceTexture points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	if( i_pSourceTexture->fmtGetFormat() != m_fmtFormat ||
+		i_pSourceTexture->iGetWidth() != m_iWidth || i_pSourceTexture->iGetHeight() != m_iHeight )
+	{
+		FUNC_FAILING( "CMuli3DSummedAreaTexture::Update: source texture doesn't match the summed-area texture.\n" );
+		return e_invalidparameters;
+	}
+
+	float32 *pSource;
+	result resLock = i_pSourceTexture->LockRect( 0, (void **)&pSource, 0 );
+	if( FUNC_FAILED( resLock ) )
+		return resLock;
+
+	const uint32 iNumPixels = m_iWidth * m_iHeight;
+
+	// Determine the mean color: subtracting it keeps the sums close to zero, which preserves precision in large tables.
+	float64 fMean[4] = { 0, 0, 0, 0 };
+	const float32 *pPixel = pSource;
+	for( uint32 iPixel = 0; iPixel < iNumPixels; ++iPixel, pPixel += m_iFloats )
+	{
+		for( uint32 iFloat = 0; iFloat < m_iFloats; ++iFloat )
+			fMean[iFloat] += pPixel[iFloat];
+	}
+	for( uint32 iFloat = 0; iFloat < m_iFloats; ++iFloat )
+		m_fMean[iFloat] = (float32)( fMean[iFloat] / iNumPixels );
+
+	// The first row and column of the table are 0; every other entry holds the sum of all pixels above and left of it.
+	const uint32 iTableRowFloats = ( m_iWidth + 1 ) * m_iFloats;
+	memset( m_pTable, 0, sizeof( float32 ) * iTableRowFloats );
+
+	pPixel = pSource;
+	for( uint32 iY = 0; iY < m_iHeight; ++iY )
+	{
+		const float32 *pPrevRow = &m_pTable[iY * iTableRowFloats];
+		float32 *pRow = &m_pTable[( iY + 1 ) * iTableRowFloats];
+
+		float64 fRowSum[4] = { 0, 0, 0, 0 };
+		for( uint32 iFloat = 0; iFloat < m_iFloats; ++iFloat )
+			pRow[iFloat] = 0.0f;
+
+		for( uint32 iX = 1; iX <= m_iWidth; ++iX, pPixel += m_iFloats )
+		{
+			for( uint32 iFloat = 0; iFloat < m_iFloats; ++iFloat )
+			{
+				fRowSum[iFloat] += pPixel[iFloat] - m_fMean[iFloat];
+				pRow[iX * m_iFloats + iFloat] = pPrevRow[iX * m_iFloats + iFloat] + (float32)fRowSum[iFloat];
+			}
+		}
+	}
+
+	i_pSourceTexture->UnlockRect( 0 );
+	return s_ok;
+}
+
+m3dtexsampleinput CMuli3DSummedAreaTexture::eGetTexSampleInput()
+{
+	return m3dtsi_2coords;
+}
+
+void CMuli3DSummedAreaTexture::AddTableEntry( float32 *io_pSum, uint32 i_iX, uint32 i_iY, float32 i_fWeight )
+{
+	const float32 *pEntry = &m_pTable[( i_iY * ( m_iWidth + 1 ) + i_iX ) * m_iFloats];
+	switch( m_iFloats )
+	{
+	case 4: io_pSum[3] += pEntry[3] * i_fWeight;
+	case 3: io_pSum[2] += pEntry[2] * i_fWeight;
+	case 2: io_pSum[1] += pEntry[1] * i_fWeight;
+	case 1: io_pSum[0] += pEntry[0] * i_fWeight;
+	}
+}
+
+void CMuli3DSummedAreaTexture::AddInterpolatedTableEntry( float32 *io_pSum, float32 i_fX, float32 i_fY, float32 i_fWeight )
+{
+	// The integral of a piecewise-constant image is bi-linear within each pixel, hence interpolating the table is exact.
+	uint32 iX = ftol( i_fX ); if( iX >= m_iWidth ) iX = m_iWidth - 1;
+	uint32 iY = ftol( i_fY ); if( iY >= m_iHeight ) iY = m_iHeight - 1;
+	const float32 fFracX = i_fX - (float32)iX, fFracY = i_fY - (float32)iY;
+
+	AddTableEntry( io_pSum, iX, iY, i_fWeight * ( 1.0f - fFracX ) * ( 1.0f - fFracY ) );
+	AddTableEntry( io_pSum, iX + 1, iY, i_fWeight * fFracX * ( 1.0f - fFracY ) );
+	AddTableEntry( io_pSum, iX, iY + 1, i_fWeight * ( 1.0f - fFracX ) * fFracY );
+	AddTableEntry( io_pSum, iX + 1, iY + 1, i_fWeight * fFracX * fFracY );
+}
+
+void CMuli3DSummedAreaTexture::AverageRect( vector4 &o_vColor, float32 i_fX0, float32 i_fY0, float32 i_fX1, float32 i_fY1, bool i_bLinear )
+{
+	float32 fSum[4] = { 0, 0, 0, 0 };
+	float32 fArea;
+
+	if( i_bLinear )
+	{
+		AddInterpolatedTableEntry( fSum, i_fX1, i_fY1, 1.0f );
+		AddInterpolatedTableEntry( fSum, i_fX0, i_fY1, -1.0f );
+		AddInterpolatedTableEntry( fSum, i_fX1, i_fY0, -1.0f );
+		AddInterpolatedTableEntry( fSum, i_fX0, i_fY0, 1.0f );
+		fArea = ( i_fX1 - i_fX0 ) * ( i_fY1 - i_fY0 );
+	}
+	else
+	{
+		// Snap the rectangle to pixel boundaries, covering at least one pixel.
+		uint32 iX0 = ftol( i_fX0 + 0.5f ), iX1 = ftol( i_fX1 + 0.5f );
+		uint32 iY0 = ftol( i_fY0 + 0.5f ), iY1 = ftol( i_fY1 + 0.5f );
+		if( iX1 > m_iWidth ) iX1 = m_iWidth;
+		if( iY1 > m_iHeight ) iY1 = m_iHeight;
+		if( iX0 >= iX1 ) { if( iX1 < m_iWidth ) iX1 = iX0 + 1; else iX0 = iX1 - 1; }
+		if( iY0 >= iY1 ) { if( iY1 < m_iHeight ) iY1 = iY0 + 1; else iY0 = iY1 - 1; }
+
+		AddTableEntry( fSum, iX1, iY1, 1.0f );
+		AddTableEntry( fSum, iX0, iY1, -1.0f );
+		AddTableEntry( fSum, iX1, iY0, -1.0f );
+		AddTableEntry( fSum, iX0, iY0, 1.0f );
+		fArea = (float32)( ( iX1 - iX0 ) * ( iY1 - iY0 ) );
+	}
+
+	const float32 fInvArea = 1.0f / fArea;
+	o_vColor = vector4( 0, 0, 0, 1 );
+	switch( m_iFloats )
+	{
+	case 4: o_vColor.a = m_fMean[3] + fSum[3] * fInvArea;
+	case 3: o_vColor.b = m_fMean[2] + fSum[2] * fInvArea;
+	case 2: o_vColor.g = m_fMean[1] + fSum[1] * fInvArea;
+	case 1: o_vColor.r = m_fMean[0] + fSum[0] * fInvArea;
+	}
+}
+
+/// @internal Clamps the range [io_fMin,io_fMax] to [0,i_fSize], making it at least one pixel wide; returns false if the range is smaller than one pixel.
+static bool bClampRange( float32 &io_fMin, float32 &io_fMax, float32 i_fSize )
+{
+	bool bMinified = true;
+	if( io_fMax - io_fMin < 1.0f )
+	{
+		const float32 fCenter = ( io_fMin + io_fMax ) * 0.5f;
+		io_fMin = fCenter - 0.5f; io_fMax = fCenter + 0.5f;
+		bMinified = false;
+	}
+
+	if( io_fMax - io_fMin >= i_fSize ) { io_fMin = 0.0f; io_fMax = i_fSize; }
+	else if( io_fMin < 0.0f ) { io_fMax -= io_fMin; io_fMin = 0.0f; }
+	else if( io_fMax > i_fSize ) { io_fMin -= io_fMax - i_fSize; io_fMax = i_fSize; }
+
+	return bMinified;
+}
+
+result CMuli3DSummedAreaTexture::SampleTextureRect( vector4 &o_vColor, float32 i_fU0, float32 i_fV0, float32 i_fU1, float32 i_fV1, const uint32 *i_pSamplerStates )
+{
+	if( i_fU1 < i_fU0 ) { const float32 fTemp = i_fU0; i_fU0 = i_fU1; i_fU1 = fTemp; }
+	if( i_fV1 < i_fV0 ) { const float32 fTemp = i_fV0; i_fV0 = i_fV1; i_fV1 = fTemp; }
+
+	// Texture coordinates [0,1] span the whole texture, pixel i covers [i,i+1] in table-space.
+	const float32 fWidth = (float32)m_iWidth, fHeight = (float32)m_iHeight;
+	float32 fX0 = i_fU0 * fWidth, fX1 = i_fU1 * fWidth;
+	float32 fY0 = i_fV0 * fHeight, fY1 = i_fV1 * fHeight;
+
+	const bool bMinifiedX = bClampRange( fX0, fX1, fWidth );
+	const bool bMinifiedY = bClampRange( fY0, fY1, fHeight );
+
+	const uint32 iTexFilter = ( bMinifiedX || bMinifiedY ) ?
+		i_pSamplerStates[m3dtss_minfilter] : i_pSamplerStates[m3dtss_magfilter];
+
+	if( m_pSamplerFeedback )
+	{
+		// Record the mip-level a mip-mapped texture would have chosen for a rectangle of this size.
+		const float32 fExtent = ( fX1 - fX0 > fY1 - fY0 ) ? fX1 - fX0 : fY1 - fY0;
+		RecordSamplerFeedback( ( fX0 + fX1 ) * 0.5f / fWidth, ( fY0 + fY1 ) * 0.5f / fHeight,
+			fExtent > 1.0f ? fFastLog2( fExtent ) : 0.0f );
+	}
+
+	AverageRect( o_vColor, fX0, fY0, fX1, fY1, iTexFilter == m3dtf_linear );
+	return s_ok;
+}
+
+result CMuli3DSummedAreaTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i_fV, float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient, const uint32 *i_pSamplerStates )
+{
+	// The texture coordinate gradients span a parallelogram; average its bounding rectangle.
+	float32 fHalfExtentU = 0.0f, fHalfExtentV = 0.0f;
+	if( i_pXGradient && i_pYGradient )
+	{
+		fHalfExtentU = ( fabsf( i_pXGradient->x ) + fabsf( i_pYGradient->x ) ) * 0.5f;
+		fHalfExtentV = ( fabsf( i_pXGradient->y ) + fabsf( i_pYGradient->y ) ) * 0.5f;
+	}
+
+	return SampleTextureRect( o_vColor, i_fU - fHalfExtentU, i_fV - fHalfExtentV,
+		i_fU + fHalfExtentU, i_fV + fHalfExtentV, i_pSamplerStates );
+}
+
+m3dformat CMuli3DSummedAreaTexture::fmtGetFormat()
+{
+	return m_fmtFormat;
+}
+
+uint32 CMuli3DSummedAreaTexture::iGetFormatFloats()
+{
+	return m_iFloats;
+}
+
+uint32 CMuli3DSummedAreaTexture::iGetWidth()
+{
+	return m_iWidth;
+}
+
+uint32 CMuli3DSummedAreaTexture::iGetHeight()
+{
+	return m_iHeight;
+}
@@ -21,7 +21,7 @@
 #include "../../include/core/m3dcore_device.h"
 
 CMuli3DSurface::CMuli3DSurface( CMuli3DDevice *i_pParent ) :
-	m_pParent( i_pParent ), m_iWidth( 0 ), m_iHeight( 0 ), m_iWidthMin1( 0 ), m_iHeightMin1( 0 ),
+	m_pParent( i_pParent ), m_iWidth( 0 ), m_iHeight( 0 ), m_iWidthMin1( 0 ), m_iHeightMin1( 0 ), m_iSamples( 1 ),
 	m_bLockedComplete( false ), m_pPartialLockData( 0 ), m_pData( 0 )
 {}
 
@@ -31,13 +31,19 @@ CMuli3DSurface::~CMuli3DSurface()
 	SAFE_DELETE_ARRAY( m_pData );
 }
 
-result CMuli3DSurface::Create( uint32 i_iWidth, uint32 i_iHeight, m3dformat i_fmtFormat )
+result CMuli3DSurface::Create( uint32 i_iWidth, uint32 i_iHeight, m3dformat i_fmtFormat, uint32 i_iSamples )
 {
 	if( !i_iWidth || !i_iHeight )
 	{
 		FUNC_FAILING( "CMuli3DSurface::Create: surface dimensions are invalid.\n" );
 		return e_invalidparameters;
 	}
+
+	if( i_iSamples != 1 && i_iSamples != 2 && i_iSamples != 4 && i_iSamples != 8 )
+	{
+		FUNC_FAILING( "CMuli3DSurface::Create: invalid number of samples specified.\n" );
+		return e_invalidparameters;
+	}
 	
 	uint32 iFloats;
 	switch( i_fmtFormat )
@@ -54,8 +60,9 @@ result CMuli3DSurface::Create( uint32 i_iWidth, uint32 i_iHeight, m3dformat i_fm
 	m_iHeight = i_iHeight;
 	m_iWidthMin1 = m_iWidth - 1;
 	m_iHeightMin1 = m_iHeight - 1;
+	m_iSamples = i_iSamples;
 
-	m_pData = new float32[m_iWidth * m_iHeight * iFloats];
+	m_pData = new float32[m_iWidth * m_iHeight * m_iSamples * iFloats];
 	if( !m_pData )
 	{
 		FUNC_FAILING( "CMuli3DSurface::Create: out of memory, cannot create surface.\n" );
@@ -97,13 +104,16 @@ result CMuli3DSurface::Clear( const vector4 &i_vColor, const m3drect *i_pRect )
 	if( FUNC_FAILED( resPointer ) )
 		return resPointer;
 
-	const uint32 iBridgeStep = ( m_iWidth - ClearRect.iRight ) + ClearRect.iLeft;
+	// the samples of a pixel are stored next to each other -> clear the rectangle's columns of samples.
+	ClearRect.iLeft *= m_iSamples; ClearRect.iRight *= m_iSamples;
+	const uint32 iRowWidth = m_iWidth * m_iSamples;
+	const uint32 iBridgeStep = ( iRowWidth - ClearRect.iRight ) + ClearRect.iLeft;
 
 	switch( m_fmtFormat )
 	{
 	case m3dfmt_r32f:
 		{
-			float32 *pCurData = &pData[ClearRect.iTop * m_iWidth + ClearRect.iLeft];
+			float32 *pCurData = &pData[ClearRect.iTop * iRowWidth + ClearRect.iLeft];
 			for( uint32 iY = ClearRect.iTop; iY < ClearRect.iBottom; ++iY, pCurData += iBridgeStep )
 			{
 				for( uint32 iX = ClearRect.iLeft; iX < ClearRect.iRight; ++iX, ++pCurData )
@@ -114,7 +124,7 @@ result CMuli3DSurface::Clear( const vector4 &i_vColor, const m3drect *i_pRect )
 
 	case m3dfmt_r32g32f:
 		{
-			vector2 *pCurData = &((vector2 *)pData)[ClearRect.iTop * m_iWidth + ClearRect.iLeft];
+			vector2 *pCurData = &((vector2 *)pData)[ClearRect.iTop * iRowWidth + ClearRect.iLeft];
 			for( uint32 iY = ClearRect.iTop; iY < ClearRect.iBottom; ++iY, pCurData += iBridgeStep )
 			{
 				for( uint32 iX = ClearRect.iLeft; iX < ClearRect.iRight; ++iX, ++pCurData )
@@ -125,7 +135,7 @@ result CMuli3DSurface::Clear( const vector4 &i_vColor, const m3drect *i_pRect )
 
 	case m3dfmt_r32g32b32f:
 		{
-			vector3 *pCurData = &((vector3 *)pData)[ClearRect.iTop * m_iWidth + ClearRect.iLeft];
+			vector3 *pCurData = &((vector3 *)pData)[ClearRect.iTop * iRowWidth + ClearRect.iLeft];
 			for( uint32 iY = ClearRect.iTop; iY < ClearRect.iBottom; ++iY, pCurData += iBridgeStep )
 			{
 				for( uint32 iX = ClearRect.iLeft; iX < ClearRect.iRight; ++iX, ++pCurData )
@@ -136,7 +146,7 @@ result CMuli3DSurface::Clear( const vector4 &i_vColor, const m3drect *i_pRect )
 
 	case m3dfmt_r32g32b32a32f:
 		{
-			vector4 *pCurData = &((vector4 *)pData)[ClearRect.iTop * m_iWidth + ClearRect.iLeft];
+			vector4 *pCurData = &((vector4 *)pData)[ClearRect.iTop * iRowWidth + ClearRect.iLeft];
 			for( uint32 iY = ClearRect.iTop; iY < ClearRect.iBottom; ++iY, pCurData += iBridgeStep )
 			{
 				for( uint32 iX = ClearRect.iLeft; iX < ClearRect.iRight; ++iX, ++pCurData )
@@ -176,6 +186,12 @@ result CMuli3DSurface::LockRect( void **o_ppData, const m3drect *i_pRect )
 		return s_ok;
 	}
 
+	if( m_iSamples > 1 )
+	{
+		FUNC_FAILING( "CMuli3DSurface::LockRect: multisampled surfaces can only be locked entirely!\n" );
+		return e_invalidstate;
+	}
+
 	if( i_pRect->iRight > m_iWidth ||
 		i_pRect->iBottom > m_iHeight )
 	{
@@ -296,6 +312,95 @@ void CMuli3DSurface::SamplePoint( vector4 &o_vColor, float32 i_fU, float32 i_fV
 	}
 }
 
+/// Compares a reference value to c_iMaxPCFKernelSize pixel-values and stores 1 for each pixel that passes, 0 otherwise.
+/// The loops have a fixed length and contain no branches, so that the compiler can vectorize them.
+static void ComparePixels( float32 *o_pPassed, const float32 *i_pValues, float32 i_fReference, m3dcmpfunc i_CmpFunc )
+{
+	uint32 i;
+	switch( i_CmpFunc )
+	{
+	case m3dcmp_equal: for( i = 0; i < c_iMaxPCFKernelSize; ++i ) o_pPassed[i] = ( i_fReference == i_pValues[i] ) ? 1.0f : 0.0f; break;
+	case m3dcmp_notequal: for( i = 0; i < c_iMaxPCFKernelSize; ++i ) o_pPassed[i] = ( i_fReference != i_pValues[i] ) ? 1.0f : 0.0f; break;
+	case m3dcmp_less: for( i = 0; i < c_iMaxPCFKernelSize; ++i ) o_pPassed[i] = ( i_fReference < i_pValues[i] ) ? 1.0f : 0.0f; break;
+	case m3dcmp_lessequal: for( i = 0; i < c_iMaxPCFKernelSize; ++i ) o_pPassed[i] = ( i_fReference <= i_pValues[i] ) ? 1.0f : 0.0f; break;
+	case m3dcmp_greaterequal: for( i = 0; i < c_iMaxPCFKernelSize; ++i ) o_pPassed[i] = ( i_fReference >= i_pValues[i] ) ? 1.0f : 0.0f; break;
+	case m3dcmp_greater: for( i = 0; i < c_iMaxPCFKernelSize; ++i ) o_pPassed[i] = ( i_fReference > i_pValues[i] ) ? 1.0f : 0.0f; break;
+	case m3dcmp_always: for( i = 0; i < c_iMaxPCFKernelSize; ++i ) o_pPassed[i] = 1.0f; break;
+	default: for( i = 0; i < c_iMaxPCFKernelSize; ++i ) o_pPassed[i] = 0.0f; break; // m3dcmp_never
+	}
+}
+
+float32 CMuli3DSurface::fSampleCompare( float32 i_fU, float32 i_fV, float32 i_fReference, m3dcmpfunc i_CmpFunc, uint32 i_iKernelSize, bool i_bLinear )
+{
+	uint32 iKernelSize = i_iKernelSize;
+	if( iKernelSize < 1 ) iKernelSize = 1;
+	else if( iKernelSize > c_iMaxPCFKernelSize ) iKernelSize = c_iMaxPCFKernelSize;
+
+	const float32 fX = i_fU * m_iWidthMin1, fY = i_fV * m_iHeightMin1;
+
+	// Determine the first pixel of the kernel and the weights of its columns and rows; unused entries get a weight of 0.
+	float32 fWeightsX[c_iMaxPCFKernelSize], fWeightsY[c_iMaxPCFKernelSize];
+	int32 iStartX, iStartY;
+	float32 fNormalization;
+	uint32 i;
+	for( i = 0; i < c_iMaxPCFKernelSize; ++i )
+	{
+		fWeightsX[i] = ( i < iKernelSize ) ? 1.0f : 0.0f;
+		fWeightsY[i] = fWeightsX[i];
+	}
+
+	if( i_bLinear && iKernelSize > 1 )
+	{
+		const float32 fOffset = 0.5f * (float32)( iKernelSize - 2 );
+		const float32 fStartX = fX - fOffset, fStartY = fY - fOffset;
+		iStartX = (int32)floorf( fStartX ); iStartY = (int32)floorf( fStartY );
+		const float32 fFracX = fStartX - iStartX, fFracY = fStartY - iStartY;
+
+		fWeightsX[0] = 1.0f - fFracX; fWeightsX[iKernelSize - 1] = fFracX;
+		fWeightsY[0] = 1.0f - fFracY; fWeightsY[iKernelSize - 1] = fFracY;
+		fNormalization = 1.0f / (float32)( ( iKernelSize - 1 ) * ( iKernelSize - 1 ) );
+	}
+	else
+	{
+		iStartX = ftol( fX ) - (int32)( ( iKernelSize - 1 ) / 2 );
+		iStartY = ftol( fY ) - (int32)( ( iKernelSize - 1 ) / 2 );
+		fNormalization = 1.0f / (float32)( iKernelSize * iKernelSize );
+	}
+
+	const uint32 iFloats = iGetFormatFloats();
+	uint32 iColumns[c_iMaxPCFKernelSize];
+	for( i = 0; i < c_iMaxPCFKernelSize; ++i )
+	{
+		int32 iColumn = iStartX + (int32)i;
+		if( iColumn < 0 ) iColumn = 0;
+		else if( iColumn > (int32)m_iWidthMin1 ) iColumn = m_iWidthMin1;
+		iColumns[i] = iColumn * iFloats;
+	}
+
+	float32 fValues[c_iMaxPCFKernelSize], fPassed[c_iMaxPCFKernelSize];
+	float32 fResult = 0.0f;
+	for( uint32 iRow = 0; iRow < iKernelSize; ++iRow )
+	{
+		int32 iY = iStartY + (int32)iRow;
+		if( iY < 0 ) iY = 0;
+		else if( iY > (int32)m_iHeightMin1 ) iY = m_iHeightMin1;
+
+		const float32 *pRow = &m_pData[iY * m_iWidth * iFloats];
+		for( i = 0; i < c_iMaxPCFKernelSize; ++i )
+			fValues[i] = pRow[iColumns[i]];
+
+		ComparePixels( fPassed, fValues, i_fReference, i_CmpFunc );
+
+		float32 fRowResult = 0.0f;
+		for( i = 0; i < c_iMaxPCFKernelSize; ++i )
+			fRowResult += fPassed[i] * fWeightsX[i];
+
+		fResult += fRowResult * fWeightsY[iRow];
+	}
+
+	return fResult * fNormalization;
+}
+
 void CMuli3DSurface::SampleLinear( vector4 &o_vColor, float32 i_fU, float32 i_fV )
 {
 	const float32 fX = i_fU * m_iWidthMin1, fY = i_fV * m_iHeightMin1;
@@ -324,10 +429,10 @@ void CMuli3DSurface::SampleLinear( vector4 &o_vColor, float32 i_fU, float32 i_fV
 		{
 			const vector2 *pPixelData = (const vector2 *)m_pData;
 
-			static vector2 vColorRows[2];
+			vector2 vColorRows[2];
 			vVector2Lerp( vColorRows[0], pPixelData[iIndexRows[0] + iPixelX], pPixelData[iIndexRows[0] + iPixelX2], fInterpolation[0] );
 			vVector2Lerp( vColorRows[1], pPixelData[iIndexRows[1] + iPixelX], pPixelData[iIndexRows[1] + iPixelX2], fInterpolation[0] );
-			static vector2 vFinalColor; vVector2Lerp( vFinalColor, vColorRows[0], vColorRows[1], fInterpolation[1] );
+			vector2 vFinalColor; vVector2Lerp( vFinalColor, vColorRows[0], vColorRows[1], fInterpolation[1] );
 
 			o_vColor = vector4( vFinalColor.x, vFinalColor.y, 0, 1 );
 		}
@@ -336,10 +441,10 @@ void CMuli3DSurface::SampleLinear( vector4 &o_vColor, float32 i_fU, float32 i_fV
 		{
 			const vector3 *pPixelData = (const vector3 *)m_pData;
 
-			static vector3 vColorRows[2];
+			vector3 vColorRows[2];
 			vVector3Lerp( vColorRows[0], pPixelData[iIndexRows[0] + iPixelX], pPixelData[iIndexRows[0] + iPixelX2], fInterpolation[0] );
 			vVector3Lerp( vColorRows[1], pPixelData[iIndexRows[1] + iPixelX], pPixelData[iIndexRows[1] + iPixelX2], fInterpolation[0] );
-			static vector3 vFinalColor; vVector3Lerp( vFinalColor, vColorRows[0], vColorRows[1], fInterpolation[1] );
+			vector3 vFinalColor; vVector3Lerp( vFinalColor, vColorRows[0], vColorRows[1], fInterpolation[1] );
 
 			o_vColor = vector4( vFinalColor.x, vFinalColor.y, vFinalColor.z, 1 );
 		}
@@ -348,7 +453,7 @@ void CMuli3DSurface::SampleLinear( vector4 &o_vColor, float32 i_fU, float32 i_fV
 		{
 			const vector4 *pPixelData = (const vector4 *)m_pData;
 
-			static vector4 vColorRows[2];
+			vector4 vColorRows[2];
 			vVector4Lerp( vColorRows[0], pPixelData[iIndexRows[0] + iPixelX], pPixelData[iIndexRows[0] + iPixelX2], fInterpolation[0] );
 			vVector4Lerp( vColorRows[1], pPixelData[iIndexRows[1] + iPixelX], pPixelData[iIndexRows[1] + iPixelX2], fInterpolation[0] );
 			vVector4Lerp( o_vColor, vColorRows[0], vColorRows[1], fInterpolation[1] );
@@ -374,6 +479,188 @@ uint32 CMuli3DSurface::iGetHeight()
 	return m_iHeight;
 }
 
+uint32 CMuli3DSurface::iGetSamples()
+{
+	return m_iSamples;
+}
+
+void CMuli3DSurface::GetSamplePosition( uint32 i_iSamples, uint32 i_iSample, float32 &o_fX, float32 &o_fY )
+{
+	// Sample positions in 1/16th of a pixel.
+	static const int32 iPositions2[2][2] = { { 4, 4 }, { -4, -4 } };
+	static const int32 iPositions4[4][2] = { { -2, -6 }, { 6, -2 }, { -6, 2 }, { 2, 6 } };
+	static const int32 iPositions8[8][2] = { { 1, -3 }, { -1, 3 }, { 5, 1 }, { -3, -5 },
+		{ -5, 5 }, { -7, -1 }, { 3, 7 }, { 7, -7 } };
+
+	const int32 *pPosition;
+	switch( i_iSamples )
+	{
+	case 2: pPosition = iPositions2[i_iSample & 1]; break;
+	case 4: pPosition = iPositions4[i_iSample & 3]; break;
+	case 8: pPosition = iPositions8[i_iSample & 7]; break;
+	default: o_fX = 0.0f; o_fY = 0.0f; return;
+	}
+
+	o_fX = pPosition[0] * ( 1.0f / 16.0f );
+	o_fY = pPosition[1] * ( 1.0f / 16.0f );
+}
+
+uint32 CMuli3DSurface::iGetInterleavePhases( m3dinterleave i_Interleave )
+{
+	switch( i_Interleave )
+	{
+	case m3dil_checkerboard: return 2;
+	case m3dil_2x2: return 4;
+	case m3dil_4x4: return 16;
+	default: return 1;
+	}
+}
+
+bool CMuli3DSurface::bGetInterleaveRow( m3dinterleave i_Interleave, uint32 i_iPhase, uint32 i_iY, uint32 &o_iOffsetX, uint32 &o_iStepX )
+{
+	// Pixel positions (x,y) within the pattern's block, in the order of the phases.
+	static const uint32 iOrder2x2[4][2] = { { 0, 0 }, { 1, 1 }, { 1, 0 }, { 0, 1 } };
+	static const uint32 iOrder4x4[16][2] = { { 0, 0 }, { 2, 2 }, { 2, 0 }, { 0, 2 }, { 1, 1 }, { 3, 3 }, { 3, 1 }, { 1, 3 },
+		{ 1, 0 }, { 3, 2 }, { 3, 0 }, { 1, 2 }, { 0, 1 }, { 2, 3 }, { 2, 1 }, { 0, 3 } };
+
+	const uint32 *pPosition;
+	switch( i_Interleave )
+	{
+	case m3dil_checkerboard: o_iOffsetX = ( i_iY + i_iPhase ) & 1; o_iStepX = 2; return true;
+	case m3dil_2x2: pPosition = iOrder2x2[i_iPhase & 3]; o_iStepX = 2; break;
+	case m3dil_4x4: pPosition = iOrder4x4[i_iPhase & 15]; o_iStepX = 4; break;
+	default: o_iOffsetX = 0; o_iStepX = 1; return true;
+	}
+
+	o_iOffsetX = pPosition[0];
+	return ( i_iY & ( o_iStepX - 1 ) ) == pPosition[1];
+}
+
+result CMuli3DSurface::ReconstructInterleaved( m3dinterleave i_Interleave, uint32 i_iPhase, const m3drect *i_pRect )
+{
+	if( i_Interleave > m3dil_4x4 )
+	{
+		FUNC_FAILING( "CMuli3DSurface::ReconstructInterleaved: invalid interleave pattern specified!\n" );
+		return e_invalidparameters;
+	}
+
+	if( m_iSamples > 1 || m_bLockedComplete || m_pPartialLockData )
+	{
+		FUNC_FAILING( "CMuli3DSurface::ReconstructInterleaved: surface is multisampled or locked!\n" );
+		return e_invalidstate;
+	}
+
+	m3drect Rect;
+	if( i_pRect )
+	{
+		if( i_pRect->iRight > m_iWidth || i_pRect->iBottom > m_iHeight ||
+			i_pRect->iLeft >= i_pRect->iRight || i_pRect->iTop >= i_pRect->iBottom )
+		{
+			FUNC_FAILING( "CMuli3DSurface::ReconstructInterleaved: invalid rectangle specified!\n" );
+			return e_invalidparameters;
+		}
+		Rect = *i_pRect;
+	}
+	else
+	{
+		Rect.iLeft = 0; Rect.iTop = 0;
+		Rect.iRight = m_iWidth; Rect.iBottom = m_iHeight;
+	}
+
+	if( i_Interleave == m3dil_none )
+		return s_ok;
+
+	const uint32 iFloats = iGetFormatFloats();
+	const uint32 iPitch = m_iWidth * iFloats;
+	i_iPhase %= iGetInterleavePhases( i_Interleave );
+
+	// Only pixels of other phases are written and only pixels of the phase are read, so the surface can be updated in place.
+	if( i_Interleave == m3dil_checkerboard )
+	{
+		for( uint32 iY = Rect.iTop; iY < Rect.iBottom; ++iY )
+		{
+			uint32 iOffsetX, iStepX;
+			bGetInterleaveRow( i_Interleave, i_iPhase, iY, iOffsetX, iStepX );
+
+			// Pixels of the other phase start at the opposite column.
+			for( uint32 iX = Rect.iLeft + ( ( iOffsetX + 1 + Rect.iLeft ) & 1 ); iX < Rect.iRight; iX += 2 )
+			{
+				float32 *pDest = &m_pData[iY * iPitch + iX * iFloats];
+				const float32 *pNeighbours[4]; uint32 iNumNeighbours = 0;
+				if( iX > Rect.iLeft ) pNeighbours[iNumNeighbours++] = pDest - iFloats;
+				if( iX + 1 < Rect.iRight ) pNeighbours[iNumNeighbours++] = pDest + iFloats;
+				if( iY > Rect.iTop ) pNeighbours[iNumNeighbours++] = pDest - iPitch;
+				if( iY + 1 < Rect.iBottom ) pNeighbours[iNumNeighbours++] = pDest + iPitch;
+				if( !iNumNeighbours )
+					continue;
+
+				const float32 fWeight = 1.0f / (float32)iNumNeighbours;
+				for( uint32 iFloat = 0; iFloat < iFloats; ++iFloat )
+				{
+					float32 fSum = 0.0f;
+					for( uint32 iNeighbour = 0; iNeighbour < iNumNeighbours; ++iNeighbour )
+						fSum += pNeighbours[iNeighbour][iFloat];
+					pDest[iFloat] = fSum * fWeight;
+				}
+			}
+		}
+
+		return s_ok;
+	}
+
+	// Grid-patterns: find the first and the last row and column of the phase's grid within the rectangle.
+	uint32 iGridX, iStep, iGridY = 0;
+	for( uint32 iRow = 0; iRow < 4; ++iRow )
+	{
+		if( bGetInterleaveRow( i_Interleave, i_iPhase, iRow, iGridX, iStep ) )
+		{
+			iGridY = iRow;
+			break;
+		}
+	}
+
+	const uint32 iFirstX = Rect.iLeft + ( iGridX + iStep - Rect.iLeft % iStep ) % iStep;
+	const uint32 iFirstY = Rect.iTop + ( iGridY + iStep - Rect.iTop % iStep ) % iStep;
+	if( iFirstX >= Rect.iRight || iFirstY >= Rect.iBottom )
+		return s_ok; // the phase has no pixels within the rectangle
+
+	const uint32 iLastX = iFirstX + ( ( Rect.iRight - 1 - iFirstX ) / iStep ) * iStep;
+	const uint32 iLastY = iFirstY + ( ( Rect.iBottom - 1 - iFirstY ) / iStep ) * iStep;
+	const float32 fInvStep = 1.0f / (float32)iStep;
+
+	for( uint32 iY = Rect.iTop; iY < Rect.iBottom; ++iY )
+	{
+		// Grid rows enclosing the pixel; outside the grid the nearest row is repeated.
+		uint32 iY0, iY1; float32 fWeightY;
+		if( iY <= iFirstY ) { iY0 = iY1 = iFirstY; fWeightY = 0.0f; }
+		else if( iY >= iLastY ) { iY0 = iY1 = iLastY; fWeightY = 0.0f; }
+		else { iY0 = iY - ( iY - iFirstY ) % iStep; iY1 = iY0 + iStep; fWeightY = (float32)( iY - iY0 ) * fInvStep; }
+
+		const float32 *pRow0 = &m_pData[iY0 * iPitch];
+		const float32 *pRow1 = &m_pData[iY1 * iPitch];
+		float32 *pDest = &m_pData[iY * iPitch + Rect.iLeft * iFloats];
+		for( uint32 iX = Rect.iLeft; iX < Rect.iRight; ++iX, pDest += iFloats )
+		{
+			if( iY == iY0 && iX >= iFirstX && ( iX - iFirstX ) % iStep == 0 )
+				continue; // pixel of the phase
+
+			uint32 iX0, iX1; float32 fWeightX;
+			if( iX <= iFirstX ) { iX0 = iX1 = iFirstX; fWeightX = 0.0f; }
+			else if( iX >= iLastX ) { iX0 = iX1 = iLastX; fWeightX = 0.0f; }
+			else { iX0 = iX - ( iX - iFirstX ) % iStep; iX1 = iX0 + iStep; fWeightX = (float32)( iX - iX0 ) * fInvStep; }
+
+			const float32 *pTaps[4] = { &pRow0[iX0 * iFloats], &pRow0[iX1 * iFloats], &pRow1[iX0 * iFloats], &pRow1[iX1 * iFloats] };
+			const float32 fWeights[4] = { ( 1.0f - fWeightX ) * ( 1.0f - fWeightY ), fWeightX * ( 1.0f - fWeightY ),
+				( 1.0f - fWeightX ) * fWeightY, fWeightX * fWeightY };
+			for( uint32 iFloat = 0; iFloat < iFloats; ++iFloat )
+				pDest[iFloat] = pTaps[0][iFloat] * fWeights[0] + pTaps[1][iFloat] * fWeights[1] +
+					pTaps[2][iFloat] * fWeights[2] + pTaps[3][iFloat] * fWeights[3];
+		}
+	}
+
+	return s_ok;
+}
+
 result CMuli3DSurface::CopyToSurface( const m3drect *i_pSrcRect, CMuli3DSurface *i_pDestSurface, const m3drect *i_pDestRect, m3dtexturefilter i_Filter )
 {
 	if( !i_pDestSurface )
@@ -388,6 +675,12 @@ result CMuli3DSurface::CopyToSurface( const m3drect *i_pSrcRect, CMuli3DSurface
 		return e_invalidparameters;
 	}
 
+	if( m_iSamples > 1 || i_pDestSurface->iGetSamples() > 1 )
+	{
+		FUNC_FAILING( "CMuli3DSurface::CopyToSurface: multisampled surfaces cannot be copied, use ResolveToSurface()!\n" );
+		return e_invalidparameters;
+	}
+
 	m3drect SrcRect;
 	if( i_pSrcRect )
 	{
@@ -488,3 +781,104 @@ result CMuli3DSurface::CopyToSurface( const m3drect *i_pSrcRect, CMuli3DSurface
 
 	return s_ok;
 }
+
+result CMuli3DSurface::ResolveToSurface( CMuli3DSurface *i_pDestSurface, m3dresolvefilter i_Filter )
+{
+	if( !i_pDestSurface || i_pDestSurface == this )
+	{
+		FUNC_FAILING( "CMuli3DSurface::ResolveToSurface: invalid destination surface specified!\n" );
+		return e_invalidparameters;
+	}
+
+	if( i_pDestSurface->iGetSamples() != 1 ||
+		i_pDestSurface->iGetWidth() != m_iWidth || i_pDestSurface->iGetHeight() != m_iHeight )
+	{
+		FUNC_FAILING( "CMuli3DSurface::ResolveToSurface: destination surface must have the same dimensions and a single sample per pixel!\n" );
+		return e_invalidparameters;
+	}
+
+	if( i_Filter != m3drf_box && i_Filter != m3drf_tent )
+	{
+		FUNC_FAILING( "CMuli3DSurface::ResolveToSurface: invalid filter specified!\n" );
+		return e_invalidparameters;
+	}
+
+	float32 *pDestData = 0;
+	result resLock = i_pDestSurface->LockRect( (void **)&pDestData, 0 );
+	if( FUNC_FAILED( resLock ) )
+	{
+		FUNC_FAILING( "CMuli3DSurface::ResolveToSurface: couldn't lock destination surface!\n" );
+		return e_invalidstate;
+	}
+
+	const uint32 iSrcFloats = iGetFormatFloats();
+	const uint32 iDestFloats = i_pDestSurface->iGetFormatFloats();
+	const uint32 iPixelFloats = m_iSamples * iSrcFloats;
+
+	if( i_Filter == m3drf_box )
+	{
+		const float32 fWeight = 1.0f / (float32)m_iSamples;
+		const float32 *pSrcData = m_pData;
+		for( uint32 iPixel = 0; iPixel < m_iWidth * m_iHeight; ++iPixel, pSrcData += iPixelFloats, pDestData += iDestFloats )
+		{
+			float32 fColor[4] = { 0, 0, 0, 0 };
+			for( uint32 iSample = 0; iSample < m_iSamples; ++iSample )
+			{
+				for( uint32 iFloat = 0; iFloat < iSrcFloats; ++iFloat )
+					fColor[iFloat] += pSrcData[iSample * iSrcFloats + iFloat];
+			}
+
+			for( uint32 iFloat = 0; iFloat < iDestFloats; ++iFloat )
+				pDestData[iFloat] = ( iFloat < iSrcFloats ) ? fColor[iFloat] * fWeight : ( iFloat == 3 ? 1.0f : 0.0f );
+		}
+
+		i_pDestSurface->UnlockRect();
+		return s_ok;
+	}
+
+	// Tent filter: weight the samples of the 3x3 neighbourhood by their distance to the pixel's center.
+	float32 fSampleX[c_iMaxMultiSamples], fSampleY[c_iMaxMultiSamples];
+	for( uint32 iSample = 0; iSample < m_iSamples; ++iSample )
+		GetSamplePosition( m_iSamples, iSample, fSampleX[iSample], fSampleY[iSample] );
+
+	for( int32 iY = 0; iY < (int32)m_iHeight; ++iY )
+	{
+		for( int32 iX = 0; iX < (int32)m_iWidth; ++iX, pDestData += iDestFloats )
+		{
+			float32 fColor[4] = { 0, 0, 0, 0 };
+			float32 fTotalWeight = 0.0f;
+			for( int32 iNeighbourY = iY - 1; iNeighbourY <= iY + 1; ++iNeighbourY )
+			{
+				if( iNeighbourY < 0 || iNeighbourY >= (int32)m_iHeight )
+					continue;
+
+				for( int32 iNeighbourX = iX - 1; iNeighbourX <= iX + 1; ++iNeighbourX )
+				{
+					if( iNeighbourX < 0 || iNeighbourX >= (int32)m_iWidth )
+						continue;
+
+					const float32 *pSrcData = &m_pData[( iNeighbourY * m_iWidth + iNeighbourX ) * iPixelFloats];
+					for( uint32 iSample = 0; iSample < m_iSamples; ++iSample, pSrcData += iSrcFloats )
+					{
+						const float32 fWeightX = 1.0f - fabsf( (float32)( iNeighbourX - iX ) + fSampleX[iSample] );
+						const float32 fWeightY = 1.0f - fabsf( (float32)( iNeighbourY - iY ) + fSampleY[iSample] );
+						if( fWeightX <= 0.0f || fWeightY <= 0.0f )
+							continue;
+
+						const float32 fWeight = fWeightX * fWeightY;
+						for( uint32 iFloat = 0; iFloat < iSrcFloats; ++iFloat )
+							fColor[iFloat] += pSrcData[iFloat] * fWeight;
+						fTotalWeight += fWeight;
+					}
+				}
+			}
+
+			const float32 fNormalization = 1.0f / fTotalWeight; // the pixel's own samples always have a weight > 0.
+			for( uint32 iFloat = 0; iFloat < iDestFloats; ++iFloat )
+				pDestData[iFloat] = ( iFloat < iSrcFloats ) ? fColor[iFloat] * fNormalization : ( iFloat == 3 ? 1.0f : 0.0f );
+		}
+	}
+
+	i_pDestSurface->UnlockRect();
+	return s_ok;
+}
@@ -23,7 +23,8 @@
 
 CMuli3DTexture::CMuli3DTexture( CMuli3DDevice *i_pParent )
 	: IMuli3DBaseTexture( i_pParent ),
-	m_iMipLevels( 0 ), m_ppMipLevels( 0 )
+	m_iMipLevels( 0 ), m_ppMipLevels( 0 ),
+	m_bAutoGenMipSubLevels( false ), m_AutoGenFilter( m3dmf_box ), m_iValidMipLevels( 0 )
 {
 	
 }
@@ -93,6 +94,8 @@ result CMuli3DTexture::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iMipL
 	}
 	while( i_iWidth && i_iHeight );
 
+	AtomicStoreRelease( &m_iValidMipLevels, m_iMipLevels );
+
 	return s_ok;
 }
 
@@ -109,10 +112,19 @@ result CMuli3DTexture::Clear( uint32 i_iMipLevel, const vector4 &i_vColor, const
 		return e_invalidparameters;
 	}
 
-	return m_ppMipLevels[i_iMipLevel]->Clear( i_vColor, i_pRect );
+	result resValidate = ValidateMipLevel( i_iMipLevel );
+	if( FUNC_FAILED( resValidate ) )
+		return resValidate;
+
+	result resClear = m_ppMipLevels[i_iMipLevel]->Clear( i_vColor, i_pRect );
+	if( FUNC_FAILED( resClear ) )
+		return resClear;
+
+	InvalidateMipSubLevels( i_iMipLevel );
+	return s_ok;
 }
 
-result CMuli3DTexture::GenerateMipSubLevels( uint32 i_iSrcLevel )
+result CMuli3DTexture::GenerateMipSubLevels( uint32 i_iSrcLevel, m3dmipfilter i_Filter )
 {
 	if( i_iSrcLevel + 1 >= m_iMipLevels )
 	{
@@ -120,115 +132,141 @@ result CMuli3DTexture::GenerateMipSubLevels( uint32 i_iSrcLevel )
 		return e_invalidparameters;
 	}
 
+	if( i_Filter != m3dmf_box && i_Filter != m3dmf_tent )
+	{
+		FUNC_FAILING( "CMuli3DTexture::GenerateMipSubLevels: invalid filter specified.\n" );
+		return e_invalidparameters;
+	}
+
+	if( m_bAutoGenMipSubLevels )
+	{
+		// Defer generation until the mip-sublevels are accessed.
+		result resValidate = ValidateMipLevel( i_iSrcLevel );
+		if( FUNC_FAILED( resValidate ) )
+			return resValidate;
+
+		m_AutoGenFilter = i_Filter;
+		InvalidateMipSubLevels( i_iSrcLevel );
+		return s_ok;
+	}
+
 	for( uint32 iLevel = i_iSrcLevel + 1; iLevel < m_iMipLevels; ++iLevel )
 	{
-		const float32 *pSrcData = 0;
-		result resLock = LockRect( iLevel - 1, (void **)&pSrcData, 0 );
-		if( FUNC_FAILED( resLock ) )
-			return resLock;
-		
-		float32 *pDestData = 0;
-		resLock = LockRect( iLevel, (void **)&pDestData, 0 );
-		if( FUNC_FAILED( resLock ) )
+		result resGenerate = GenerateMipLevel( iLevel, i_Filter );
+		if( FUNC_FAILED( resGenerate ) )
+			return resGenerate;
+	}
+
+	return s_ok;
+}
+
+result CMuli3DTexture::SetAutoGenMipSubLevels( bool i_bAutoGen, m3dmipfilter i_Filter )
+{
+	if( i_Filter != m3dmf_box && i_Filter != m3dmf_tent )
+	{
+		FUNC_FAILING( "CMuli3DTexture::SetAutoGenMipSubLevels: invalid filter specified.\n" );
+		return e_invalidparameters;
+	}
+
+	if( !i_bAutoGen )
+	{
+		// Explicit generation expects all mip-levels to be present.
+		m_AutoGenFilter = i_Filter;
+		result resValidate = ValidateMipLevel( m_iMipLevels - 1 );
+		if( FUNC_FAILED( resValidate ) )
+			return resValidate;
+
+		m_bAutoGenMipSubLevels = false;
+		return s_ok;
+	}
+
+	m_MipLevelMutex.Lock();
+
+	m_bAutoGenMipSubLevels = true;
+	m_AutoGenFilter = i_Filter;
+
+	// Free all mip-sublevels; they will be recreated on demand.
+	for( uint32 iLevel = 1; iLevel < m_iMipLevels; ++iLevel )
+		SAFE_RELEASE( m_ppMipLevels[iLevel] );
+	AtomicStoreRelease( &m_iValidMipLevels, 1 );
+
+	m_MipLevelMutex.Unlock();
+
+	return s_ok;
+}
+
+result CMuli3DTexture::GenerateMipLevel( uint32 i_iMipLevel, m3dmipfilter i_Filter )
+{
+	if( !m_ppMipLevels[i_iMipLevel] )
+	{
+		result resCreate = m_pParent->CreateSurface( &m_ppMipLevels[i_iMipLevel], iGetWidth( i_iMipLevel ), iGetHeight( i_iMipLevel ), fmtGetFormat() );
+		if( FUNC_FAILED( resCreate ) )
 		{
-			UnlockRect( iLevel );
-			return resLock;
+			FUNC_FAILING( "CMuli3DTexture::GenerateMipLevel: creation of mip-level failed.\n" );
+			return resCreate;
 		}
+	}
 
-		const uint32 iSrcHeight = iGetHeight( iLevel - 1 );
-		const uint32 iSrcWidth = iGetWidth( iLevel - 1 );
+	mipdownsample Downsample;
+	result resLock = m_ppMipLevels[i_iMipLevel - 1]->LockRect( (void **)&Downsample.pSrcData, 0 );
+	if( FUNC_FAILED( resLock ) )
+		return resLock;
 
-		switch( fmtGetFormat() )
-		{
-		case m3dfmt_r32f:
-			{
-				for( uint32 iY = 0; iY < iSrcHeight; iY += 2 )
-				{
-					const uint32 iIndexRows[2] = { iY * iSrcWidth, ( iY + 1 ) * iSrcWidth };
-					for( uint32 iX = 0; iX < iSrcWidth; iX += 2, ++pDestData )
-					{
-						const float32 fSrcPixels[4] = 
-						{
-							pSrcData[iIndexRows[0] + iX],
-							pSrcData[iIndexRows[0] + iX + 1],
-							pSrcData[iIndexRows[1] + iX],
-							pSrcData[iIndexRows[1] + iX + 1]
-						};
-						*pDestData = ( fSrcPixels[0] + fSrcPixels[1] + fSrcPixels[2] + fSrcPixels[3] ) * 0.25f;
-					}
-				}
-			}
-			break;
+	resLock = m_ppMipLevels[i_iMipLevel]->LockRect( (void **)&Downsample.pDestData, 0 );
+	if( FUNC_FAILED( resLock ) )
+	{
+		m_ppMipLevels[i_iMipLevel - 1]->UnlockRect();
+		return resLock;
+	}
 
-		case m3dfmt_r32g32f:
-			{
-				for( uint32 iY = 0; iY < iSrcHeight; iY += 2 )
-				{
-					const uint32 iIndexRows[2] = { iY * iSrcWidth, ( iY + 1 ) * iSrcWidth };
-					for( uint32 iX = 0; iX < iSrcWidth; iX += 2, pDestData += 2 )
-					{
-						const vector2 *pSrcPixels[4] = 
-						{
-							&((vector2 *)pSrcData)[iIndexRows[0] + iX],
-							&((vector2 *)pSrcData)[iIndexRows[0] + iX + 1],
-							&((vector2 *)pSrcData)[iIndexRows[1] + iX],
-							&((vector2 *)pSrcData)[iIndexRows[1] + iX + 1]
-						};
-						*(vector2 *)pDestData = ( *pSrcPixels[0] + *pSrcPixels[1] + *pSrcPixels[2] + *pSrcPixels[3] ) * 0.25f;
-					}
-				}
-			}
-			break;
+	Downsample.iFloats = iGetFormatFloats();
+	Downsample.iSrcWidth = iGetWidth( i_iMipLevel - 1 );
+	Downsample.iSrcHeight = iGetHeight( i_iMipLevel - 1 );
+	Downsample.iSrcDepth = 1;
+	Downsample.Filter = i_Filter;
+	DownsampleMipLevels( &Downsample, 1 );
 
-		case m3dfmt_r32g32b32f:
-			{
-				for( uint32 iY = 0; iY < iSrcHeight; iY += 2 )
-				{
-					const uint32 iIndexRows[2] = { iY * iSrcWidth, ( iY + 1 ) * iSrcWidth };
-					for( uint32 iX = 0; iX < iSrcWidth; iX += 2, pDestData += 3 )
-					{
-						const vector3 *pSrcPixels[4] = 
-						{
-							&((vector3 *)pSrcData)[iIndexRows[0] + iX],
-							&((vector3 *)pSrcData)[iIndexRows[0] + iX + 1],
-							&((vector3 *)pSrcData)[iIndexRows[1] + iX],
-							&((vector3 *)pSrcData)[iIndexRows[1] + iX + 1]
-						};
-						*(vector3 *)pDestData = ( *pSrcPixels[0] + *pSrcPixels[1] + *pSrcPixels[2] + *pSrcPixels[3] ) * 0.25f;
-					}
-				}
-			}
-			break;
+	m_ppMipLevels[i_iMipLevel]->UnlockRect();
+	m_ppMipLevels[i_iMipLevel - 1]->UnlockRect();
 
-		case m3dfmt_r32g32b32a32f:
-			{
-				for( uint32 iY = 0; iY < iSrcHeight; iY += 2 )
-				{
-					const uint32 iIndexRows[2] = { iY * iSrcWidth, ( iY + 1 ) * iSrcWidth };
-					for( uint32 iX = 0; iX < iSrcWidth; iX += 2, pDestData += 4 )
-					{
-						const vector4 *pSrcPixels[4] = 
-						{
-							&((vector4 *)pSrcData)[iIndexRows[0] + iX],
-							&((vector4 *)pSrcData)[iIndexRows[0] + iX + 1],
-							&((vector4 *)pSrcData)[iIndexRows[1] + iX],
-							&((vector4 *)pSrcData)[iIndexRows[1] + iX + 1]
-						};
-						*(vector4 *)pDestData = ( *pSrcPixels[0] + *pSrcPixels[1] + *pSrcPixels[2] + *pSrcPixels[3] ) * 0.25f;
-					}
-				}
-			}
-			break;
+	return s_ok;
+}
 
-		default: // cannot happen
+result CMuli3DTexture::ValidateMipLevel( uint32 i_iMipLevel )
+{
+	// Fast path: always taken if automatic mip-sublevel generation is disabled.
+	// Pairs with the release-store below, so that the mip-level's texels are visible.
+	if( i_iMipLevel < iAtomicLoadAcquire( &m_iValidMipLevels ) )
+		return s_ok;
+
+	m_MipLevelMutex.Lock();
+
+	// Generate all missing mip-levels up to the requested one; another thread may
+	// have done so while we were waiting for the mutex.
+	result resGenerate = s_ok;
+	while( m_iValidMipLevels <= i_iMipLevel )
+	{
+		resGenerate = GenerateMipLevel( m_iValidMipLevels, m_AutoGenFilter );
+		if( FUNC_FAILED( resGenerate ) )
 			break;
-		}
 
-		UnlockRect( iLevel );
-		UnlockRect( iLevel - 1 );
+		AtomicStoreRelease( &m_iValidMipLevels, m_iValidMipLevels + 1 );
 	}
 
-	return s_ok;
+	m_MipLevelMutex.Unlock();
+
+	return resGenerate;
+}
+
+void CMuli3DTexture::InvalidateMipSubLevels( uint32 i_iMipLevel )
+{
+	if( !m_bAutoGenMipSubLevels )
+		return;
+
+	m_MipLevelMutex.Lock();
+	if( m_iValidMipLevels > i_iMipLevel + 1 )
+		AtomicStoreRelease( &m_iValidMipLevels, i_iMipLevel + 1 );
+	m_MipLevelMutex.Unlock();
 }
 
 result CMuli3DTexture::LockRect( uint32 i_iMipLevel, void **o_ppData, const m3drect *i_pRect )
@@ -239,6 +277,10 @@ result CMuli3DTexture::LockRect( uint32 i_iMipLevel, void **o_ppData, const m3dr
 		return e_invalidparameters;
 	}
 
+	result resValidate = ValidateMipLevel( i_iMipLevel );
+	if( FUNC_FAILED( resValidate ) )
+		return resValidate;
+
 	return m_ppMipLevels[i_iMipLevel]->LockRect( o_ppData, i_pRect );
 }
 
@@ -250,7 +292,18 @@ result CMuli3DTexture::UnlockRect( uint32 i_iMipLevel )
 		return e_invalidparameters;
 	}
 
-	return m_ppMipLevels[i_iMipLevel]->UnlockRect();
+	if( !m_ppMipLevels[i_iMipLevel] )
+	{
+		FUNC_FAILING( "CMuli3DTexture::UnlockRect: cannot unlock mip-level because it isn't locked!\n" );
+		return e_invalidstate;
+	}
+
+	result resUnlock = m_ppMipLevels[i_iMipLevel]->UnlockRect();
+	if( FUNC_FAILED( resUnlock ) )
+		return resUnlock;
+
+	InvalidateMipSubLevels( i_iMipLevel );
+	return s_ok;
 }
 
 CMuli3DSurface *CMuli3DTexture::pGetMipLevel( uint32 i_iMipLevel )
@@ -261,11 +314,22 @@ CMuli3DSurface *CMuli3DTexture::pGetMipLevel( uint32 i_iMipLevel )
 		return 0;
 	}
 
+	if( FUNC_FAILED( ValidateMipLevel( i_iMipLevel ) ) )
+		return 0;
+
 	m_ppMipLevels[i_iMipLevel]->AddRef();
 
 	return m_ppMipLevels[i_iMipLevel];
 }
 
+result CMuli3DTexture::SampleTextureCmp( float32 &o_fResult, float32 i_fU, float32 i_fV, float32 i_fReference, const uint32 *i_pSamplerStates )
+{
+	o_fResult = m_ppMipLevels[0]->fSampleCompare( i_fU, i_fV, i_fReference,
+		(m3dcmpfunc)i_pSamplerStates[m3dtss_comparefunc], i_pSamplerStates[m3dtss_pcfkernelsize],
+		i_pSamplerStates[m3dtss_minfilter] == m3dtf_linear );
+	return s_ok;
+}
+
 result CMuli3DTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i_fV, float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient, const uint32 *i_pSamplerStates )
 {
 	uint32 iTexFilter = i_pSamplerStates[m3dtss_minfilter];
@@ -273,12 +337,12 @@ result CMuli3DTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i
 	
 	if( i_pXGradient && i_pYGradient )
 	{
-		// Compute the mip-level and determine the texture filter type.
+		// Compute the mip-level from the squared gradient lengths and determine the texture filter type.
 		const float32 fLenXGrad = i_pXGradient->x * i_pXGradient->x * m_fSquaredWidth + i_pXGradient->y * i_pXGradient->y * m_fSquaredHeight;
 		const float32 fLenYGrad = i_pYGradient->x * i_pYGradient->x * m_fSquaredWidth + i_pYGradient->y * i_pYGradient->y * m_fSquaredHeight;
-		const float32 fTexelsPerScreenPixel = sqrtf( fLenXGrad > fLenYGrad ? fLenXGrad : fLenYGrad );
+		const float32 fSquaredTexelsPerScreenPixel = fLenXGrad > fLenYGrad ? fLenXGrad : fLenYGrad;
 
-		if( fTexelsPerScreenPixel <= 1.0f )
+		if( fSquaredTexelsPerScreenPixel <= 1.0f )
 		{
 			 // if fTexelsPerScreenPixel < 1.0f -> magnification, no mipmapping needed
 			fTexMipLevel = 0.0f;
@@ -286,9 +350,8 @@ result CMuli3DTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i
 		}
 		else
 		{
-			// minification, need mipmapping
-			static const float32 fInvLog2 = 1.0f / logf( 2.0f ); // calculate log2
-			fTexMipLevel = logf( fTexelsPerScreenPixel ) * fInvLog2;
+			// minification, need mipmapping: log2( sqrt( x ) ) = 0.5f * log2( x )
+			fTexMipLevel = 0.5f * fFastLog2( fSquaredTexelsPerScreenPixel );
 			iTexFilter = i_pSamplerStates[m3dtss_minfilter];
 		}
 	}
@@ -297,11 +360,21 @@ result CMuli3DTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i
 	const float32 fMaxMipLevel = *(float32 *)&i_pSamplerStates[m3dtss_maxmiplevel];
 	fTexMipLevel = fClamp( fTexMipLevel + fMipLODBias, 0.0f, fMaxMipLevel );
 
+	if( m_pSamplerFeedback )
+		RecordSamplerFeedback( i_fU, i_fV, fTexMipLevel < m_iMipLevels ? fTexMipLevel : (float32)( m_iMipLevels - 1 ) );
+
 	if( i_pSamplerStates[m3dtss_mipfilter] == m3dtf_linear )
 	{
 		uint32 iMipLevelA = ftol( fTexMipLevel ), iMipLevelB = iMipLevelA + 1;
 		if( iMipLevelA >= m_iMipLevels ) iMipLevelA = m_iMipLevels - 1;
 		if( iMipLevelB >= m_iMipLevels ) iMipLevelB = m_iMipLevels - 1;
+		if( FUNC_FAILED( ValidateMipLevel( iMipLevelB ) ) )
+		{
+			// fall back to the smallest valid mip-level
+			const uint32 iValidMipLevels = iAtomicLoadAcquire( &m_iValidMipLevels );
+			if( iMipLevelA >= iValidMipLevels ) iMipLevelA = iValidMipLevels - 1;
+			if( iMipLevelB >= iValidMipLevels ) iMipLevelB = iValidMipLevels - 1;
+		}
 
 		vector4 vColorA, vColorB;
 		if( iTexFilter == m3dtf_linear )
@@ -322,6 +395,8 @@ result CMuli3DTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i
 	{
 		uint32 iMipLevel = ftol( fTexMipLevel );
 		if( iMipLevel >= m_iMipLevels ) iMipLevel = m_iMipLevels - 1;
+		if( FUNC_FAILED( ValidateMipLevel( iMipLevel ) ) )
+			iMipLevel = iAtomicLoadAcquire( &m_iValidMipLevels ) - 1; // fall back to the smallest valid mip-level
 
 		if( iTexFilter == m3dtf_linear )
 			m_ppMipLevels[iMipLevel]->SampleLinear( o_vColor, i_fU, i_fV );
@@ -355,7 +430,7 @@ uint32 CMuli3DTexture::iGetWidth( uint32 i_iMipLevel )
 		return 0;
 	}
 
-	return m_ppMipLevels[i_iMipLevel]->iGetWidth();
+	return m_ppMipLevels[0]->iGetWidth() >> i_iMipLevel; // surfaces of mip-sublevels may not have been created yet
 }
 
 uint32 CMuli3DTexture::iGetHeight( uint32 i_iMipLevel )
@@ -366,5 +441,5 @@ uint32 CMuli3DTexture::iGetHeight( uint32 i_iMipLevel )
 		return 0;
 	}
 
-	return m_ppMipLevels[i_iMipLevel]->iGetHeight();
+	return m_ppMipLevels[0]->iGetHeight() >> i_iMipLevel;
 }
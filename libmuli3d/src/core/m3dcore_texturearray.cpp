@@ -0,0 +1,236 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "../../include/core/m3dcore_texturearray.h"
+#include "../../include/core/m3dcore_texture.h"
+#include "../../include/core/m3dcore_device.h"
+
+CMuli3DTextureArray::CMuli3DTextureArray( CMuli3DDevice *i_pParent )
+	: IMuli3DBaseTexture( i_pParent ), m_iNumLayers( 0 ), m_ppLayers( 0 )
+{
+
+}
+
+CMuli3DTextureArray::~CMuli3DTextureArray()
+{
+	for( uint32 iLayer = 0; iLayer < m_iNumLayers; ++iLayer )
+		SAFE_RELEASE( m_ppLayers[iLayer] );
+	SAFE_DELETE_ARRAY( m_ppLayers );
+}
+
+result CMuli3DTextureArray::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iNumLayers, uint32 i_iMipLevels, m3dformat i_fmtFormat )
+{
+	if( !i_iNumLayers )
+	{
+		FUNC_FAILING( "CMuli3DTextureArray::Create: number of layers is invalid.\n" );
+		return e_invalidparameters;
+	}
+
+	m_ppLayers = new CMuli3DTexture *[i_iNumLayers];
+	if( !m_ppLayers )
+	{
+		FUNC_FAILING( "CMuli3DTextureArray::Create: out of memory, cannot create layers.\n" );
+		return e_outofmemory;
+	}
+
+	for( m_iNumLayers = 0; m_iNumLayers < i_iNumLayers; ++m_iNumLayers )
+	{
+		result resCreate = m_pParent->CreateTexture( &m_ppLayers[m_iNumLayers], i_iWidth, i_iHeight, i_iMipLevels, i_fmtFormat );
+		if( FUNC_FAILED( resCreate ) )
+			return resCreate;
+	}
+
+	return s_ok;
+}
+
+m3dtexsampleinput CMuli3DTextureArray::eGetTexSampleInput()
+{
+	return m3dtsi_layer;
+}
+
+result CMuli3DTextureArray::GenerateMipSubLevels( uint32 i_iSrcLevel, m3dmipfilter i_Filter )
+{
+	const uint32 iMipLevels = iGetMipLevels();
+	if( i_iSrcLevel + 1 >= iMipLevels )
+	{
+		FUNC_FAILING( "CMuli3DTextureArray::GenerateMipSubLevels: i_iSrcLevel refers either to last mip-level or is larger than the number of mip-levels.\n" );
+		return e_invalidparameters;
+	}
+
+	if( i_Filter != m3dmf_box && i_Filter != m3dmf_tent )
+	{
+		FUNC_FAILING( "CMuli3DTextureArray::GenerateMipSubLevels: invalid filter specified.\n" );
+		return e_invalidparameters;
+	}
+
+	if( m_ppLayers[0]->m_bAutoGenMipSubLevels )
+	{
+		// The layers defer generation until their mip-sublevels are accessed.
+		for( uint32 iLayer = 0; iLayer < m_iNumLayers; ++iLayer )
+		{
+			result resLayer = m_ppLayers[iLayer]->GenerateMipSubLevels( i_iSrcLevel, i_Filter );
+			if( FUNC_FAILED( resLayer ) )
+				return resLayer;
+		}
+		return s_ok;
+	}
+
+	mipdownsample *pDownsamples = new mipdownsample[m_iNumLayers];
+	if( !pDownsamples )
+	{
+		FUNC_FAILING( "CMuli3DTextureArray::GenerateMipSubLevels: out of memory, cannot create downsample descriptions.\n" );
+		return e_outofmemory;
+	}
+
+	// All layers of a mip-level are downsampled in one go, which gives the worker threads more rows to share.
+	result resLock = s_ok;
+	for( uint32 iLevel = i_iSrcLevel + 1; iLevel < iMipLevels && !FUNC_FAILED( resLock ); ++iLevel )
+	{
+		uint32 iLayer;
+		for( iLayer = 0; iLayer < m_iNumLayers; ++iLayer )
+		{
+			resLock = LockRect( iLayer, iLevel - 1, (void **)&pDownsamples[iLayer].pSrcData, 0 );
+			if( FUNC_FAILED( resLock ) )
+				break;
+
+			resLock = LockRect( iLayer, iLevel, (void **)&pDownsamples[iLayer].pDestData, 0 );
+			if( FUNC_FAILED( resLock ) )
+			{
+				UnlockRect( iLayer, iLevel - 1 );
+				break;
+			}
+
+			pDownsamples[iLayer].iFloats = iGetFormatFloats();
+			pDownsamples[iLayer].iSrcWidth = iGetWidth( iLevel - 1 );
+			pDownsamples[iLayer].iSrcHeight = iGetHeight( iLevel - 1 );
+			pDownsamples[iLayer].iSrcDepth = 1;
+			pDownsamples[iLayer].Filter = i_Filter;
+		}
+
+		if( !FUNC_FAILED( resLock ) )
+			DownsampleMipLevels( pDownsamples, m_iNumLayers );
+
+		while( iLayer-- > 0 )
+		{
+			UnlockRect( iLayer, iLevel );
+			UnlockRect( iLayer, iLevel - 1 );
+		}
+	}
+
+	SAFE_DELETE_ARRAY( pDownsamples );
+	return resLock;
+}
+
+result CMuli3DTextureArray::SetAutoGenMipSubLevels( bool i_bAutoGen, m3dmipfilter i_Filter )
+{
+	for( uint32 iLayer = 0; iLayer < m_iNumLayers; ++iLayer )
+	{
+		result resLayer = m_ppLayers[iLayer]->SetAutoGenMipSubLevels( i_bAutoGen, i_Filter );
+		if( FUNC_FAILED( resLayer ) )
+			return resLayer;
+	}
+	return s_ok;
+}
+
+result CMuli3DTextureArray::LockRect( uint32 i_iLayer, uint32 i_iMipLevel, void **o_ppData, const m3drect *i_pRect )
+{
+	if( i_iLayer >= m_iNumLayers )
+	{
+		FUNC_FAILING( "CMuli3DTextureArray::LockRect: invalid layer requested.\n" );
+		return e_invalidparameters;
+	}
+
+	return m_ppLayers[i_iLayer]->LockRect( i_iMipLevel, o_ppData, i_pRect );
+}
+
+result CMuli3DTextureArray::UnlockRect( uint32 i_iLayer, uint32 i_iMipLevel )
+{
+	if( i_iLayer >= m_iNumLayers )
+	{
+		FUNC_FAILING( "CMuli3DTextureArray::UnlockRect: invalid layer specified.\n" );
+		return e_invalidparameters;
+	}
+
+	return m_ppLayers[i_iLayer]->UnlockRect( i_iMipLevel );
+}
+
+result CMuli3DTextureArray::SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i_fV, float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient, const uint32 *i_pSamplerStates )
+{
+	// Round to the nearest layer; the layer index is not subject to texture addressing.
+	uint32 iLayer = 0;
+	if( i_fW > 0.0f )
+	{
+		iLayer = ftol( i_fW + 0.5f );
+		if( iLayer >= m_iNumLayers )
+			iLayer = m_iNumLayers - 1;
+	}
+
+	return m_ppLayers[iLayer]->SampleTexture( o_vColor, i_fU, i_fV, 0, i_pXGradient, i_pYGradient, i_pSamplerStates );
+}
+
+m3dformat CMuli3DTextureArray::fmtGetFormat()
+{
+	return m_ppLayers[0]->fmtGetFormat();
+}
+
+uint32 CMuli3DTextureArray::iGetFormatFloats()
+{
+	return m_ppLayers[0]->iGetFormatFloats();
+}
+
+uint32 CMuli3DTextureArray::iGetMipLevels()
+{
+	return m_ppLayers[0]->iGetMipLevels();
+}
+
+uint32 CMuli3DTextureArray::iGetNumLayers()
+{
+	return m_iNumLayers;
+}
+
+uint32 CMuli3DTextureArray::iGetWidth( uint32 i_iMipLevel )
+{
+	return m_ppLayers[0]->iGetWidth( i_iMipLevel );
+}
+
+uint32 CMuli3DTextureArray::iGetHeight( uint32 i_iMipLevel )
+{
+	return m_ppLayers[0]->iGetHeight( i_iMipLevel );
+}
+
+result CMuli3DTextureArray::SetSamplerFeedback( bool i_bEnable )
+{
+	if( !i_bEnable )
+		return IMuli3DBaseTexture::SetSamplerFeedback( false );
+
+	FUNC_FAILING( "CMuli3DTextureArray::SetSamplerFeedback: texture arrays record sampler feedback per layer, enable it on the textures returned by pGetLayer().\n" );
+	return e_invalidstate;
+}
+
+CMuli3DTexture *CMuli3DTextureArray::pGetLayer( uint32 i_iLayer )
+{
+	if( i_iLayer >= m_iNumLayers )
+	{
+		FUNC_FAILING( "CMuli3DTextureArray::pGetLayer: invalid layer requested.\n" );
+		return 0;
+	}
+
+	m_ppLayers[i_iLayer]->AddRef();
+	return m_ppLayers[i_iLayer];
+}
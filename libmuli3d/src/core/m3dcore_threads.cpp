@@ -0,0 +1,421 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "../../include/core/m3dcore_threads.h"
+
+#if defined( WIN32 )
+#	include <windows.h>
+#elif !defined( __amigaos4__ )
+#	define M3D_PTHREADS
+#	include <pthread.h>
+#	include <unistd.h>
+#endif
+
+const uint32 c_iMaxWorkerThreads = 32; ///< Upper limit for the number of worker threads.
+
+/// @internal Describes the range of items a worker thread processes.
+struct m3dparallelrange
+{
+	m3dparallelfunc	fpFunc;		///< Work-function.
+	void			*pUserData;	///< User data passed to the work-function.
+	uint32			iBegin;		///< First item.
+	uint32			iEnd;		///< Item following the last item.
+};
+
+static void ProcessParallelRange( const m3dparallelrange *i_pRange )
+{
+	i_pRange->fpFunc( i_pRange->iBegin, i_pRange->iEnd, i_pRange->pUserData );
+}
+
+/// @internal Persistent worker thread of the pool ParallelFor() distributes work across.
+struct m3dworker
+{
+	CMuli3DThread		Thread;	///< The worker thread.
+	CMuli3DEvent		Start;	///< Signaled when Range has been set up or the worker has to quit.
+	CMuli3DEvent		Done;	///< Signaled when Range has been processed.
+	m3dparallelrange	Range;	///< Range of items to be processed.
+	bool				bQuit;	///< Tells the worker to exit when Start is signaled.
+};
+
+static void WorkerThread( void *i_pWorker )
+{
+	m3dworker *pWorker = (m3dworker *)i_pWorker;
+	for( ;; )
+	{
+		pWorker->Start.Wait();
+		if( pWorker->bQuit )
+			return;
+
+		ProcessParallelRange( &pWorker->Range );
+		pWorker->Done.Set();
+	}
+}
+
+// The worker threads are created on the first call to ParallelFor() and live until the program exits.
+static m3dworker *s_pWorkers = 0;			///< The workers.
+static uint32 s_iNumWorkers = 0;			///< Number of workers, whose threads have been started.
+static bool s_bWorkersCreated = false;		///< True once creation of the workers has been attempted.
+static volatile uint32 s_iWorkersBusy = 0;	///< 1 while a ParallelFor() call owns the workers.
+
+/// @internal Shuts down the worker threads at program exit.
+static struct m3dworkershutdown
+{
+	~m3dworkershutdown()
+	{
+		for( uint32 iWorker = 0; iWorker < s_iNumWorkers; ++iWorker )
+		{
+			s_pWorkers[iWorker].bQuit = true;
+			s_pWorkers[iWorker].Start.Set();
+			s_pWorkers[iWorker].Thread.Join();
+		}
+		SAFE_DELETE_ARRAY( s_pWorkers );
+		s_iNumWorkers = 0;
+	}
+} s_WorkerShutdown;
+
+static void CreateWorkers()
+{
+	s_bWorkersCreated = true;
+
+	const uint32 iNumWorkers = iGetNumWorkerThreads() - 1;
+	if( !iNumWorkers )
+		return;
+
+	s_pWorkers = new m3dworker[iNumWorkers];
+	if( !s_pWorkers )
+		return;
+
+	// Thread creation may fail or be unsupported, in which case only the workers started so far are used.
+	for( ; s_iNumWorkers < iNumWorkers; ++s_iNumWorkers )
+	{
+		s_pWorkers[s_iNumWorkers].bQuit = false;
+		if( FUNC_FAILED( s_pWorkers[s_iNumWorkers].Thread.Start( WorkerThread, &s_pWorkers[s_iNumWorkers] ) ) )
+			break;
+	}
+}
+
+uint32 iGetNumWorkerThreads()
+{
+	static uint32 iNumWorkerThreads = 0;
+	if( iNumWorkerThreads )
+		return iNumWorkerThreads;
+
+	int32 iProcessors = 1;
+#if defined( WIN32 )
+	SYSTEM_INFO SystemInfo;
+	GetSystemInfo( &SystemInfo );
+	iProcessors = (int32)SystemInfo.dwNumberOfProcessors;
+#elif defined( M3D_PTHREADS )
+	iProcessors = (int32)sysconf( _SC_NPROCESSORS_ONLN );
+#endif
+
+	if( iProcessors < 1 ) iProcessors = 1;
+	if( iProcessors > (int32)c_iMaxWorkerThreads ) iProcessors = c_iMaxWorkerThreads;
+	iNumWorkerThreads = (uint32)iProcessors;
+	return iNumWorkerThreads;
+}
+
+void ParallelFor( uint32 i_iNumItems, uint32 i_iMinItemsPerThread, m3dparallelfunc i_fpFunc, void *i_pUserData )
+{
+	if( !i_iNumItems )
+		return;
+
+	if( !i_iMinItemsPerThread )
+		i_iMinItemsPerThread = 1;
+
+	uint32 iNumThreads = iGetNumWorkerThreads();
+	if( iNumThreads > i_iNumItems / i_iMinItemsPerThread )
+		iNumThreads = i_iNumItems / i_iMinItemsPerThread;
+
+	// The workers serve one call at a time; nested calls from within a work-function
+	// and calls from other threads while the workers are busy are processed serially.
+	if( iNumThreads <= 1 || !bAtomicCompareExchange( &s_iWorkersBusy, 0, 1 ) )
+	{
+		i_fpFunc( 0, i_iNumItems, i_pUserData );
+		return;
+	}
+
+	if( !s_bWorkersCreated )
+		CreateWorkers();
+
+	if( iNumThreads > s_iNumWorkers + 1 )
+		iNumThreads = s_iNumWorkers + 1;
+
+	// Split the items into contiguous ranges, the first iRemainder ranges get one extra item.
+	m3dparallelrange Ranges[c_iMaxWorkerThreads];
+	const uint32 iItemsPerThread = i_iNumItems / iNumThreads;
+	const uint32 iRemainder = i_iNumItems % iNumThreads;
+	uint32 iBegin = 0;
+	for( uint32 iThread = 0; iThread < iNumThreads; ++iThread )
+	{
+		Ranges[iThread].fpFunc = i_fpFunc;
+		Ranges[iThread].pUserData = i_pUserData;
+		Ranges[iThread].iBegin = iBegin;
+		iBegin += iItemsPerThread + ( iThread < iRemainder ? 1 : 0 );
+		Ranges[iThread].iEnd = iBegin;
+	}
+
+	for( uint32 iThread = 1; iThread < iNumThreads; ++iThread )
+	{
+		s_pWorkers[iThread - 1].Range = Ranges[iThread];
+		s_pWorkers[iThread - 1].Start.Set();
+	}
+
+	ProcessParallelRange( &Ranges[0] );
+
+	for( uint32 iThread = 1; iThread < iNumThreads; ++iThread )
+		s_pWorkers[iThread - 1].Done.Wait();
+
+	bAtomicCompareExchange( &s_iWorkersBusy, 1, 0 );
+}
+
+bool bAtomicCompareExchange( volatile uint32 *io_pValue, uint32 i_iExpected, uint32 i_iNewValue )
+{
+#if defined( WIN32 )
+	return (uint32)InterlockedCompareExchange( (volatile LONG *)io_pValue, (LONG)i_iNewValue, (LONG)i_iExpected ) == i_iExpected;
+#elif defined( M3D_PTHREADS ) && defined( __GNUC__ )
+	return __sync_bool_compare_and_swap( io_pValue, i_iExpected, i_iNewValue );
+#else
+	if( *io_pValue != i_iExpected ) // single-threaded
+		return false;
+	*io_pValue = i_iNewValue;
+	return true;
+#endif
+}
+
+void AtomicMin( volatile uint32 *io_pValue, uint32 i_iValue )
+{
+	uint32 iCurValue = *io_pValue;
+	while( i_iValue < iCurValue )
+	{
+#if defined( WIN32 )
+		const uint32 iPrevValue = (uint32)InterlockedCompareExchange( (volatile LONG *)io_pValue, (LONG)i_iValue, (LONG)iCurValue );
+#elif defined( M3D_PTHREADS ) && defined( __GNUC__ )
+		const uint32 iPrevValue = __sync_val_compare_and_swap( io_pValue, iCurValue, i_iValue );
+#else
+		const uint32 iPrevValue = iCurValue; // single-threaded
+		*io_pValue = i_iValue;
+#endif
+		if( iPrevValue == iCurValue )
+			break;
+
+		iCurValue = iPrevValue; // another thread got in between, retry
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+CMuli3DMutex::CMuli3DMutex() : m_pHandle( 0 )
+{
+#if defined( WIN32 )
+	CRITICAL_SECTION *pCriticalSection = new CRITICAL_SECTION;
+	InitializeCriticalSection( pCriticalSection );
+	m_pHandle = pCriticalSection;
+#elif defined( M3D_PTHREADS )
+	pthread_mutex_t *pMutex = new pthread_mutex_t;
+	pthread_mutex_init( pMutex, 0 );
+	m_pHandle = pMutex;
+#endif
+}
+
+CMuli3DMutex::~CMuli3DMutex()
+{
+#if defined( WIN32 )
+	CRITICAL_SECTION *pCriticalSection = (CRITICAL_SECTION *)m_pHandle;
+	DeleteCriticalSection( pCriticalSection );
+	SAFE_DELETE( pCriticalSection );
+#elif defined( M3D_PTHREADS )
+	pthread_mutex_t *pMutex = (pthread_mutex_t *)m_pHandle;
+	pthread_mutex_destroy( pMutex );
+	SAFE_DELETE( pMutex );
+#endif
+}
+
+void CMuli3DMutex::Lock()
+{
+#if defined( WIN32 )
+	EnterCriticalSection( (CRITICAL_SECTION *)m_pHandle );
+#elif defined( M3D_PTHREADS )
+	pthread_mutex_lock( (pthread_mutex_t *)m_pHandle );
+#endif
+}
+
+void CMuli3DMutex::Unlock()
+{
+#if defined( WIN32 )
+	LeaveCriticalSection( (CRITICAL_SECTION *)m_pHandle );
+#elif defined( M3D_PTHREADS )
+	pthread_mutex_unlock( (pthread_mutex_t *)m_pHandle );
+#endif
+}
+
+// ----------------------------------------------------------------------------
+
+/// @internal Thread function and user data, passed to the platform's thread entry point.
+struct m3dthreadstart
+{
+	m3dthreadfunc	fpFunc;		///< Thread function.
+	void			*pUserData;	///< User data passed to the thread function.
+#if defined( WIN32 )
+	HANDLE			hThread;	///< Thread handle.
+#elif defined( M3D_PTHREADS )
+	pthread_t		Thread;		///< Thread handle.
+#endif
+};
+
+#if defined( WIN32 )
+static DWORD WINAPI ThreadEntry( LPVOID i_pThreadStart )
+#else
+static void *ThreadEntry( void *i_pThreadStart )
+#endif
+{
+	const m3dthreadstart *pThreadStart = (const m3dthreadstart *)i_pThreadStart;
+	pThreadStart->fpFunc( pThreadStart->pUserData );
+	return 0;
+}
+
+CMuli3DThread::CMuli3DThread() : m_pHandle( 0 )
+{
+
+}
+
+CMuli3DThread::~CMuli3DThread()
+{
+	Join();
+}
+
+result CMuli3DThread::Start( m3dthreadfunc i_fpFunc, void *i_pUserData )
+{
+	if( m_pHandle )
+	{
+		FUNC_FAILING( "CMuli3DThread::Start: thread has already been started.\n" );
+		return e_invalidstate;
+	}
+
+#if defined( WIN32 ) || defined( M3D_PTHREADS )
+	m3dthreadstart *pThreadStart = new m3dthreadstart;
+	if( !pThreadStart )
+		return e_outofmemory;
+
+	pThreadStart->fpFunc = i_fpFunc;
+	pThreadStart->pUserData = i_pUserData;
+
+#if defined( WIN32 )
+	pThreadStart->hThread = CreateThread( 0, 0, ThreadEntry, pThreadStart, 0, 0 );
+	if( !pThreadStart->hThread )
+#else
+	if( pthread_create( &pThreadStart->Thread, 0, ThreadEntry, pThreadStart ) != 0 )
+#endif
+	{
+		SAFE_DELETE( pThreadStart );
+		return e_unknown;
+	}
+
+	m_pHandle = pThreadStart;
+	return s_ok;
+#else
+	return e_unknown;
+#endif
+}
+
+void CMuli3DThread::Join()
+{
+	if( !m_pHandle )
+		return;
+
+	m3dthreadstart *pThreadStart = (m3dthreadstart *)m_pHandle;
+#if defined( WIN32 )
+	WaitForSingleObject( pThreadStart->hThread, INFINITE );
+	CloseHandle( pThreadStart->hThread );
+#elif defined( M3D_PTHREADS )
+	pthread_join( pThreadStart->Thread, 0 );
+#endif
+	SAFE_DELETE( pThreadStart );
+	m_pHandle = 0;
+}
+
+bool CMuli3DThread::bIsStarted()
+{
+	return m_pHandle != 0;
+}
+
+// ----------------------------------------------------------------------------
+
+#if defined( M3D_PTHREADS )
+/// @internal pthreads lacks events; they are built from a condition variable.
+struct m3dpthreadevent
+{
+	pthread_mutex_t	Mutex;		///< Protects bSignaled.
+	pthread_cond_t	Condition;	///< Signaled when bSignaled becomes true.
+	bool			bSignaled;	///< State of the event.
+};
+#endif
+
+CMuli3DEvent::CMuli3DEvent() : m_pHandle( 0 )
+{
+#if defined( WIN32 )
+	m_pHandle = CreateEvent( 0, FALSE, FALSE, 0 );
+#elif defined( M3D_PTHREADS )
+	m3dpthreadevent *pEvent = new m3dpthreadevent;
+	pthread_mutex_init( &pEvent->Mutex, 0 );
+	pthread_cond_init( &pEvent->Condition, 0 );
+	pEvent->bSignaled = false;
+	m_pHandle = pEvent;
+#endif
+}
+
+CMuli3DEvent::~CMuli3DEvent()
+{
+#if defined( WIN32 )
+	if( m_pHandle )
+		CloseHandle( (HANDLE)m_pHandle );
+#elif defined( M3D_PTHREADS )
+	m3dpthreadevent *pEvent = (m3dpthreadevent *)m_pHandle;
+	pthread_cond_destroy( &pEvent->Condition );
+	pthread_mutex_destroy( &pEvent->Mutex );
+	SAFE_DELETE( pEvent );
+#endif
+}
+
+void CMuli3DEvent::Set()
+{
+#if defined( WIN32 )
+	SetEvent( (HANDLE)m_pHandle );
+#elif defined( M3D_PTHREADS )
+	m3dpthreadevent *pEvent = (m3dpthreadevent *)m_pHandle;
+	pthread_mutex_lock( &pEvent->Mutex );
+	pEvent->bSignaled = true;
+	pthread_cond_signal( &pEvent->Condition );
+	pthread_mutex_unlock( &pEvent->Mutex );
+#endif
+}
+
+void CMuli3DEvent::Wait()
+{
+#if defined( WIN32 )
+	WaitForSingleObject( (HANDLE)m_pHandle, INFINITE );
+#elif defined( M3D_PTHREADS )
+	m3dpthreadevent *pEvent = (m3dpthreadevent *)m_pHandle;
+	pthread_mutex_lock( &pEvent->Mutex );
+	while( !pEvent->bSignaled )
+		pthread_cond_wait( &pEvent->Condition, &pEvent->Mutex );
+	pEvent->bSignaled = false;
+	pthread_mutex_unlock( &pEvent->Mutex );
+#endif
+}
@@ -22,14 +22,16 @@
 
 CMuli3DVolume::CMuli3DVolume( CMuli3DDevice *i_pParent ) :
 	m_pParent( i_pParent ), m_iWidth( 0 ), m_iHeight( 0 ), m_iDepth( 0 ),
-	m_iWidthMin1( 0 ), m_iHeightMin1( 0 ), m_iDepthMin1( 0 ), 
-	m_bLockedComplete( false ), m_pPartialLockData( 0 ), m_pData( 0 )
+	m_iWidthMin1( 0 ), m_iHeightMin1( 0 ), m_iDepthMin1( 0 ), m_iFloats( 0 ),
+	m_iBricksX( 0 ), m_iBricksY( 0 ), m_iBricksZ( 0 ),
+	m_pLockData( 0 ), m_pData( 0 ), m_pBricks( 0 )
 {}
 
 CMuli3DVolume::~CMuli3DVolume()
 {
-	SAFE_DELETE_ARRAY( m_pPartialLockData ); // somebody might have forgotten to unlock the volume ;)
+	SAFE_DELETE_ARRAY( m_pLockData ); // somebody might have forgotten to unlock the volume ;)
 	SAFE_DELETE_ARRAY( m_pData );
+	SAFE_DELETE_ARRAY( m_pBricks );
 }
 
 result CMuli3DVolume::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth, m3dformat i_fmtFormat )
@@ -51,6 +53,7 @@ result CMuli3DVolume::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth
 	}
 
 	m_fmtFormat = i_fmtFormat;
+	m_iFloats = iFloats;
 	m_iWidth = i_iWidth;
 	m_iHeight = i_iHeight;
 	m_iDepth = i_iDepth;
@@ -58,13 +61,27 @@ result CMuli3DVolume::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth
 	m_iHeightMin1 = m_iHeight - 1;
 	m_iDepthMin1 = m_iDepth - 1;
 
-	m_pData = new float32[m_iWidth * m_iHeight * m_iDepth * iFloats];
-	if( !m_pData )
+	m_iBricksX = ( m_iWidth + c_iVolumeBrickMask ) >> c_iVolumeBrickShift;
+	m_iBricksY = ( m_iHeight + c_iVolumeBrickMask ) >> c_iVolumeBrickShift;
+	m_iBricksZ = ( m_iDepth + c_iVolumeBrickMask ) >> c_iVolumeBrickShift;
+	const uint32 iNumBricks = m_iBricksX * m_iBricksY * m_iBricksZ;
+	const uint32 iBrickFloats = c_iVolumeBrickSize * c_iVolumeBrickSize * c_iVolumeBrickSize * m_iFloats;
+
+	m_pData = new float32[iNumBricks * iBrickFloats];
+	m_pBricks = new volumebrick[iNumBricks];
+	if( !m_pData || !m_pBricks )
 	{
 		FUNC_FAILING( "CMuli3DVolume::Create: out of memory, cannot create volume.\n" );
 		return e_outofmemory;
 	}
 
+	// padding voxels are never sampled, but keep the data defined
+	memset( m_pData, 0, sizeof( float32 ) * iNumBricks * iBrickFloats );
+	m3dbox Box;
+	Box.iLeft = 0; Box.iTop = 0; Box.iFront = 0;
+	Box.iRight = m_iWidth; Box.iBottom = m_iHeight; Box.iBack = m_iDepth;
+	UpdateBrickMinMax( Box );
+
 	return s_ok;
 }
 
@@ -97,81 +114,110 @@ result CMuli3DVolume::Clear( const vector4 &i_vColor, const m3dbox *i_pBox )
 		ClearBox.iRight = m_iWidth; ClearBox.iBottom = m_iHeight; ClearBox.iBack = m_iDepth;
 	}
 
-	float32 *pData;
-	result resPointer = LockBox( (void **)&pData, 0 );
-	if( FUNC_FAILED( resPointer ) )
-		return resPointer;
+	if( m_pLockData )
+	{
+		FUNC_FAILING( "CMuli3DVolume::Clear: volume is locked!\n" );
+		return e_invalidstate;
+	}
 
-	switch( m_fmtFormat )
+	for( uint32 iZ = ClearBox.iFront; iZ < ClearBox.iBack; ++iZ )
 	{
-	case m3dfmt_r32f:
+		for( uint32 iY = ClearBox.iTop; iY < ClearBox.iBottom; ++iY )
 		{
-			for( uint32 iZ = ClearBox.iFront; iZ < ClearBox.iBack; ++iZ )
+			for( uint32 iX = ClearBox.iLeft; iX < ClearBox.iRight; ++iX )
 			{
-				float32 *pCurData2 = &pData[iZ * m_iWidth * m_iHeight];
-				for( uint32 iY = ClearBox.iTop; iY < ClearBox.iBottom; ++iY )
+				float32 *pVoxel = &m_pData[iGetVoxelOffset( iX, iY, iZ )];
+				switch( m_iFloats )
 				{
-					float32 *pCurData = &pCurData2[iY * m_iWidth + ClearBox.iLeft];
-					for( uint32 iX = ClearBox.iLeft; iX < ClearBox.iRight; ++iX, ++pCurData )
-						*pCurData = i_vColor.r;
+				case 4: pVoxel[3] = i_vColor.a;
+				case 3: pVoxel[2] = i_vColor.b;
+				case 2: pVoxel[1] = i_vColor.g;
+				case 1: pVoxel[0] = i_vColor.r;
 				}
 			}
 		}
-		break;
+	}
 
-	case m3dfmt_r32g32f:
-		{
-			for( uint32 iZ = ClearBox.iFront; iZ < ClearBox.iBack; ++iZ )
-			{
-				vector2 *pCurData2 = &((vector2 *)pData)[iZ * m_iWidth * m_iHeight];
-				for( uint32 iY = ClearBox.iTop; iY < ClearBox.iBottom; ++iY )
-				{
-					vector2 *pCurData = &pCurData2[iY * m_iWidth + ClearBox.iLeft];
-					for( uint32 iX = ClearBox.iLeft; iX < ClearBox.iRight; ++iX, ++pCurData )
-						*pCurData = i_vColor;
-				}
-			}
-		}
-		break;
+	UpdateBrickMinMax( ClearBox );
+
+	return s_ok;
+}
+
+void CMuli3DVolume::CopyRow( float32 *io_pLinearData, uint32 i_iLeft, uint32 i_iRight, uint32 i_iY, uint32 i_iZ, bool i_bToBricks )
+{
+	// copy the row in segments, which lie within a single brick and are contiguous in memory
+	uint32 iX = i_iLeft;
+	while( iX < i_iRight )
+	{
+		uint32 iSegmentEnd = ( iX | c_iVolumeBrickMask ) + 1;
+		if( iSegmentEnd > i_iRight ) iSegmentEnd = i_iRight;
+		const uint32 iSegmentFloats = ( iSegmentEnd - iX ) * m_iFloats;
+
+		float32 *pVolumeData = &m_pData[iGetVoxelOffset( iX, i_iY, i_iZ )];
+		if( i_bToBricks )
+			memcpy( pVolumeData, io_pLinearData, sizeof( float32 ) * iSegmentFloats );
+		else
+			memcpy( io_pLinearData, pVolumeData, sizeof( float32 ) * iSegmentFloats );
+
+		io_pLinearData += iSegmentFloats;
+		iX = iSegmentEnd;
+	}
+}
+
+void CMuli3DVolume::UpdateBrickMinMax( const m3dbox &i_Box )
+{
+	// a brick's lookups access the voxels [brick start, brick end] -> the voxel at the start of a brick also affects the preceding brick
+	const uint32 iBrickLeft = i_Box.iLeft ? ( i_Box.iLeft - 1 ) >> c_iVolumeBrickShift : 0;
+	const uint32 iBrickTop = i_Box.iTop ? ( i_Box.iTop - 1 ) >> c_iVolumeBrickShift : 0;
+	const uint32 iBrickFront = i_Box.iFront ? ( i_Box.iFront - 1 ) >> c_iVolumeBrickShift : 0;
+	const uint32 iBrickRight = ( ( i_Box.iRight - 1 ) >> c_iVolumeBrickShift ) + 1;
+	const uint32 iBrickBottom = ( ( i_Box.iBottom - 1 ) >> c_iVolumeBrickShift ) + 1;
+	const uint32 iBrickBack = ( ( i_Box.iBack - 1 ) >> c_iVolumeBrickShift ) + 1;
+
+	for( uint32 iBrickZ = iBrickFront; iBrickZ < iBrickBack; ++iBrickZ )
+	{
+		const uint32 iZ0 = iBrickZ << c_iVolumeBrickShift;
+		uint32 iZ1 = iZ0 + c_iVolumeBrickSize; if( iZ1 > m_iDepthMin1 ) iZ1 = m_iDepthMin1;
 
-	case m3dfmt_r32g32b32f:
+		for( uint32 iBrickY = iBrickTop; iBrickY < iBrickBottom; ++iBrickY )
 		{
-			for( uint32 iZ = ClearBox.iFront; iZ < ClearBox.iBack; ++iZ )
+			const uint32 iY0 = iBrickY << c_iVolumeBrickShift;
+			uint32 iY1 = iY0 + c_iVolumeBrickSize; if( iY1 > m_iHeightMin1 ) iY1 = m_iHeightMin1;
+
+			for( uint32 iBrickX = iBrickLeft; iBrickX < iBrickRight; ++iBrickX )
 			{
-				vector3 *pCurData2 = &((vector3 *)pData)[iZ * m_iWidth * m_iHeight];
-				for( uint32 iY = ClearBox.iTop; iY < ClearBox.iBottom; ++iY )
+				const uint32 iX0 = iBrickX << c_iVolumeBrickShift;
+				uint32 iX1 = iX0 + c_iVolumeBrickSize; if( iX1 > m_iWidthMin1 ) iX1 = m_iWidthMin1;
+
+				volumebrick &Brick = m_pBricks[( iBrickZ * m_iBricksY + iBrickY ) * m_iBricksX + iBrickX];
+				Brick.vMin = vector4( 0, 0, 0, 1 );
+				Brick.vMax = vector4( 0, 0, 0, 1 );
+
+				const float32 *pFirstVoxel = &m_pData[iGetVoxelOffset( iX0, iY0, iZ0 )];
+				for( uint32 iChannel = 0; iChannel < m_iFloats; ++iChannel )
 				{
-					vector3 *pCurData = &pCurData2[iY * m_iWidth + ClearBox.iLeft];
-					for( uint32 iX = ClearBox.iLeft; iX < ClearBox.iRight; ++iX, ++pCurData )
-						*pCurData = i_vColor;
+					Brick.vMin[iChannel] = pFirstVoxel[iChannel];
+					Brick.vMax[iChannel] = pFirstVoxel[iChannel];
 				}
-			}
-		}
-		break;
 
-	case m3dfmt_r32g32b32a32f:
-		{
-			for( uint32 iZ = ClearBox.iFront; iZ < ClearBox.iBack; ++iZ )
-			{
-				vector4 *pCurData2 = &((vector4 *)pData)[iZ * m_iWidth * m_iHeight];
-				for( uint32 iY = ClearBox.iTop; iY < ClearBox.iBottom; ++iY )
+				for( uint32 iZ = iZ0; iZ <= iZ1; ++iZ )
 				{
-					vector4 *pCurData = &pCurData2[iY * m_iWidth + ClearBox.iLeft];
-					for( uint32 iX = ClearBox.iLeft; iX < ClearBox.iRight; ++iX, ++pCurData )
-						*pCurData = i_vColor;
+					for( uint32 iY = iY0; iY <= iY1; ++iY )
+					{
+						for( uint32 iX = iX0; iX <= iX1; ++iX )
+						{
+							const float32 *pVoxel = &m_pData[iGetVoxelOffset( iX, iY, iZ )];
+							for( uint32 iChannel = 0; iChannel < m_iFloats; ++iChannel )
+							{
+								if( pVoxel[iChannel] < Brick.vMin[iChannel] ) Brick.vMin[iChannel] = pVoxel[iChannel];
+								if( pVoxel[iChannel] > Brick.vMax[iChannel] ) Brick.vMax[iChannel] = pVoxel[iChannel];
+							}
+						}
+					}
 				}
 			}
 		}
-		break;
-
-	default: // cannot happen
-		FUNC_FAILING( "CMuli3DVolume::Clear: invalid volume format.\n" );
-		UnlockBox();
-		return e_invalidformat;
 	}
-
-	UnlockBox();
-	return s_ok;
 }
 
 result CMuli3DVolume::LockBox( void **o_ppData, const m3dbox *i_pBox )
@@ -182,112 +228,96 @@ result CMuli3DVolume::LockBox( void **o_ppData, const m3dbox *i_pBox )
 		return e_invalidparameters;
 	}
 
-	if( m_bLockedComplete || m_pPartialLockData )
+	if( m_pLockData )
 	{
 		FUNC_FAILING( "CMuli3DVolume::LockBox: mip-level is already locked!\n" );
 		return e_invalidstate;
 	}
 
-	if( !i_pBox )
+	if( i_pBox )
 	{
-		*o_ppData = m_pData;
-		m_bLockedComplete = true;
-		return s_ok;
-	}
+		if( i_pBox->iRight > m_iWidth ||
+			i_pBox->iBottom > m_iHeight ||
+			i_pBox->iBack > m_iDepth )
+		{
+			FUNC_FAILING( "CMuli3DVolume::LockBox: box exceeds volume dimensions!\n" );
+			return e_invalidparameters;
+		}
 
-	if( i_pBox->iRight > m_iWidth ||
-		i_pBox->iBottom > m_iHeight ||
-		i_pBox->iBack > m_iDepth )
-	{
-		FUNC_FAILING( "CMuli3DVolume::LockBox: box exceeds volume dimensions!\n" );
-		return e_invalidparameters;
-	}
+		if( i_pBox->iLeft >= i_pBox->iRight ||
+			i_pBox->iTop >= i_pBox->iBottom ||
+			i_pBox->iFront >= i_pBox->iBack )
+		{
+			FUNC_FAILING( "CMuli3DVolume::LockBox: invalid box specified!\n" );
+			return e_invalidparameters;
+		}
 
-	if( i_pBox->iLeft >= i_pBox->iRight ||
-		i_pBox->iTop >= i_pBox->iBottom ||
-		i_pBox->iFront >= i_pBox->iBack )
+		m_LockBox = *i_pBox;
+	}
+	else
 	{
-		FUNC_FAILING( "CMuli3DVolume::LockBox: invalid box specified!\n" );
-		return e_invalidparameters;
+		m_LockBox.iLeft = 0; m_LockBox.iTop = 0; m_LockBox.iFront = 0;
+		m_LockBox.iRight = m_iWidth; m_LockBox.iBottom = m_iHeight; m_LockBox.iBack = m_iDepth;
 	}
-
-	m_PartialLockBox = *i_pBox;
 	
 	// create lock-buffer
-	const uint32 iLockWidth = m_PartialLockBox.iRight - m_PartialLockBox.iLeft;
-	const uint32 iLockHeight = m_PartialLockBox.iBottom - m_PartialLockBox.iTop;
-	const uint32 iLockDepth = m_PartialLockBox.iBack - m_PartialLockBox.iFront;
-	const uint32 iVolumeFloats = iGetFormatFloats();
+	const uint32 iLockWidth = m_LockBox.iRight - m_LockBox.iLeft;
+	const uint32 iLockHeight = m_LockBox.iBottom - m_LockBox.iTop;
+	const uint32 iLockDepth = m_LockBox.iBack - m_LockBox.iFront;
 
-	m_pPartialLockData = new float32[iLockWidth * iLockHeight * iLockDepth * iVolumeFloats];
-	if( !m_pPartialLockData )
+	m_pLockData = new float32[iLockWidth * iLockHeight * iLockDepth * m_iFloats];
+	if( !m_pLockData )
 	{
 		FUNC_FAILING( "CMuli3DVolume::LockBox: memory allocation failed!\n" );
 		return e_outofmemory;
 	}
 	
-	float32 *pCurLockData = m_pPartialLockData;
-	for( uint32 iZ = m_PartialLockBox.iFront; iZ < m_PartialLockBox.iBack; ++iZ )
+	float32 *pCurLockData = m_pLockData;
+	for( uint32 iZ = m_LockBox.iFront; iZ < m_LockBox.iBack; ++iZ )
 	{
-		const float32 *pCurVolumeData2 = &m_pData[(iZ * m_iWidth * m_iHeight) * iVolumeFloats];
-		for( uint32 iY = m_PartialLockBox.iTop; iY < m_PartialLockBox.iBottom; ++iY )
+		for( uint32 iY = m_LockBox.iTop; iY < m_LockBox.iBottom; ++iY )
 		{
-			const float32 *pCurVolumeData = &pCurVolumeData2[(iY * m_iWidth + m_PartialLockBox.iLeft) * iVolumeFloats];
-			memcpy( pCurLockData, pCurVolumeData, sizeof( float32 ) * iVolumeFloats * iLockWidth );
-			pCurLockData += iVolumeFloats * iLockWidth;
+			CopyRow( pCurLockData, m_LockBox.iLeft, m_LockBox.iRight, iY, iZ, false );
+			pCurLockData += m_iFloats * iLockWidth;
 		}
 	}
 
-	*o_ppData = m_pPartialLockData;
+	*o_ppData = m_pLockData;
 
 	return s_ok;
 }
 
 result CMuli3DVolume::UnlockBox()
 {
-	if( !m_bLockedComplete && !m_pPartialLockData )
+	if( !m_pLockData )
 	{
 		FUNC_FAILING( "CMuli3DVolume::UnlockBox: cannot unlock mip-level because it isn't locked!\n" );
 		return e_invalidstate;
 	}
 
-	if( m_bLockedComplete )
-	{
-		m_bLockedComplete = false;
-		return s_ok;
-	}
-
 	// update volume
-	const uint32 iLockWidth = m_PartialLockBox.iRight - m_PartialLockBox.iLeft;
-	const uint32 iVolumeFloats = iGetFormatFloats();
+	const uint32 iLockWidth = m_LockBox.iRight - m_LockBox.iLeft;
 
-	const float32 *pCurLockData = m_pPartialLockData;
-	for( uint32 iZ = m_PartialLockBox.iFront; iZ < m_PartialLockBox.iBack; ++iZ )
+	float32 *pCurLockData = m_pLockData;
+	for( uint32 iZ = m_LockBox.iFront; iZ < m_LockBox.iBack; ++iZ )
 	{
-		float32 *pCurVolumeData2 = &m_pData[(iZ * m_iWidth * m_iHeight) * iVolumeFloats];
-		for( uint32 iY = m_PartialLockBox.iTop; iY < m_PartialLockBox.iBottom; ++iY )
+		for( uint32 iY = m_LockBox.iTop; iY < m_LockBox.iBottom; ++iY )
 		{
-			float32 *pCurVolumeData = &pCurVolumeData2[(iY * m_iWidth + m_PartialLockBox.iLeft) * iVolumeFloats];
-			memcpy( pCurVolumeData, pCurLockData, sizeof( float32 ) * iVolumeFloats * iLockWidth );
-			pCurLockData += iVolumeFloats * iLockWidth;
+			CopyRow( pCurLockData, m_LockBox.iLeft, m_LockBox.iRight, iY, iZ, true );
+			pCurLockData += m_iFloats * iLockWidth;
 		}
 	}
 
-	SAFE_DELETE_ARRAY( m_pPartialLockData );
+	SAFE_DELETE_ARRAY( m_pLockData );
+
+	UpdateBrickMinMax( m_LockBox );
 
 	return s_ok;
 }
 
 uint32 CMuli3DVolume::iGetFormatFloats()
 {
-	switch( m_fmtFormat )
-	{
-	case m3dfmt_r32f: return 1;
-	case m3dfmt_r32g32f: return 2;
-	case m3dfmt_r32g32b32f: return 3;
-	case m3dfmt_r32g32b32a32f: return 4;
-	default: /* cannot happen */ return 0;
-	}
+	return m_iFloats;
 }
 
 void CMuli3DVolume::SamplePoint( vector4 &o_vColor, float32 i_fU, float32 i_fV, float32 i_fW )
@@ -295,32 +325,13 @@ void CMuli3DVolume::SamplePoint( vector4 &o_vColor, float32 i_fU, float32 i_fV,
 	const float32 fX = i_fU * m_iWidthMin1, fY = i_fV * m_iHeightMin1, fZ = i_fW * m_iDepthMin1;
 	const uint32 iPixelX = ftol( fX ), iPixelY = ftol( fY ), iPixelZ = ftol( fZ );
 
-	switch( m_fmtFormat )
+	const float32 *pVoxel = &m_pData[iGetVoxelOffset( iPixelX, iPixelY, iPixelZ )];
+	switch( m_iFloats )
 	{
-	case m3dfmt_r32f:
-		{
-			const float32 *pPixel = &m_pData[iPixelZ * m_iWidth * m_iHeight + iPixelY * m_iWidth + iPixelX];
-			o_vColor = vector4( pPixel[0], 0, 0, 1 );
-		}
-		break;
-	case m3dfmt_r32g32f:
-		{
-			const vector2 *pPixel = (const vector2 *)&m_pData[2 * (iPixelZ * m_iWidth * m_iHeight + iPixelY * m_iWidth + iPixelX)];
-			o_vColor = vector4( pPixel->x, pPixel->y, 0, 1 );
-		}
-		break;
-	case m3dfmt_r32g32b32f:
-		{
-			const vector3 *pPixel = (const vector3 *)&m_pData[3 * (iPixelZ * m_iWidth * m_iHeight + iPixelY * m_iWidth + iPixelX)];
-			o_vColor = vector4( pPixel->x, pPixel->y, pPixel->z, 1 );
-		}
-		break;
-	case m3dfmt_r32g32b32a32f:
-		{
-			const vector4 *pPixel = (const vector4 *)&m_pData[4 * (iPixelZ * m_iWidth * m_iHeight + iPixelY * m_iWidth + iPixelX)];
-			o_vColor = *pPixel;
-		}
-		break;
+	case 1: o_vColor = vector4( pVoxel[0], 0, 0, 1 ); break;
+	case 2: o_vColor = vector4( pVoxel[0], pVoxel[1], 0, 1 ); break;
+	case 3: o_vColor = vector4( pVoxel[0], pVoxel[1], pVoxel[2], 1 ); break;
+	case 4: o_vColor = vector4( pVoxel[0], pVoxel[1], pVoxel[2], pVoxel[3] ); break;
 	default: // cannot happen
 		break;
 	}
@@ -336,86 +347,51 @@ void CMuli3DVolume::SampleLinear( vector4 &o_vColor, float32 i_fU, float32 i_fV,
 	if( iPixelY2 >= m_iHeight ) iPixelY2 = m_iHeightMin1;
 	if( iPixelZ2 >= m_iDepth ) iPixelZ2 = m_iDepthMin1;
 
-	const uint32 iIndexRows[2] = { iPixelY * m_iWidth, iPixelY2 * m_iWidth };
-	const uint32 iIndexSlices[2] = { iPixelZ * m_iWidth * m_iHeight, iPixelZ2 * m_iWidth * m_iHeight };
-	const float32 fInterpolation[3] = { fX - iPixelX, fY - iPixelY, fZ - iPixelZ };
-
-	switch( m_fmtFormat )
+	// voxels are ordered: x varies fastest, then y, then z
+	const float32 *pVoxels[8];
+	if( ( ( iPixelX ^ iPixelX2 ) | ( iPixelY ^ iPixelY2 ) | ( iPixelZ ^ iPixelZ2 ) ) >> c_iVolumeBrickShift )
 	{
-	case m3dfmt_r32f:
-		{
-			float32 fColorSlices[2], fColorRows[2];
-
-			fColorRows[0] = fLerp( m_pData[iIndexSlices[0] + iIndexRows[0] + iPixelX], m_pData[iIndexSlices[0] + iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			fColorRows[1] = fLerp( m_pData[iIndexSlices[0] + iIndexRows[1] + iPixelX], m_pData[iIndexSlices[0] + iIndexRows[1] + iPixelX2], fInterpolation[0] );
-			fColorSlices[0] = fLerp( fColorRows[0], fColorRows[1], fInterpolation[1] );
-
-			fColorRows[0] = fLerp( m_pData[iIndexSlices[1] + iIndexRows[0] + iPixelX], m_pData[iIndexSlices[1] + iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			fColorRows[1] = fLerp( m_pData[iIndexSlices[1] + iIndexRows[1] + iPixelX], m_pData[iIndexSlices[1] + iIndexRows[1] + iPixelX2], fInterpolation[0] );
-			fColorSlices[1] = fLerp( fColorRows[1], fColorRows[1], fInterpolation[1] );
-
-			const float32 fFinalColor = fLerp( fColorSlices[0], fColorSlices[1], fInterpolation[2] );
-			
-			o_vColor = vector4( fFinalColor, 0, 0, 1 );
-		}
-		break;
-	case m3dfmt_r32g32f:
-		{
-			const vector2 *pPixelData = (const vector2 *)m_pData;
-
-			static vector2 vColorSlices[2], vColorRows[2];
-
-			vVector2Lerp( vColorRows[0], pPixelData[iIndexSlices[0] + iIndexRows[0] + iPixelX], pPixelData[iIndexSlices[0] + iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			vVector2Lerp( vColorRows[1], pPixelData[iIndexSlices[0] + iIndexRows[1] + iPixelX], pPixelData[iIndexSlices[0] + iIndexRows[1] + iPixelX2], fInterpolation[0] );
-			vVector2Lerp( vColorSlices[0], vColorRows[0], vColorRows[1], fInterpolation[1] );
-			
-			vVector2Lerp( vColorRows[0], pPixelData[iIndexSlices[1] + iIndexRows[0] + iPixelX], pPixelData[iIndexSlices[1] + iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			vVector2Lerp( vColorRows[1], pPixelData[iIndexSlices[1] + iIndexRows[1] + iPixelX], pPixelData[iIndexSlices[1] + iIndexRows[1] + iPixelX2], fInterpolation[0] );
-			vVector2Lerp( vColorSlices[1], vColorRows[0], vColorRows[1], fInterpolation[1] );
-
-			static vector2 vFinalColor; vVector2Lerp( vFinalColor, vColorSlices[0], vColorSlices[1], fInterpolation[2] );
-
-			o_vColor = vector4( vFinalColor.x, vFinalColor.y, 0, 1 );
-		}
-		break;
-	case m3dfmt_r32g32b32f:
-		{
-			const vector3 *pPixelData = (const vector3 *)m_pData;
-
-			static vector3 vColorSlices[2], vColorRows[2];
-
-			vVector3Lerp( vColorRows[0], pPixelData[iIndexSlices[0] + iIndexRows[0] + iPixelX], pPixelData[iIndexSlices[0] + iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			vVector3Lerp( vColorRows[1], pPixelData[iIndexSlices[0] + iIndexRows[1] + iPixelX], pPixelData[iIndexSlices[0] + iIndexRows[1] + iPixelX2], fInterpolation[0] );
-			vVector3Lerp( vColorSlices[0], vColorRows[0], vColorRows[1], fInterpolation[1] );
-			
-			vVector3Lerp( vColorRows[0], pPixelData[iIndexSlices[1] + iIndexRows[0] + iPixelX], pPixelData[iIndexSlices[1] + iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			vVector3Lerp( vColorRows[1], pPixelData[iIndexSlices[1] + iIndexRows[1] + iPixelX], pPixelData[iIndexSlices[1] + iIndexRows[1] + iPixelX2], fInterpolation[0] );
-			vVector3Lerp( vColorSlices[1], vColorRows[0], vColorRows[1], fInterpolation[1] );
-
-			static vector3 vFinalColor; vVector3Lerp( vFinalColor, vColorSlices[0], vColorSlices[1], fInterpolation[2] );
+		// lookup crosses brick boundaries
+		pVoxels[0] = &m_pData[iGetVoxelOffset( iPixelX, iPixelY, iPixelZ )];
+		pVoxels[1] = &m_pData[iGetVoxelOffset( iPixelX2, iPixelY, iPixelZ )];
+		pVoxels[2] = &m_pData[iGetVoxelOffset( iPixelX, iPixelY2, iPixelZ )];
+		pVoxels[3] = &m_pData[iGetVoxelOffset( iPixelX2, iPixelY2, iPixelZ )];
+		pVoxels[4] = &m_pData[iGetVoxelOffset( iPixelX, iPixelY, iPixelZ2 )];
+		pVoxels[5] = &m_pData[iGetVoxelOffset( iPixelX2, iPixelY, iPixelZ2 )];
+		pVoxels[6] = &m_pData[iGetVoxelOffset( iPixelX, iPixelY2, iPixelZ2 )];
+		pVoxels[7] = &m_pData[iGetVoxelOffset( iPixelX2, iPixelY2, iPixelZ2 )];
+	}
+	else
+	{
+		// all voxels lie within the same brick
+		const uint32 iStepX = ( iPixelX2 - iPixelX ) * m_iFloats;
+		const uint32 iStepY = ( ( iPixelY2 - iPixelY ) << c_iVolumeBrickShift ) * m_iFloats;
+		const uint32 iStepZ = ( ( iPixelZ2 - iPixelZ ) << ( 2 * c_iVolumeBrickShift ) ) * m_iFloats;
+
+		pVoxels[0] = &m_pData[iGetVoxelOffset( iPixelX, iPixelY, iPixelZ )];
+		pVoxels[1] = pVoxels[0] + iStepX;
+		pVoxels[2] = pVoxels[0] + iStepY;
+		pVoxels[3] = pVoxels[2] + iStepX;
+		pVoxels[4] = pVoxels[0] + iStepZ;
+		pVoxels[5] = pVoxels[4] + iStepX;
+		pVoxels[6] = pVoxels[4] + iStepY;
+		pVoxels[7] = pVoxels[6] + iStepX;
+	}
 
-			o_vColor = vector4( vFinalColor.x, vFinalColor.y, vFinalColor.z, 1 );
-		}
-		break;
-	case m3dfmt_r32g32b32a32f:
-		{
-			const vector4 *pPixelData = (const vector4 *)m_pData;
+	const float32 fInterpolation[3] = { fX - iPixelX, fY - iPixelY, fZ - iPixelZ };
 
-			static vector4 vColorSlices[2], vColorRows[2];
+	o_vColor = vector4( 0, 0, 0, 1 );
+	for( uint32 iChannel = 0; iChannel < m_iFloats; ++iChannel )
+	{
+		const float32 fRow0 = fLerp( pVoxels[0][iChannel], pVoxels[1][iChannel], fInterpolation[0] );
+		const float32 fRow1 = fLerp( pVoxels[2][iChannel], pVoxels[3][iChannel], fInterpolation[0] );
+		const float32 fRow2 = fLerp( pVoxels[4][iChannel], pVoxels[5][iChannel], fInterpolation[0] );
+		const float32 fRow3 = fLerp( pVoxels[6][iChannel], pVoxels[7][iChannel], fInterpolation[0] );
 
-			vVector4Lerp( vColorRows[0], pPixelData[iIndexSlices[0] + iIndexRows[0] + iPixelX], pPixelData[iIndexSlices[0] + iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			vVector4Lerp( vColorRows[1], pPixelData[iIndexSlices[0] + iIndexRows[1] + iPixelX], pPixelData[iIndexSlices[0] + iIndexRows[1] + iPixelX2], fInterpolation[0] );
-			vVector4Lerp( vColorSlices[0], vColorRows[0], vColorRows[1], fInterpolation[1] );
-			
-			vVector4Lerp( vColorRows[0], pPixelData[iIndexSlices[1] + iIndexRows[0] + iPixelX], pPixelData[iIndexSlices[1] + iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			vVector4Lerp( vColorRows[1], pPixelData[iIndexSlices[1] + iIndexRows[1] + iPixelX], pPixelData[iIndexSlices[1] + iIndexRows[1] + iPixelX2], fInterpolation[0] );
-			vVector4Lerp( vColorSlices[1], vColorRows[0], vColorRows[1], fInterpolation[1] );
+		const float32 fSlice0 = fLerp( fRow0, fRow1, fInterpolation[1] );
+		const float32 fSlice1 = fLerp( fRow2, fRow3, fInterpolation[1] );
 
-			vVector4Lerp( o_vColor, vColorSlices[0], vColorSlices[1], fInterpolation[2] );
-		}
-		break;
-	default: // cannot happen
-		break;
+		o_vColor[iChannel] = fLerp( fSlice0, fSlice1, fInterpolation[2] );
 	}
 }
 
@@ -439,6 +415,81 @@ uint32 CMuli3DVolume::iGetDepth()
 	return m_iDepth;
 }
 
+uint32 CMuli3DVolume::iGetNumBricksX()
+{
+	return m_iBricksX;
+}
+
+uint32 CMuli3DVolume::iGetNumBricksY()
+{
+	return m_iBricksY;
+}
+
+uint32 CMuli3DVolume::iGetNumBricksZ()
+{
+	return m_iBricksZ;
+}
+
+result CMuli3DVolume::GetBrickMinMax( vector4 &o_vMin, vector4 &o_vMax, uint32 i_iBrickX, uint32 i_iBrickY, uint32 i_iBrickZ )
+{
+	if( i_iBrickX >= m_iBricksX || i_iBrickY >= m_iBricksY || i_iBrickZ >= m_iBricksZ )
+	{
+		FUNC_FAILING( "CMuli3DVolume::GetBrickMinMax: invalid brick specified!\n" );
+		return e_invalidparameters;
+	}
+
+	const volumebrick &Brick = m_pBricks[( i_iBrickZ * m_iBricksY + i_iBrickY ) * m_iBricksX + i_iBrickX];
+	o_vMin = Brick.vMin;
+	o_vMax = Brick.vMax;
+
+	return s_ok;
+}
+
+bool CMuli3DVolume::bIsBrickOccupied( uint32 i_iBrickX, uint32 i_iBrickY, uint32 i_iBrickZ, uint32 i_iChannel, float32 i_fThreshold )
+{
+	if( i_iBrickX >= m_iBricksX || i_iBrickY >= m_iBricksY || i_iBrickZ >= m_iBricksZ )
+	{
+		FUNC_FAILING( "CMuli3DVolume::bIsBrickOccupied: invalid brick specified!\n" );
+		return false;
+	}
+
+	if( i_iChannel > 3 )
+	{
+		FUNC_FAILING( "CMuli3DVolume::bIsBrickOccupied: invalid channel specified!\n" );
+		return false;
+	}
+
+	const volumebrick &Brick = m_pBricks[( i_iBrickZ * m_iBricksY + i_iBrickY ) * m_iBricksX + i_iBrickX];
+	return Brick.vMax[i_iChannel] > i_fThreshold;
+}
+
+uint32 CMuli3DVolume::iGetBrickOccupancy( bool *o_pOccupied, uint32 i_iChannel, float32 i_fThreshold )
+{
+	if( !o_pOccupied )
+	{
+		FUNC_FAILING( "CMuli3DVolume::iGetBrickOccupancy: parameter o_pOccupied points to null.\n" );
+		return 0;
+	}
+
+	if( i_iChannel > 3 )
+	{
+		FUNC_FAILING( "CMuli3DVolume::iGetBrickOccupancy: invalid channel specified!\n" );
+		return 0;
+	}
+
+	const uint32 iNumBricks = m_iBricksX * m_iBricksY * m_iBricksZ;
+
+	uint32 iNumOccupied = 0;
+	for( uint32 iBrick = 0; iBrick < iNumBricks; ++iBrick )
+	{
+		o_pOccupied[iBrick] = m_pBricks[iBrick].vMax[i_iChannel] > i_fThreshold;
+		if( o_pOccupied[iBrick] )
+			++iNumOccupied;
+	}
+
+	return iNumOccupied;
+}
+
 result CMuli3DVolume::CopyToVolume( const m3dbox *i_pSrcBox, CMuli3DVolume *i_pDestVolume, const m3dbox *i_pDestBox, m3dtexturefilter i_Filter )
 {
 	if( !i_pDestVolume )
@@ -447,7 +498,7 @@ result CMuli3DVolume::CopyToVolume( const m3dbox *i_pSrcBox, CMuli3DVolume *i_pD
 		return e_invalidparameters;
 	}
 
-	if( i_Filter != m3dtf_point || i_Filter != m3dtf_linear )
+	if( i_Filter != m3dtf_point && i_Filter != m3dtf_linear )
 	{
 		FUNC_FAILING( "CMuli3DVolume::CopyToSurface: invalid filter specified!\n" );
 		return e_invalidparameters;
@@ -507,28 +558,32 @@ result CMuli3DVolume::CopyToVolume( const m3dbox *i_pSrcBox, CMuli3DVolume *i_pD
 		DestBox.iRight = i_pDestVolume->iGetWidth(); DestBox.iBottom = i_pDestVolume->iGetHeight(); DestBox.iBack = i_pDestVolume->iGetDepth();
 	}
 
-	float32 *pDestData = 0;
-	result resLock = i_pDestVolume->LockBox( (void **)&pDestData, i_pDestBox );
-	if( FUNC_FAILED( resLock ) )
-	{
-		FUNC_FAILING( "CMuli3DVolume::CopyToSurface: couldn't lock destination volume!\n" );
-		return resLock;
-	}
-
 	const uint32 iDestFloats = i_pDestVolume->iGetFormatFloats();
 	const uint32 iDestWidth = DestBox.iRight - DestBox.iLeft;
 	const uint32 iDestHeight = DestBox.iBottom - DestBox.iTop;
 	const uint32 iDestDepth = DestBox.iBack - DestBox.iFront;
 	
-	// direct copy possible?
-	if( !i_pSrcBox && !i_pDestBox && iDestFloats == iGetFormatFloats() &&
-		iDestWidth == m_iWidth && iDestHeight == m_iHeight && iDestDepth == m_iDepth )
+	// direct copy possible? both volumes have the same brick layout then.
+	if( !i_pSrcBox && !i_pDestBox && iDestFloats == m_iFloats &&
+		iDestWidth == m_iWidth && iDestHeight == m_iHeight && iDestDepth == m_iDepth &&
+		!i_pDestVolume->m_pLockData )
 	{
-		memcpy( pDestData, m_pData, sizeof( float32 ) * iDestFloats * iDestWidth * iDestHeight * iDestDepth );
-		i_pDestVolume->UnlockBox();
+		const uint32 iNumBricks = m_iBricksX * m_iBricksY * m_iBricksZ;
+		memcpy( i_pDestVolume->m_pData, m_pData, sizeof( float32 ) * iNumBricks *
+			c_iVolumeBrickSize * c_iVolumeBrickSize * c_iVolumeBrickSize * m_iFloats );
+		for( uint32 iBrick = 0; iBrick < iNumBricks; ++iBrick )
+			i_pDestVolume->m_pBricks[iBrick] = m_pBricks[iBrick];
 		return s_ok;
 	}
 
+	float32 *pDestData = 0;
+	result resLock = i_pDestVolume->LockBox( (void **)&pDestData, i_pDestBox );
+	if( FUNC_FAILED( resLock ) )
+	{
+		FUNC_FAILING( "CMuli3DVolume::CopyToSurface: couldn't lock destination volume!\n" );
+		return resLock;
+	}
+
 	const float32 fStepU = 1.0f / m_iWidthMin1;
 	const float32 fStepV = 1.0f / m_iHeightMin1;
 	const float32 fStepW = 1.0f / m_iDepthMin1;
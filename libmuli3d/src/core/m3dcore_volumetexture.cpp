@@ -113,7 +113,7 @@ result CMuli3DVolumeTexture::Clear( uint32 i_iMipLevel, const vector4 &i_vColor,
 	return m_ppMipLevels[i_iMipLevel]->Clear( i_vColor, i_pBox );
 }
 
-result CMuli3DVolumeTexture::GenerateMipSubLevels( uint32 i_iSrcLevel )
+result CMuli3DVolumeTexture::GenerateMipSubLevels( uint32 i_iSrcLevel, m3dmipfilter i_Filter )
 {
 	if( i_iSrcLevel + 1 >= m_iMipLevels )
 	{
@@ -121,146 +121,32 @@ result CMuli3DVolumeTexture::GenerateMipSubLevels( uint32 i_iSrcLevel )
 		return e_invalidparameters;
 	}
 
+	if( i_Filter != m3dmf_box && i_Filter != m3dmf_tent )
+	{
+		FUNC_FAILING( "CMuli3DVolumeTexture::GenerateMipSubLevels: invalid filter specified.\n" );
+		return e_invalidparameters;
+	}
+
 	for( uint32 iLevel = i_iSrcLevel + 1; iLevel < m_iMipLevels; ++iLevel )
 	{
-		const float32 *pSrcData = 0;
-		result resLock = LockBox( iLevel - 1, (void **)&pSrcData, 0 );
+		mipdownsample Downsample;
+		result resLock = LockBox( iLevel - 1, (void **)&Downsample.pSrcData, 0 );
 		if( FUNC_FAILED( resLock ) )
 			return resLock;
 		
-		float32 *pDestData = 0;
-		resLock = LockBox( iLevel, (void **)&pDestData, 0 );
+		resLock = LockBox( iLevel, (void **)&Downsample.pDestData, 0 );
 		if( FUNC_FAILED( resLock ) )
 		{
-			UnlockBox( iLevel );
+			UnlockBox( iLevel - 1 );
 			return resLock;
 		}
 
-		const uint32 iSrcDepth = iGetDepth( iLevel - 1 );
-		const uint32 iSrcHeight = iGetHeight( iLevel - 1 );
-		const uint32 iSrcWidth = iGetWidth( iLevel - 1 );
-
-		switch( fmtGetFormat() )
-		{
-		case m3dfmt_r32f:
-			{
-				for( uint32 iZ = 0; iZ < iSrcDepth; iZ += 2 )
-				{
-					const uint32 iIndexSlices[2] = { iZ * iSrcWidth * iSrcHeight, ( iZ + 1 ) * iSrcWidth * iSrcHeight };
-					for( uint32 iY = 0; iY < iSrcHeight; iY += 2 )
-					{
-						const uint32 iIndexRows[2] = { iY * iSrcWidth, ( iY + 1 ) * iSrcWidth };
-						for( uint32 iX = 0; iX < iSrcWidth; iX += 2, ++pDestData )
-						{
-							const float32 fSrcPixels[8] = 
-							{
-								pSrcData[iIndexSlices[0] + iIndexRows[0] + iX],
-								pSrcData[iIndexSlices[0] + iIndexRows[0] + iX + 1],
-								pSrcData[iIndexSlices[0] + iIndexRows[1] + iX],
-								pSrcData[iIndexSlices[0] + iIndexRows[1] + iX + 1],
-								pSrcData[iIndexSlices[1] + iIndexRows[0] + iX],
-								pSrcData[iIndexSlices[1] + iIndexRows[0] + iX + 1],
-								pSrcData[iIndexSlices[1] + iIndexRows[1] + iX],
-								pSrcData[iIndexSlices[1] + iIndexRows[1] + iX + 1]
-							};
-							*pDestData = ( fSrcPixels[0] + fSrcPixels[1] + fSrcPixels[2] + fSrcPixels[3] +
-								fSrcPixels[4] + fSrcPixels[5] + fSrcPixels[6] + fSrcPixels[7] ) * 0.125f;
-						}
-					}
-				}
-			}
-			break;
-
-		case m3dfmt_r32g32f:
-			{
-				for( uint32 iZ = 0; iZ < iSrcDepth; iZ += 2 )
-				{
-					const uint32 iIndexSlices[2] = { iZ * iSrcWidth * iSrcHeight, ( iZ + 1 ) * iSrcWidth * iSrcHeight };
-					for( uint32 iY = 0; iY < iSrcHeight; iY += 2 )
-					{
-						const uint32 iIndexRows[2] = { iY * iSrcWidth, ( iY + 1 ) * iSrcWidth };
-						for( uint32 iX = 0; iX < iSrcWidth; iX += 2, pDestData += 2 )
-						{
-							const vector2 *pSrcPixels[8] = 
-							{
-								&((vector2 *)pSrcData)[iIndexSlices[0] + iIndexRows[0] + iX],
-								&((vector2 *)pSrcData)[iIndexSlices[0] + iIndexRows[0] + iX + 1],
-								&((vector2 *)pSrcData)[iIndexSlices[0] + iIndexRows[1] + iX],
-								&((vector2 *)pSrcData)[iIndexSlices[0] + iIndexRows[1] + iX + 1],
-								&((vector2 *)pSrcData)[iIndexSlices[1] + iIndexRows[0] + iX],
-								&((vector2 *)pSrcData)[iIndexSlices[1] + iIndexRows[0] + iX + 1],
-								&((vector2 *)pSrcData)[iIndexSlices[1] + iIndexRows[1] + iX],
-								&((vector2 *)pSrcData)[iIndexSlices[1] + iIndexRows[1] + iX + 1]
-							};
-							*(vector2 *)pDestData = ( *pSrcPixels[0] + *pSrcPixels[1] + *pSrcPixels[2] + *pSrcPixels[3] +
-								*pSrcPixels[4] + *pSrcPixels[5] + *pSrcPixels[6] + *pSrcPixels[7] ) * 0.125f;
-						}
-					}
-				}
-			}
-			break;
-
-		case m3dfmt_r32g32b32f:
-			{
-				for( uint32 iZ = 0; iZ < iSrcDepth; iZ += 2 )
-				{
-					const uint32 iIndexSlices[2] = { iZ * iSrcWidth * iSrcHeight, ( iZ + 1 ) * iSrcWidth * iSrcHeight };
-					for( uint32 iY = 0; iY < iSrcHeight; iY += 2 )
-					{
-						const uint32 iIndexRows[2] = { iY * iSrcWidth, ( iY + 1 ) * iSrcWidth };
-						for( uint32 iX = 0; iX < iSrcWidth; iX += 2, pDestData += 3 )
-						{
-							const vector3 *pSrcPixels[8] = 
-							{
-								&((vector3 *)pSrcData)[iIndexSlices[0] + iIndexRows[0] + iX],
-								&((vector3 *)pSrcData)[iIndexSlices[0] + iIndexRows[0] + iX + 1],
-								&((vector3 *)pSrcData)[iIndexSlices[0] + iIndexRows[1] + iX],
-								&((vector3 *)pSrcData)[iIndexSlices[0] + iIndexRows[1] + iX + 1],
-								&((vector3 *)pSrcData)[iIndexSlices[1] + iIndexRows[0] + iX],
-								&((vector3 *)pSrcData)[iIndexSlices[1] + iIndexRows[0] + iX + 1],
-								&((vector3 *)pSrcData)[iIndexSlices[1] + iIndexRows[1] + iX],
-								&((vector3 *)pSrcData)[iIndexSlices[1] + iIndexRows[1] + iX + 1]
-							};
-							*(vector3 *)pDestData = ( *pSrcPixels[0] + *pSrcPixels[1] + *pSrcPixels[2] + *pSrcPixels[3] +
-								*pSrcPixels[4] + *pSrcPixels[5] + *pSrcPixels[6] + *pSrcPixels[7] ) * 0.125f;
-						}
-					}
-				}
-			}
-			break;
-
-		case m3dfmt_r32g32b32a32f:
-			{
-				for( uint32 iZ = 0; iZ < iSrcDepth; iZ += 2 )
-				{
-					const uint32 iIndexSlices[2] = { iZ * iSrcWidth * iSrcHeight, ( iZ + 1 ) * iSrcWidth * iSrcHeight };
-					for( uint32 iY = 0; iY < iSrcHeight; iY += 2 )
-					{
-						const uint32 iIndexRows[2] = { iY * iSrcWidth, ( iY + 1 ) * iSrcWidth };
-						for( uint32 iX = 0; iX < iSrcWidth; iX += 2, pDestData += 4 )
-						{
-							const vector4 *pSrcPixels[8] = 
-							{
-								&((vector4 *)pSrcData)[iIndexSlices[0] + iIndexRows[0] + iX],
-								&((vector4 *)pSrcData)[iIndexSlices[0] + iIndexRows[0] + iX + 1],
-								&((vector4 *)pSrcData)[iIndexSlices[0] + iIndexRows[1] + iX],
-								&((vector4 *)pSrcData)[iIndexSlices[0] + iIndexRows[1] + iX + 1],
-								&((vector4 *)pSrcData)[iIndexSlices[1] + iIndexRows[0] + iX],
-								&((vector4 *)pSrcData)[iIndexSlices[1] + iIndexRows[0] + iX + 1],
-								&((vector4 *)pSrcData)[iIndexSlices[1] + iIndexRows[1] + iX],
-								&((vector4 *)pSrcData)[iIndexSlices[1] + iIndexRows[1] + iX + 1]
-							};
-							*(vector4 *)pDestData = ( *pSrcPixels[0] + *pSrcPixels[1] + *pSrcPixels[2] + *pSrcPixels[3] +
-								*pSrcPixels[4] + *pSrcPixels[5] + *pSrcPixels[6] + *pSrcPixels[7] ) * 0.125f;
-						}
-					}
-				}
-			}
-			break;
-
-		default: // cannot happen
-			break;
-		}
+		Downsample.iFloats = iGetFormatFloats();
+		Downsample.iSrcWidth = iGetWidth( iLevel - 1 );
+		Downsample.iSrcHeight = iGetHeight( iLevel - 1 );
+		Downsample.iSrcDepth = iGetDepth( iLevel - 1 );
+		Downsample.Filter = i_Filter;
+		DownsampleMipLevels( &Downsample, 1 );
 
 		UnlockBox( iLevel );
 		UnlockBox( iLevel - 1 );
@@ -311,12 +197,12 @@ result CMuli3DVolumeTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, flo
 	
 	if( i_pXGradient && i_pYGradient )
 	{
-		// Compute the mip-level and determine the texture filter type.
+		// Compute the mip-level from the squared gradient lengths and determine the texture filter type.
 		const float32 fLenXGrad = i_pXGradient->x * i_pXGradient->x * m_fSquaredWidth + i_pXGradient->y * i_pXGradient->y * m_fSquaredHeight + i_pXGradient->z * i_pXGradient->z * m_fSquaredDepth;
 		const float32 fLenYGrad = i_pYGradient->x * i_pYGradient->x * m_fSquaredWidth + i_pYGradient->y * i_pYGradient->y * m_fSquaredHeight + i_pYGradient->z * i_pYGradient->z * m_fSquaredDepth;
-		const float32 fTexelsPerScreenPixel = sqrtf( fLenXGrad > fLenYGrad ? fLenXGrad : fLenYGrad );
+		const float32 fSquaredTexelsPerScreenPixel = fLenXGrad > fLenYGrad ? fLenXGrad : fLenYGrad;
 
-		if( fTexelsPerScreenPixel <= 1.0f )
+		if( fSquaredTexelsPerScreenPixel <= 1.0f )
 		{
 			 // if fTexelsPerScreenPixel < 1.0f -> magnification, no mipmapping needed
 			fTexMipLevel = 0.0f;
@@ -324,13 +210,15 @@ result CMuli3DVolumeTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, flo
 		}
 		else
 		{
-			// minification, need mipmapping
-			static const float32 fInvLog2 = 1.0f / logf( 2.0f ); // calculate log2
-			fTexMipLevel = logf( fTexelsPerScreenPixel ) * fInvLog2;
+			// minification, need mipmapping: log2( sqrt( x ) ) = 0.5f * log2( x )
+			fTexMipLevel = 0.5f * fFastLog2( fSquaredTexelsPerScreenPixel );
 			iTexFilter = i_pSamplerStates[m3dtss_minfilter];
 		}
 	}
 
+	if( m_pSamplerFeedback )
+		RecordSamplerFeedback( i_fU, i_fV, fTexMipLevel < m_iMipLevels ? fTexMipLevel : (float32)( m_iMipLevels - 1 ) );
+
 	if( i_pSamplerStates[m3dtss_mipfilter] == m3dtf_linear )
 	{
 		uint32 iMipLevelA = ftol( fTexMipLevel );
@@ -367,6 +255,139 @@ result CMuli3DVolumeTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, flo
 	return s_ok;
 }
 
+result CMuli3DVolumeTexture::IntegrateRay( vector4 &o_vColor, const vector3 &i_vOrigin, const vector3 &i_vDirection, const m3dvolumeintegration &i_Integration, const uint32 *i_pSamplerStates )
+{
+	o_vColor = vector4( 0, 0, 0, 0 );
+
+	if( i_Integration.iOpacityChannel > 3 || i_Integration.fMinStepSize <= 0.0f ||
+		i_Integration.fMaxStepSize < i_Integration.fMinStepSize )
+	{
+		FUNC_FAILING( "CMuli3DVolumeTexture::IntegrateRay: invalid integration parameters specified.\n" );
+		return e_invalidparameters;
+	}
+
+	CMuli3DVolume *pVolume = m_ppMipLevels[0];
+	const float32 fExtents[3] = { (float32)( pVolume->iGetWidth() - 1 ),
+		(float32)( pVolume->iGetHeight() - 1 ), (float32)( pVolume->iGetDepth() - 1 ) };
+	const uint32 iMaxBrick[3] = { pVolume->iGetNumBricksX() - 1,
+		pVolume->iGetNumBricksY() - 1, pVolume->iGetNumBricksZ() - 1 };
+
+	// Clip the ray to the volume; the ray is parameterized in texture space: p( t ) = origin + t * direction, t >= 0.
+	const float32 *pOrigin = i_vOrigin, *pDirection = i_vDirection;
+	float32 fEnter = 0.0f, fExit = FLT_MAX;
+	float32 fVoxelOrigin[3], fVoxelDirection[3]; // the ray in voxel coordinates
+	uint32 iAxis;
+	for( iAxis = 0; iAxis < 3; ++iAxis )
+	{
+		fVoxelOrigin[iAxis] = pOrigin[iAxis] * fExtents[iAxis];
+		fVoxelDirection[iAxis] = pDirection[iAxis] * fExtents[iAxis];
+
+		if( pDirection[iAxis] == 0.0f )
+		{
+			if( pOrigin[iAxis] < 0.0f || pOrigin[iAxis] > 1.0f )
+				return s_ok; // parallel to the volume's faces and outside
+			continue;
+		}
+
+		const float32 fInvDirection = 1.0f / pDirection[iAxis];
+		float32 fNear = -pOrigin[iAxis] * fInvDirection;
+		float32 fFar = ( 1.0f - pOrigin[iAxis] ) * fInvDirection;
+		if( fNear > fFar ) { const float32 fTemp = fNear; fNear = fFar; fFar = fTemp; }
+		if( fNear > fEnter ) fEnter = fNear;
+		if( fFar < fExit ) fExit = fFar;
+	}
+
+	const float32 fVoxelsPerUnit = sqrtf( fVoxelDirection[0] * fVoxelDirection[0] +
+		fVoxelDirection[1] * fVoxelDirection[1] + fVoxelDirection[2] * fVoxelDirection[2] );
+	if( fEnter >= fExit || fVoxelsPerUnit <= 0.0f )
+		return s_ok;
+
+	// Moves a ray leaving a brick safely into the next one.
+	const float32 fNudge = 0.001f / fVoxelsPerUnit;
+	const bool bLinear = i_pSamplerStates[m3dtss_minfilter] == m3dtf_linear;
+	const uint32 iOpacityChannel = i_Integration.iOpacityChannel;
+
+	float32 fOpacity = 0.0f;
+	float32 fT = fEnter;
+	while( fT < fExit )
+	{
+		// Determine the brick containing the current position and where the ray leaves it.
+		uint32 iBrick[3];
+		float32 fBrickExit = fExit;
+		for( iAxis = 0; iAxis < 3; ++iAxis )
+		{
+			const float32 fVoxel = fVoxelOrigin[iAxis] + fT * fVoxelDirection[iAxis];
+			int32 iCurBrick = ftol( fVoxel ) >> c_iVolumeBrickShift;
+			if( iCurBrick < 0 ) iCurBrick = 0;
+			else if( iCurBrick > (int32)iMaxBrick[iAxis] ) iCurBrick = iMaxBrick[iAxis];
+			iBrick[iAxis] = iCurBrick;
+
+			float32 fBorder;
+			if( fVoxelDirection[iAxis] > 0.0f )
+				fBorder = (float32)( ( iCurBrick + 1 ) << c_iVolumeBrickShift );
+			else if( fVoxelDirection[iAxis] < 0.0f )
+				fBorder = (float32)( iCurBrick << c_iVolumeBrickShift );
+			else
+				continue;
+
+			const float32 fAxisExit = ( fBorder - fVoxelOrigin[iAxis] ) / fVoxelDirection[iAxis];
+			if( fAxisExit < fBrickExit ) fBrickExit = fAxisExit;
+		}
+
+		vector4 vBrickMin, vBrickMax;
+		pVolume->GetBrickMinMax( vBrickMin, vBrickMax, iBrick[0], iBrick[1], iBrick[2] );
+
+		const float32 fBrickOpacity = vBrickMax[iOpacityChannel];
+		if( fBrickOpacity <= i_Integration.fEmptyThreshold )
+		{
+			// empty space: skip the brick
+			fT = ( fBrickExit > fT ? fBrickExit : fT ) + fNudge;
+			continue;
+		}
+
+		// Denser bricks are sampled at smaller steps.
+		const float32 fStepSize = fLerp( i_Integration.fMaxStepSize, i_Integration.fMinStepSize, fSaturate( fBrickOpacity ) );
+		const float32 fStepT = fStepSize / fVoxelsPerUnit;
+
+		if( fBrickExit > fExit ) fBrickExit = fExit;
+		if( fBrickExit <= fT ) fBrickExit = fT + fNudge; // always take at least one sample
+
+		for( ; fT < fBrickExit; fT += fStepT )
+		{
+			vector4 vSample;
+			const float32 fU = fSaturate( pOrigin[0] + fT * pDirection[0] );
+			const float32 fV = fSaturate( pOrigin[1] + fT * pDirection[1] );
+			const float32 fW = fSaturate( pOrigin[2] + fT * pDirection[2] );
+			if( bLinear )
+				pVolume->SampleLinear( vSample, fU, fV, fW );
+			else
+				pVolume->SamplePoint( vSample, fU, fV, fW );
+
+			const float32 fSampleOpacity = fSaturate( vSample[iOpacityChannel] );
+			if( fSampleOpacity <= 0.0f )
+				continue;
+
+			// Correct the opacity, which is given for a distance of 1 voxel, for the step size and composite front to back.
+			const float32 fStepOpacity = fSampleOpacity < 1.0f ? 1.0f - powf( 1.0f - fSampleOpacity, fStepSize ) : 1.0f;
+			const float32 fWeight = ( 1.0f - fOpacity ) * fStepOpacity;
+			o_vColor.r += fWeight * vSample.r;
+			o_vColor.g += fWeight * vSample.g;
+			o_vColor.b += fWeight * vSample.b;
+			fOpacity += fWeight;
+
+			if( fOpacity >= i_Integration.fOpacityThreshold )
+			{
+				// early ray termination
+				o_vColor.a = fOpacity;
+				return s_ok;
+			}
+		}
+	}
+
+	o_vColor.a = fOpacity;
+	return s_ok;
+}
+
 m3dformat CMuli3DVolumeTexture::fmtGetFormat()
 {
 	return m_ppMipLevels[0]->fmtGetFormat();
@@ -34,6 +34,7 @@ class CFractalPS : public IMuli3DPixelShader
 {
 public:
 	bool bMightKillPixels() { return false; }
+	bool bNeedsDestinationColor() { return false; }
 	bool bExecute( const shaderreg *i_pInput, vector4 &io_vColor, float32 &io_fDepth )
 	{
 		const vector2 &vConst = i_pInput[0];
@@ -31,6 +31,12 @@ bool CApp::bCreateWorld()
 	if( !m_pCamera->bCreateRenderCamera( iGetWindowWidth(), iGetWindowHeight(), m3dfmt_r32g32b32f, false ) ) // no depthbuffer is necessary
 		return false;
 
+	// Trade resolution for frame rate, when tracing gets too expensive
+	m_pCamera->SetDynamicResolution( true, 1.0f / 20.0f, 0.5f, 0.1f, eUpscaleFilter_EdgeAware );
+
+	// Trace one pixel of every 2x2 block per frame; the image converges when the camera stops
+	m_pCamera->SetInterleavedRendering( m3dil_2x2 );
+
 	// m_pCamera->CalculateProjection( M3D_PI * 0.5f, 10.0f, 1 );
 
 	m_pCamera->SetPosition( vector3( 0, 0, -1 ) );
@@ -126,6 +132,6 @@ void CApp::RenderWorld()
 		m_pCamera->RenderPass( -1 );
 		m_pCamera->EndRender();
 		
-		Present( m_pCamera->pGetRenderTarget() );
+		Present( m_pCamera );
 	}
 }
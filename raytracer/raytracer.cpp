@@ -143,6 +143,7 @@ private:
 
 public:
 	bool bMightKillPixels() { return false; }
+	bool bNeedsDestinationColor() { return false; }
 	bool bExecute( const shaderreg *i_pInput, vector4 &io_vColor, float32 &io_fDepth )
 	{
 		const vector3 vRayOrigin = vGetVector( 0 );
@@ -21,6 +21,29 @@ public:
 			return vScaleA.r;
 	}
 
+	// Looks up the scales of 4 normals at once, so that the cube-faces are selected together.
+	void GetScale4( float32 *o_pScales, const vector3 *i_pNormals )
+	{
+		vector4 vCoords[4];
+		for( uint32 i = 0; i < 4; ++i )
+			vCoords[i] = i_pNormals[i];
+
+		vector4 vScalesA[4];
+		SampleTexture4( vScalesA, 2, vCoords );
+		if( fGetFloat( 0 ) > 0.0f )
+		{
+			vector4 vScalesB[4];
+			SampleTexture4( vScalesB, 3, vCoords );
+			for( uint32 i = 0; i < 4; ++i )
+				o_pScales[i] = fLerp( vScalesA[i].r, vScalesB[i].r, fGetFloat( 0 ) );
+		}
+		else
+		{
+			for( uint32 i = 0; i < 4; ++i )
+				o_pScales[i] = vScalesA[i].r;
+		}
+	}
+
 	void Execute( const shaderreg *i_pInput, vector4 &o_vPosition, shaderreg *o_pOutput )
 	{
 		vector3 vSphereNormal = i_pInput[0]; vSphereNormal.normalize();
@@ -39,10 +62,13 @@ public:
 		vNextSphereNormals[2] = vector3( cosf( fTheta ) * sinf( fPhi + fEpsilon ), cosf( fPhi + fEpsilon ), sinf( fTheta ) * sinf( fPhi + fEpsilon ) ); // down
 		vNextSphereNormals[3] = vector3( cosf( fTheta - fEpsilon ) * sinf( fPhi ), cosf( fPhi ), sinf( fTheta - fEpsilon ) * sinf( fPhi ) ); // left
 
+		float32 fNextScales[4];
+		GetScale4( fNextScales, vNextSphereNormals );
+
 		vector3 vDeltas[4];
 		for( uint32 i = 0; i < 4; ++i )
 		{
-			vDeltas[i] = ( vNextSphereNormals[i] * fGetScale( vNextSphereNormals[i] ) ) - vMyPos;
+			vDeltas[i] = ( vNextSphereNormals[i] * fNextScales[i] ) - vMyPos;
 			vDeltas[i].normalize();
 		}
 
@@ -107,6 +133,7 @@ class CSpherePS : public IMuli3DPixelShader
 {
 public:
 	bool bMightKillPixels() { return false; }
+	bool bNeedsDestinationColor() { return false; }
 	bool bExecute( const shaderreg *i_pInput, vector4 &io_vColor, float32 &io_fDepth )
 	{
 		vector3 vNormal = i_pInput[0]; vNormal.normalize();
@@ -198,6 +225,7 @@ class CCubePS : public IMuli3DPixelShader
 {
 public:
 	bool bMightKillPixels() { return false; }
+	bool bNeedsDestinationColor() { return false; }
 	bool bExecute( const shaderreg *i_pInput, vector4 &io_vColor, float32 &io_fDepth )
 	{
 		vector4 vCubeColorA; SampleTexture( vCubeColorA, 2, i_pInput[0].x, i_pInput[0].y, i_pInput[0].z );